@@ -0,0 +1,248 @@
+// Network DMX output benchmark.
+//
+// Sends a number of universes over loopback for a number of frames through each network
+// output path that was built in, and reports frames per second, packets per second and
+// the CPU time the sending thread spent per frame. A local receiver counts the packets
+// that arrive for the paths that unicast to it.
+//
+// On a machine without a network interface libartnet sends to its own socket over
+// loopback, and nothing reads those packets. The "unread" run sends the native ArtNet
+// packets to a socket that is never read either, for a like for like comparison.
+//
+// Usage: DMXNetBench [universes] [frames]
+
+#include <string>
+#include <atomic>
+#include <ctime>
+#include <iomanip>
+#include <thread>
+#include "LumiverseCoreConfig.h"
+#include "LumiverseCore.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace Lumiverse;
+
+// Counts the datagrams that arrive on a loopback port, or just lets them pile up.
+class Receiver {
+public:
+  Receiver(bool read = true) : m_count(0), m_running(true) {
+    m_socket = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    int bufSize = 16 * 1024 * 1024;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, (const char*)&bufSize, sizeof(bufSize));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = 0;
+    ::bind(m_socket, (sockaddr*)&addr, sizeof(addr));
+
+    socklen_t len = sizeof(addr);
+    getsockname(m_socket, (sockaddr*)&addr, &len);
+    m_port = ntohs(addr.sin_port);
+
+#ifndef _WIN32
+    timeval timeout = { 0, 100000 };
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+
+    m_thread = thread([this, read] {
+      char buf[1024];
+      while (m_running && read) {
+        if (recv(m_socket, buf, sizeof(buf), 0) > 0)
+          m_count++;
+      }
+    });
+  }
+
+  ~Receiver() {
+    m_running = false;
+    m_thread.join();
+    UDPBatch::closeSocket(m_socket);
+  }
+
+  int getPort() { return m_port; }
+
+  // Waits for packets in flight, then returns the count and starts over.
+  size_t take() {
+    this_thread::sleep_for(chrono::milliseconds(200));
+    return m_count.exchange(0);
+  }
+
+private:
+  int m_socket;
+  int m_port;
+  atomic<size_t> m_count;
+  atomic<bool> m_running;
+  thread m_thread;
+};
+
+#ifdef USE_ARTNET
+// Sends each universe with its own libartnet call, the way ArtNetInterface does without
+// its native sender. ArtNetInterface only drives libartnet's four ports, so this uses
+// the raw send that takes any 8 bit universe.
+class LibArtNetSender : public DMXInterface {
+public:
+  LibArtNetSender() : m_node(nullptr), m_failed(0) { m_ifaceId = "libartnet"; }
+
+  virtual void init() {
+    m_node = artnet_new(nullptr, 0);
+    if (m_node == nullptr) {
+      cout << "libartnet failed to start: " << artnet_strerror() << "\n";
+      return;
+    }
+
+    artnet_set_node_type(m_node, ARTNET_RAW);
+    if (artnet_start(m_node) != ARTNET_EOK)
+      cout << "libartnet failed to start: " << artnet_strerror() << "\n";
+  }
+
+  virtual void sendDMX(unsigned char* data, unsigned int universe) {
+    if (artnet_raw_send_dmx(m_node, (uint8_t)universe, 512, data) != ARTNET_EOK)
+      m_failed++;
+  }
+
+  size_t getFailed() { return m_failed; }
+
+  virtual void closeInt() {
+    if (m_node != nullptr)
+      artnet_destroy(m_node);
+    m_node = nullptr;
+  }
+
+  virtual void reset() { closeInt(); init(); }
+  virtual JSONNode toJSON() { return JSONNode(); }
+  virtual string getInterfaceType() { return "LibArtNetSender"; }
+
+private:
+  artnet_node m_node;
+  size_t m_failed;
+};
+#endif
+
+// CPU time used by the calling thread in seconds.
+double cpuTime() {
+#if defined(__linux__)
+  rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#elif !defined(_WIN32)
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#else
+  return clock() / (double)CLOCKS_PER_SEC;
+#endif
+}
+
+// Sends every universe through an interface for a number of frames and prints the results.
+void run(string name, DMXInterface* iface, int universes, int frames, int packetsPerFrame, Receiver* rx) {
+  vector<unsigned char> data(512, 0);
+
+  iface->init();
+  if (rx != nullptr)
+    rx->take();
+
+  double cpuStart = cpuTime();
+  auto start = chrono::high_resolution_clock::now();
+
+  for (int f = 0; f < frames; f++) {
+    data[f % 512] = (unsigned char)f;
+    for (int u = 0; u < universes; u++) {
+      iface->sendDMX(&data.front(), u);
+    }
+    iface->flush();
+  }
+
+  auto end = chrono::high_resolution_clock::now();
+  double cpu = cpuTime() - cpuStart;
+  double secs = chrono::duration<double>(end - start).count();
+
+  size_t received = (rx != nullptr) ? rx->take() : 0;
+  iface->closeInt();
+
+  cout << fixed << setprecision(1);
+  cout << left << setw(22) << name << right
+    << setw(10) << frames / secs << " frames/s"
+    << setw(12) << (double)frames * packetsPerFrame / secs << " packets/s"
+    << setw(10) << cpu / frames * 1e6 << " us CPU/frame";
+
+  if (rx != nullptr)
+    cout << "  (" << received << "/" << (size_t)frames * packetsPerFrame << " received)";
+  cout << "\n";
+}
+
+int main(int argc, char** argv) {
+  int universes = (argc > 1) ? atoi(argv[1]) : 256;
+  int frames = (argc > 2) ? atoi(argv[2]) : 1000;
+
+  Logger::setLogLevel(WARN);
+  cout << universes << " universes, " << frames << " frames over loopback\n";
+
+#ifdef USE_ARTNET
+  {
+    LibArtNetSender libartnet;
+    run("ArtNet (libartnet)", &libartnet, universes, frames, universes, nullptr);
+    if (libartnet.getFailed() > 0)
+      cout << "  " << libartnet.getFailed() << " libartnet sends failed\n";
+  }
+
+  {
+    Receiver rx;
+    set<unsigned int> all;
+    for (int u = 0; u < universes; u++)
+      all.insert(u);
+
+    ArtNetInterface native("native", "127.0.0.1");
+    native.setSync(false);
+    native.addNode(ArtNetNode("127.0.0.1", all, rx.getPort()));
+    run("ArtNet (native)", &native, universes, frames, universes, &rx);
+
+    native.setSync(true);
+    run("ArtNet (native+sync)", &native, universes, frames, universes + 1, &rx);
+  }
+
+  {
+    Receiver unread(false);
+    set<unsigned int> all;
+    for (int u = 0; u < universes; u++)
+      all.insert(u);
+
+    ArtNetInterface native("native", "127.0.0.1");
+    native.setSync(false);
+    native.addNode(ArtNetNode("127.0.0.1", all, unread.getPort()));
+    run("ArtNet (native unread)", &native, universes, frames, universes, nullptr);
+  }
+#endif
+
+#ifdef USE_SACN
+  {
+    Receiver rx;
+    SACNInterface sacn("sacn", "DMXNetBench", 100, "127.0.0.1", rx.getPort());
+    run("sACN", &sacn, universes, frames, universes, &rx);
+
+    sacn.setSyncUniverse(63999);
+    run("sACN+sync", &sacn, universes, frames, universes + 1, &rx);
+  }
+#endif
+
+#ifdef USE_KINET
+  {
+    // One KiNet v2 power supply, each port on its own universe
+    Receiver rx;
+    KiNetInterface kinet("kinet", "127.0.0.1", rx.getPort(), KinetProtocolType::NEW);
+    int ports = min(universes, (int)kinet.getNumChannels());
+    for (int p = 1; p <= ports; p++)
+      kinet.setPortUniverse(p, p - 1);
+
+    run("KiNet v2", &kinet, universes, frames, ports, &rx);
+  }
+#endif
+
+  return 0;
+}
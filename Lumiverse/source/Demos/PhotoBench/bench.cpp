@@ -0,0 +1,128 @@
+// Photo compositing benchmark.
+//
+// Blends a number of RGBA float light photos into one image, the way PhotoPatch renders a
+// frame, and reports milliseconds per frame. The "per light" run is the loop PhotoPatch
+// used before PhotoAccumulator: each light is added to the whole image in turn, checking
+// the interrupt flag once per row. The "tiled" run uses PhotoAccumulator.
+//
+// Each light of a rig has its own photo. Holding hundreds of full size photos takes more
+// memory than most machines have, so the lights cycle over a smaller pool of photos.
+// Every photo in the pool is far larger than the cache, so the memory traffic is the same
+// as with distinct photos.
+//
+// Usage: PhotoBench [width] [height] [photos] [frames]
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include "LumiverseCoreConfig.h"
+#include "LumiverseCore.h"
+
+using namespace std;
+using namespace Lumiverse;
+
+struct Photo {
+  float* data;
+  float intensity;
+  float color[3];
+};
+
+// Adds every light to the image in turn, as PhotoPatch::blendFloat did.
+bool blendPerLight(float* blended, const vector<Photo>& lights, int width, int height,
+  atomic_flag& interrupt) {
+  memset(blended, 0, (size_t)width * height * 4 * sizeof(float));
+
+  for (const Photo& light : lights) {
+    float rgba[4] = { light.color[0], light.color[1], light.color[2], 1.f };
+
+    for (int i = 0; i < height; i++) {
+      for (int j = 0; j < width; j++) {
+        for (size_t ch = 0; ch < 4; ch++) {
+          size_t offset = (width * i + j) * 4 + ch;
+          if (ch < 3)
+            blended[offset] += light.data[offset] * rgba[ch] * light.intensity;
+          else
+            blended[offset] += light.data[offset] * rgba[ch];
+        }
+      }
+      if (!interrupt.test_and_set())
+        return false;
+    }
+  }
+
+  return true;
+}
+
+template<typename F>
+double msPerFrame(int frames, F render) {
+  render();
+
+  auto start = chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++)
+    render();
+  chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+  return elapsed.count() / frames;
+}
+
+int main(int argc, char** argv) {
+  int width = (argc > 1) ? atoi(argv[1]) : 1920;
+  int height = (argc > 2) ? atoi(argv[2]) : 1080;
+  int numPhotos = (argc > 3) ? atoi(argv[3]) : 24;
+  int frames = (argc > 4) ? atoi(argv[4]) : 3;
+  size_t numFloats = (size_t)width * height * 4;
+
+  vector<float*> pool(numPhotos);
+  for (int p = 0; p < numPhotos; p++) {
+    pool[p] = new float[numFloats];
+    for (size_t i = 0; i < numFloats; i++)
+      pool[p][i] = (float)((i + p * 7) % 256) / 255;
+  }
+
+  float* blended = new float[numFloats];
+  atomic_flag interrupt = ATOMIC_FLAG_INIT;
+  interrupt.test_and_set();
+
+  PhotoAccumulator accumulator(ThreadPool::getShared());
+
+  cout << width << "x" << height << ", " << numPhotos << " distinct photos, "
+    << frames << " frames, " << PhotoAccumulator::getInstructionSet() << " kernel, "
+    << thread::hardware_concurrency() << " hardware threads\n";
+  cout << left << setw(8) << "lights" << right << setw(16) << "per light ms"
+    << setw(12) << "tiled ms" << setw(10) << "speedup" << "\n";
+  cout << fixed << setprecision(1);
+
+  for (int numLights : { 50, 100, 250, 500 }) {
+    vector<Photo> photos(numLights);
+    vector<PhotoAccumulator::Light> lights(numLights);
+    for (int l = 0; l < numLights; l++) {
+      photos[l] = { pool[l % numPhotos], 0.5f + (l % 5) * 0.1f, { 1.f, 0.8f, 0.6f } };
+
+      PhotoAccumulator::Light light = { photos[l].data, {
+        photos[l].color[0] * photos[l].intensity,
+        photos[l].color[1] * photos[l].intensity,
+        photos[l].color[2] * photos[l].intensity,
+        1.f } };
+      lights[l] = light;
+    }
+
+    double perLight = msPerFrame(frames, [&]() {
+      blendPerLight(blended, photos, width, height, interrupt);
+    });
+
+    double tiled = msPerFrame(frames, [&]() {
+      accumulator.accumulate(blended, (size_t)width * height, lights,
+        [&]() { return !interrupt.test_and_set(); });
+    });
+
+    cout << left << setw(8) << numLights << right << setw(16) << perLight
+      << setw(12) << tiled << setw(9) << perLight / tiled << "x\n";
+  }
+
+  delete[] blended;
+  for (float* p : pool)
+    delete[] p;
+
+  return 0;
+}
@@ -0,0 +1,332 @@
+// Timeline evaluation benchmark.
+//
+// Loads a rig and the cues from a playback file, stitches each cue list into a single
+// Timeline, then evaluates every device parameter at 40Hz over the length of each
+// Timeline using a few different lookup methods.
+//
+// Usage: TimelineBench [rig file] [playback file] [passes]
+
+#include <string>
+#include <iomanip>
+#include "LumiverseCoreConfig.h"
+#include "LumiverseCore.h"
+#include "LumiverseShowControl.h"
+
+using namespace std;
+using namespace Lumiverse;
+using namespace Lumiverse::ShowControl;
+
+struct BenchParam {
+  string id;
+  string param;
+  LumiverseType* val;
+};
+
+// Reads a file into a JSONNode.
+JSONNode loadJSONFile(string filename) {
+  ifstream data(filename, ios::in | ios::binary);
+  if (!data.is_open()) {
+    Logger::log(ERR, "Unable to open " + filename);
+    return JSONNode();
+  }
+
+  stringstream ss;
+  ss << data.rdbuf();
+  return libjson::parse(ss.str());
+}
+
+// Builds one Timeline per cue list. Cues in the file store keyframe times in seconds and
+// leave the end value blank when it comes from cue timing, so blank values hold the
+// previous keyframe's value.
+map<string, shared_ptr<Timeline> > loadCueLists(JSONNode root) {
+  map<string, shared_ptr<Timeline> > timelines;
+
+  auto pb = root.find("playback");
+  if (pb == root.end())
+    return timelines;
+
+  auto cueLists = pb->find("cueLists");
+  if (cueLists == pb->end())
+    return timelines;
+
+  for (auto list = cueLists->begin(); list != cueLists->end(); list++) {
+    auto cues = list->find("cues");
+    if (cues == list->end())
+      continue;
+
+    // Sort cues by number
+    map<float, JSONNode> sorted;
+    for (auto cue = cues->begin(); cue != cues->end(); cue++) {
+      sorted[stof(cue->name())] = *cue;
+    }
+
+    shared_ptr<Timeline> tl(new Timeline());
+    size_t offset = 0;
+
+    for (auto& cue : sorted) {
+      auto cueData = cue.second.find("cueData");
+      if (cueData == cue.second.end())
+        continue;
+
+      size_t cueLength = 0;
+      for (auto device = cueData->begin(); device != cueData->end(); device++) {
+        for (auto param = device->begin(); param != device->end(); param++) {
+          shared_ptr<LumiverseType> last;
+
+          map<size_t, JSONNode> keyframes;
+          for (auto kf = param->begin(); kf != param->end(); kf++) {
+            keyframes[(size_t)(kf->find("time")->as_float() * 1000)] = *kf;
+          }
+
+          for (auto& kf : keyframes) {
+            auto val = kf.second.find("val");
+            if (val != kf.second.end() && val->type() == JSON_NODE) {
+              last = shared_ptr<LumiverseType>(LumiverseTypeUtils::loadFromJSON(*val));
+            }
+
+            if (last == nullptr)
+              continue;
+
+            tl->setKeyframe(tl->getTimelineKey(device->name(), param->name()), offset + kf.first, last.get());
+            cueLength = max(cueLength, kf.first);
+          }
+        }
+      }
+
+      // Hold each cue for a second before the next one starts
+      offset += cueLength + 1000;
+    }
+
+    timelines[list->name()] = tl;
+  }
+
+  return timelines;
+}
+
+// The lookup Timeline::getValueAtTime used before keyframe tracks: copy the keyframe map
+// and scan it for the first keyframe after the given time.
+shared_ptr<LumiverseType> legacyValueAtTime(map<string, map<size_t, Keyframe> >& data, const string& identifier, size_t time) {
+  auto it = data.find(identifier);
+  if (it == data.end())
+    return nullptr;
+
+  auto keyframes = it->second;
+  if (keyframes.size() == 0)
+    return nullptr;
+
+  for (auto keyframe = keyframes.begin(); keyframe != keyframes.end(); ++keyframe) {
+    if (keyframe->first > time) {
+      Keyframe next = keyframe->second;
+      Keyframe first = (keyframe == keyframes.begin()) ? next : prev(keyframe)->second;
+      float a = (next.t > first.t) ? (float)(time - first.t) / (float)(next.t - first.t) : 0;
+      return LumiverseTypeUtils::lerp(first.val.get(), next.val.get(), a);
+    }
+  }
+
+  return keyframes.rbegin()->second.val;
+}
+
+// Compares two values. Scalars are allowed a small rounding error, and color channel
+// order in asString() isn't fixed, so colors are compared channel by channel.
+bool sameValue(LumiverseType* a, LumiverseType* b) {
+  if (a->getTypeName() == "float" && b->getTypeName() == "float")
+    return abs(((LumiverseFloat*)a)->getVal() - ((LumiverseFloat*)b)->getVal()) < 1e-4;
+
+  if (a->getTypeName() == "orientation" && b->getTypeName() == "orientation")
+    return abs(((LumiverseOrientation*)a)->valAsUnit(DEGREE) - ((LumiverseOrientation*)b)->valAsUnit(DEGREE)) < 1e-3;
+
+  if (a->getTypeName() == "color" && b->getTypeName() == "color") {
+    LumiverseColor* ca = (LumiverseColor*)a;
+    LumiverseColor* cb = (LumiverseColor*)b;
+    auto pb = cb->getColorParams();
+
+    if (abs(ca->getWeight() - cb->getWeight()) > 1e-5)
+      return false;
+
+    for (const auto& c : ca->getColorParams()) {
+      if (pb.count(c.first) == 0 || abs(c.second - pb[c.first]) > 1e-5)
+        return false;
+    }
+    return true;
+  }
+
+  return a->asString() == b->asString();
+}
+
+// Runs f(time) for every frame of every timeline and returns the average time per
+// parameter evaluation in nanoseconds.
+double run(map<string, shared_ptr<Timeline> >& timelines, size_t numParams, int passes,
+  function<void(const string&, Timeline*, size_t)> f)
+{
+  size_t evals = 0;
+  auto start = chrono::high_resolution_clock::now();
+
+  for (int p = 0; p < passes; p++) {
+    for (auto& tl : timelines) {
+      size_t length = tl.second->getLength();
+      for (size_t t = 0; t <= length; t += 25) {
+        f(tl.first, tl.second.get(), t);
+        evals += numParams;
+      }
+    }
+  }
+
+  auto end = chrono::high_resolution_clock::now();
+  return chrono::duration_cast<chrono::nanoseconds>(end - start).count() / (double)evals;
+}
+
+int main(int argc, char** argv) {
+  string rigFile = (argc > 1) ? argv[1] : "../../../data/movingLights_box.rig.json";
+  string pbFile = (argc > 2) ? argv[2] : "../../../data/movingLights_box.playback.json";
+  int passes = (argc > 3) ? atoi(argv[3]) : 200;
+
+  Logger::setLogLevel(ERR);
+
+  Rig rig(rigFile);
+  auto timelines = loadCueLists(loadJSONFile(pbFile));
+
+  if (rig.getNumDevices() == 0 || timelines.size() == 0) {
+    cout << "Nothing to benchmark. Check the rig and playback file paths.\n";
+    return 1;
+  }
+
+  vector<BenchParam> params;
+  DeviceSet devices = rig.getAllDevices();
+  for (Device* d : devices.getDevices()) {
+    for (auto& p : d->getRawParameters()) {
+      params.push_back({ d->getId(), p.first, p.second });
+    }
+  }
+
+  size_t frames = 0;
+  for (auto& tl : timelines) {
+    tl.second->getTrackVersion();
+    frames += tl.second->getLength() / 25 + 1;
+  }
+
+  cout << timelines.size() << " timelines, " << params.size() << " parameters, " << frames << " frames, " << passes << " passes\n";
+
+  map<string, shared_ptr<Timeline> > tls = timelines;
+  map<string, map<string, map<size_t, Keyframe> > > legacyData;
+  for (auto& tl : timelines) {
+    legacyData[tl.first] = tl.second->getAllKeyframes();
+    tl.second->getTrackVersion();
+  }
+
+  // Check that all methods agree before timing anything.
+  size_t mismatches = 0;
+  for (auto& tl : timelines) {
+    vector<TrackCursor> cursors(params.size());
+    for (size_t i = 0; i < params.size(); i++)
+      cursors[i].track = tl.second->getTrackIndex(tl.second->getTimelineKey(params[i].id, params[i].param));
+
+    for (size_t t = 0; t <= tl.second->getLength(); t += 25) {
+      for (size_t i = 0; i < params.size(); i++) {
+        auto a = legacyValueAtTime(legacyData[tl.first], tl.second->getTimelineKey(params[i].id, params[i].param), t);
+        auto b = tl.second->getValueAtTime(params[i].id, params[i].param, params[i].val, t, tls);
+        auto c = tl.second->getValueAtCursor(cursors[i], params[i].id, params[i].param, params[i].val, t, tls);
+
+        if ((a == nullptr) != (b == nullptr) || (b == nullptr) != (c == nullptr) ||
+          (a != nullptr && (!sameValue(a.get(), b.get()) || !sameValue(b.get(), c.get())))) {
+          mismatches++;
+        }
+      }
+    }
+  }
+
+  // Baked curves, with cursors for anything that couldn't be baked. The playhead writes
+  // into copies of the parameters so they can be compared with getValueAtTime.
+  struct BakedTimeline {
+    CurvePlayhead playhead;
+    vector<shared_ptr<LumiverseType> > vals;
+    vector<size_t> unbaked;
+    vector<TrackCursor> cursors;
+  };
+
+  map<string, BakedTimeline> baked;
+  size_t numBaked = 0;
+  for (auto& tl : timelines) {
+    BakedTimeline& b = baked[tl.first];
+    b.playhead.reset(tl.second->getBakedCurves());
+
+    for (size_t i = 0; i < params.size(); i++) {
+      b.vals.push_back(shared_ptr<LumiverseType>(LumiverseTypeUtils::copy(params[i].val)));
+
+      int track = tl.second->getTrackIndex(tl.second->getTimelineKey(params[i].id, params[i].param));
+      if (track >= 0 && b.playhead.bind(track, b.vals.back().get())) {
+        numBaked++;
+        continue;
+      }
+
+      TrackCursor c;
+      c.track = track;
+      b.unbaked.push_back(i);
+      b.cursors.push_back(c);
+    }
+
+    for (size_t t = 0; t <= tl.second->getLength(); t += 25) {
+      b.playhead.evaluate(tl.second->getLoopTime(t));
+
+      for (size_t i = 0; i < params.size(); i++) {
+        auto expected = tl.second->getValueAtTime(params[i].id, params[i].param, params[i].val, t, tls);
+        if (expected != nullptr && !sameValue(expected.get(), b.vals[i].get()) &&
+          find(b.unbaked.begin(), b.unbaked.end(), i) == b.unbaked.end()) {
+          mismatches++;
+        }
+      }
+    }
+  }
+
+  double legacy = run(timelines, params.size(), passes, [&](const string& name, Timeline* tl, size_t t) {
+    auto& data = legacyData[name];
+    for (auto& p : params) {
+      auto val = legacyValueAtTime(data, tl->getTimelineKey(p.id, p.param), t);
+      if (val != nullptr) LumiverseTypeUtils::copyByVal(val.get(), p.val);
+    }
+  });
+
+  double search = run(timelines, params.size(), passes, [&](const string&, Timeline* tl, size_t t) {
+    for (auto& p : params) {
+      auto val = tl->getValueAtTime(p.id, p.param, p.val, t, tls);
+      if (val != nullptr) LumiverseTypeUtils::copyByVal(val.get(), p.val);
+    }
+  });
+
+  map<string, vector<TrackCursor> > cursors;
+  for (auto& tl : timelines) {
+    for (auto& p : params) {
+      TrackCursor c;
+      c.track = tl.second->getTrackIndex(tl.second->getTimelineKey(p.id, p.param));
+      cursors[tl.first].push_back(c);
+    }
+  }
+
+  double cursor = run(timelines, params.size(), passes, [&](const string& name, Timeline* tl, size_t t) {
+    auto& c = cursors[name];
+    for (size_t i = 0; i < params.size(); i++) {
+      auto val = tl->getValueAtCursor(c[i], params[i].id, params[i].param, params[i].val, t, tls);
+      if (val != nullptr) LumiverseTypeUtils::copyByVal(val.get(), params[i].val);
+    }
+  });
+
+  double bakedTime = run(timelines, params.size(), passes, [&](const string& name, Timeline* tl, size_t t) {
+    auto& b = baked[name];
+    b.playhead.evaluate(tl->getLoopTime(t));
+
+    for (size_t j = 0; j < b.unbaked.size(); j++) {
+      BenchParam& p = params[b.unbaked[j]];
+      auto val = tl->getValueAtCursor(b.cursors[j], p.id, p.param, p.val, t, tls);
+      if (val != nullptr) LumiverseTypeUtils::copyByVal(val.get(), b.vals[b.unbaked[j]].get());
+    }
+  });
+
+  cout << fixed << setprecision(1);
+  cout << "legacy map copy + scan: " << legacy << " ns/param\n";
+  cout << "binary search:          " << search << " ns/param (" << legacy / search << "x)\n";
+  cout << "track cursor:           " << cursor << " ns/param (" << legacy / cursor << "x)\n";
+  cout << "baked curves:           " << bakedTime << " ns/param (" << legacy / bakedTime << "x, "
+    << numBaked << "/" << params.size() * timelines.size() << " baked)\n";
+  cout << "mismatched values:      " << mismatches << "\n";
+
+  return (mismatches == 0) ? 0 : 1;
+}
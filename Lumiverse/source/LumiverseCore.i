@@ -23,6 +23,7 @@ using namespace std;
 %shared_ptr(Lumiverse::LumiverseFloat)
 %shared_ptr(Lumiverse::LumiverseColor)
 %shared_ptr(Lumiverse::LumiverseOrientation)
+%shared_ptr(Lumiverse::DMXCurve)
 
 %apply const std::string& {std::string* m_id};
 %apply const std::string& {std::string* m_type};
@@ -50,6 +51,7 @@ using namespace Lumiverse::ShowControl;
 %include "types/LumiverseColorLib.h"
 %include "types/LumiverseTypeUtils.h"
 %include "DMX/KiNetInterface.h"
+%include "DMX/DMXCurve.h"
 %include "DMX/DMXDevicePatch.h"
 %include "DMX/ArtNetInterface.h"
 %include "Device.h"
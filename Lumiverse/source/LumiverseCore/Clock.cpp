@@ -0,0 +1,11 @@
+#include "Clock.h"
+
+namespace Lumiverse {
+
+SteppingClock::SteppingClock(time_point start) : m_ticks(start.time_since_epoch().count()) { }
+
+Clock::time_point SteppingClock::now() {
+  return time_point(duration(m_ticks.load()));
+}
+
+}
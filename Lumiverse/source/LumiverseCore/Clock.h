@@ -0,0 +1,68 @@
+/*! \file Clock.h
+* \brief Time sources for the Rig and Playback.
+*/
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+namespace Lumiverse {
+  /*!
+  \brief Source of the current time for everything that animates.
+
+  Layers and Playback read the time from the Rig's clock instead of the system, so a
+  show can be evaluated on a virtual timeline. Time points use the same type as
+  chrono::high_resolution_clock so they can be passed to existing update functions.
+  \sa SystemClock, SteppingClock, Rig::setClock()
+  */
+  class Clock
+  {
+  public:
+    typedef chrono::high_resolution_clock::time_point time_point;
+    typedef chrono::high_resolution_clock::duration duration;
+
+    virtual ~Clock() { }
+
+    /*! \brief Returns the current time. Must be safe to call from any thread. */
+    virtual time_point now() = 0;
+  };
+
+  /*! \brief Wall clock time. The default clock of a Rig. */
+  class SystemClock : public Clock
+  {
+  public:
+    virtual time_point now() { return chrono::high_resolution_clock::now(); }
+  };
+
+  /*!
+  \brief A clock that only moves when told to.
+
+  Lets a show be evaluated faster (or slower) than real time, with exactly the same
+  frame times every run.
+  */
+  class SteppingClock : public Clock
+  {
+  public:
+    /*! \brief Creates a clock stopped at the given time. */
+    SteppingClock(time_point start = time_point());
+
+    virtual time_point now();
+
+    /*! \brief Moves the clock forward. */
+    void step(duration d) { m_ticks.fetch_add(d.count()); }
+
+    /*! \brief Sets the clock to the given time. */
+    void setTime(time_point t) { m_ticks.store(t.time_since_epoch().count()); }
+
+  private:
+    /*! \brief Current time as a count of clock durations since the epoch. */
+    atomic<duration::rep> m_ticks;
+  };
+}
+
+#endif
@@ -2,10 +2,70 @@
 
 #ifdef USE_ARTNET
 
+#include <chrono>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/select.h>
+#endif
+
 namespace Lumiverse {
 
+namespace {
+
+const unsigned char ARTNET_ID[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+
+const uint16_t OP_POLL = 0x2000;
+const uint16_t OP_POLL_REPLY = 0x2100;
+const uint16_t OP_DMX = 0x5000;
+const uint16_t OP_SYNC = 0x5200;
+
+const int ARTNET_UDP_PORT = 6454;
+
+// Offsets into an ArtDmx packet
+const size_t DMX_SEQUENCE = 12;
+const size_t DMX_DATA = 18;
+
+// Offsets into an ArtPollReply
+const size_t REPLY_IP = 10;
+const size_t REPLY_NET = 18;
+const size_t REPLY_SUBNET = 19;
+const size_t REPLY_SHORT_NAME = 26;
+const size_t REPLY_NUM_PORTS = 173;
+const size_t REPLY_PORT_TYPES = 174;
+const size_t REPLY_SW_OUT = 190;
+const size_t REPLY_MIN_SIZE = 194;
+
+// ID, op code (little endian) and protocol version 14
+void putHeader(unsigned char* p, uint16_t opCode) {
+  memcpy(p, ARTNET_ID, 8);
+  p[8] = opCode & 0xff;
+  p[9] = opCode >> 8;
+  p[10] = 0;
+  p[11] = 14;
+}
+
+sockaddr_in makeAddr(in_addr ip, int port) {
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr = ip;
+  addr.sin_port = htons((unsigned short)port);
+  return addr;
+}
+
+bool sameAddr(const sockaddr_in& a, const sockaddr_in& b) {
+  return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+}
+
+const size_t ArtNetInterface::DMX_PACKET_SIZE;
+const size_t ArtNetInterface::SYNC_PACKET_SIZE;
+
 ArtNetInterface::ArtNetInterface(string id, string ip, string broadcast, bool verbose) :
-  m_ip(ip), m_broadcast(broadcast), m_verbose(verbose)
+  m_ip(ip), m_broadcast(broadcast), m_verbose(verbose), m_native(false), m_sync(true), m_discover(false),
+  m_socket(-1), m_sequence(1)
 {
   m_connected = false;
   m_ifaceId = id;
@@ -13,9 +73,27 @@ ArtNetInterface::ArtNetInterface(string id, string ip, string broadcast, bool ve
 
 ArtNetInterface::~ArtNetInterface()
 {
+  closeInt();
 }
 
 void ArtNetInterface::init() {
+  if (m_native) {
+    if (!initNative())
+      return;
+
+    if (m_discover) {
+      int found = discoverNodes();
+      if (found >= 0) {
+        stringstream ss;
+        ss << "ArtNet interface " << m_ifaceId << " found " << found << " nodes";
+        Logger::log(INFO, ss.str());
+      }
+    }
+
+    m_connected = true;
+    return;
+  }
+
   // Set up ArtNet Node
   if ((m_node = artnet_new(m_ip.c_str(), m_verbose)) == NULL) {
     stringstream ss;
@@ -30,35 +108,337 @@ void ArtNetInterface::init() {
   artnet_set_node_type(m_node, ARTNET_NODE);
   artnet_set_subnet_addr(m_node, 0);
 
-  // Start. 
+  // Start.
   if (artnet_start(m_node) != ARTNET_EOK) {
     stringstream ss;
     ss << "Failed to start ArtNet node. ArtNet error: " << artnet_strerror();
     Logger::log(ERR, ss.str());
-    closeInt();
+    artnet_destroy(m_node);
     return;
   }
 
   m_connected = true;
 }
 
+bool ArtNetInterface::initNative() {
+#ifdef _WIN32
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR)
+    Logger::log(ERR, "Error at WSAStartup()");
+#endif
+
+  string broadcast = (m_broadcast == "") ? "255.255.255.255" : m_broadcast;
+  m_broadcastAddr.s_addr = inet_addr(broadcast.c_str());
+
+  // The trailing 255 octets of the broadcast address are the host part
+  uint32_t b = ntohl(m_broadcastAddr.s_addr);
+  uint32_t mask = 0;
+  for (int shift = 0; shift < 32 && ((b >> shift) & 0xff) == 0xff; shift += 8)
+    mask |= 0xffu << shift;
+  m_broadcastMask = htonl(mask);
+
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    Logger::log(ERR, "ArtNet interface " + m_ifaceId + " could not create a socket.");
+    return false;
+  }
+
+  int on = 1;
+  setsockopt(sock, SOL_SOCKET, SO_BROADCAST, (const char*)&on, sizeof(on));
+
+  // Send from the interface with the given address
+  if (m_ip != "") {
+    in_addr local;
+    local.s_addr = inet_addr(m_ip.c_str());
+    sockaddr_in addr = makeAddr(local, 0);
+    if (::bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0)
+      Logger::log(WARN, "ArtNet interface " + m_ifaceId + " can't send from " + m_ip);
+  }
+
+  putHeader(m_syncPacket, OP_SYNC);
+  m_syncPacket[12] = 0;
+  m_syncPacket[13] = 0;
+
+  m_outputs.clear();
+  m_queued.clear();
+  m_syncDests.clear();
+
+  m_socket = sock;
+
+  // Name lookups can block, so they happen here rather than on the output thread
+  for (size_t i = 0; i < m_nodes.size(); i++)
+    resolveNode(i);
+
+  return true;
+}
+
+void ArtNetInterface::addNode(ArtNetNode node) {
+  m_nodes.push_back(node);
+  m_nodeAddrs.resize(m_nodes.size());
+
+  if (m_socket >= 0)
+    resolveNode(m_nodes.size() - 1);
+  else
+    m_nodeAddrs.back().s_addr = INADDR_NONE;
+
+  // Destinations depend on the node table
+  m_outputs.clear();
+  m_queued.clear();
+  m_syncDests.clear();
+}
+
+void ArtNetInterface::resolveNode(size_t i) {
+  if (!UDPBatch::resolve(m_nodes[i].ip, m_nodeAddrs[i])) {
+    Logger::log(WARN, "ArtNet interface " + m_ifaceId + " can't resolve node " + m_nodes[i].ip);
+    m_nodeAddrs[i].s_addr = INADDR_NONE;
+  }
+}
+
+void ArtNetInterface::clearNodes() {
+  m_nodes.clear();
+  m_nodeAddrs.clear();
+  m_outputs.clear();
+  m_queued.clear();
+  m_syncDests.clear();
+}
+
+ArtNetInterface::Output* ArtNetInterface::getOutput(unsigned int universe) {
+  if (universe >= m_outputs.size())
+    m_outputs.resize(universe + 1);
+
+  if (m_outputs[universe] != nullptr)
+    return m_outputs[universe].get();
+
+  Output* out = new Output();
+  unsigned char* p = out->packet;
+  memset(p, 0, DMX_PACKET_SIZE);
+
+  putHeader(p, OP_DMX);
+  p[13] = 0;                          // Physical port
+  p[14] = universe & 0xff;            // SubUni
+  p[15] = (universe >> 8) & 0x7f;     // Net
+  p[16] = 512 >> 8;
+  p[17] = 512 & 0xff;
+
+  for (size_t i = 0; i < m_nodes.size(); i++) {
+    if (m_nodes[i].universes.count(universe) == 0 || m_nodeAddrs[i].s_addr == INADDR_NONE)
+      continue;
+
+    sockaddr_in dest = makeAddr(m_nodeAddrs[i], m_nodes[i].port);
+    bool dup = false;
+    for (auto& d : out->dests)
+      dup = dup || sameAddr(d, dest);
+
+    if (!dup)
+      out->dests.push_back(dest);
+  }
+
+  // Nobody claimed this universe
+  if (out->dests.empty())
+    out->dests.push_back(makeAddr(m_broadcastAddr, ARTNET_UDP_PORT));
+
+  for (auto& d : out->dests)
+    addSyncDest(d);
+
+  out->queued = false;
+  m_outputs[universe].reset(out);
+  return out;
+}
+
+void ArtNetInterface::addSyncDest(const sockaddr_in& dest) {
+  sockaddr_in sync = dest;
+
+  uint32_t net = ~m_broadcastMask;
+  if (ntohs(dest.sin_port) == ARTNET_UDP_PORT &&
+    (dest.sin_addr.s_addr & net) == (m_broadcastAddr.s_addr & net))
+  {
+    sync = makeAddr(m_broadcastAddr, ARTNET_UDP_PORT);
+  }
+
+  for (auto& d : m_syncDests) {
+    if (sameAddr(d, sync))
+      return;
+  }
+
+  m_syncDests.push_back(sync);
+}
+
 void ArtNetInterface::sendDMX(unsigned char* data, unsigned int universe) {
+  if (!m_connected)
+    return;
+
+  if (m_socket >= 0) {
+    if (universe > 0x7fff)
+      return;
+
+    Output* out = getOutput(universe);
+    memcpy(out->packet + DMX_DATA, data, 512);
+
+    if (!out->queued) {
+      out->queued = true;
+      m_queued.push_back(universe);
+    }
+    return;
+  }
+
   if (m_universes.count(universe) == 0)
     initUniverse(universe);
 
   artnet_send_dmx(m_node, universe, ARTNET_DMX_LENGTH, data);
 }
 
+void ArtNetInterface::flush() {
+  if (!m_connected || m_socket < 0 || m_queued.empty())
+    return;
+
+  for (unsigned int u : m_queued) {
+    Output* out = m_outputs[u].get();
+    out->queued = false;
+    out->packet[DMX_SEQUENCE] = m_sequence;
+
+    for (auto& d : out->dests)
+      m_batch.add(out->packet, DMX_PACKET_SIZE, &d);
+  }
+  m_queued.clear();
+
+  if (m_sync) {
+    for (auto& d : m_syncDests)
+      m_batch.add(m_syncPacket, SYNC_PACKET_SIZE, &d);
+  }
+
+  // 0 tells nodes not to reorder packets, so skip it
+  m_sequence = (m_sequence == 255) ? 1 : m_sequence + 1;
+
+  m_batch.send(m_socket);
+}
+
 void ArtNetInterface::initUniverse(int universe) {
   artnet_set_port_type(m_node, universe, ARTNET_ENABLE_OUTPUT, ARTNET_PORT_DMX);
   artnet_set_port_addr(m_node, universe, ARTNET_OUTPUT_PORT, universe);
-  
+
   m_universes.insert(universe);
 }
 
+int ArtNetInterface::discoverNodes(int timeout) {
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    Logger::log(ERR, "ArtNet interface " + m_ifaceId + " could not create a socket for discovery.");
+    return -1;
+  }
+
+  int on = 1;
+  setsockopt(sock, SOL_SOCKET, SO_BROADCAST, (const char*)&on, sizeof(on));
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+
+  // Replies come back to the ArtNet port
+  in_addr any;
+  any.s_addr = htonl(INADDR_ANY);
+  sockaddr_in local = makeAddr(any, ARTNET_UDP_PORT);
+  if (::bind(sock, (sockaddr*)&local, sizeof(local)) != 0) {
+    Logger::log(ERR, "ArtNet interface " + m_ifaceId + " can't listen for ArtPollReply on port 6454.");
+    UDPBatch::closeSocket(sock);
+    return -1;
+  }
+
+  string broadcast = (m_broadcast == "") ? "255.255.255.255" : m_broadcast;
+  in_addr bcast;
+  bcast.s_addr = inet_addr(broadcast.c_str());
+  sockaddr_in dest = makeAddr(bcast, ARTNET_UDP_PORT);
+
+  unsigned char poll[14];
+  putHeader(poll, OP_POLL);
+  poll[12] = 0;   // Flags
+  poll[13] = 0;   // Diagnostics priority
+
+  if (sendto(sock, (const char*)poll, sizeof(poll), 0, (sockaddr*)&dest, sizeof(dest)) < 0) {
+    Logger::log(ERR, "ArtNet interface " + m_ifaceId + " couldn't send ArtPoll.");
+    UDPBatch::closeSocket(sock);
+    return -1;
+  }
+
+  int found = 0;
+  auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+  unsigned char buf[1024];
+
+  while (true) {
+    auto left = chrono::duration_cast<chrono::microseconds>(deadline - chrono::steady_clock::now()).count();
+    if (left <= 0)
+      break;
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    timeval tv;
+    tv.tv_sec = (long)(left / 1000000);
+    tv.tv_usec = (long)(left % 1000000);
+
+    if (select(sock + 1, &fds, nullptr, nullptr, &tv) <= 0)
+      break;
+
+    int size = (int)recv(sock, (char*)buf, sizeof(buf), 0);
+    if (size > 0 && readPollReply(buf, size))
+      found++;
+  }
+
+  UDPBatch::closeSocket(sock);
+  return found;
+}
+
+bool ArtNetInterface::readPollReply(const unsigned char* data, size_t size) {
+  if (size < REPLY_MIN_SIZE || memcmp(data, ARTNET_ID, 8) != 0)
+    return false;
+
+  if ((data[8] | (data[9] << 8)) != OP_POLL_REPLY)
+    return false;
+
+  stringstream ip;
+  ip << (int)data[REPLY_IP] << "." << (int)data[REPLY_IP + 1] << "." << (int)data[REPLY_IP + 2] << "."
+    << (int)data[REPLY_IP + 3];
+
+  ArtNetNode node;
+  node.ip = ip.str();
+  node.name = string((const char*)data + REPLY_SHORT_NAME, strnlen((const char*)data + REPLY_SHORT_NAME, 18));
+
+  // Port address is net:subnet:universe
+  int ports = min((int)data[REPLY_NUM_PORTS], 4);
+  for (int i = 0; i < ports; i++) {
+    if (!(data[REPLY_PORT_TYPES + i] & 0x80))
+      continue;
+
+    unsigned int addr = ((data[REPLY_NET] & 0x7f) << 8) | ((data[REPLY_SUBNET] & 0x0f) << 4) |
+      (data[REPLY_SW_OUT + i] & 0x0f);
+    node.universes.insert(addr);
+  }
+
+  // Nodes with several bind indexes reply once per group of ports
+  for (auto& n : m_nodes) {
+    if (n.ip == node.ip && n.port == node.port) {
+      n.universes.insert(node.universes.begin(), node.universes.end());
+      n.name = node.name;
+      m_outputs.clear();
+      m_queued.clear();
+      m_syncDests.clear();
+      return true;
+    }
+  }
+
+  addNode(node);
+  return true;
+}
+
 void ArtNetInterface::closeInt() {
   if (m_connected) {
-    artnet_destroy(m_node);
+    if (m_socket >= 0) {
+      UDPBatch::closeSocket(m_socket);
+      m_socket = -1;
+      m_outputs.clear();
+      m_queued.clear();
+      m_syncDests.clear();
+    }
+    else {
+      artnet_destroy(m_node);
+      m_universes.clear();
+    }
 
     m_connected = false;
   }
@@ -77,10 +457,30 @@ JSONNode ArtNetInterface::toJSON() {
   root.push_back(JSONNode("ip", m_ip));
   root.push_back(JSONNode("broadcast", m_broadcast));
   root.push_back(JSONNode("verbose", m_verbose));
+  root.push_back(JSONNode("native", m_native));
+  root.push_back(JSONNode("sync", m_sync));
+  root.push_back(JSONNode("discover", m_discover));
+
+  JSONNode nodes(JSON_ARRAY);
+  nodes.set_name("nodes");
+  for (auto& n : m_nodes) {
+    JSONNode node;
+    node.push_back(JSONNode("ip", n.ip));
+    node.push_back(JSONNode("port", n.port));
+
+    JSONNode universes(JSON_ARRAY);
+    universes.set_name("universes");
+    for (unsigned int u : n.universes)
+      universes.push_back(JSONNode("", (int)u));
+    node.push_back(universes);
+
+    nodes.push_back(node);
+  }
+  root.push_back(nodes);
 
   return root;
 }
 
 }
 
-#endif
\ No newline at end of file
+#endif
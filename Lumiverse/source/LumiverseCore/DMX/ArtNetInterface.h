@@ -13,20 +13,66 @@
 #include <lib/libjson/libjson.h>
 
 #include "DMXInterface.h"
+#include "UDPBatch.h"
 #include "Logger.h"
+#include <memory>
 #include <string>
 #include <sstream>
 #include <iostream>
 #include <set>
+#include <vector>
 
 namespace Lumiverse {
+  /*!
+  * \brief An ArtNet node that universes are unicast to.
+  */
+  struct ArtNetNode {
+    ArtNetNode() : port(6454) { }
+    ArtNetNode(string ip, set<unsigned int> universes, int port = 6454) :
+      ip(ip), port(port), universes(universes) { }
+
+    /*! \brief IP address of the node */
+    string ip;
+
+    /*! \brief UDP port of the node. 6454 is the standard port. */
+    int port;
+
+    /*! \brief Port addresses (universes) the node outputs */
+    set<unsigned int> universes;
+
+    /*! \brief Short name the node reported when it was discovered */
+    string name;
+  };
+
   /*!
   * \brief Provides an interface to an ArtNet system
   *
-  * Uses libartnet to provide ArtNet communication.
   * ArtNet broadcasts via UDP on a specified subnet. The user is responsible for picking
   * the right IPs to make the system work. This particular interface specifically sends out DMX ArtNet
-  * packets. 
+  * packets.
+  *
+  * By default every universe is sent through libartnet as soon as sendDMX() is called.
+  * libartnet answers ArtPoll, so the interface shows up as a node to other controllers.
+  *
+  * setNative(true) switches to a built in sender, which doesn't answer ArtPoll. Each
+  * universe has a prebuilt ArtDmx packet that sendDMX() copies the data into. flush(),
+  * called by the DMXPatch once per frame, sends every waiting packet as one UDPBatch
+  * and follows them with an ArtSync so nodes output all universes of the frame at the
+  * same time. Universes are unicast to the nodes in the node table that output them,
+  * which can be filled in by hand or by ArtPoll discovery. Universes no node claims are
+  * broadcast. Node addresses are resolved in init() and addNode(), never while sending.
+  *
+  * One ArtSync goes to the broadcast address and reaches every node on the standard
+  * port within it. The subnet is taken from the broadcast address, so 2.255.255.255
+  * covers 2.0.0.0/8 and 255.255.255.255 covers every node. Nodes outside the subnet or
+  * on another port get their own ArtSync.
+  *
+  * In the rig JSON, an ArtNetInterface has these fields:
+  * - "ip", "broadcast", "verbose": as in the constructor. Required.
+  * - "native": use the built in sender. Optional, defaults to false.
+  * - "sync": send an ArtSync after every frame. Optional, defaults to true.
+  * - "discover": run ArtPoll discovery in init(). Optional, defaults to false.
+  * - "nodes": array of nodes, each with "ip", "universes" and an optional "port".
   */
   class ArtNetInterface : public DMXInterface
   {
@@ -38,7 +84,6 @@ namespace Lumiverse {
     * \param ip IP address for this ArtNet Node
     * \param broadcast Broadcast address
     * \param verbose Set to true to enable detailed logging to stdout
-    * \param protocolType Tells this interface which interface to use.
     */
     ArtNetInterface(string id, string ip, string broadcast = "", bool verbose = false);
 
@@ -48,6 +93,8 @@ namespace Lumiverse {
 
     virtual void sendDMX(unsigned char* data, unsigned int universe);
 
+    virtual void flush();
+
     virtual void closeInt();
 
     virtual void reset();
@@ -61,27 +108,128 @@ namespace Lumiverse {
 
     string getBroadcast() { return m_broadcast; }
     void setBroadcast(string bc) { m_broadcast = bc; }
-  
+
+    /*!
+    * \brief Selects the built in sender (true) or libartnet (false).
+    *
+    * libartnet is the default. Takes effect on init().
+    */
+    void setNative(bool native) { m_native = native; }
+    bool getNative() { return m_native; }
+
+    /*! \brief Sends an ArtSync after every frame. Only used by the built in sender. */
+    void setSync(bool sync) { m_sync = sync; }
+    bool getSync() { return m_sync; }
+
+    /*! \brief Runs ArtPoll discovery in init(). */
+    void setDiscover(bool discover) { m_discover = discover; }
+    bool getDiscover() { return m_discover; }
+
+    /*!
+    * \brief Adds a node to the node table.
+    *
+    * The node table shouldn't be changed while the interface is sending.
+    */
+    void addNode(ArtNetNode node);
+
+    /*! \brief Empties the node table. */
+    void clearNodes();
+
+    const vector<ArtNetNode>& getNodes() { return m_nodes; }
+
+    /*!
+    * \brief Broadcasts an ArtPoll and adds the nodes that reply to the node table.
+    *
+    * Nodes that are already in the table are updated. Replies are received on the
+    * standard ArtNet port, so this fails if another program holds the port without
+    * allowing it to be shared.
+    * \param timeout Time to wait for replies in milliseconds
+    * \return Number of nodes that replied, or -1 if the poll couldn't be sent.
+    */
+    int discoverNodes(int timeout = 3000);
+
+    /*! \brief Size of an ArtDmx packet with 512 channels. */
+    static const size_t DMX_PACKET_SIZE = 530;
+
+    /*! \brief Size of an ArtSync packet. */
+    static const size_t SYNC_PACKET_SIZE = 14;
+
   private:
+    /*! \brief Prebuilt ArtDmx packet of a universe and where it goes. */
+    struct Output {
+      unsigned char packet[DMX_PACKET_SIZE];
+      vector<sockaddr_in> dests;
+      bool queued;
+    };
+
     void initUniverse(int universe);
 
+    /*! \brief Opens the socket of the built in sender. */
+    bool initNative();
+
+    /*! \brief Creates the output for a universe with its header and destinations. */
+    Output* getOutput(unsigned int universe);
+
+    /*!
+    \brief Adds the ArtSync destination for an ArtDmx destination if it isn't there yet.
+
+    Destinations on the standard port within the broadcast subnet share one ArtSync to
+    the broadcast address.
+    */
+    void addSyncDest(const sockaddr_in& dest);
+
+    /*! \brief Resolves the address of node i into m_nodeAddrs. */
+    void resolveNode(size_t i);
+
+    /*! \brief Adds or updates a node from an ArtPollReply. Returns false if it isn't one. */
+    bool readPollReply(const unsigned char* data, size_t size);
+
     string m_ip;
     string m_broadcast;
     bool m_verbose;
     bool m_connected;
 
+    bool m_native;
+    bool m_sync;
+    bool m_discover;
+
     artnet_node m_node;
 
     /*!
     \brief List of universes used by ArtNet.
 
     Universes are initialized the first time they get
-    encountered in the update process. 
+    encountered in the update process.
     */
     set<int> m_universes;
+
+    vector<ArtNetNode> m_nodes;
+
+    /*! \brief Resolved address of each node, or INADDR_NONE if it couldn't be resolved. */
+    vector<in_addr> m_nodeAddrs;
+
+    int m_socket;
+    in_addr m_broadcastAddr;
+
+    /*! \brief Host bits of the broadcast address, in network order. */
+    uint32_t m_broadcastMask;
+
+    /*! \brief Output for each universe, created the first time a universe is sent. */
+    vector<unique_ptr<Output> > m_outputs;
+
+    /*! \brief Universes with a packet waiting for flush(). */
+    vector<unsigned int> m_queued;
+
+    /*! \brief Every destination the outputs send to. */
+    vector<sockaddr_in> m_syncDests;
+
+    unsigned char m_syncPacket[SYNC_PACKET_SIZE];
+    unsigned char m_sequence;
+
+    UDPBatch m_batch;
   };
 }
 
 #endif
 
-#endif
\ No newline at end of file
+#endif
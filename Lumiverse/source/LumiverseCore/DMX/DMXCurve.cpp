@@ -0,0 +1,147 @@
+#include "DMXCurve.h"
+
+namespace Lumiverse {
+
+DMXCurve::DMXCurve(Shape shape) : m_shape((shape == CUSTOM) ? LINEAR : shape) {
+  compile();
+}
+
+DMXCurve::DMXCurve(const vector<float>& points) : m_shape(CUSTOM), m_points(points) {
+  if (m_points.size() < 2) {
+    m_shape = LINEAR;
+    m_points.clear();
+  }
+
+  compile();
+}
+
+DMXCurve::DMXCurve(const JSONNode data) : m_shape(LINEAR) {
+  auto shape = data.find("shape");
+  if (shape != data.end())
+    stringToShape(shape->as_string(), m_shape);
+
+  auto points = data.find("points");
+  if (m_shape == CUSTOM && points != data.end()) {
+    for (auto p = points->begin(); p != points->end(); p++)
+      m_points.push_back(p->as_float());
+  }
+
+  if (m_shape == CUSTOM && m_points.size() < 2) {
+    m_shape = LINEAR;
+    m_points.clear();
+  }
+
+  compile();
+}
+
+float DMXCurve::evaluate(float val) const {
+  switch (m_shape) {
+  case (SQUARE) :
+    return val * val;
+  case (S_CURVE) :
+    return val * val * (3 - 2 * val);
+  case (CUSTOM) :
+  {
+    float pos = val * (m_points.size() - 1);
+    size_t i = (size_t)pos;
+    if (i >= m_points.size() - 1)
+      return m_points.back();
+
+    float t = pos - i;
+    return m_points[i] + (m_points[i + 1] - m_points[i]) * t;
+  }
+  default:
+    return val;
+  }
+}
+
+void DMXCurve::compile() {
+  for (int i = 0; i < TABLE_SIZE; i++) {
+    float out = evaluate(i / (float)(TABLE_SIZE - 1));
+    out = (out < 0) ? 0 : (out > 1) ? 1 : out;
+
+    m_single[i] = (unsigned char)(255 * out + 0.5f);
+    m_fine[i] = (unsigned short)(65535 * out + 0.5f);
+  }
+}
+
+unsigned short DMXCurve::toFine(float val) const {
+  // 16 bits need more steps than the table has, so interpolate between entries
+  float pos = val * (TABLE_SIZE - 1);
+  if (pos <= 0)
+    return m_fine[0];
+  if (pos >= TABLE_SIZE - 1)
+    return m_fine[TABLE_SIZE - 1];
+
+  int i = (int)pos;
+  float t = pos - i;
+  return (unsigned short)(m_fine[i] + (m_fine[i + 1] - m_fine[i]) * t + 0.5f);
+}
+
+float DMXCurve::inverse(float out) const {
+  unsigned short target = (unsigned short)(65535 * ((out < 0) ? 0 : (out > 1) ? 1 : out) + 0.5f);
+
+  // First entry at or above the target
+  int lo = 0;
+  int hi = TABLE_SIZE - 1;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (m_fine[mid] < target)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == 0 || m_fine[lo] == m_fine[lo - 1])
+    return lo / (float)(TABLE_SIZE - 1);
+
+  // Interpolate within the step
+  float t = (target - m_fine[lo - 1]) / (float)(m_fine[lo] - m_fine[lo - 1]);
+  return (lo - 1 + t) / (TABLE_SIZE - 1);
+}
+
+JSONNode DMXCurve::toJSON(string name) const {
+  JSONNode root;
+  root.set_name(name);
+  root.push_back(JSONNode("shape", shapeToString(m_shape)));
+
+  if (m_shape == CUSTOM) {
+    JSONNode points(JSON_ARRAY);
+    points.set_name("points");
+    for (float p : m_points)
+      points.push_back(JSONNode("", p));
+    root.push_back(points);
+  }
+
+  return root;
+}
+
+string DMXCurve::shapeToString(Shape shape) {
+  switch (shape) {
+  case (SQUARE) :
+    return "square";
+  case (S_CURVE) :
+    return "scurve";
+  case (CUSTOM) :
+    return "custom";
+  default:
+    return "linear";
+  }
+}
+
+bool DMXCurve::stringToShape(string name, Shape& shape) {
+  if (name == "linear")
+    shape = LINEAR;
+  else if (name == "square")
+    shape = SQUARE;
+  else if (name == "scurve")
+    shape = S_CURVE;
+  else if (name == "custom")
+    shape = CUSTOM;
+  else
+    return false;
+
+  return true;
+}
+
+}
@@ -0,0 +1,109 @@
+/*! \file DMXCurve.h
+* \brief Dimmer curves applied while converting values to DMX.
+*/
+#ifndef _DMXCURVE_H_
+#define _DMXCURVE_H_
+
+#pragma once
+
+#include "../lib/libjson/libjson.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Lumiverse {
+  /*!
+  \brief Response curve of a fixture, compiled into lookup tables.
+
+  A curve maps a level from 0 to 1 to the level sent over DMX, also from 0 to 1. The
+  curve is evaluated once when it is created and stored in an 8 bit and a 16 bit
+  table, so applying it while converting a frame costs one table lookup.
+
+  Curves are attached to parameters of a DMX map and shared by every device that
+  uses the map.
+  \sa DMXPatch::addCurve(), patchData
+  */
+  class DMXCurve
+  {
+  public:
+    /*! \brief Built in curve shapes. */
+    enum Shape {
+      LINEAR,   /*!< Output follows the level */
+      SQUARE,   /*!< Output is the square of the level, so fades look even on LEDs */
+      S_CURVE,  /*!< Smoothstep, slow at both ends of a fade */
+      CUSTOM    /*!< Interpolates a table of output levels */
+    };
+
+    /*! \brief Creates a curve with a built in shape. */
+    DMXCurve(Shape shape = LINEAR);
+
+    /*!
+    \brief Creates a custom curve.
+    \param points Output levels from 0 to 1, evenly spaced from level 0 to level 1.
+    Values in between are interpolated. Needs at least two points, a linear curve is
+    created otherwise.
+    */
+    DMXCurve(const vector<float>& points);
+
+    /*!
+    \brief Creates a curve from its JSON representation.
+
+    Unknown shapes are linear.
+    */
+    DMXCurve(const JSONNode data);
+
+    /*! \brief Converts a level to a single DMX byte. */
+    unsigned char toSingle(float val) const { return m_single[index(val)]; }
+
+    /*! \brief Converts a level to a 16 bit DMX value. */
+    unsigned short toFine(float val) const;
+
+    /*!
+    \brief Finds the level that is sent as a given output level.
+
+    Used to read DMX back into parameters. Assumes the curve doesn't go down.
+    \param out Output level from 0 to 1
+    */
+    float inverse(float out) const;
+
+    Shape getShape() const { return m_shape; }
+
+    /*! \brief Output levels of a custom curve. Empty for built in shapes. */
+    const vector<float>& getPoints() const { return m_points; }
+
+    /*! \brief Returns the JSON representation of the curve. */
+    JSONNode toJSON(string name) const;
+
+    /*! \brief Returns the name of a shape, for example "square". */
+    static string shapeToString(Shape shape);
+
+    /*! \brief Returns the shape with a name. False if there is no such shape. */
+    static bool stringToShape(string name, Shape& shape);
+
+    /*! \brief Number of entries in the lookup tables. */
+    static const int TABLE_SIZE = 4096;
+
+  private:
+    /*! \brief Evaluates the curve at a level from 0 to 1. */
+    float evaluate(float val) const;
+
+    /*! \brief Fills the lookup tables. */
+    void compile();
+
+    /*! \brief Table entry closest to a level. */
+    int index(float val) const {
+      float pos = val * (TABLE_SIZE - 1) + 0.5f;
+      return (pos <= 0) ? 0 : (pos >= TABLE_SIZE - 1) ? TABLE_SIZE - 1 : (int)pos;
+    }
+
+    Shape m_shape;
+    vector<float> m_points;
+
+    unsigned char m_single[TABLE_SIZE];
+    unsigned short m_fine[TABLE_SIZE];
+  };
+}
+
+#endif
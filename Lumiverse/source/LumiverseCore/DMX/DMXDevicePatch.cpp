@@ -25,18 +25,19 @@ void DMXDevicePatch::updateDMX(unsigned char* data, Device* device, map<string,
 
     // Eventually might have to check the type of the data in the device to make
     // sure we can process it. Right now it's just floats all day erry day.
+    const DMXCurve* curve = instr.second.curve.get();
 
     switch (instr.second.type) {
       case (FLOAT_TO_SINGLE):
       {
         LumiverseFloat* val = (LumiverseFloat*)param;
-        floatToSingle(data, instr.second.startAddress, val);
+        floatToSingle(data, instr.second.startAddress, val, curve);
         break;
       }
       case (FLOAT_TO_FINE):
       {
         LumiverseFloat* val = (LumiverseFloat*)param;
-        floatToFine(data, instr.second.startAddress, val->asPercent());
+        floatToFine(data, instr.second.startAddress, val->asPercent(), curve);
         break;
       }
       case (ENUM) :
@@ -48,43 +49,43 @@ void DMXDevicePatch::updateDMX(unsigned char* data, Device* device, map<string,
       case (RGB_REPEAT2) :
       {
         LumiverseFloat* val = (LumiverseFloat*)param;
-        RGBRepeat(data, instr.second.startAddress, val, 2);
+        RGBRepeat(data, instr.second.startAddress, val, 2, curve);
         break;
       }
       case (RGB_REPEAT3) :
       {
         LumiverseFloat* val = (LumiverseFloat*)param;
-        RGBRepeat(data, instr.second.startAddress, val, 3);
+        RGBRepeat(data, instr.second.startAddress, val, 3, curve);
         break;
       }
       case (RGB_REPEAT4) :
       {
         LumiverseFloat* val = (LumiverseFloat*)param;
-        RGBRepeat(data, instr.second.startAddress, val, 4);
+        RGBRepeat(data, instr.second.startAddress, val, 4, curve);
         break;
       }
       case(COLOR_RGB) :
       {
         LumiverseColor* val = (LumiverseColor*)param;
-        ColorToRGB(data, instr.second.startAddress, val);
+        ColorToRGB(data, instr.second.startAddress, val, curve);
         break;
       }
       case (COLOR_RGBW) :
       {
         LumiverseColor* val = (LumiverseColor*)param;
-        ColorToRGBW(data, instr.second.startAddress, val);
+        ColorToRGBW(data, instr.second.startAddress, val, curve);
         break;
       }
       case (COLOR_LUSTRPLUS):
       {
         LumiverseColor* val = (LumiverseColor*)param;
-        ColorToLustrPlus(data, instr.second.startAddress, val);
+        ColorToLustrPlus(data, instr.second.startAddress, val, curve);
         break;
       }
       case (ORI_TO_FINE) :
       {
         LumiverseOrientation* val = (LumiverseOrientation*)param;
-        floatToFine(data, instr.second.startAddress, val->asPercent());
+        floatToFine(data, instr.second.startAddress, val->asPercent(), nullptr);
         break;
       }
       default:
@@ -102,13 +103,96 @@ void DMXDevicePatch::updateDMX(unsigned char* data, Device* device, map<string,
   }
 }
 
-void DMXDevicePatch::floatToSingle(unsigned char* data, unsigned int address, LumiverseFloat* val) {
-  unsigned char cvt = (unsigned char)(255 * val->asPercent());
+void DMXDevicePatch::readDMX(const unsigned char* data, Device* device, map<string, patchData>& dmxMap) {
+  for (auto& instr : dmxMap) {
+    LumiverseType* param = device->getParam(instr.first);
+    if (param == nullptr) {
+      ostringstream ss;
+      ss << "Device does not have a parameter named " << instr.first << "\n";
+      Logger::log(ERR, ss.str());
+      return;
+    }
+
+    unsigned int addr = instr.second.startAddress;
+    const DMXCurve* curve = instr.second.curve.get();
+
+    switch (instr.second.type) {
+      case (FLOAT_TO_SINGLE) :
+      case (RGB_REPEAT2) :
+      case (RGB_REPEAT3) :
+      case (RGB_REPEAT4) :
+      {
+        ((LumiverseFloat*)param)->setValAsPercent(fromSingle(data, addr, curve));
+        break;
+      }
+      case (FLOAT_TO_FINE) :
+      {
+        float coarse = getDMXVal(data, addr) * 255;
+        float fine = getDMXVal(data, addr + 1) * 255;
+        float val = (coarse * 256 + fine) / 65535;
+        ((LumiverseFloat*)param)->setValAsPercent((curve == nullptr) ? val : curve->inverse(val));
+        break;
+      }
+      case (ENUM) :
+      {
+        ((LumiverseEnum*)param)->setVal(getDMXVal(data, addr) * 255);
+        break;
+      }
+      case (COLOR_RGB) :
+      {
+        LumiverseColor* val = (LumiverseColor*)param;
+        val->setColorChannel("Red", fromSingle(data, addr, curve));
+        val->setColorChannel("Green", fromSingle(data, addr + 1, curve));
+        val->setColorChannel("Blue", fromSingle(data, addr + 2, curve));
+        break;
+      }
+      case (COLOR_RGBW) :
+      {
+        LumiverseColor* val = (LumiverseColor*)param;
+        val->setColorChannel("Red", fromSingle(data, addr, curve));
+        val->setColorChannel("Green", fromSingle(data, addr + 1, curve));
+        val->setColorChannel("Blue", fromSingle(data, addr + 2, curve));
+        val->setColorChannel("White", fromSingle(data, addr + 3, curve));
+        break;
+      }
+      case (COLOR_LUSTRPLUS) :
+      {
+        LumiverseColor* val = (LumiverseColor*)param;
+        val->setColorChannel("Red", fromSingle(data, addr, curve));
+        val->setColorChannel("White", fromSingle(data, addr + 1, curve));
+        val->setColorChannel("Amber", fromSingle(data, addr + 2, curve));
+        val->setColorChannel("Green", fromSingle(data, addr + 3, curve));
+        val->setColorChannel("Cyan", fromSingle(data, addr + 4, curve));
+        val->setColorChannel("Blue", fromSingle(data, addr + 5, curve));
+        val->setColorChannel("Indigo", fromSingle(data, addr + 6, curve));
+        break;
+      }
+      case (ORI_TO_FINE) :
+      {
+        float coarse = getDMXVal(data, addr) * 255;
+        float fine = getDMXVal(data, addr + 1) * 255;
+        ((LumiverseOrientation*)param)->setValAsPercent((coarse * 256 + fine) / 65535);
+        break;
+      }
+      default:
+      {
+        stringstream ss;
+        ss << "Device \"" << device->getId() << "\" has invalid conversion type specified (" << (int)instr.second.type << ")";
+        Logger::log(ERR, ss.str());
+
+        throw logic_error("Device has an invalid conversion type specified.");
+      }
+    }
+  }
+}
+
+void DMXDevicePatch::floatToSingle(unsigned char* data, unsigned int address, LumiverseFloat* val, const DMXCurve* curve) {
+  unsigned char cvt = toSingle(val->asPercent(), curve);
   setDMXVal(data, address, cvt);
 }
 
-void DMXDevicePatch::floatToFine(unsigned char* data, unsigned int address, float val) {
-  unsigned short cvt = (unsigned short)(65535 * val);
+void DMXDevicePatch::floatToFine(unsigned char* data, unsigned int address, float val, const DMXCurve* curve) {
+  unsigned short cvt = (curve == nullptr) ? (unsigned short)(65535 * val) : curve->toFine(val);
   unsigned char coarse = (unsigned char)(cvt >> 8);
   unsigned char fine = (unsigned char) cvt;
   setDMXVal(data, address, coarse);
@@ -122,29 +206,31 @@ void DMXDevicePatch::toEnum(unsigned char* data, unsigned int address, Lumiverse
   setDMXVal(data, address, cvt);
 }
 
-void DMXDevicePatch::RGBRepeat(unsigned char* data, unsigned int address, LumiverseFloat* val, int repeats) {
-  unsigned char cvt = (unsigned char)(255 * val->asPercent());
+void DMXDevicePatch::RGBRepeat(unsigned char* data, unsigned int address, LumiverseFloat* val, int repeats,
+  const DMXCurve* curve)
+{
+  unsigned char cvt = toSingle(val->asPercent(), curve);
   for (int i = 0; i < repeats; i++) {
     setDMXVal(data, address + (i * 3), cvt);
   }
 }
 
-void DMXDevicePatch::ColorToRGB(unsigned char* data, unsigned int address, LumiverseColor* val) {
+void DMXDevicePatch::ColorToRGB(unsigned char* data, unsigned int address, LumiverseColor* val, const DMXCurve* curve) {
   // Missing parameters will just kinda end up undefined.
-  unsigned char r = (unsigned char)(255 * val->getColorChannel("Red"));
-  unsigned char g = (unsigned char)(255 * val->getColorChannel("Green"));
-  unsigned char b = (unsigned char)(255 * val->getColorChannel("Blue"));
+  unsigned char r = toSingle((float)val->getColorChannel("Red"), curve);
+  unsigned char g = toSingle((float)val->getColorChannel("Green"), curve);
+  unsigned char b = toSingle((float)val->getColorChannel("Blue"), curve);
 
   setDMXVal(data, address, r);
   setDMXVal(data, address + 1, g);
   setDMXVal(data, address + 2, b);
 }
 
-void DMXDevicePatch::ColorToRGBW(unsigned char* data, unsigned int address, LumiverseColor* val) {
-  unsigned char r = (unsigned char)(255 * val->getColorChannel("Red"));
-  unsigned char g = (unsigned char)(255 * val->getColorChannel("Green"));
-  unsigned char b = (unsigned char)(255 * val->getColorChannel("Blue"));;
-  unsigned char w = (unsigned char)(255 * val->getColorChannel("White"));;
+void DMXDevicePatch::ColorToRGBW(unsigned char* data, unsigned int address, LumiverseColor* val, const DMXCurve* curve) {
+  unsigned char r = toSingle((float)val->getColorChannel("Red"), curve);
+  unsigned char g = toSingle((float)val->getColorChannel("Green"), curve);
+  unsigned char b = toSingle((float)val->getColorChannel("Blue"), curve);;
+  unsigned char w = toSingle((float)val->getColorChannel("White"), curve);;
 
   setDMXVal(data, address, r);
   setDMXVal(data, address + 1, g);
@@ -152,14 +238,16 @@ void DMXDevicePatch::ColorToRGBW(unsigned char* data, unsigned int address, Lumi
   setDMXVal(data, address + 3, w);
 }
 
-void DMXDevicePatch::ColorToLustrPlus(unsigned char* data, unsigned int address, LumiverseColor* val) {
-  setDMXVal(data, address, (unsigned char)(255 * val->getColorChannel("Red")));
-  setDMXVal(data, address + 1, (unsigned char)(255 * val->getColorChannel("White")));
-  setDMXVal(data, address + 2, (unsigned char)(255 * val->getColorChannel("Amber")));
-  setDMXVal(data, address + 3, (unsigned char)(255 * val->getColorChannel("Green")));
-  setDMXVal(data, address + 4, (unsigned char)(255 * val->getColorChannel("Cyan")));
-  setDMXVal(data, address + 5, (unsigned char)(255 * val->getColorChannel("Blue")));
-  setDMXVal(data, address + 6, (unsigned char)(255 * val->getColorChannel("Indigo")));
+void DMXDevicePatch::ColorToLustrPlus(unsigned char* data, unsigned int address, LumiverseColor* val,
+  const DMXCurve* curve)
+{
+  setDMXVal(data, address, toSingle((float)val->getColorChannel("Red"), curve));
+  setDMXVal(data, address + 1, toSingle((float)val->getColorChannel("White"), curve));
+  setDMXVal(data, address + 2, toSingle((float)val->getColorChannel("Amber"), curve));
+  setDMXVal(data, address + 3, toSingle((float)val->getColorChannel("Green"), curve));
+  setDMXVal(data, address + 4, toSingle((float)val->getColorChannel("Cyan"), curve));
+  setDMXVal(data, address + 5, toSingle((float)val->getColorChannel("Blue"), curve));
+  setDMXVal(data, address + 6, toSingle((float)val->getColorChannel("Indigo"), curve));
 }
 
 void DMXDevicePatch::setDMXVal(unsigned char* data, unsigned int address, unsigned char val) {
@@ -6,7 +6,10 @@
 
 #pragma once
 #include "../Device.h"
+#include "DMXCurve.h"
+#include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <unordered_map>
 
 namespace Lumiverse {
@@ -98,6 +101,18 @@ namespace Lumiverse {
     */
     conversionType type;
 
+    /*!
+    * \brief Dimmer curve applied to the value, nullptr for a straight conversion.
+    *
+    * Used by the float and color conversions. Set it with DMXPatch::setParameterCurve()
+    * so it is saved with the map.
+    * \sa DMXCurve
+    */
+    shared_ptr<DMXCurve> curve;
+
+    /*! \brief Name of the curve in the DMXPatch. Empty if there is no curve. */
+    string curveName;
+
     /*! \brief Constructs a default patch entry. 
     *
     * Default assumes a starting address of 0 and a floating point to single DMX byte conversion.
@@ -159,6 +174,18 @@ namespace Lumiverse {
     */
     void updateDMX(unsigned char* data, Device* device, map<string, patchData>& dmxMap);
 
+    /*!
+    * \brief Given a universe of DMX, set the device's parameters from it.
+    *
+    * The inverse of updateDMX(). Values are read from the same addresses and
+    * converted back to the device's parameter types.
+    * This function will throw logic errors if the device and the patch don't match up.
+    * \param data Buffer of 512 bytes representing the universe to read
+    * \param device The Device to write data to
+    * \param dmxMap Table to DMX Maps to tell this function how to interpret the DMX data.
+    */
+    void readDMX(const unsigned char* data, Device* device, map<string, patchData>& dmxMap);
+
     /*! \brief Gets the universe the device is patched to.
     * \return The Device's universe */
     unsigned int getUniverse() { return m_universe; }
@@ -221,8 +248,9 @@ namespace Lumiverse {
     * \param data DMX Universe buffer
     * \param address Address to write the value to
     * \param LumiverseFloat value to convert
+    * \param curve Dimmer curve to apply, nullptr for none
     */
-    void floatToSingle(unsigned char* data, unsigned int address, LumiverseFloat* val);
+    void floatToSingle(unsigned char* data, unsigned int address, LumiverseFloat* val, const DMXCurve* curve);
 
     /*!
     * \brief Converts a float value to two DMX channels of data. min-max -> 0 - 65535
@@ -233,8 +261,9 @@ namespace Lumiverse {
     * \param data DMX Universe buffer
     * \param address First address to write the value to (the coarse bits)
     * \param val The float value to convert. Must be in the range [0, 1].
+    * \param curve Dimmer curve to apply, nullptr for none
     */
-    void floatToFine(unsigned char* data, unsigned int address, float val);
+    void floatToFine(unsigned char* data, unsigned int address, float val, const DMXCurve* curve);
 
     /*!
     * \brief Converts an enum to a single DMX channel of data
@@ -256,8 +285,9 @@ namespace Lumiverse {
     * \param address Address to write the value to
     * \param val LumiverseFloat value to convert
     * \param repeats Number of times to repeat the writing of the data.    
+    * \param curve Dimmer curve to apply, nullptr for none
     */
-    void RGBRepeat(unsigned char* data, unsigned int address, LumiverseFloat* val, int repeats);
+    void RGBRepeat(unsigned char* data, unsigned int address, LumiverseFloat* val, int repeats, const DMXCurve* curve);
 
     /*!
     * \brief Converts a LumiverseColor to 3 channels of DMX data.
@@ -266,8 +296,9 @@ namespace Lumiverse {
     * \param data DMX universe buffer
     * \param address Address to write the value to.
     * \param val LumiverseColor value to convert.
+    * \param curve Dimmer curve applied to each channel, nullptr for none
     */
-    void ColorToRGB(unsigned char* data, unsigned int address, LumiverseColor* val);
+    void ColorToRGB(unsigned char* data, unsigned int address, LumiverseColor* val, const DMXCurve* curve);
 
     /*!
     * \brief Converts a LumiverseColor to 4 channels of DMX data.
@@ -276,8 +307,9 @@ namespace Lumiverse {
     * \param data DMX Universe buffer
     * \param address Address to write the value to
     * \param val LumiverseColor value to convert
+    * \param curve Dimmer curve applied to each channel, nullptr for none
     */
-    void ColorToRGBW(unsigned char* data, unsigned int address, LumiverseColor* val);
+    void ColorToRGBW(unsigned char* data, unsigned int address, LumiverseColor* val, const DMXCurve* curve);
 
     /*!
     \brief Converts a LumiverseColor to 7 channels of DMX data.
@@ -287,8 +319,9 @@ namespace Lumiverse {
     \param data DMX Universe buffer
     \param address Address to write the value to
     \param val LumiverseColor value to convert
+    \param curve Dimmer curve applied to each channel, nullptr for none
     */
-    void ColorToLustrPlus(unsigned char* data, unsigned int address, LumiverseColor* val);
+    void ColorToLustrPlus(unsigned char* data, unsigned int address, LumiverseColor* val, const DMXCurve* curve);
 
     /*!
     * \brief Helper for setting DMX values.
@@ -299,6 +332,39 @@ namespace Lumiverse {
     * \param DMX value to write, single byte.
     */
     inline void setDMXVal(unsigned char* data, unsigned int address, unsigned char val);
+
+    /*!
+    * \brief Converts a value from 0 to 1 to a single DMX byte through a curve.
+    * \param val Value to convert
+    * \param curve Dimmer curve to apply, nullptr for a straight conversion
+    */
+    inline unsigned char toSingle(float val, const DMXCurve* curve) {
+      return (curve == nullptr) ? (unsigned char)(255 * val) : curve->toSingle(val);
+    }
+
+    /*!
+    * \brief Reads a single DMX byte back into a value from 0 to 1, undoing a curve.
+    * \param data DMX Universe buffer
+    * \param address Address to read the value from
+    * \param curve Dimmer curve the value was sent through, nullptr for none
+    */
+    inline float fromSingle(const unsigned char* data, unsigned int address, const DMXCurve* curve) {
+      float val = getDMXVal(data, address);
+      return (curve == nullptr) ? val : curve->inverse(val);
+    }
+
+    /*!
+    * \brief Helper for reading DMX values.
+    * \param data DMX Universe buffer
+    * \param address Address to read the value from
+    * \return DMX value at the address, as a fraction of 255.
+    */
+    inline float getDMXVal(const unsigned char* data, unsigned int address) {
+      if (m_baseAddress + address >= 512) {
+        throw logic_error("Attempting to read data outside of DMX address range (0-511).");
+      }
+      return data[m_baseAddress + address] / 255.0f;
+    }
   };
 }
 
@@ -0,0 +1,279 @@
+#include "DMXInput.h"
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+namespace Lumiverse {
+
+namespace {
+
+const unsigned char ACN_PACKET_ID[12] = {
+  0x41, 0x53, 0x43, 0x2d, 0x45, 0x31, 0x2e, 0x31, 0x37, 0x00, 0x00, 0x00
+};
+
+const unsigned char OPTION_PREVIEW_DATA = 0x80;
+const unsigned char OPTION_STREAM_TERMINATED = 0x40;
+
+uint16_t get16(const unsigned char* p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+uint32_t get32(const unsigned char* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+}
+
+DMXInput::DMXInput(string id, int port) : m_id(id), m_port(port), m_timeout(2500), m_socket(-1),
+  m_thread(nullptr), m_running(false), m_received(0), m_ignored(0)
+{
+}
+
+DMXInput::~DMXInput() {
+  stop();
+}
+
+bool DMXInput::start() {
+  if (m_thread != nullptr)
+    return true;
+
+#ifdef _WIN32
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR)
+    Logger::log(ERR, "Error at WSAStartup()");
+#endif
+
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    Logger::log(ERR, "DMX input " + m_id + " could not create a socket.");
+    return false;
+  }
+
+  // Consoles send a lot of universes at once
+  int bufSize = 4 * 1024 * 1024;
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&bufSize, sizeof(bufSize));
+
+  // Share the port with other programs listening for the same protocol
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+  // Wake up regularly to check if the input was stopped
+#ifdef _WIN32
+  DWORD timeout = 100;
+#else
+  timeval timeout = { 0, 100000 };
+#endif
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((unsigned short)m_port);
+  addr.sin_addr.s_addr = (m_listenAddr == "") ? htonl(INADDR_ANY) : inet_addr(m_listenAddr.c_str());
+
+  socklen_t len = sizeof(addr);
+  if (::bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(sock, (sockaddr*)&addr, &len) != 0) {
+    stringstream ss;
+    ss << "DMX input " << m_id << " can't listen on port " << m_port;
+    Logger::log(ERR, ss.str());
+    UDPBatch::closeSocket(sock);
+    return false;
+  }
+
+  m_port = ntohs(addr.sin_port);
+  m_socket = sock;
+  opened(sock);
+
+  m_running = true;
+  m_thread = new thread(&DMXInput::run, this);
+
+  stringstream ss;
+  ss << getInputType() << " " << m_id << " listening on port " << m_port;
+  Logger::log(INFO, ss.str());
+  return true;
+}
+
+void DMXInput::stop() {
+  if (m_thread == nullptr)
+    return;
+
+  m_running = false;
+  m_thread->join();
+  delete m_thread;
+  m_thread = nullptr;
+
+  UDPBatch::closeSocket(m_socket);
+  m_socket = -1;
+}
+
+void DMXInput::listen(unsigned int universe) {
+  if (universe < m_slots.size() && m_slots[universe] != nullptr)
+    return;
+
+  bool wasRunning = isRunning();
+  stop();
+
+  if (universe >= m_slots.size())
+    m_slots.resize(universe + 1);
+
+  Slot* slot = new Slot();
+  memset(slot->data, 0, sizeof(slot->data));
+  memset(slot->priority, 0, sizeof(slot->priority));
+  slot->back = 0;
+  slot->front = 1;
+  slot->middle = 2;
+  slot->valid = false;
+  slot->lastPriority = 0;
+
+  m_slots[universe].reset(slot);
+  m_universes.push_back(universe);
+
+  if (wasRunning)
+    start();
+}
+
+bool DMXInput::read(unsigned int universe, unsigned char* data, unsigned char& priority) {
+  if (universe >= m_slots.size() || m_slots[universe] == nullptr)
+    return false;
+
+  Slot& s = *m_slots[universe];
+  if (s.middle.load(memory_order_acquire) & FRESH) {
+    s.front = s.middle.exchange(s.front, memory_order_acq_rel) & ~FRESH;
+    s.valid = true;
+  }
+
+  if (!s.valid || clock::now() - s.received[s.front] > chrono::milliseconds(m_timeout.load()))
+    return false;
+
+  memcpy(data, s.data[s.front], 512);
+  priority = s.priority[s.front];
+  return true;
+}
+
+bool DMXInput::receive(unsigned int universe, const unsigned char* data, size_t size, unsigned char priority) {
+  if (universe >= m_slots.size() || m_slots[universe] == nullptr)
+    return false;
+
+  Slot& s = *m_slots[universe];
+  clock::time_point now = clock::now();
+
+  // A higher priority source owns the universe until it goes quiet
+  if (priority < s.lastPriority && now - s.lastReceived <= chrono::milliseconds(m_timeout.load()))
+    return true;
+
+  size = (size > 512) ? 512 : size;
+  memcpy(s.data[s.back], data, size);
+  memset(s.data[s.back] + size, 0, 512 - size);
+  s.priority[s.back] = priority;
+  s.received[s.back] = now;
+  s.lastPriority = priority;
+  s.lastReceived = now;
+
+  s.back = s.middle.exchange(s.back | FRESH, memory_order_acq_rel) & ~FRESH;
+  return true;
+}
+
+void DMXInput::run() {
+  unsigned char buf[1500];
+
+  while (m_running) {
+    int size = (int)recv(m_socket, (char*)buf, sizeof(buf), 0);
+    if (size <= 0)
+      continue;
+
+    if (parse(buf, size))
+      m_received++;
+    else
+      m_ignored++;
+  }
+}
+
+JSONNode DMXInput::toJSON() {
+  JSONNode root;
+
+  root.set_name(m_id);
+  root.push_back(JSONNode("type", getInputType()));
+  root.push_back(JSONNode("port", m_port));
+  root.push_back(JSONNode("listenAddress", m_listenAddr));
+  root.push_back(JSONNode("timeout", m_timeout.load()));
+
+  return root;
+}
+
+ArtNetInput::ArtNetInput(string id, int port, int priority) : DMXInput(id, port) {
+  setPriority(priority);
+}
+
+ArtNetInput::~ArtNetInput() {
+  stop();
+}
+
+bool ArtNetInput::parse(const unsigned char* data, size_t size) {
+  // ArtDmx: ID, OpCode 0x5000 (little endian), protocol version, sequence, physical,
+  // port address, length, data
+  if (size < 18 || memcmp(data, "Art-Net", 8) != 0 || data[8] != 0x00 || data[9] != 0x50)
+    return false;
+
+  unsigned int universe = data[14] | ((data[15] & 0x7f) << 8);
+  size_t length = get16(data + 16);
+  if (length > size - 18)
+    return false;
+
+  return receive(universe, data + 18, length, (unsigned char)m_priority);
+}
+
+JSONNode ArtNetInput::toJSON() {
+  JSONNode root = DMXInput::toJSON();
+  root.push_back(JSONNode("priority", m_priority));
+  return root;
+}
+
+SACNInput::SACNInput(string id, int port) : DMXInput(id, port) {
+}
+
+SACNInput::~SACNInput() {
+  stop();
+}
+
+void SACNInput::opened(int socket) {
+  for (unsigned int u : getUniverses()) {
+    unsigned int sacnUniverse = u + 1;
+    if (sacnUniverse >= 64000)
+      continue;
+
+    ip_mreq group;
+    group.imr_multiaddr.s_addr = htonl(0xefff0000 | sacnUniverse);
+    group.imr_interface.s_addr = (m_listenAddr == "") ? htonl(INADDR_ANY) : inet_addr(m_listenAddr.c_str());
+
+    if (setsockopt(socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&group, sizeof(group)) != 0) {
+      stringstream ss;
+      ss << "sACN input " << m_id << " can't join the multicast group of universe " << sacnUniverse;
+      Logger::log(WARN, ss.str());
+    }
+  }
+}
+
+bool SACNInput::parse(const unsigned char* data, size_t size) {
+  // Root layer with the E1.31 data vector, framing layer with the data packet vector
+  if (size < 126 || memcmp(data + 4, ACN_PACKET_ID, 12) != 0 || get32(data + 18) != 0x00000004 ||
+    get32(data + 40) != 0x00000002)
+    return false;
+
+  unsigned char options = data[112];
+  if (options & (OPTION_PREVIEW_DATA | OPTION_STREAM_TERMINATED))
+    return false;
+
+  // DMP layer: set property, then the property values starting with the start code
+  size_t count = get16(data + 123);
+  if (data[117] != 0x02 || count < 1 || count > size - 125 || data[125] != 0x00)
+    return false;
+
+  unsigned int sacnUniverse = get16(data + 113);
+  if (sacnUniverse == 0)
+    return false;
+
+  return receive(sacnUniverse - 1, data + 126, count - 1, data[108]);
+}
+
+}
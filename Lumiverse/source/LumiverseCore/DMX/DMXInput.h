@@ -0,0 +1,249 @@
+/*! \file DMXInput.h
+* \brief Receives DMX from the network on its own thread.
+*/
+#ifndef _DMXINPUT_H_
+#define _DMXINPUT_H_
+
+#pragma once
+
+#include "UDPBatch.h"
+#include "../Logger.h"
+#include "../lib/libjson/libjson.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Lumiverse {
+  /*!
+  \brief Provides a common interface to DMX sources on the network.
+
+  An input listens for a set of universes on a UDP port. A receiver thread parses each
+  datagram and writes the universe into a triple buffer, like the DMXOutputThread does
+  in the other direction, so neither side ever waits on the other. read() hands back
+  the latest frame of a universe without blocking.
+
+  Universes are zero-indexed, as they are in the DMXPatch.
+
+  Subclasses parse their protocol in parse() and hand the universes they find to
+  receive(). Their destructors have to call stop(), since the receiver thread calls
+  into the subclass.
+  \sa ArtNetInput, SACNInput, DMXPatch::addInput()
+  */
+  class DMXInput
+  {
+  public:
+    /*!
+    \brief Creates a stopped input.
+    \param id Identifier for this input
+    \param port UDP port to listen on. 0 picks a free port when the input starts.
+    */
+    DMXInput(string id, int port);
+
+    /*! \brief Stops the receiver thread. */
+    virtual ~DMXInput();
+
+    /*!
+    \brief Opens the socket and starts the receiver thread.
+    \return False if the socket couldn't be opened.
+    */
+    bool start();
+
+    /*! \brief Stops the receiver thread and closes the socket. */
+    void stop();
+
+    /*! \brief Returns true if the receiver thread is running. */
+    bool isRunning() { return m_thread != nullptr; }
+
+    /*!
+    \brief Starts buffering a universe.
+
+    Restarts the receiver thread if it is running. Data for universes nobody listens
+    to is ignored.
+    */
+    void listen(unsigned int universe);
+
+    /*! \brief Universes the input buffers. */
+    const vector<unsigned int>& getUniverses() { return m_universes; }
+
+    /*!
+    \brief Copies the latest frame of a universe. Never blocks on the receiver thread.
+
+    Call from one thread only, normally the update loop.
+    \param universe Universe to read
+    \param data Buffer of 512 bytes the frame is copied into
+    \param priority Set to the priority of the frame, 0 to 200.
+    \return False if the universe isn't buffered, nothing was received yet or the
+    source went quiet for longer than the timeout. data isn't touched then.
+    */
+    bool read(unsigned int universe, unsigned char* data, unsigned char& priority);
+
+    /*!
+    \brief Sets how long a universe stays live after its last packet.
+
+    Defaults to 2500ms, the sACN data loss timeout.
+    */
+    void setTimeout(unsigned int ms) { m_timeout = ms; }
+    unsigned int getTimeout() { return m_timeout.load(); }
+
+    /*! \brief Port the input listens on. The port that was picked once started with port 0. */
+    int getPort() { return m_port; }
+    void setPort(int port) { m_port = port; }
+
+    /*!
+    \brief Address of the network interface to listen on.
+
+    Empty listens on every interface. Takes effect on start().
+    */
+    string getListenAddress() { return m_listenAddr; }
+    void setListenAddress(string ip) { m_listenAddr = ip; }
+
+    /*! \brief Number of packets that delivered a universe. */
+    size_t getPacketsReceived() { return m_received; }
+
+    /*! \brief Number of datagrams that weren't for a buffered universe or couldn't be parsed. */
+    size_t getPacketsIgnored() { return m_ignored; }
+
+    /*! \brief Returns the ID of this input. */
+    string getInputId() { return m_id; }
+
+    /*! \brief Returns the name of the input's type, for example "SACNInput". */
+    virtual string getInputType() = 0;
+
+    /*! \brief Returns the JSON representation of the input. */
+    virtual JSONNode toJSON();
+
+  protected:
+    /*!
+    \brief Parses a datagram and calls receive() for the universe it carries.
+    \return False if the datagram isn't DMX data.
+    */
+    virtual bool parse(const unsigned char* data, size_t size) = 0;
+
+    /*! \brief Called once the socket is bound, for example to join multicast groups. */
+    virtual void opened(int) { }
+
+    /*!
+    \brief Writes a universe received by parse() into its buffer.
+
+    A frame with a lower priority than the frame before it is dropped while the
+    higher priority source is still live.
+    \return False if the universe isn't buffered.
+    */
+    bool receive(unsigned int universe, const unsigned char* data, size_t size, unsigned char priority);
+
+    string m_id;
+    int m_port;
+    string m_listenAddr;
+
+  private:
+    typedef chrono::steady_clock clock;
+
+    /*! \brief Triple buffer for one universe. */
+    struct Slot {
+      unsigned char data[3][512];
+      unsigned char priority[3];
+      clock::time_point received[3];
+
+      /*! \brief Buffer only written by the receiver thread */
+      int back;
+
+      /*! \brief Buffer only read by read() */
+      int front;
+
+      /*! \brief Shared buffer, with FRESH set if it holds a frame read() hasn't seen. */
+      atomic<int> middle;
+
+      /*! \brief True once read() has a frame in the front buffer. */
+      bool valid;
+
+      /*! \brief Priority and time of the last frame written, for the receiver thread. */
+      unsigned char lastPriority;
+      clock::time_point lastReceived;
+    };
+
+    static const int FRESH = 4;
+
+    void run();
+
+    /*! \brief Slot for each universe, nullptr for universes that aren't buffered. */
+    vector<unique_ptr<Slot> > m_slots;
+    vector<unsigned int> m_universes;
+
+    /*! \brief Read by the receive thread, so it can be changed while running. */
+    atomic<unsigned int> m_timeout;
+
+    int m_socket;
+    thread* m_thread;
+    atomic<bool> m_running;
+
+    atomic<size_t> m_received;
+    atomic<size_t> m_ignored;
+  };
+
+  /*!
+  \brief Receives ArtDmx packets.
+
+  The universe is the 15 bit Art-Net port address, the same number the ArtNetInterface
+  sends a DMXPatch universe on. Art-Net has no priority, so every frame gets the
+  priority set on the input.
+  */
+  class ArtNetInput : public DMXInput
+  {
+  public:
+    /*!
+    \brief Creates an ArtNet input.
+    \param id Identifier for this input
+    \param port Port to listen on. 6454 is the standard port.
+    \param priority Priority given to the data, 0 to 200.
+    */
+    ArtNetInput(string id, int port = 6454, int priority = 100);
+
+    ~ArtNetInput();
+
+    int getPriority() { return m_priority; }
+    void setPriority(int priority) { m_priority = (priority < 0) ? 0 : (priority > 200) ? 200 : priority; }
+
+    virtual string getInputType() { return "ArtNetInput"; }
+
+    virtual JSONNode toJSON();
+
+  protected:
+    virtual bool parse(const unsigned char* data, size_t size);
+
+  private:
+    int m_priority;
+  };
+
+  /*!
+  \brief Receives streaming ACN (ANSI E1.31) data packets.
+
+  DMXPatch universe 0 is sACN universe 1, as in the SACNInterface. The input joins the
+  multicast group of every universe it listens to, so unicast and multicast sources
+  both arrive. Preview data and packets with a start code other than 0 are ignored.
+  */
+  class SACNInput : public DMXInput
+  {
+  public:
+    /*!
+    \brief Creates an sACN input.
+    \param id Identifier for this input
+    \param port Port to listen on. 5568 is the standard port.
+    */
+    SACNInput(string id, int port = 5568);
+
+    ~SACNInput();
+
+    virtual string getInputType() { return "SACNInput"; }
+
+  protected:
+    virtual bool parse(const unsigned char* data, size_t size);
+
+    virtual void opened(int socket);
+  };
+}
+
+#endif
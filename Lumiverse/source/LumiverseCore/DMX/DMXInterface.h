@@ -46,6 +46,16 @@ namespace Lumiverse {
     */
     virtual void sendDMX(unsigned char* data, unsigned int universe) = 0;
 
+    /*!
+    * \brief Called once all the universes of a frame have been given to sendDMX().
+    *
+    * Interfaces that can send several universes at once, or that synchronize
+    * universes, can hold on to the data from sendDMX() and send it here. The data
+    * pointers given to sendDMX() stay valid until flush() returns, so they can be
+    * sent from without a copy. Does nothing by default.
+    */
+    virtual void flush() { }
+
     /*!
     * \brief Closes the connection to the DMX device
     */
@@ -0,0 +1,217 @@
+#include "DMXOutputThread.h"
+
+#include <cstring>
+
+namespace Lumiverse {
+
+DMXOutputThread::DMXOutputThread(DMXInterface* iface) : m_iface(iface), m_rate(0), m_thread(nullptr),
+  m_running(false), m_pending(false), m_published(0), m_sent(0), m_dropped(0), m_errors(0),
+  m_latencySum(0), m_latencyMax(0), m_failing(false)
+{
+}
+
+DMXOutputThread::~DMXOutputThread() {
+  stop();
+}
+
+void DMXOutputThread::setUniverses(const vector<unsigned int>& universes) {
+  bool wasRunning = isRunning();
+  stop();
+
+  m_slots.clear();
+  m_universes.clear();
+
+  for (unsigned int u : universes) {
+    if (u >= m_slots.size())
+      m_slots.resize(u + 1);
+
+    if (m_slots[u] != nullptr)
+      continue;
+
+    Slot* slot = new Slot();
+    slot->universe = u;
+    memset(slot->data, 0, sizeof(slot->data));
+    slot->back = 0;
+    slot->front = 1;
+    slot->middle = 2;
+
+    m_slots[u].reset(slot);
+    m_universes.push_back(u);
+  }
+
+  m_queued.reserve(m_universes.size());
+
+  if (wasRunning)
+    start();
+}
+
+void DMXOutputThread::start() {
+  if (m_thread != nullptr)
+    return;
+
+  m_running = true;
+  m_pending = false;
+  m_thread = new thread(&DMXOutputThread::run, this);
+}
+
+void DMXOutputThread::stop() {
+  if (m_thread == nullptr)
+    return;
+
+  {
+    lock_guard<mutex> lock(m_lock);
+    m_running = false;
+  }
+  m_cond.notify_one();
+
+  m_thread->join();
+  delete m_thread;
+  m_thread = nullptr;
+}
+
+bool DMXOutputThread::publish(const unsigned char* data, unsigned int universe) {
+  if (universe >= m_slots.size() || m_slots[universe] == nullptr)
+    return false;
+
+  Slot& s = *m_slots[universe];
+  memcpy(s.data[s.back], data, 512);
+  s.published[s.back] = clock::now();
+
+  int prev = s.middle.exchange(s.back | FRESH, memory_order_acq_rel);
+  s.back = prev & ~FRESH;
+
+  m_published++;
+  if (prev & FRESH)
+    m_dropped++;
+
+  return true;
+}
+
+void DMXOutputThread::commit() {
+  {
+    lock_guard<mutex> lock(m_lock);
+    m_pending = true;
+  }
+  m_cond.notify_one();
+}
+
+void DMXOutputThread::setRate(unsigned int rate) {
+  lock_guard<mutex> lock(m_lock);
+  m_rate = rate;
+}
+
+DMXOutputStats DMXOutputThread::getStats() {
+  DMXOutputStats stats;
+  stats.published = m_published;
+  stats.sent = m_sent;
+  stats.dropped = m_dropped;
+  stats.errors = m_errors;
+
+  if (stats.sent > 0)
+    stats.avgLatency = (m_latencySum / (double)stats.sent) / 1e6;
+  stats.maxLatency = m_latencyMax / 1e6;
+
+  return stats;
+}
+
+void DMXOutputThread::resetStats() {
+  m_published = 0;
+  m_sent = 0;
+  m_dropped = 0;
+  m_errors = 0;
+  m_latencySum = 0;
+  m_latencyMax = 0;
+}
+
+void DMXOutputThread::run() {
+  clock::time_point nextSend = clock::now();
+
+  while (true) {
+    {
+      unique_lock<mutex> lock(m_lock);
+      m_cond.wait(lock, [this] { return m_pending || !m_running; });
+
+      if (!m_running)
+        break;
+
+      // Hold off until the interface is due to send again. Frames published in the
+      // meantime replace the waiting ones.
+      if (m_rate > 0) {
+        if (m_cond.wait_until(lock, nextSend, [this] { return !m_running; }))
+          break;
+
+        nextSend = max(nextSend + chrono::duration_cast<clock::duration>(chrono::duration<double>(1.0 / m_rate)),
+          clock::now());
+      }
+
+      m_pending = false;
+    }
+
+    sendFresh();
+  }
+
+  // Don't lose the last frame
+  sendFresh();
+}
+
+void DMXOutputThread::sendFresh() {
+  // Universes handed to the interface in this call. They only count as sent once
+  // the interface has flushed them.
+  m_queued.clear();
+
+  for (unsigned int u : m_universes) {
+    Slot& s = *m_slots[u];
+    if (!(s.middle.load(memory_order_acquire) & FRESH))
+      continue;
+
+    s.front = s.middle.exchange(s.front, memory_order_acq_rel) & ~FRESH;
+
+    try {
+      m_iface->sendDMX(s.data[s.front], u);
+    }
+    catch (exception& e) {
+      sendFailed(e);
+      continue;
+    }
+
+    m_queued.push_back(u);
+  }
+
+  if (m_queued.empty())
+    return;
+
+  try {
+    m_iface->flush();
+  }
+  catch (exception& e) {
+    // Nothing queued went out
+    sendFailed(e, m_queued.size());
+    return;
+  }
+
+  if (m_failing) {
+    Logger::log(INFO, "Interface " + m_iface->getInterfaceId() + " is sending again.");
+    m_failing = false;
+  }
+
+  clock::time_point now = clock::now();
+  for (unsigned int u : m_queued) {
+    Slot& s = *m_slots[u];
+    long long latency = chrono::duration_cast<chrono::nanoseconds>(now - s.published[s.front]).count();
+    m_latencySum += latency;
+    if (latency > m_latencyMax)
+      m_latencyMax = latency;
+    m_sent++;
+  }
+}
+
+void DMXOutputThread::sendFailed(exception& e, size_t frames) {
+  m_errors += frames;
+
+  if (!m_failing) {
+    Logger::log(ERR, "Interface " + m_iface->getInterfaceId() + " failed to send: " + e.what());
+    m_failing = true;
+  }
+}
+
+}
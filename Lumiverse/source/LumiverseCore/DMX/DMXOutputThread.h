@@ -0,0 +1,165 @@
+/*! \file DMXOutputThread.h
+* \brief Sends DMX to an interface from its own thread.
+*/
+#ifndef _DMXOUTPUTTHREAD_H_
+#define _DMXOUTPUTTHREAD_H_
+
+#pragma once
+
+#include "DMXInterface.h"
+#include "../Logger.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Lumiverse {
+  /*! \brief Counters for a DMXOutputThread. Latencies are in milliseconds. */
+  struct DMXOutputStats {
+    DMXOutputStats() : published(0), sent(0), dropped(0), errors(0), avgLatency(0), maxLatency(0) { }
+    size_t published;   /*!< Universe frames handed to the output */
+    size_t sent;        /*!< Universe frames the interface sent successfully */
+    size_t dropped;     /*!< Universe frames replaced by a newer frame before they were sent */
+    size_t errors;      /*!< Sends that threw an exception */
+    double avgLatency;  /*!< Mean time from publishing a frame to the end of its send */
+    double maxLatency;  /*!< Longest time from publishing a frame to the end of its send */
+  };
+
+  /*!
+  \brief Runs the sends of one DMXInterface on a separate thread.
+
+  Each universe of the interface has a triple buffer. publish() copies a universe into
+  the buffer the update loop owns and swaps it with the shared middle buffer, so the
+  update loop never waits on the interface. The output thread swaps the middle buffer
+  for its own when a newer frame is there and sends it. A frame that is replaced before
+  the thread picks it up is counted as dropped, only the latest frame is ever sent.
+
+  Exceptions thrown by the interface are caught and counted, so a failing device can't
+  take down the update loop.
+  \sa DMXPatch::setAsyncOutput()
+  */
+  class DMXOutputThread
+  {
+  public:
+    /*! \brief Creates a stopped output for an interface. The interface is not owned. */
+    DMXOutputThread(DMXInterface* iface);
+
+    /*! \brief Stops the thread. */
+    ~DMXOutputThread();
+
+    /*!
+    \brief Sets the universes the output sends.
+
+    Stops the thread while the buffers are rebuilt and restarts it if it was running.
+    Frames that weren't sent yet are lost.
+    */
+    void setUniverses(const vector<unsigned int>& universes);
+
+    /*! \brief Starts the output thread. */
+    void start();
+
+    /*! \brief Sends the frames that are waiting and stops the output thread. */
+    void stop();
+
+    /*! \brief Returns true if the output thread is running. */
+    bool isRunning() { return m_thread != nullptr; }
+
+    /*!
+    \brief Copies a 512 byte universe into the output. Never blocks on the interface.
+    \return False if the universe isn't one of the output's universes.
+    */
+    bool publish(const unsigned char* data, unsigned int universe);
+
+    /*! \brief Wakes the output thread to send everything published since the last send. */
+    void commit();
+
+    /*!
+    \brief Limits how often the interface sends.
+
+    Frames published faster than this are dropped, only the latest is sent.
+    \param rate Sends per second. 0 sends every committed frame as soon as possible.
+    */
+    void setRate(unsigned int rate);
+
+    /*! \brief Returns the send rate limit. 0 if there is no limit. */
+    unsigned int getRate() { return m_rate; }
+
+    /*! \brief Returns the counters of the output. */
+    DMXOutputStats getStats();
+
+    /*! \brief Sets every counter back to 0. */
+    void resetStats();
+
+    /*! \brief Interface the output sends to. */
+    DMXInterface* getInterface() { return m_iface; }
+
+  private:
+    typedef chrono::steady_clock clock;
+
+    /*! \brief Triple buffer for one universe. */
+    struct Slot {
+      unsigned int universe;
+      unsigned char data[3][512];
+      clock::time_point published[3];
+
+      /*! \brief Buffer only written by publish() */
+      int back;
+
+      /*! \brief Buffer only read by the output thread */
+      int front;
+
+      /*! \brief Shared buffer, with FRESH set if it holds a frame that wasn't sent. */
+      atomic<int> middle;
+    };
+
+    static const int FRESH = 4;
+
+    DMXInterface* m_iface;
+    unsigned int m_rate;
+
+    /*! \brief Slot for each universe, nullptr for universes the output doesn't send. */
+    vector<unique_ptr<Slot> > m_slots;
+
+    /*! \brief Universes with a slot, in the order they are sent. */
+    vector<unsigned int> m_universes;
+
+    thread* m_thread;
+    mutex m_lock;
+    condition_variable m_cond;
+    bool m_running;
+    bool m_pending;
+
+    atomic<size_t> m_published;
+    atomic<size_t> m_sent;
+    atomic<size_t> m_dropped;
+    atomic<size_t> m_errors;
+    atomic<long long> m_latencySum;
+    atomic<long long> m_latencyMax;
+
+    /*! \brief True while sends or flushes are failing, so an error is only logged once. */
+    bool m_failing;
+
+    /*! \brief Universes given to the interface since the last flush. Only used by the output thread. */
+    vector<unsigned int> m_queued;
+
+    void run();
+
+    /*!
+    \brief Sends every universe with a fresh frame, then flushes the interface.
+
+    Universes are counted as sent, and their latency recorded, after a successful flush.
+    */
+    void sendFresh();
+
+    /*!
+    \brief Counts frames lost to a failed send or flush and logs the first of a run of failures.
+    */
+    void sendFailed(exception& e, size_t frames = 1);
+  };
+}
+
+#endif
@@ -21,13 +21,20 @@
 #include "OLAInterface.h"
 #endif
 
+#ifdef USE_SACN
+#include "SACNInterface.h"
+#endif
+
 namespace Lumiverse {
 
-DMXPatch::DMXPatch() {
-  // Empty for now
+DMXPatch::DMXPatch() : m_asyncOutput(true), m_keepAlive(1000), m_routesChanged(true), m_packetsSent(0),
+  m_packetsSaved(0), m_merging(false), m_outputPriority(100), m_initialized(false)
+{
 }
 
-DMXPatch::DMXPatch(const JSONNode data) {
+DMXPatch::DMXPatch(const JSONNode data) : m_asyncOutput(true), m_keepAlive(1000), m_routesChanged(true),
+  m_packetsSent(0), m_packetsSaved(0), m_merging(false), m_outputPriority(100), m_initialized(false)
+{
   loadJSON(data);
 }
 
@@ -35,6 +42,14 @@ void DMXPatch::loadJSON(const JSONNode data) {
   string patchName = data.name();
   map<string, DMXInterface*> ifaceMap;
 
+  // Curves come first, since device maps refer to them
+  auto curves = data.find("curves");
+  if (curves != data.end()) {
+    for (auto c = curves->begin(); c != curves->end(); c++) {
+      addCurve(c->name(), make_shared<DMXCurve>(*c));
+    }
+  }
+
   auto i = data.begin();
   // This is a two pass process. First pass initializes the interfaces and Device mappings
   // Second pass actually patches devices and assigns the interfaces to universes.
@@ -74,6 +89,14 @@ void DMXPatch::loadJSON(const JSONNode data) {
 
             if (host != iface->end() && port != iface->end() && protocolType != iface->end()) {
               KiNetInterface* intface = new KiNetInterface(iface->name(), host->as_string(), port->as_int(), (KinetProtocolType)protocolType->as_int());
+
+              auto ports = iface->find("ports");
+              if (ports != iface->end()) {
+                unsigned int p = 1;
+                for (auto u = ports->begin(); u != ports->end(); u++, p++)
+                  intface->setPortUniverse(p, u->as_int());
+              }
+
               ifaceMap[iface->name()] = (DMXInterface*)intface;
             }
 
@@ -92,6 +115,38 @@ void DMXPatch::loadJSON(const JSONNode data) {
             
             if (ip != iface->end() && broad != iface->end() && verb != iface->end()) {
               ArtNetInterface* intface = new ArtNetInterface(iface->name(), ip->as_string(), broad->as_string(), verb->as_bool());
+
+              auto native = iface->find("native");
+              auto sync = iface->find("sync");
+              auto discover = iface->find("discover");
+              auto nodes = iface->find("nodes");
+
+              if (native != iface->end())
+                intface->setNative(native->as_bool());
+              if (sync != iface->end())
+                intface->setSync(sync->as_bool());
+              if (discover != iface->end())
+                intface->setDiscover(discover->as_bool());
+
+              if (nodes != iface->end()) {
+                for (auto n = nodes->begin(); n != nodes->end(); n++) {
+                  auto nodeIp = n->find("ip");
+                  auto nodePort = n->find("port");
+                  auto universes = n->find("universes");
+                  if (nodeIp == n->end() || universes == n->end())
+                    continue;
+
+                  ArtNetNode node;
+                  node.ip = nodeIp->as_string();
+                  if (nodePort != n->end())
+                    node.port = nodePort->as_int();
+                  for (auto u = universes->begin(); u != universes->end(); u++)
+                    node.universes.insert(u->as_int());
+
+                  intface->addNode(node);
+                }
+              }
+
               ifaceMap[iface->name()] = (DMXInterface*)intface;
             }
 
@@ -111,6 +166,40 @@ void DMXPatch::loadJSON(const JSONNode data) {
             Logger::log(INFO, ss.str());
 #else
             Logger::log(WARN, "LumiverseCore built without OLA support. Skipping interface...");
+#endif
+          }
+          else if (type->as_string() == "SACNInterface") {
+#ifdef USE_SACN
+            SACNInterface* intface = new SACNInterface(iface->name());
+            auto sourceName = iface->find("sourceName");
+            auto priority = iface->find("priority");
+            auto host = iface->find("host");
+            auto port = iface->find("port");
+            auto syncUniverse = iface->find("syncUniverse");
+            auto mcastIface = iface->find("multicastInterface");
+            auto cid = iface->find("cid");
+
+            if (sourceName != iface->end())
+              intface->setSourceName(sourceName->as_string());
+            if (priority != iface->end())
+              intface->setPriority(priority->as_int());
+            if (host != iface->end())
+              intface->setHost(host->as_string());
+            if (port != iface->end())
+              intface->setPort(port->as_int());
+            if (syncUniverse != iface->end())
+              intface->setSyncUniverse(syncUniverse->as_int());
+            if (mcastIface != iface->end())
+              intface->setMulticastInterface(mcastIface->as_string());
+            if (cid != iface->end() && !intface->setCID(cid->as_string()))
+              Logger::log(WARN, "Invalid CID for sACN interface " + iface->name());
+
+            ifaceMap[iface->name()] = (DMXInterface*)intface;
+            stringstream ss;
+            ss << "Added sACN Interface \"" << iface->name() << "\"";
+            Logger::log(INFO, ss.str());
+#else
+            Logger::log(WARN, "LumiverseCore built without sACN support. Skipping interface...");
 #endif
           }
           else {
@@ -123,9 +212,54 @@ void DMXPatch::loadJSON(const JSONNode data) {
         ++iface;
       }
     }
+    if (nodeName == "inputs") {
+      for (auto in = i->begin(); in != i->end(); in++) {
+        auto type = in->find("type");
+        if (type == in->end())
+          continue;
+
+        DMXInput* input = nullptr;
+        if (type->as_string() == "ArtNetInput") {
+          ArtNetInput* artnet = new ArtNetInput(in->name());
+          auto priority = in->find("priority");
+          if (priority != in->end())
+            artnet->setPriority(priority->as_int());
+          input = artnet;
+        }
+        else if (type->as_string() == "SACNInput") {
+          input = new SACNInput(in->name());
+        }
+        else {
+          Logger::log(WARN, "Unsupported Input Type " + type->as_string() + " in " + patchName);
+          continue;
+        }
+
+        auto port = in->find("port");
+        auto listenAddr = in->find("listenAddress");
+        auto timeout = in->find("timeout");
+        if (port != in->end())
+          input->setPort(port->as_int());
+        if (listenAddr != in->end())
+          input->setListenAddress(listenAddr->as_string());
+        if (timeout != in->end())
+          input->setTimeout(timeout->as_int());
+
+        if (!addInput(input))
+          delete input;
+      }
+    }
+    if (nodeName == "outputPriority") {
+      setOutputPriority(i->as_int());
+    }
     if (nodeName == "deviceMaps") {
       loadDeviceMaps(*i);
     }
+    if (nodeName == "asyncOutput") {
+      m_asyncOutput = i->as_bool();
+    }
+    if (nodeName == "keepAliveInterval") {
+      m_keepAlive = i->as_int();
+    }
 
     ++i;
   }
@@ -150,6 +284,32 @@ void DMXPatch::loadJSON(const JSONNode data) {
     Logger::log(LOG_LEVEL::WARN, "No interfaces assignments found in rig");
   }
 
+  // Merge inputs into universes. Modes are stored as one letter per channel.
+  auto merges = data.find("merges");
+  if (merges != data.end()) {
+    for (auto m = merges->begin(); m != merges->end(); m++) {
+      unsigned int universe = (*m)["universe"].as_int();
+      if (!setMergeSource(universe, (*m)["input"].as_string(), (*m)["inputUniverse"].as_int())) {
+        stringstream ss;
+        ss << "Can't merge input " << (*m)["input"].as_string() << " into universe " << universe
+          << " because the input does not exist.";
+        Logger::log(ERR, ss.str());
+        continue;
+      }
+
+      auto modes = m->find("modes");
+      if (modes == m->end())
+        continue;
+
+      string letters = modes->as_string();
+      for (unsigned int c = 0; c < letters.size() && c < 512; c++) {
+        DMXMergeMode mode = (letters[c] == 'L') ? MERGE_LTP : (letters[c] == 'P') ? MERGE_PRIORITY :
+          (letters[c] == 'H') ? MERGE_HTP : MERGE_OFF;
+        setMergeMode(universe, mode, c, 1);
+      }
+    }
+  }
+
   // Patch the devices
   auto devices = data.find("devicePatch");
   if (devices != data.end()) {
@@ -185,12 +345,22 @@ void DMXPatch::loadDeviceMaps(const JSONNode data) {
     while (j != i->end()) {
       string paramName = j->name();
 
-      // This assumes the next piece of data is arranged in a [ int, string ] format
+      // This assumes the next piece of data is arranged in a [ int, string ] format,
+      // optionally followed by the name of a curve
       unsigned int addr = (*j)[0].as_int();
       string conversion = (*j)[1].as_string();
 
       dmxMap[paramName] = patchData(addr, conversion);
 
+      if (j->size() > 2) {
+        string curveName = (*j)[2].as_string();
+        dmxMap[paramName].curve = getCurve(curveName);
+        if (dmxMap[paramName].curve != nullptr)
+          dmxMap[paramName].curveName = curveName;
+        else
+          Logger::log(WARN, "Unknown curve " + curveName + " for " + name + "." + paramName);
+      }
+
       ++j;
     }
 
@@ -205,6 +375,13 @@ void DMXPatch::loadDeviceMaps(const JSONNode data) {
 }
 
 DMXPatch::~DMXPatch() {
+  stopRecording();
+  stopOutputs();
+
+  for (auto& input : m_inputs) {
+    delete input.second;
+  }
+
   // Deallocate all interfaces after closing them.
   for (auto& interfaces : m_interfaces) {
     interfaces.second->closeInt();
@@ -224,27 +401,95 @@ void DMXPatch::update(set<Device *> devices) {
       // For each device, find the device patch stored.
       DMXDevicePatch devPatch = *(m_patch).at(d->getId());
 
-      unsigned int uni = devPatch.getUniverse();
-      
       // Skip if universes aren't allocated because the interface doesn't exist.
-      // TODO: check this, logic may be questionable
-      if (uni >= m_universes.size())
+      unsigned char* data = m_universes.get(devPatch.getUniverse());
+      if (data == nullptr)
         continue;
       
-      devPatch.updateDMX(&m_universes[uni].front(), d, m_deviceMaps[devPatch.getDMXMapKey()]);
+      devPatch.updateDMX(data, d, m_deviceMaps[devPatch.getDMXMapKey()]);
     }
     catch (exception e) {
       continue;
     }
   }
 
-  // Send updated data to interfaces
-  for (auto& i : m_ifacePatch) {
-    m_interfaces[i.first]->sendDMX(&m_universes[i.second].front(), i.second);
+  sendUniverses();
+}
+
+void DMXPatch::sendUniverses() {
+  const unsigned char* frame = mergeInputs();
+  const size_t size = DMXUniverseSlab::UNIVERSE_SIZE;
+  size_t numUniverses = m_universes.size();
+
+  shared_ptr<DMXShowRecorder> recorder = atomic_load(&m_recorder);
+  if (recorder != nullptr) {
+    // Show files number universes densely
+    m_recordFrame.resize(m_universes.range(), vector<unsigned char>(size, 0));
+    for (size_t slot = 0; slot < numUniverses; slot++)
+      memcpy(m_recordFrame[m_universes.universeAt(slot)].data(), frame + slot * size, size);
+
+    recorder->record(m_recordFrame);
+  }
+
+  // Find the universes that changed or haven't been sent in a while
+  auto now = chrono::steady_clock::now();
+  auto keepAlive = chrono::milliseconds(m_keepAlive);
+
+  m_lastSent.resize(numUniverses * size);
+  m_lastSendTime.resize(numUniverses);
+  m_dirty.resize(numUniverses);
+
+  for (size_t slot = 0; slot < numUniverses; slot++) {
+    const unsigned char* cur = frame + slot * size;
+    unsigned char* last = &m_lastSent[slot * size];
+
+    m_dirty[slot] = m_keepAlive == 0 || now - m_lastSendTime[slot] >= keepAlive || memcmp(last, cur, size) != 0;
+
+    if (m_dirty[slot]) {
+      memcpy(last, cur, size);
+      m_lastSendTime[slot] = now;
+    }
+  }
+
+  if (m_routesChanged)
+    buildRoutes();
+
+  // Send updated data to interfaces, or hand it to their output threads
+  for (const Route& r : m_routes) {
+    if (!m_dirty[r.slot]) {
+      m_packetsSaved++;
+      continue;
+    }
+
+    m_packetsSent++;
+    const unsigned char* data = frame + r.slot * size;
+
+    if (r.output != nullptr) {
+      r.output->publish(data, r.universe);
+    }
+    else {
+      r.iface->sendDMX((unsigned char*)data, r.universe);
+
+      // Routes are sorted by interface, so each interface is added once
+      if (m_toFlush.empty() || m_toFlush.back() != r.iface)
+        m_toFlush.push_back(r.iface);
+    }
+  }
+
+  for (DMXInterface* iface : m_toFlush) {
+    iface->flush();
+  }
+  m_toFlush.clear();
+
+  for (auto& out : m_outputs) {
+    out.second->commit();
   }
 }
 
 void DMXPatch::init() {
+  // Interfaces can't be sent to while they're initialized
+  stopOutputs();
+
   for (auto& iface : m_interfaces) {
     try {
       iface.second->init();
@@ -253,9 +498,26 @@ void DMXPatch::init() {
       Logger::log(LOG_LEVEL::ERR, e.what());
     }
   }
+
+  m_routesChanged = true;
+
+  if (m_asyncOutput) {
+    for (auto& iface : m_interfaces) {
+      m_outputs[iface.first] = new DMXOutputThread(iface.second);
+      updateOutputUniverses(iface.first);
+      m_outputs[iface.first]->start();
+    }
+  }
+
+  startInputs();
+  m_initialized = true;
 }
 
 void DMXPatch::close() {
+  m_initialized = false;
+  stopInputs();
+  stopOutputs();
+
   for (auto& interfaces : m_interfaces) {
     interfaces.second->closeInt();
   }
@@ -265,6 +527,9 @@ JSONNode DMXPatch::toJSON() {
   JSONNode root;
 
   root.push_back(JSONNode("type", getType()));
+  root.push_back(JSONNode("asyncOutput", m_asyncOutput));
+  root.push_back(JSONNode("keepAliveInterval", m_keepAlive));
+  root.push_back(JSONNode("outputPriority", m_outputPriority));
   JSONNode interfaces;
   interfaces.set_name("interfaces");
   for (auto i : m_interfaces) {
@@ -280,6 +545,13 @@ JSONNode DMXPatch::toJSON() {
   }
   root.push_back(universes);
 
+  JSONNode curves;
+  curves.set_name("curves");
+  for (auto& c : m_curves) {
+    curves.push_back(c.second->toJSON(c.first));
+  }
+  root.push_back(curves);
+
   JSONNode deviceMaps;
   deviceMaps.set_name("deviceMaps");
   for (auto dm : m_deviceMaps) {
@@ -299,6 +571,34 @@ JSONNode DMXPatch::toJSON() {
   }
   root.push_back(devicePatch);
 
+  JSONNode inputs;
+  inputs.set_name("inputs");
+  for (auto& in : m_inputs) {
+    inputs.push_back(in.second->toJSON());
+  }
+  root.push_back(inputs);
+
+  JSONNode merges(JSON_ARRAY);
+  merges.set_name("merges");
+  for (unsigned int u = 0; u < m_merges.size(); u++) {
+    if (m_merges[u] == nullptr)
+      continue;
+
+    string modes(512, 'O');
+    for (unsigned int c = 0; c < 512; c++) {
+      DMXMergeMode mode = getMergeMode(u, c);
+      modes[c] = (mode == MERGE_HTP) ? 'H' : (mode == MERGE_LTP) ? 'L' : (mode == MERGE_PRIORITY) ? 'P' : 'O';
+    }
+
+    JSONNode merge;
+    merge.push_back(JSONNode("universe", u));
+    merge.push_back(JSONNode("input", m_merges[u]->inputId));
+    merge.push_back(JSONNode("inputUniverse", m_merges[u]->inputUniverse));
+    merge.push_back(JSONNode("modes", modes));
+    merges.push_back(merge);
+  }
+  root.push_back(merges);
+
   return root;
 }
 
@@ -315,6 +615,8 @@ JSONNode DMXPatch::deviceMapToJSON(string id, map<string, patchData> data) {
 #else
     mapping.push_back(JSONNode("ctype", convTypeToString(d.second.type)));
 #endif
+    if (d.second.curve != nullptr)
+      mapping.push_back(JSONNode("curve", d.second.curveName));
     root.push_back(mapping.as_array());
   }
 
@@ -343,13 +645,9 @@ void DMXPatch::assignInterface(DMXInterface* iface, unsigned int universe) {
   }
 
   m_ifacePatch.insert(make_pair(id, universe));
-
-  // Update universe vector size.
-  if (universe + 1 > m_universes.size()) {
-    m_universes.resize(universe + 1);
-    for (auto& uni : m_universes)
-      uni.resize(512);
-  }
+  m_universes.add(universe);
+  m_routesChanged = true;
+  updateOutputUniverses(id);
 }
 
 void DMXPatch::assignInterface(string id, unsigned int universe) {
@@ -372,6 +670,12 @@ void DMXPatch::removeInterface(unsigned int universe, string id) {
   for (const auto& val : toRemove) {
     m_ifacePatch.erase(val);
   }
+  releaseUniverses();
+  m_routesChanged = true;
+
+  for (auto& out : m_outputs) {
+    updateOutputUniverses(out.first);
+  }
 }
 
 bool DMXPatch::addInterface(DMXInterface* iface) {
@@ -383,6 +687,11 @@ bool DMXPatch::addInterface(DMXInterface* iface) {
 }
 
 void DMXPatch::deleteInterface(string id) {
+  if (m_outputs.count(id) > 0) {
+    delete m_outputs[id];
+    m_outputs.erase(id);
+  }
+
   // Close and delete the interface
   m_interfaces[id]->closeInt();
   delete m_interfaces[id];
@@ -390,6 +699,8 @@ void DMXPatch::deleteInterface(string id) {
   // Remove from the patch maps
   m_interfaces.erase(id);
   m_ifacePatch.erase(id);
+  releaseUniverses();
+  m_routesChanged = true;
 }
 
 DMXInterface* DMXPatch::getInterface(string id) {
@@ -412,6 +723,10 @@ void DMXPatch::moveInterface(string id, unsigned int universeFrom, unsigned int
 
   // Insert the to element.
   m_ifacePatch.insert(make_pair(id, universeTo));
+  m_universes.add(universeTo);
+  releaseUniverses();
+  m_routesChanged = true;
+  updateOutputUniverses(id);
 }
 
 void DMXPatch::patchDevice(Device* device, DMXDevicePatch* patch) {
@@ -434,35 +749,100 @@ void DMXPatch::addParameter(string mapId, string paramId, unsigned int address,
   m_deviceMaps[mapId][paramId] = patchData(address, type);
 }
 
+void DMXPatch::addCurve(string name, shared_ptr<DMXCurve> curve) {
+  m_curves[name] = curve;
+
+  for (auto& dm : m_deviceMaps) {
+    for (auto& param : dm.second) {
+      if (param.second.curveName == name)
+        param.second.curve = curve;
+    }
+  }
+}
+
+shared_ptr<DMXCurve> DMXPatch::getCurve(string name) {
+  if (m_curves.count(name) > 0)
+    return m_curves[name];
+
+  DMXCurve::Shape shape;
+  if (!DMXCurve::stringToShape(name, shape) || shape == DMXCurve::CUSTOM)
+    return nullptr;
+
+  shared_ptr<DMXCurve> curve = make_shared<DMXCurve>(shape);
+  m_curves[name] = curve;
+  return curve;
+}
+
+bool DMXPatch::setParameterCurve(string mapId, string paramId, string curveName) {
+  if (m_deviceMaps.count(mapId) == 0 || m_deviceMaps[mapId].count(paramId) == 0)
+    return false;
+
+  patchData& pd = m_deviceMaps[mapId][paramId];
+  if (curveName == "") {
+    pd.curve = nullptr;
+    pd.curveName = "";
+    return true;
+  }
+
+  shared_ptr<DMXCurve> curve = getCurve(curveName);
+  if (curve == nullptr)
+    return false;
+
+  pd.curve = curve;
+  pd.curveName = curveName;
+  return true;
+}
+
 void DMXPatch::dumpUniverses() {
-  for (unsigned int i = 0; i < m_universes.size(); i++) {
+  for (unsigned int i = 0; i < m_universes.range(); i++) {
     dumpUniverse(i);
   }
 }
 
 void DMXPatch::dumpUniverse(unsigned int universe) {
-  vector<unsigned char> uni = m_universes[universe];
+  const unsigned char* uni = m_universes.get(universe);
+  if (uni == nullptr)
+    return;
 
   cout << "Universe " << universe << "\n";
-  for (unsigned int i = 0; i < uni.size(); i++) {
+  for (unsigned int i = 0; i < DMXUniverseSlab::UNIVERSE_SIZE; i++) {
     cout << i << ":" << (int)uni[i] << "\n";
   }
   cout << "\n";
 }
 
+const vector<vector<unsigned char> >& DMXPatch::getUniverses() {
+  const size_t size = DMXUniverseSlab::UNIVERSE_SIZE;
+  m_universeCopy.resize(m_universes.range(), vector<unsigned char>(size, 0));
+
+  for (size_t u = 0; u < m_universeCopy.size(); u++) {
+    const unsigned char* data = m_universes.get((unsigned int)u);
+    if (data != nullptr)
+      memcpy(m_universeCopy[u].data(), data, size);
+    else
+      memset(m_universeCopy[u].data(), 0, size);
+  }
+
+  return m_universeCopy;
+}
+
 bool DMXPatch::setRawData(unsigned int universe, vector<unsigned char> univData) {
   if (univData.size() != 512) {
     Logger::log(LOG_LEVEL::ERR, "Set raw DMX data failure: buffer is not 512 bytes long.");
     return false;
   }
 
-  m_universes[universe] = univData;
-
-  // Send updated data to interfaces
-  for (auto& i : m_ifacePatch) {
-    m_interfaces[i.first]->sendDMX(&m_universes[i.second].front(), i.second);
+  unsigned char* data = m_universes.get(universe);
+  if (data == nullptr) {
+    stringstream ss;
+    ss << "Set raw DMX data failure: no interface is assigned to universe " << universe << ".";
+    Logger::log(LOG_LEVEL::ERR, ss.str());
+    return false;
   }
 
+  memcpy(data, univData.data(), DMXUniverseSlab::UNIVERSE_SIZE);
+  sendUniverses();
+
   return true;
 }
 
@@ -515,4 +895,294 @@ vector<string> DMXPatch::getInterfaceIDs() {
   return ids;
 }
 
+bool DMXPatch::startRecording(const string& filename, shared_ptr<Clock> clock, bool compress) {
+  // Finish the current file first in case the new recording replaces it.
+  stopRecording();
+
+  shared_ptr<DMXShowRecorder> recorder = make_shared<DMXShowRecorder>(clock);
+  if (!recorder->start(filename, compress))
+    return false;
+
+  atomic_store(&m_recorder, recorder);
+  Logger::log(INFO, "Recording DMX output to " + filename);
+  return true;
+}
+
+void DMXPatch::stopRecording() {
+  shared_ptr<DMXShowRecorder> recorder = atomic_exchange(&m_recorder, shared_ptr<DMXShowRecorder>());
+  if (recorder != nullptr)
+    recorder->stop();
+}
+
+bool DMXPatch::isRecording() {
+  return atomic_load(&m_recorder) != nullptr;
+}
+
+void DMXPatch::setAsyncOutput(bool async) {
+  m_asyncOutput = async;
+
+  if (!async)
+    stopOutputs();
+}
+
+DMXOutputThread* DMXPatch::getOutputThread(string id) {
+  return (m_outputs.count(id) == 0) ? nullptr : m_outputs[id];
+}
+
+DMXOutputStats DMXPatch::getOutputStats(string id) {
+  return (m_outputs.count(id) == 0) ? DMXOutputStats() : m_outputs[id]->getStats();
+}
+
+void DMXPatch::updateOutputUniverses(string id) {
+  if (m_outputs.count(id) == 0)
+    return;
+
+  vector<unsigned int> universes;
+  auto range = m_ifacePatch.equal_range(id);
+  for (auto it = range.first; it != range.second; ++it) {
+    universes.push_back(it->second);
+  }
+
+  m_outputs[id]->setUniverses(universes);
+}
+
+void DMXPatch::stopOutputs() {
+  for (auto& out : m_outputs) {
+    delete out.second;
+  }
+
+  m_outputs.clear();
+  m_routesChanged = true;
+}
+
+void DMXPatch::buildRoutes() {
+  m_routes.clear();
+
+  for (auto& i : m_ifacePatch) {
+    auto iface = m_interfaces.find(i.first);
+    int slot = m_universes.indexOf(i.second);
+    if (iface == m_interfaces.end() || slot < 0)
+      continue;
+
+    Route r;
+    r.iface = iface->second;
+    auto out = m_outputs.find(i.first);
+    r.output = (out != m_outputs.end()) ? out->second : nullptr;
+    r.universe = i.second;
+    r.slot = slot;
+    m_routes.push_back(r);
+  }
+
+  m_routesChanged = false;
+}
+
+void DMXPatch::releaseUniverses() {
+  vector<char> used(m_universes.range(), 0);
+  for (const auto& i : m_ifacePatch) {
+    if (i.second < used.size())
+      used[i.second] = 1;
+  }
+
+  bool removed = false;
+  for (unsigned int u = 0; u < used.size(); u++) {
+    if (!used[u] && m_universes.remove(u))
+      removed = true;
+  }
+
+  // Slots moved, so every universe goes out again on the next frame
+  if (removed)
+    m_lastSendTime.clear();
+}
+
+bool DMXPatch::addInput(DMXInput* input) {
+  if (m_inputs.count(input->getInputId()) > 0)
+    return false;
+
+  m_inputs[input->getInputId()] = input;
+  return true;
+}
+
+DMXInput* DMXPatch::getInput(string id) {
+  return (m_inputs.count(id) == 0) ? nullptr : m_inputs[id];
+}
+
+void DMXPatch::deleteInput(string id) {
+  if (m_inputs.count(id) == 0)
+    return;
+
+  for (unsigned int u = 0; u < m_merges.size(); u++) {
+    if (m_merges[u] != nullptr && m_merges[u]->inputId == id)
+      removeMerge(u);
+  }
+
+  delete m_inputs[id];
+  m_inputs.erase(id);
+}
+
+bool DMXPatch::setMergeSource(unsigned int universe, string inputId, unsigned int inputUniverse) {
+  DMXInput* input = getInput(inputId);
+  if (input == nullptr)
+    return false;
+
+  if (universe >= m_merges.size())
+    m_merges.resize(universe + 1);
+
+  Merge* merge = new Merge();
+  merge->inputId = inputId;
+  merge->inputUniverse = inputUniverse;
+  memset(merge->htp, 0xff, 512);
+  memset(merge->ltp, 0, 512);
+  memset(merge->priority, 0, 512);
+  memset(merge->inputOwns, 0, 512);
+  memset(merge->lastInput, 0, 512);
+  memset(merge->lastOutput, 0, 512);
+  memset(merge->input, 0, 512);
+  merge->inputPriority = 0;
+  merge->live = false;
+
+  m_merges[universe].reset(merge);
+  m_merging = true;
+
+  input->listen(inputUniverse);
+  if (m_initialized)
+    input->start();
+
+  return true;
+}
+
+void DMXPatch::removeMerge(unsigned int universe) {
+  if (universe >= m_merges.size())
+    return;
+
+  m_merges[universe].reset();
+
+  m_merging = false;
+  for (auto& m : m_merges) {
+    if (m != nullptr)
+      m_merging = true;
+  }
+}
+
+void DMXPatch::setMergeMode(unsigned int universe, DMXMergeMode mode, unsigned int first, unsigned int count) {
+  if (universe >= m_merges.size() || m_merges[universe] == nullptr || first >= 512)
+    return;
+
+  Merge& m = *m_merges[universe];
+  count = min(count, 512 - first);
+
+  memset(m.htp + first, (mode == MERGE_HTP) ? 0xff : 0, count);
+  memset(m.ltp + first, (mode == MERGE_LTP) ? 0xff : 0, count);
+  memset(m.priority + first, (mode == MERGE_PRIORITY) ? 0xff : 0, count);
+}
+
+DMXMergeMode DMXPatch::getMergeMode(unsigned int universe, unsigned int channel) {
+  if (universe >= m_merges.size() || m_merges[universe] == nullptr || channel >= 512)
+    return MERGE_OFF;
+
+  Merge& m = *m_merges[universe];
+  if (m.htp[channel])
+    return MERGE_HTP;
+  if (m.ltp[channel])
+    return MERGE_LTP;
+  if (m.priority[channel])
+    return MERGE_PRIORITY;
+
+  return MERGE_OFF;
+}
+
+void DMXPatch::readInput(Merge& merge) {
+  DMXInput* input = getInput(merge.inputId);
+  merge.live = input != nullptr && input->read(merge.inputUniverse, merge.input, merge.inputPriority);
+}
+
+const unsigned char* DMXPatch::mergeInputs() {
+  if (!m_merging)
+    return m_universes.data();
+
+  const size_t size = DMXUniverseSlab::UNIVERSE_SIZE;
+  m_merged.resize(m_universes.size() * size);
+  if (m_universes.size() > 0)
+    memcpy(m_merged.data(), m_universes.data(), m_merged.size());
+
+  for (size_t slot = 0; slot < m_universes.size(); slot++) {
+    unsigned int u = m_universes.universeAt(slot);
+    if (u >= m_merges.size() || m_merges[u] == nullptr)
+      continue;
+
+    Merge& m = *m_merges[u];
+    readInput(m);
+    if (!m.live)
+      continue;
+
+    const unsigned char* in = m.input;
+    const unsigned char* out = m_universes.at(slot);
+    unsigned char* res = &m_merged[slot * size];
+
+    // Priority channels follow the input if it has the higher priority, and take the
+    // highest value on a tie.
+    unsigned char inputWins = (m.inputPriority > m_outputPriority) ? 0xff : 0;
+    unsigned char tie = (m.inputPriority == m_outputPriority) ? 0xff : 0;
+
+    // Every channel is worked out with masks instead of branches, so the loop vectorizes.
+    for (int c = 0; c < 512; c++) {
+      unsigned char inChanged = (unsigned char)-(in[c] != m.lastInput[c]);
+      unsigned char outChanged = (unsigned char)-(out[c] != m.lastOutput[c]);
+      unsigned char owns = (unsigned char)((m.inputOwns[c] & ~outChanged) | inChanged);
+
+      unsigned char highest = (in[c] > out[c]) ? in[c] : out[c];
+      unsigned char useHighest = m.htp[c] | (m.priority[c] & tie);
+      unsigned char useInput = (m.ltp[c] & owns) | (m.priority[c] & inputWins);
+      unsigned char picked = (unsigned char)((useInput & in[c]) | (~useInput & out[c]));
+
+      res[c] = (unsigned char)((useHighest & highest) | (~useHighest & picked));
+      m.inputOwns[c] = owns;
+      m.lastInput[c] = in[c];
+      m.lastOutput[c] = out[c];
+    }
+  }
+
+  return m_merged.data();
+}
+
+int DMXPatch::applyInput(const set<Device*>& devices) {
+  for (auto& m : m_merges) {
+    if (m != nullptr)
+      readInput(*m);
+  }
+
+  int updated = 0;
+  for (Device* d : devices) {
+    auto patch = m_patch.find(d->getId());
+    if (patch == m_patch.end())
+      continue;
+
+    unsigned int uni = patch->second->getUniverse();
+    if (uni >= m_merges.size() || m_merges[uni] == nullptr || !m_merges[uni]->live)
+      continue;
+
+    try {
+      patch->second->readDMX(m_merges[uni]->input, d, m_deviceMaps[patch->second->getDMXMapKey()]);
+      updated++;
+    }
+    catch (exception& e) {
+      Logger::log(ERR, "Can't read DMX input into " + d->getId() + ": " + e.what());
+    }
+  }
+
+  return updated;
+}
+
+void DMXPatch::startInputs() {
+  for (auto& in : m_inputs) {
+    if (!in.second->getUniverses().empty())
+      in.second->start();
+  }
+}
+
+void DMXPatch::stopInputs() {
+  for (auto& in : m_inputs) {
+    in.second->stop();
+  }
+}
+
 }
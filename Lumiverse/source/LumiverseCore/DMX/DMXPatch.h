@@ -10,12 +10,30 @@
 
 #include "../Patch.h"
 #include "DMXDevicePatch.h"
+#include "DMXInput.h"
 #include "DMXInterface.h"
+#include "DMXOutputThread.h"
+#include "DMXShow.h"
+#include "DMXUniverseSlab.h"
 #include "../lib/libjson/libjson.h"
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
 
 namespace Lumiverse {
+  /*!
+  \brief How a channel combines DMX input with the output of the patch.
+
+  \sa DMXPatch::setMergeSource()
+  */
+  enum DMXMergeMode {
+    MERGE_OFF,      /*!< The channel ignores the input */
+    MERGE_HTP,      /*!< Highest value wins */
+    MERGE_LTP,      /*!< Whichever side changed the channel last wins */
+    MERGE_PRIORITY  /*!< Higher priority wins, highest value wins on a tie */
+  };
 
   /*!
   * \brief The DMX Patch object manages the communication between the DMX network
@@ -71,12 +89,14 @@ namespace Lumiverse {
     * \brief Initializes connections and other network settings for the patch.
     *
     * Call this AFTER all interfaces have been assigned. May need to call again
-    * if interfaces change.
+    * if interfaces change. Starts the output threads if output is asynchronous.
     */
     virtual void init();
 
     /*!
     * \brief Closes connections to the interfaces.
+    *
+    * Output threads send what they have left and are stopped first.
     */
     virtual void close();
 
@@ -217,6 +237,38 @@ namespace Lumiverse {
     */
     void addParameter(string mapId, string paramId, unsigned int address, conversionType type);
 
+    /*!
+    * \brief Adds a dimmer curve that parameters of device maps can use.
+    *
+    * Replaces a curve with the same name, and parameters that use the old curve
+    * switch to the new one.
+    * \param name Name of the curve
+    * \param curve The curve
+    * \sa DMXCurve
+    */
+    void addCurve(string name, shared_ptr<DMXCurve> curve);
+
+    /*!
+    * \brief Gets a curve by name.
+    *
+    * The names of the built in shapes, "linear", "square" and "scurve", are always
+    * available. They are added to the patch the first time they are used.
+    * \return The curve, or nullptr if there is no curve with that name.
+    */
+    shared_ptr<DMXCurve> getCurve(string name);
+
+    /*!
+    * \brief Applies a curve to a parameter of a device map.
+    *
+    * The curve is applied while the parameter is converted to DMX, so it costs nothing
+    * beyond a table lookup. Only float and color conversions use curves.
+    * \param mapId Device map ID
+    * \param paramId Parameter in the map
+    * \param curveName Name of the curve. Empty removes the curve.
+    * \return False if the parameter or the curve doesn't exist.
+    */
+    bool setParameterCurve(string mapId, string paramId, string curveName);
+
     /*!
     * \brief Debug function that prints out all DMX values for all universes in the patch.
     */
@@ -231,7 +283,8 @@ namespace Lumiverse {
     /*!
     * \brief Directly modifies the DMX data in the specified universe. 
     *
-    * Pushes the data to the proper interface after updating. Note that if the update loop is active,
+    * Pushes the data to the proper interface after updating, through the interface's
+    * output thread if there is one. Note that if the update loop is active,
     * this probably won't do much of anything as the manual values will get overwritten
     * by the update loop. To get around this, initialize the rig but don't call Rig::run().
     * Must give an entire universe to this function. If you don't provide the entire universe,
@@ -253,7 +306,238 @@ namespace Lumiverse {
     */
     vector<string> getInterfaceIDs();
 
+    /*!
+    \brief Returns the DMX data computed by the last update.
+
+    Universe 1 is index 0. Universes without an interface are all zeros. Useful for
+    capturing output without a network, for example while rendering offline. The
+    universes are copied into a buffer the patch keeps, which is only reallocated
+    when the highest universe changes. Use getUniverse() to look at a single
+    universe without copying.
+    */
+    const vector<vector<unsigned char> >& getUniverses();
+
+    /*!
+    \brief Returns the 512 bytes computed for a universe by the last update.
+
+    nullptr if no interface is assigned to the universe. The pointer stays valid
+    until an interface is assigned to a new universe or the last interface is
+    removed from one.
+    */
+    const unsigned char* getUniverse(unsigned int universe) { return m_universes.get(universe); }
+
+    /*! \brief Returns the storage of every universe the patch outputs. */
+    const DMXUniverseSlab& getUniverseSlab() { return m_universes; }
+
+    /*!
+    \brief Sends to each interface from its own thread.
+
+    On by default. With asynchronous output, the update loop hands every universe
+    to the output thread of its interface and moves on, so a slow or failing
+    interface can't hold up the Rig. The threads start in init(). Until then, and
+    with asynchronous output off, interfaces are sent to from the update loop.
+    \sa DMXOutputThread
+    */
+    void setAsyncOutput(bool async);
+
+    /*! \brief Returns true if interfaces are sent to from their own threads. */
+    bool getAsyncOutput() { return m_asyncOutput; }
+
+    /*!
+    \brief Returns the output thread of an interface.
+
+    nullptr if output is synchronous, the patch wasn't initialized or there is no
+    interface with that id. Use it to limit the send rate of an interface.
+    */
+    DMXOutputThread* getOutputThread(string id);
+
+    /*!
+    \brief Returns the send, drop, error and latency counters of an interface.
+
+    All zero if the interface has no output thread.
+    */
+    DMXOutputStats getOutputStats(string id);
+
+    /*!
+    \brief Sets how often universes that haven't changed are sent again.
+
+    A universe goes out to its interfaces when any of its bytes changed since it was
+    last sent, or when the keep-alive interval has passed. Art-Net and sACN receivers
+    expect at least one packet a second. Defaults to 1000ms.
+    \param ms Keep-alive interval in milliseconds. 0 sends every universe every frame.
+    */
+    void setKeepAliveInterval(unsigned int ms) { m_keepAlive = ms; }
+
+    /*! \brief Returns the keep-alive interval in milliseconds. */
+    unsigned int getKeepAliveInterval() { return m_keepAlive; }
+
+    /*! \brief Number of universes sent to an interface. */
+    size_t getPacketsSent() { return m_packetsSent; }
+
+    /*! \brief Number of universe sends skipped because nothing changed. */
+    size_t getPacketsSaved() { return m_packetsSaved; }
+
+    /*! \brief Sets the sent and saved packet counters back to 0. */
+    void resetPacketCounters() { m_packetsSent = 0; m_packetsSaved = 0; }
+
+    /*!
+    \brief Starts recording every frame sent by the patch to a DMX show file.
+
+    The update loop only copies the universes into a queue, encoding and disk writes
+    happen on the recorder's own thread. Starting a new recording stops the current one.
+    \param filename Path of the show file.
+    \param clock Clock used to timestamp the frames. nullptr uses a SystemClock. Use
+    Rig::getSharedClock() to record on the Rig's timeline, for example while rendering
+    offline.
+    \param compress Deflates frames with zlib, if LumiverseCore was built with it.
+    \return False if the file couldn't be created.
+    \sa DMXShowRecorder, DMXShowPlayer
+    */
+    bool startRecording(const string& filename, shared_ptr<Clock> clock = nullptr, bool compress = false);
+
+    /*! \brief Writes out the rest of the recording and closes the show file. */
+    void stopRecording();
+
+    /*! \brief Returns true while the patch is recording. */
+    bool isRecording();
+
+    /*!
+    \brief Adds a DMX input to the patch. The patch frees it.
+
+    Inputs start listening in init() and stop in close().
+    \return False if an input with the same id already exists.
+    \sa DMXInput
+    */
+    bool addInput(DMXInput* input);
+
+    /*! \brief Returns an input for editing. nullptr if there is no input with that id. */
+    DMXInput* getInput(string id);
+
+    /*! \brief Stops and deletes an input and every merge that uses it. */
+    void deleteInput(string id);
+
+    /*!
+    \brief Merges a universe of an input into an output universe.
+
+    Every update, the latest frame of the input universe is combined with the universe
+    computed from the devices, one channel at a time according to the merge mode of the
+    channel. All channels start out as MERGE_HTP. A universe that isn't live, because
+    nothing was received or the source timed out, leaves the output alone.
+
+    The merged data is what goes to the interfaces and the recorder. getUniverses()
+    still returns the data computed from the devices.
+    \param universe Output universe
+    \param inputId Input to take data from
+    \param inputUniverse Universe of the input
+    \return False if there is no input with that id.
+    */
+    bool setMergeSource(unsigned int universe, string inputId, unsigned int inputUniverse);
+
+    /*! \brief Stops merging input into a universe. */
+    void removeMerge(unsigned int universe);
+
+    /*!
+    \brief Sets the merge mode of a range of channels in a merged universe.
+    \param universe Output universe, which needs a merge source.
+    \param mode Merge mode
+    \param first First channel (zero-indexed)
+    \param count Number of channels
+    */
+    void setMergeMode(unsigned int universe, DMXMergeMode mode, unsigned int first = 0, unsigned int count = 512);
+
+    /*! \brief Returns the merge mode of a channel. MERGE_OFF if the universe isn't merged. */
+    DMXMergeMode getMergeMode(unsigned int universe, unsigned int channel);
+
+    /*!
+    \brief Sets the priority of the data computed from the devices, 0 to 200.
+
+    Compared against the priority of the input on MERGE_PRIORITY channels. Defaults to 100.
+    */
+    void setOutputPriority(int priority) { m_outputPriority = (priority < 0) ? 0 : (priority > 200) ? 200 : priority; }
+    int getOutputPriority() { return m_outputPriority; }
+
+    /*!
+    \brief Sets device parameters from the DMX input.
+
+    Each device with a patch on a merged universe reads its parameters back from the
+    latest frame of the input, through the inverse of its DMX map. Use it to let a
+    console drive a Programmer, or the devices a Layer captures, instead of the output.
+    Devices on universes without a live input are left alone.
+
+    Inputs are read from one thread only, so call this from the update loop, for
+    example from a function added with Rig::addFunction().
+    \param devices Devices to update
+    \return Number of devices that were updated.
+    */
+    int applyInput(const set<Device*>& devices);
+
   private:
+    /*! \brief Input merged into an output universe and the state of each channel. */
+    struct Merge {
+      string inputId;
+      unsigned int inputUniverse;
+
+      /*! \brief 0xff on the channels that use a mode, 0 everywhere else. */
+      unsigned char htp[512];
+      unsigned char ltp[512];
+      unsigned char priority[512];
+
+      /*! \brief 0xff on LTP channels the input changed last. */
+      unsigned char inputOwns[512];
+
+      /*! \brief Input and device data of the last merge, to see what changed. */
+      unsigned char lastInput[512];
+      unsigned char lastOutput[512];
+
+      /*! \brief Latest frame of the input and its priority. */
+      unsigned char input[512];
+      unsigned char inputPriority;
+
+      /*! \brief True if the input is live. */
+      bool live;
+    };
+
+    /*! \brief Reads the latest frame of the input of a merge. */
+    void readInput(Merge& merge);
+
+    /*!
+    \brief Merges the input of each merged universe into m_merged.
+    \return Start of the merged universes, laid out like m_universes.
+    */
+    const unsigned char* mergeInputs();
+
+    /*! \brief Starts every input that listens to at least one universe. */
+    void startInputs();
+
+    /*! \brief Stops every input. */
+    void stopInputs();
+
+    /*!
+    \brief Sends the universes that changed or are due for a keep-alive to their
+    interfaces, and every universe to the recorder if there is one.
+    */
+    void sendUniverses();
+
+    /*! \brief Gives an output thread the universes its interface is assigned to. */
+    void updateOutputUniverses(string id);
+
+    /*! \brief Stops and deletes every output thread. */
+    void stopOutputs();
+
+    /*! \brief Interface a universe is sent to, resolved ahead of time. */
+    struct Route {
+      DMXInterface* iface;
+      DMXOutputThread* output;
+      unsigned int universe;
+      size_t slot;
+    };
+
+    /*! \brief Rebuilds m_routes from the interface patch. */
+    void buildRoutes();
+
+    /*! \brief Frees the storage of universes that no interface is assigned to anymore. */
+    void releaseUniverses();
+
     /*!
     * \brief Loads data from a parsed JSON object
     * \param data JSON data to load
@@ -276,9 +560,10 @@ namespace Lumiverse {
     /*!
     * \brief Stores the state of the DMX universes.
     *
-    * Note that DMX Universe 1 is index 0 here due to one-indexing.
+    * Every universe assigned to an interface has a slot. Note that DMX Universe 1
+    * is universe 0 here due to one-indexing.
     */
-    vector<vector<unsigned char> > m_universes;
+    DMXUniverseSlab m_universes;
 
     /*!
     * \brief Maps interface id to universe number (zero-indexed)
@@ -309,6 +594,79 @@ namespace Lumiverse {
     * devices. Key is the device map name.
     */
     map<string, map<string, patchData> > m_deviceMaps;
+
+    /*! \brief Dimmer curves used by the device maps, by name. */
+    map<string, shared_ptr<DMXCurve> > m_curves;
+
+    /*!
+    \brief Recorder for the output of the patch, if recording.
+
+    Accessed with the atomic shared_ptr functions, since recording can be started and
+    stopped while the update loop is running.
+    */
+    shared_ptr<DMXShowRecorder> m_recorder;
+
+    /*! \brief If true, init() gives every interface an output thread. */
+    bool m_asyncOutput;
+
+    /*!
+    \brief Output thread of each interface, by interface id.
+
+    Only exists between init() and close().
+    */
+    map<string, DMXOutputThread*> m_outputs;
+
+    /*! \brief Keep-alive interval in milliseconds. 0 if every frame is sent. */
+    unsigned int m_keepAlive;
+
+    /*! \brief Each universe as it was last sent, by slot. */
+    vector<unsigned char> m_lastSent;
+
+    /*! \brief When each universe was last sent, by slot. */
+    vector<chrono::steady_clock::time_point> m_lastSendTime;
+
+    /*! \brief Slots that go out this frame. */
+    vector<char> m_dirty;
+
+    /*!
+    \brief Every universe of every interface, sorted by interface.
+
+    Built from m_ifacePatch when it or the output threads change, so sending a
+    frame doesn't look anything up.
+    */
+    vector<Route> m_routes;
+
+    /*! \brief True if m_routes is out of date. */
+    bool m_routesChanged;
+
+    /*! \brief Frame handed to the recorder, with every universe up to the highest. */
+    vector<vector<unsigned char> > m_recordFrame;
+
+    /*! \brief Universes returned by getUniverses(). */
+    vector<vector<unsigned char> > m_universeCopy;
+
+    /*! \brief Interfaces sent to from the update loop this frame. */
+    vector<DMXInterface*> m_toFlush;
+
+    atomic<size_t> m_packetsSent;
+    atomic<size_t> m_packetsSaved;
+
+    /*! \brief DMX inputs by id. */
+    map<string, DMXInput*> m_inputs;
+
+    /*! \brief Merge of each output universe, nullptr for universes that aren't merged. */
+    vector<unique_ptr<Merge> > m_merges;
+
+    /*! \brief Output universes after merging, by slot. Only used while there are merges. */
+    vector<unsigned char> m_merged;
+
+    /*! \brief True while at least one universe is merged. */
+    bool m_merging;
+
+    int m_outputPriority;
+
+    /*! \brief True between init() and close(). */
+    bool m_initialized;
   };
 }
 
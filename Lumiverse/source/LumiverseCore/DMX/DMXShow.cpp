@@ -0,0 +1,838 @@
+#include "DMXShow.h"
+#include "DMXPatch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#ifdef USE_ZLIB
+#include "zlib.h"
+#endif
+
+namespace Lumiverse {
+
+namespace {
+
+const char SHOW_MAGIC[4] = { 'L', 'D', 'M', 'X' };
+const char INDEX_MAGIC[4] = { 'L', 'D', 'X', 'I' };
+const uint16_t SHOW_VERSION = 1;
+
+const uint16_t SHOW_FLAG_ZLIB = 1;
+const unsigned char FRAME_KEY = 1;
+const unsigned char FRAME_DEFLATED = 2;
+
+// magic, version, flags, keyframe interval, reserved
+const size_t HEADER_SIZE = 16;
+// type, time, stored size, raw size
+const size_t FRAME_HEADER_SIZE = 17;
+// time, offset, frame
+const size_t INDEX_ENTRY_SIZE = 20;
+// index entry count, index offset, frame count, magic
+const size_t TRAILER_SIZE = 20;
+
+// Encoded runs are 3 to 130 bytes long, literals 1 to 128 bytes.
+const size_t MIN_RUN = 3;
+const size_t MAX_RUN = 130;
+const size_t MAX_LITERAL = 128;
+
+void put16(vector<unsigned char>& buf, uint16_t v) {
+  buf.push_back(v & 0xff);
+  buf.push_back(v >> 8);
+}
+
+void put32(vector<unsigned char>& buf, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    buf.push_back((v >> (8 * i)) & 0xff);
+}
+
+void put64(vector<unsigned char>& buf, uint64_t v) {
+  for (int i = 0; i < 8; i++)
+    buf.push_back((v >> (8 * i)) & 0xff);
+}
+
+uint16_t get16(const unsigned char* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const unsigned char* p) {
+  uint32_t v = 0;
+  for (int i = 3; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+uint64_t get64(const unsigned char* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+// Run-length encodes a buffer. A control byte c < 128 is followed by c + 1 literal
+// bytes, otherwise the next byte repeats c - 125 times.
+void encodeRLE(const unsigned char* in, size_t n, vector<unsigned char>& out) {
+  size_t i = 0;
+
+  while (i < n) {
+    size_t run = 1;
+    while (i + run < n && run < MAX_RUN && in[i + run] == in[i])
+      run++;
+
+    if (run >= MIN_RUN) {
+      out.push_back((unsigned char)(run + 125));
+      out.push_back(in[i]);
+      i += run;
+      continue;
+    }
+
+    // Literal bytes up to the start of the next run
+    size_t start = i;
+    while (i < n && i - start < MAX_LITERAL) {
+      if (i + 2 < n && in[i] == in[i + 1] && in[i] == in[i + 2])
+        break;
+      i++;
+    }
+
+    out.push_back((unsigned char)(i - start - 1));
+    out.insert(out.end(), in + start, in + i);
+  }
+}
+
+// Decodes run-length encoded data and XORs it into out. Runs of zeros are skipped,
+// so unchanged channels cost nothing.
+bool decodeRLEXor(const unsigned char* in, size_t n, unsigned char* out, size_t outSize) {
+  const unsigned char* end = in + n;
+  size_t o = 0;
+
+  while (in < end) {
+    unsigned char c = *in++;
+
+    if (c < 128) {
+      size_t len = c + 1;
+      if (in + len > end || o + len > outSize)
+        return false;
+
+      for (size_t k = 0; k < len; k++)
+        out[o + k] ^= in[k];
+
+      in += len;
+      o += len;
+    }
+    else {
+      size_t len = c - 125;
+      if (in >= end || o + len > outSize)
+        return false;
+
+      unsigned char v = *in++;
+      if (v != 0) {
+        for (size_t k = 0; k < len; k++)
+          out[o + k] ^= v;
+      }
+
+      o += len;
+    }
+  }
+
+  return true;
+}
+
+}
+
+// ===========================================================================
+// DMXShowWriter
+
+DMXShowWriter::DMXShowWriter() : m_compress(false), m_keyframeInterval(44), m_numFrames(0) { }
+
+DMXShowWriter::~DMXShowWriter() {
+  if (isOpen())
+    close();
+}
+
+bool DMXShowWriter::open(const string& filename, bool compress, unsigned int keyframeInterval) {
+  if (isOpen())
+    close();
+
+#ifndef USE_ZLIB
+  if (compress) {
+    Logger::log(WARN, "LumiverseCore built without zlib. Writing " + filename + " uncompressed.");
+    compress = false;
+  }
+#endif
+
+  m_file.open(filename, ios::out | ios::binary | ios::trunc);
+  if (!m_file.is_open()) {
+    Logger::log(ERR, "Can't open DMX show file " + filename + " for writing.");
+    return false;
+  }
+
+  m_compress = compress;
+  m_keyframeInterval = (keyframeInterval == 0) ? 1 : keyframeInterval;
+  m_numFrames = 0;
+  m_index.clear();
+  m_prev.clear();
+
+  vector<unsigned char> header(SHOW_MAGIC, SHOW_MAGIC + 4);
+  put16(header, SHOW_VERSION);
+  put16(header, m_compress ? SHOW_FLAG_ZLIB : 0);
+  put32(header, m_keyframeInterval);
+  put32(header, 0);
+  m_file.write((const char*)header.data(), header.size());
+
+  return m_file.good();
+}
+
+bool DMXShowWriter::writeFrame(Clock::duration time, const vector<vector<unsigned char> >& universes) {
+  if (!isOpen())
+    return false;
+
+  if (universes.size() > 0xffff) {
+    Logger::log(ERR, "Too many universes for a DMX show frame.");
+    return false;
+  }
+
+  bool key = (m_numFrames % m_keyframeInterval == 0);
+  unsigned char diff[DMX_SHOW_UNIVERSE_SIZE];
+
+  m_payload.clear();
+  put16(m_payload, (uint16_t)universes.size());
+  put16(m_payload, 0);
+  uint16_t count = 0;
+
+  for (size_t u = 0; u < universes.size(); u++) {
+    const vector<unsigned char>& cur = universes[u];
+    if (cur.size() != DMX_SHOW_UNIVERSE_SIZE) {
+      Logger::log(ERR, "DMX show frames need 512 byte universes.");
+      return false;
+    }
+
+    bool hasPrev = !key && u < m_prev.size();
+    if (hasPrev && memcmp(cur.data(), m_prev[u].data(), DMX_SHOW_UNIVERSE_SIZE) == 0)
+      continue;
+
+    for (size_t i = 0; i < DMX_SHOW_UNIVERSE_SIZE; i++)
+      diff[i] = hasPrev ? (cur[i] ^ m_prev[u][i]) : cur[i];
+
+    put16(m_payload, (uint16_t)u);
+    size_t sizePos = m_payload.size();
+    put16(m_payload, 0);
+    encodeRLE(diff, DMX_SHOW_UNIVERSE_SIZE, m_payload);
+
+    uint16_t encoded = (uint16_t)(m_payload.size() - sizePos - 2);
+    m_payload[sizePos] = encoded & 0xff;
+    m_payload[sizePos + 1] = encoded >> 8;
+    count++;
+  }
+
+  m_payload[2] = count & 0xff;
+  m_payload[3] = count >> 8;
+  m_prev = universes;
+
+  const unsigned char* stored = m_payload.data();
+  size_t storedSize = m_payload.size();
+  unsigned char type = key ? FRAME_KEY : 0;
+
+#ifdef USE_ZLIB
+  if (m_compress) {
+    uLongf destLen = compressBound((uLong)m_payload.size());
+    m_stored.resize(destLen);
+
+    // Keep the raw payload if deflating doesn't help
+    if (compress2(m_stored.data(), &destLen, m_payload.data(), (uLong)m_payload.size(), Z_BEST_SPEED) == Z_OK &&
+      destLen < m_payload.size()) {
+      stored = m_stored.data();
+      storedSize = destLen;
+      type |= FRAME_DEFLATED;
+    }
+  }
+#endif
+
+  int64_t ns = chrono::duration_cast<chrono::nanoseconds>(time).count();
+
+  if (key) {
+    IndexEntry entry = { ns, (uint64_t)m_file.tellp(), (uint32_t)m_numFrames };
+    m_index.push_back(entry);
+  }
+
+  vector<unsigned char> header;
+  header.push_back(type);
+  put64(header, (uint64_t)ns);
+  put32(header, (uint32_t)storedSize);
+  put32(header, (uint32_t)m_payload.size());
+
+  m_file.write((const char*)header.data(), header.size());
+  m_file.write((const char*)stored, storedSize);
+  m_numFrames++;
+
+  return m_file.good();
+}
+
+bool DMXShowWriter::close() {
+  if (!isOpen())
+    return false;
+
+  uint64_t indexOffset = (uint64_t)m_file.tellp();
+
+  vector<unsigned char> index;
+  for (const auto& e : m_index) {
+    put64(index, (uint64_t)e.time);
+    put64(index, e.offset);
+    put32(index, e.frame);
+  }
+
+  put32(index, (uint32_t)m_index.size());
+  put64(index, indexOffset);
+  put32(index, (uint32_t)m_numFrames);
+  index.insert(index.end(), INDEX_MAGIC, INDEX_MAGIC + 4);
+
+  m_file.write((const char*)index.data(), index.size());
+  bool ok = m_file.good();
+  m_file.close();
+
+  return ok;
+}
+
+// ===========================================================================
+// DMXShowReader
+
+DMXShowReader::DMXShowReader() : m_compressed(false), m_numFrames(0), m_dataStart(HEADER_SIZE),
+  m_dataEnd(HEADER_SIZE), m_pos(HEADER_SIZE), m_frame(-1), m_time(0), m_keyframe(false) { }
+
+bool DMXShowReader::open(const string& filename) {
+  close();
+
+  m_file.open(filename, ios::in | ios::binary);
+  if (!m_file.is_open()) {
+    Logger::log(ERR, "Can't open DMX show file " + filename);
+    return false;
+  }
+
+  unsigned char header[HEADER_SIZE];
+  if (!m_file.read((char*)header, HEADER_SIZE) || memcmp(header, SHOW_MAGIC, 4) != 0) {
+    Logger::log(ERR, filename + " is not a DMX show file.");
+    close();
+    return false;
+  }
+
+  if (get16(header + 4) > SHOW_VERSION) {
+    Logger::log(ERR, filename + " was written by a newer version of Lumiverse.");
+    close();
+    return false;
+  }
+
+  m_compressed = (get16(header + 6) & SHOW_FLAG_ZLIB) != 0;
+#ifndef USE_ZLIB
+  if (m_compressed) {
+    Logger::log(ERR, "LumiverseCore built without zlib. Can't read compressed DMX show " + filename);
+    close();
+    return false;
+  }
+#endif
+
+  if (!loadIndex()) {
+    Logger::log(ERR, "Can't read the frames of DMX show " + filename);
+    close();
+    return false;
+  }
+
+  rewind();
+  return true;
+}
+
+void DMXShowReader::close() {
+  if (m_file.is_open())
+    m_file.close();
+
+  m_numFrames = 0;
+  m_index.clear();
+  m_dataEnd = m_dataStart;
+  m_frame = -1;
+  m_time = Clock::duration(0);
+  m_universes.clear();
+  m_changed.clear();
+}
+
+bool DMXShowReader::loadIndex() {
+  m_file.clear();
+  m_file.seekg(0, ios::end);
+  uint64_t size = (uint64_t)m_file.tellg();
+
+  // A closed file ends with the index
+  if (size >= m_dataStart + TRAILER_SIZE) {
+    unsigned char trailer[TRAILER_SIZE];
+    m_file.seekg(size - TRAILER_SIZE);
+
+    if (m_file.read((char*)trailer, TRAILER_SIZE) && memcmp(trailer + 16, INDEX_MAGIC, 4) == 0) {
+      uint32_t count = get32(trailer);
+      uint64_t indexOffset = get64(trailer + 4);
+
+      if (indexOffset >= m_dataStart && indexOffset + count * INDEX_ENTRY_SIZE + TRAILER_SIZE == size) {
+        vector<unsigned char> index(count * INDEX_ENTRY_SIZE);
+        m_file.seekg(indexOffset);
+
+        if (count == 0 || m_file.read((char*)index.data(), index.size())) {
+          for (uint32_t i = 0; i < count; i++) {
+            const unsigned char* p = index.data() + i * INDEX_ENTRY_SIZE;
+            IndexEntry e = { (int64_t)get64(p), get64(p + 8), get32(p + 16) };
+            m_index.push_back(e);
+          }
+
+          m_numFrames = get32(trailer + 12);
+          m_dataEnd = indexOffset;
+          return true;
+        }
+      }
+    }
+  }
+
+  // Otherwise the recording was cut short. Walk the frame headers to index it.
+  Logger::log(WARN, "DMX show file has no index, scanning frames.");
+  m_file.clear();
+  m_index.clear();
+
+  uint64_t pos = m_dataStart;
+  unsigned char header[FRAME_HEADER_SIZE];
+  size_t frames = 0;
+
+  while (pos + FRAME_HEADER_SIZE <= size) {
+    m_file.seekg(pos);
+    if (!m_file.read((char*)header, FRAME_HEADER_SIZE))
+      break;
+
+    uint64_t next = pos + FRAME_HEADER_SIZE + get32(header + 9);
+    if (next > size)
+      break;
+
+    if (header[0] & FRAME_KEY) {
+      IndexEntry e = { (int64_t)get64(header + 1), pos, (uint32_t)frames };
+      m_index.push_back(e);
+    }
+
+    frames++;
+    pos = next;
+  }
+
+  m_file.clear();
+  m_numFrames = frames;
+  m_dataEnd = pos;
+  return true;
+}
+
+void DMXShowReader::rewind() {
+  m_file.clear();
+  m_file.seekg(m_dataStart);
+  m_pos = m_dataStart;
+  m_frame = -1;
+  m_time = Clock::duration(0);
+  m_keyframe = false;
+  m_universes.clear();
+  m_changed.clear();
+}
+
+bool DMXShowReader::next() {
+  if (!isOpen() || m_pos + FRAME_HEADER_SIZE > m_dataEnd)
+    return false;
+
+  unsigned char header[FRAME_HEADER_SIZE];
+  if (!m_file.read((char*)header, FRAME_HEADER_SIZE))
+    return false;
+
+  unsigned char type = header[0];
+  int64_t ns = (int64_t)get64(header + 1);
+  uint32_t storedSize = get32(header + 9);
+  uint32_t rawSize = get32(header + 13);
+
+  if (m_pos + FRAME_HEADER_SIZE + storedSize > m_dataEnd)
+    return false;
+
+  m_stored.resize(storedSize);
+  if (storedSize > 0 && !m_file.read((char*)m_stored.data(), storedSize))
+    return false;
+
+  const unsigned char* data = m_stored.data();
+  if (type & FRAME_DEFLATED) {
+#ifdef USE_ZLIB
+    m_payload.resize(rawSize);
+    uLongf destLen = rawSize;
+    if (uncompress(m_payload.data(), &destLen, m_stored.data(), storedSize) != Z_OK || destLen != rawSize)
+      return false;
+    data = m_payload.data();
+#else
+    return false;
+#endif
+  }
+  else if (rawSize != storedSize) {
+    return false;
+  }
+
+  if (rawSize < 4)
+    return false;
+
+  const unsigned char* end = data + rawSize;
+  uint16_t numUniverses = get16(data);
+  uint16_t count = get16(data + 2);
+  data += 4;
+
+  bool key = (type & FRAME_KEY) != 0;
+  m_universes.resize(numUniverses, vector<unsigned char>(DMX_SHOW_UNIVERSE_SIZE, 0));
+  if (key) {
+    for (auto& u : m_universes)
+      fill(u.begin(), u.end(), 0);
+  }
+
+  m_changed.clear();
+  for (uint16_t i = 0; i < count; i++) {
+    if (data + 4 > end)
+      return false;
+
+    uint16_t u = get16(data);
+    uint16_t len = get16(data + 2);
+    data += 4;
+
+    if (u >= numUniverses || data + len > end ||
+      !decodeRLEXor(data, len, m_universes[u].data(), DMX_SHOW_UNIVERSE_SIZE))
+      return false;
+
+    m_changed.push_back(u);
+    data += len;
+  }
+
+  m_pos += FRAME_HEADER_SIZE + storedSize;
+  m_frame++;
+  m_time = chrono::duration_cast<Clock::duration>(chrono::nanoseconds(ns));
+  m_keyframe = key;
+
+  return true;
+}
+
+bool DMXShowReader::peekTime(Clock::duration& time) {
+  if (!isOpen() || m_pos + FRAME_HEADER_SIZE > m_dataEnd)
+    return false;
+
+  unsigned char header[FRAME_HEADER_SIZE];
+  if (!m_file.read((char*)header, FRAME_HEADER_SIZE))
+    return false;
+
+  m_file.seekg(m_pos);
+  time = chrono::duration_cast<Clock::duration>(chrono::nanoseconds((int64_t)get64(header + 1)));
+  return true;
+}
+
+bool DMXShowReader::seekIndex(size_t entry) {
+  rewind();
+  m_file.seekg(m_index[entry].offset);
+  m_pos = m_index[entry].offset;
+  m_frame = (long)m_index[entry].frame - 1;
+
+  return next();
+}
+
+bool DMXShowReader::seek(Clock::duration time) {
+  if (!isOpen())
+    return false;
+
+  int64_t ns = chrono::duration_cast<chrono::nanoseconds>(time).count();
+  auto it = upper_bound(m_index.begin(), m_index.end(), ns,
+    [](int64_t t, const IndexEntry& e) { return t < e.time; });
+
+  if (it == m_index.begin()) {
+    rewind();
+    return true;
+  }
+
+  if (!seekIndex(it - m_index.begin() - 1))
+    return false;
+
+  Clock::duration nextTime;
+  while (peekTime(nextTime) && nextTime <= time) {
+    if (!next())
+      return false;
+  }
+
+  return true;
+}
+
+bool DMXShowReader::seekFrame(size_t frame) {
+  if (!isOpen() || frame >= m_numFrames)
+    return false;
+
+  auto it = upper_bound(m_index.begin(), m_index.end(), frame,
+    [](size_t f, const IndexEntry& e) { return f < e.frame; });
+
+  if (it == m_index.begin())
+    rewind();
+  else if (!seekIndex(it - m_index.begin() - 1))
+    return false;
+
+  while (m_frame < (long)frame) {
+    if (!next())
+      return false;
+  }
+
+  return true;
+}
+
+// ===========================================================================
+// DMXShowRecorder
+
+DMXShowRecorder::DMXShowRecorder(shared_ptr<Clock> clock) : m_clock(clock), m_writeThread(nullptr),
+  m_recording(false), m_dropped(0)
+{
+  if (m_clock == nullptr)
+    m_clock = make_shared<SystemClock>();
+}
+
+DMXShowRecorder::~DMXShowRecorder() {
+  stop();
+}
+
+bool DMXShowRecorder::start(const string& filename, bool compress, unsigned int keyframeInterval) {
+  if (m_recording)
+    return false;
+
+  if (!m_writer.open(filename, compress, keyframeInterval))
+    return false;
+
+  m_start = m_clock->now();
+  m_dropped = 0;
+  m_recording = true;
+  m_writeThread = new thread(&DMXShowRecorder::writeLoop, this);
+
+  return true;
+}
+
+void DMXShowRecorder::stop() {
+  if (m_writeThread == nullptr)
+    return;
+
+  {
+    lock_guard<mutex> lock(m_queueLock);
+    m_recording = false;
+  }
+  m_queueCond.notify_one();
+
+  m_writeThread->join();
+  delete m_writeThread;
+  m_writeThread = nullptr;
+
+  m_writer.close();
+
+  if (m_dropped > 0) {
+    stringstream ss;
+    ss << "DMX recorder dropped " << m_dropped << " frames because the disk couldn't keep up.";
+    Logger::log(WARN, ss.str());
+  }
+}
+
+void DMXShowRecorder::record(const vector<vector<unsigned char> >& universes) {
+  if (!m_recording)
+    return;
+
+  Clock::duration time = m_clock->now() - m_start;
+  unique_ptr<Frame> frame;
+
+  {
+    lock_guard<mutex> lock(m_queueLock);
+    if (m_queue.size() >= MAX_QUEUED) {
+      m_dropped++;
+      return;
+    }
+
+    if (!m_pool.empty()) {
+      frame = move(m_pool.back());
+      m_pool.pop_back();
+    }
+  }
+
+  // Copy outside of the lock. Pooled frames already have room for the data.
+  if (frame == nullptr)
+    frame.reset(new Frame());
+  frame->time = time;
+  frame->universes = universes;
+
+  {
+    lock_guard<mutex> lock(m_queueLock);
+    m_queue.push_back(move(frame));
+  }
+  m_queueCond.notify_one();
+}
+
+void DMXShowRecorder::writeLoop() {
+  unique_lock<mutex> lock(m_queueLock);
+
+  while (true) {
+    m_queueCond.wait(lock, [this] { return !m_queue.empty() || !m_recording; });
+
+    // Everything queued is written before stopping
+    if (m_queue.empty())
+      break;
+
+    unique_ptr<Frame> frame = move(m_queue.front());
+    m_queue.pop_front();
+
+    lock.unlock();
+    m_writer.writeFrame(frame->time, frame->universes);
+    lock.lock();
+
+    m_pool.push_back(move(frame));
+  }
+}
+
+// ===========================================================================
+// DMXShowPlayer
+
+DMXShowPlayer::DMXShowPlayer() : m_pending(false), m_playThread(nullptr), m_playing(false), m_loop(false) { }
+
+DMXShowPlayer::~DMXShowPlayer() {
+  stop();
+}
+
+bool DMXShowPlayer::open(const string& filename) {
+  stop();
+  m_pending = false;
+
+  return m_reader.open(filename);
+}
+
+void DMXShowPlayer::addOutput(DMXInterface* iface, unsigned int universe) {
+  if (universe >= m_outputs.size())
+    m_outputs.resize(universe + 1);
+
+  m_outputs[universe].push_back(iface);
+}
+
+void DMXShowPlayer::addOutputs(DMXPatch* patch) {
+  for (const auto& i : patch->getInterfaceInfo()) {
+    DMXInterface* iface = patch->getInterface(i.first);
+    if (iface != nullptr)
+      addOutput(iface, i.second);
+  }
+}
+
+void DMXShowPlayer::clearOutputs() {
+  m_outputs.clear();
+}
+
+bool DMXShowPlayer::play(bool loop) {
+  if (m_playing || !m_reader.isOpen())
+    return false;
+
+  // Clean up after a playback that reached the end by itself
+  stop();
+
+  m_loop = loop;
+  m_playing = true;
+  m_playThread = new thread(&DMXShowPlayer::playLoop, this);
+
+  return true;
+}
+
+void DMXShowPlayer::stop() {
+  {
+    lock_guard<mutex> lock(m_stopLock);
+    m_playing = false;
+  }
+  m_stopCond.notify_all();
+
+  if (m_playThread != nullptr) {
+    m_playThread->join();
+    delete m_playThread;
+    m_playThread = nullptr;
+  }
+}
+
+bool DMXShowPlayer::seek(Clock::duration time) {
+  if (m_playing || !m_reader.seek(time))
+    return false;
+
+  m_pending = false;
+  sendAll();
+  return true;
+}
+
+size_t DMXShowPlayer::sendUntil(Clock::duration time) {
+  if (m_playing)
+    return 0;
+
+  size_t count = 0;
+  while (true) {
+    if (!m_pending) {
+      if (!m_reader.next())
+        break;
+      m_pending = true;
+    }
+
+    if (m_reader.getTime() > time)
+      break;
+
+    send(m_reader.getChanged());
+    m_pending = false;
+    count++;
+  }
+
+  return count;
+}
+
+void DMXShowPlayer::playLoop() {
+  // Frame times are relative to the current position
+  auto start = chrono::steady_clock::now() - chrono::duration_cast<chrono::steady_clock::duration>(m_reader.getTime());
+
+  while (m_playing) {
+    if (!m_pending) {
+      if (!m_reader.next()) {
+        if (!m_loop || m_reader.getNumFrames() == 0)
+          break;
+
+        m_reader.rewind();
+        start = chrono::steady_clock::now();
+        continue;
+      }
+
+      m_pending = true;
+    }
+
+    // Sleep until the frame is due. The frame is already decoded so it goes out on time.
+    auto due = start + chrono::duration_cast<chrono::steady_clock::duration>(m_reader.getTime());
+    {
+      unique_lock<mutex> lock(m_stopLock);
+      if (m_stopCond.wait_until(lock, due, [this] { return !m_playing; }))
+        break;
+    }
+
+    send(m_reader.getChanged());
+    m_pending = false;
+  }
+
+  m_playing = false;
+}
+
+void DMXShowPlayer::send(const vector<unsigned int>& universes) {
+  // Interfaces only read from the buffer they're given
+  vector<vector<unsigned char> >& data = const_cast<vector<vector<unsigned char> >&>(m_reader.getUniverses());
+
+  vector<DMXInterface*> sent;
+
+  for (unsigned int u : universes) {
+    if (u >= m_outputs.size())
+      continue;
+
+    for (DMXInterface* iface : m_outputs[u]) {
+      iface->sendDMX(data[u].data(), u);
+
+      if (find(sent.begin(), sent.end(), iface) == sent.end())
+        sent.push_back(iface);
+    }
+  }
+
+  for (DMXInterface* iface : sent)
+    iface->flush();
+}
+
+void DMXShowPlayer::sendAll() {
+  vector<unsigned int> all;
+  for (unsigned int u = 0; u < m_reader.getUniverses().size(); u++)
+    all.push_back(u);
+
+  send(all);
+}
+
+}
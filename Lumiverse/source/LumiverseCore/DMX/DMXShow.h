@@ -0,0 +1,381 @@
+/*! \file DMXShow.h
+* \brief Recording and replay of timed DMX frames.
+*/
+#ifndef _DMXSHOW_H_
+#define _DMXSHOW_H_
+
+#pragma once
+
+#include "LumiverseCoreConfig.h"
+
+#include "../Clock.h"
+#include "../Logger.h"
+#include "DMXInterface.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Lumiverse {
+  class DMXPatch;
+
+  /*!
+  \brief Size in bytes of every universe in a DMX show file.
+  */
+  const unsigned int DMX_SHOW_UNIVERSE_SIZE = 512;
+
+  /*!
+  \brief Writes a sequence of timed DMX frames to a show file.
+
+  A show file is a header followed by one record per frame and a frame index.
+  Every universe in a frame is stored as the XOR with the same universe in the
+  previous frame, run-length encoded, so a channel that holds its value costs
+  nothing and an unchanged universe is left out of the frame entirely. Every
+  keyframeInterval frames a keyframe stores all universes against zero so a reader
+  can start decoding there. When LumiverseCore is built with zlib, frame payloads
+  can also be deflated.
+
+  The index at the end of the file lists the time and position of every keyframe.
+  It is written by close(). A file that was never closed can still be read, the
+  reader rebuilds the index by walking the frames.
+
+  All values in the file are little endian. Times are nanoseconds from the start of
+  the recording.
+  \sa DMXShowReader, DMXShowRecorder
+  */
+  class DMXShowWriter
+  {
+  public:
+    DMXShowWriter();
+
+    /*! \brief Closes the file if it is still open. */
+    ~DMXShowWriter();
+
+    /*!
+    \brief Creates a show file, replacing any existing file.
+    \param filename Path of the file.
+    \param compress Deflates frames with zlib. Ignored with a warning if LumiverseCore
+    was built without zlib.
+    \param keyframeInterval Number of frames between keyframes.
+    \return False if the file couldn't be created.
+    */
+    bool open(const string& filename, bool compress = false, unsigned int keyframeInterval = 44);
+
+    /*!
+    \brief Appends a frame to the file.
+
+    Universes must be DMX_SHOW_UNIVERSE_SIZE bytes long. Universe 1 is index 0, as
+    in DMXPatch.
+    \param time Time of the frame from the start of the recording. Should not be
+    earlier than the previous frame.
+    */
+    bool writeFrame(Clock::duration time, const vector<vector<unsigned char> >& universes);
+
+    /*! \brief Writes the frame index and closes the file. */
+    bool close();
+
+    /*! \brief Returns true if a file is open. */
+    bool isOpen() { return m_file.is_open(); }
+
+    /*! \brief Number of frames written to the current file. */
+    size_t getNumFrames() { return m_numFrames; }
+
+  private:
+    struct IndexEntry {
+      int64_t time;
+      uint64_t offset;
+      uint32_t frame;
+    };
+
+    ofstream m_file;
+    bool m_compress;
+    unsigned int m_keyframeInterval;
+    size_t m_numFrames;
+    vector<IndexEntry> m_index;
+
+    /*! \brief Universes of the previous frame. */
+    vector<vector<unsigned char> > m_prev;
+
+    // Scratch buffers reused for every frame
+    vector<unsigned char> m_payload;
+    vector<unsigned char> m_stored;
+  };
+
+  /*!
+  \brief Reads the frames of a show file, one frame at a time.
+
+  The reader keeps the state of every universe as of the current frame, so a frame
+  only costs as much to decode as the channels that changed in it.
+  \sa DMXShowWriter, DMXShowPlayer
+  */
+  class DMXShowReader
+  {
+  public:
+    DMXShowReader();
+
+    /*!
+    \brief Opens a show file and loads its frame index.
+
+    The reader is placed before the first frame.
+    */
+    bool open(const string& filename);
+
+    /*! \brief Closes the file. */
+    void close();
+
+    /*! \brief Returns true if a file is open. */
+    bool isOpen() { return m_file.is_open(); }
+
+    /*! \brief Number of frames in the file. */
+    size_t getNumFrames() { return m_numFrames; }
+
+    /*!
+    \brief Decodes the next frame.
+    \return False at the end of the file or if the frame is damaged.
+    */
+    bool next();
+
+    /*! \brief Moves before the first frame. */
+    void rewind();
+
+    /*!
+    \brief Moves to the last frame at or before the given time.
+
+    Decoding starts from the closest keyframe, so seeking costs at most one keyframe
+    interval of frames. Seeking before the first frame rewinds.
+    */
+    bool seek(Clock::duration time);
+
+    /*! \brief Moves to the given frame. */
+    bool seekFrame(size_t frame);
+
+    /*! \brief Number of the current frame, or -1 before the first frame. */
+    long getFrame() { return m_frame; }
+
+    /*! \brief Time of the current frame from the start of the recording. */
+    Clock::duration getTime() { return m_time; }
+
+    /*! \brief Returns true if the current frame is a keyframe. */
+    bool isKeyframe() { return m_keyframe; }
+
+    /*!
+    \brief Universe data as of the current frame.
+
+    Universe 1 is index 0.
+    */
+    const vector<vector<unsigned char> >& getUniverses() { return m_universes; }
+
+    /*!
+    \brief Universes stored in the current frame.
+
+    Lists every universe for a keyframe and the universes that changed otherwise.
+    */
+    const vector<unsigned int>& getChanged() { return m_changed; }
+
+  private:
+    struct IndexEntry {
+      int64_t time;
+      uint64_t offset;
+      uint32_t frame;
+    };
+
+    ifstream m_file;
+    bool m_compressed;
+    size_t m_numFrames;
+    uint64_t m_dataStart;
+    uint64_t m_dataEnd;
+    vector<IndexEntry> m_index;
+
+    /*! \brief File position of the next frame. */
+    uint64_t m_pos;
+
+    long m_frame;
+    Clock::duration m_time;
+    bool m_keyframe;
+    vector<vector<unsigned char> > m_universes;
+    vector<unsigned int> m_changed;
+
+    // Scratch buffers reused for every frame
+    vector<unsigned char> m_stored;
+    vector<unsigned char> m_payload;
+
+    /*!
+    \brief Reads the index at the end of the file, or walks the frames to make one.
+    */
+    bool loadIndex();
+
+    /*! \brief Moves to a keyframe from the index and decodes it. */
+    bool seekIndex(size_t entry);
+
+    /*! \brief Reads the time of the next frame without decoding it. */
+    bool peekTime(Clock::duration& time);
+  };
+
+  /*!
+  \brief Records the output of a DMXPatch to a show file without holding up the
+  update loop.
+
+  record() only copies the universes into a buffer from a pool and queues it. A
+  writer thread encodes the queued frames and writes them out. If the writer falls
+  too far behind, new frames are dropped instead of blocking the caller.
+  \sa DMXPatch::startRecording()
+  */
+  class DMXShowRecorder
+  {
+  public:
+    /*!
+    \brief Creates a recorder.
+    \param clock Clock that frames are timestamped with. nullptr uses a SystemClock.
+    Pass the Rig's clock to record an offline render on its virtual timeline.
+    */
+    DMXShowRecorder(shared_ptr<Clock> clock = nullptr);
+
+    /*! \brief Stops recording. */
+    ~DMXShowRecorder();
+
+    /*!
+    \brief Opens the show file and starts the writer thread.
+
+    Frame times are measured from the call to start().
+    */
+    bool start(const string& filename, bool compress = false, unsigned int keyframeInterval = 44);
+
+    /*! \brief Writes out every queued frame and closes the file. */
+    void stop();
+
+    /*! \brief Returns true between start() and stop(). */
+    bool isRecording() { return m_recording; }
+
+    /*! \brief Queues a frame for writing, timestamped with the current time. */
+    void record(const vector<vector<unsigned char> >& universes);
+
+    /*! \brief Number of frames that were dropped because the queue was full. */
+    size_t getNumDropped() { return m_dropped; }
+
+    /*! \brief Frames that can be waiting for the writer before frames are dropped. */
+    static const size_t MAX_QUEUED = 256;
+
+  private:
+    struct Frame {
+      Clock::duration time;
+      vector<vector<unsigned char> > universes;
+    };
+
+    shared_ptr<Clock> m_clock;
+    Clock::time_point m_start;
+    DMXShowWriter m_writer;
+
+    thread* m_writeThread;
+    atomic<bool> m_recording;
+    atomic<size_t> m_dropped;
+
+    mutex m_queueLock;
+    condition_variable m_queueCond;
+    deque<unique_ptr<Frame> > m_queue;
+    vector<unique_ptr<Frame> > m_pool;
+
+    /*! \brief Writes out queued frames until recording stops. */
+    void writeLoop();
+  };
+
+  /*!
+  \brief Plays a show file back through DMXInterfaces.
+
+  Frames are decoded ahead of time and sent when their time comes, measured on a
+  steady clock from the start of playback. Only universes stored in a frame are
+  sent, so an idle show costs nothing between keyframes. Keyframes send every
+  universe, which refreshes receivers that time out without data.
+  */
+  class DMXShowPlayer
+  {
+  public:
+    DMXShowPlayer();
+
+    /*! \brief Stops playback. Interfaces are not owned by the player. */
+    ~DMXShowPlayer();
+
+    /*! \brief Opens a show file. Stops playback first. */
+    bool open(const string& filename);
+
+    /*!
+    \brief Sends a universe of the show to an interface.
+
+    A universe can go to many interfaces.
+    \param universe Zero-indexed universe, as in DMXPatch.
+    */
+    void addOutput(DMXInterface* iface, unsigned int universe);
+
+    /*!
+    \brief Sends every universe of the show to the interfaces a DMXPatch has assigned
+    to it.
+
+    The interfaces belong to the patch and must outlive the player's use of them.
+    */
+    void addOutputs(DMXPatch* patch);
+
+    /*! \brief Removes every output. */
+    void clearOutputs();
+
+    /*!
+    \brief Starts playing from the current position on a separate thread.
+    \param loop Starts over at the end of the file.
+    */
+    bool play(bool loop = false);
+
+    /*! \brief Stops playing. The position is kept. */
+    void stop();
+
+    /*! \brief Returns true while the playback thread is running. */
+    bool isPlaying() { return m_playing; }
+
+    /*!
+    \brief Moves to the given time of the show and sends the full state there.
+
+    Can't be used while playing.
+    */
+    bool seek(Clock::duration time);
+
+    /*!
+    \brief Sends every frame up to and including the given time.
+
+    Used by the playback thread, and can be called directly to drive playback from
+    another clock. Can't be used while playing.
+    \return Number of frames sent.
+    */
+    size_t sendUntil(Clock::duration time);
+
+    /*! \brief Time of the last frame that was sent. */
+    Clock::duration getTime() { return m_reader.getTime(); }
+
+  private:
+    DMXShowReader m_reader;
+
+    /*! \brief Interfaces for each universe. */
+    vector<vector<DMXInterface*> > m_outputs;
+
+    /*! \brief True when the reader holds a decoded frame that wasn't sent yet. */
+    bool m_pending;
+
+    thread* m_playThread;
+    atomic<bool> m_playing;
+    bool m_loop;
+    mutex m_stopLock;
+    condition_variable m_stopCond;
+
+    void playLoop();
+
+    /*! \brief Sends the given universes of the reader's current frame. */
+    void send(const vector<unsigned int>& universes);
+
+    /*! \brief Sends every universe of the reader's current frame. */
+    void sendAll();
+  };
+}
+
+#endif
@@ -0,0 +1,79 @@
+#include "DMXUniverseSlab.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace Lumiverse {
+
+const size_t DMXUniverseSlab::UNIVERSE_SIZE;
+const size_t DMXUniverseSlab::ALIGNMENT;
+
+DMXUniverseSlab::DMXUniverseSlab() : m_data(nullptr), m_capacity(0) {
+}
+
+unsigned char* DMXUniverseSlab::add(unsigned int universe) {
+  int existing = indexOf(universe);
+  if (existing >= 0)
+    return at(existing);
+
+  if (m_universes.size() == m_capacity)
+    reserve((m_capacity == 0) ? 16 : m_capacity * 2);
+
+  if (universe >= m_index.size())
+    m_index.resize(universe + 1, -1);
+
+  size_t slot = m_universes.size();
+  m_index[universe] = (int)slot;
+  m_universes.push_back(universe);
+
+  memset(at(slot), 0, UNIVERSE_SIZE);
+  return at(slot);
+}
+
+bool DMXUniverseSlab::remove(unsigned int universe) {
+  int slot = indexOf(universe);
+  if (slot < 0)
+    return false;
+
+  size_t last = m_universes.size() - 1;
+  if ((size_t)slot != last) {
+    memcpy(at(slot), at(last), UNIVERSE_SIZE);
+    m_universes[slot] = m_universes[last];
+    m_index[m_universes[slot]] = slot;
+  }
+
+  m_universes.pop_back();
+  m_index[universe] = -1;
+
+  // Keep range() at the highest universe still here
+  while (!m_index.empty() && m_index.back() < 0)
+    m_index.pop_back();
+
+  if (m_capacity > 16 && m_universes.size() < m_capacity / 4)
+    reallocate(m_capacity / 2);
+
+  return true;
+}
+
+void DMXUniverseSlab::reserve(size_t count) {
+  if (count <= m_capacity)
+    return;
+
+  reallocate(count);
+}
+
+void DMXUniverseSlab::reallocate(size_t count) {
+  vector<unsigned char> storage(count * UNIVERSE_SIZE + ALIGNMENT);
+  uintptr_t addr = (uintptr_t)storage.data();
+  unsigned char* data = storage.data() + ((ALIGNMENT - addr % ALIGNMENT) % ALIGNMENT);
+
+  if (m_data != nullptr)
+    memcpy(data, m_data, m_universes.size() * UNIVERSE_SIZE);
+
+  // Moving the vector keeps its buffer where it is, so data stays valid
+  m_storage = move(storage);
+  m_data = data;
+  m_capacity = count;
+}
+
+}
@@ -0,0 +1,119 @@
+/*! \file DMXUniverseSlab.h
+* \brief Storage for the DMX universes of a patch.
+*/
+#ifndef _DMXUNIVERSESLAB_H_
+#define _DMXUNIVERSESLAB_H_
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+namespace Lumiverse {
+  /*!
+  \brief Keeps every universe of a patch in one contiguous, aligned block of memory.
+
+  Universes are stored back to back in the order they were added, 512 bytes each,
+  starting on a 64 byte boundary. Universe numbers can be sparse. A table maps each
+  number to its slot, so finding a universe is an array lookup, and adding one
+  copies the block only when it runs out of room, which doubles it. Removing a
+  universe moves the last slot into the hole, and the block is halved once it is
+  less than a quarter full.
+
+  Pointers to universe data and slot numbers stay valid until the next add() or
+  remove().
+  */
+  class DMXUniverseSlab
+  {
+  public:
+    /*! \brief Size of a universe in bytes. */
+    static const size_t UNIVERSE_SIZE = 512;
+
+    /*! \brief Alignment of the block in bytes. */
+    static const size_t ALIGNMENT = 64;
+
+    DMXUniverseSlab();
+
+    // The block points into its own storage, so slabs aren't copied
+    DMXUniverseSlab(const DMXUniverseSlab&) = delete;
+    DMXUniverseSlab& operator=(const DMXUniverseSlab&) = delete;
+
+    /*!
+    \brief Adds a universe, set to all zeros.
+
+    Does nothing if the universe is already there.
+    \return Data of the universe.
+    */
+    unsigned char* add(unsigned int universe);
+
+    /*!
+    \brief Removes a universe and frees its slot.
+
+    The universe in the last slot moves into the freed one.
+    \return false if the universe isn't in the slab.
+    */
+    bool remove(unsigned int universe);
+
+    /*! \brief Returns the slot of a universe, or -1 if it isn't in the slab. */
+    int indexOf(unsigned int universe) const {
+      return (universe < m_index.size()) ? m_index[universe] : -1;
+    }
+
+    /*! \brief Returns the data of a universe, or nullptr if it isn't in the slab. */
+    unsigned char* get(unsigned int universe) {
+      int i = indexOf(universe);
+      return (i < 0) ? nullptr : at(i);
+    }
+
+    const unsigned char* get(unsigned int universe) const {
+      int i = indexOf(universe);
+      return (i < 0) ? nullptr : at(i);
+    }
+
+    /*! \brief Returns the data in a slot. */
+    unsigned char* at(size_t slot) { return m_data + slot * UNIVERSE_SIZE; }
+    const unsigned char* at(size_t slot) const { return m_data + slot * UNIVERSE_SIZE; }
+
+    /*! \brief Returns the universe number stored in a slot. */
+    unsigned int universeAt(size_t slot) const { return m_universes[slot]; }
+
+    /*! \brief Universe numbers by slot. */
+    const vector<unsigned int>& getUniverseNumbers() const { return m_universes; }
+
+    /*! \brief Number of universes in the slab. */
+    size_t size() const { return m_universes.size(); }
+
+    /*! \brief Highest universe number plus one, 0 if the slab is empty. */
+    size_t range() const { return m_index.size(); }
+
+    /*! \brief Start of the block. Holds size() * UNIVERSE_SIZE bytes. */
+    unsigned char* data() { return m_data; }
+    const unsigned char* data() const { return m_data; }
+
+  private:
+    /*! \brief Makes room for a number of universes, keeping the data. */
+    void reserve(size_t count);
+
+    /*! \brief Moves the data to a new block with room for count universes. */
+    void reallocate(size_t count);
+
+    /*! \brief Backing memory, with room to align the start. */
+    vector<unsigned char> m_storage;
+
+    /*! \brief Aligned start of the block inside m_storage. */
+    unsigned char* m_data;
+
+    /*! \brief Number of universes the block has room for. */
+    size_t m_capacity;
+
+    /*! \brief Universe number of each slot. */
+    vector<unsigned int> m_universes;
+
+    /*! \brief Slot of each universe number, -1 if the universe isn't in the slab. */
+    vector<int> m_index;
+  };
+}
+
+#endif
@@ -2,6 +2,8 @@
 
 #ifdef USE_KINET
 
+#include <cstring>
+
 namespace Lumiverse {
 const unsigned char oldHeaderBytes[] = {
   0x04, 0x01, 0xdc, 0x4a, 0x01, 0x00, 0x01, 0x01,
@@ -16,7 +18,7 @@ const unsigned char newHeaderBytes[] = {
 };
 
 KiNetInterface::KiNetInterface(string id, string host, int port, enum KinetProtocolType protocolType)
-  : m_host(host), m_port(port)
+  : m_host(host), m_port(port), m_socket(-1)
 {
   m_connected = false;
   m_ifaceId = id;
@@ -44,27 +46,70 @@ KiNetInterface::KiNetInterface(string id, string host, int port, enum KinetProto
       m_headerBytes = oldHeaderBytes;
       break;
   }
+
+  m_portUniverses.assign(m_numChannels, -1);
+  updatePorts();
 }
 
 KiNetInterface::~KiNetInterface()
 {
-  free(m_buffer);
+  closeInt();
+}
+
+bool KiNetInterface::setPortUniverse(unsigned int port, int universe) {
+  if (port < 1 || port > getNumChannels())
+    return false;
+
+  m_portUniverses[port - 1] = (universe < 0) ? -1 : universe;
+  updatePorts();
+  return true;
+}
+
+int KiNetInterface::getPortUniverse(unsigned int port) {
+  if (port < 1 || port > getNumChannels())
+    return -1;
+
+  return m_portUniverses[port - 1];
+}
+
+void KiNetInterface::clearPortUniverses() {
+  m_portUniverses.assign(getNumChannels(), -1);
+  updatePorts();
+}
+
+void KiNetInterface::updatePorts() {
+  m_universePorts.clear();
+  m_allPorts.clear();
+
+  bool mapped = false;
+  for (size_t c = 0; c < getNumChannels(); c++) {
+    m_allPorts.push_back((unsigned int)c);
+
+    int u = m_portUniverses[c];
+    if (u < 0)
+      continue;
+
+    if ((size_t)u >= m_universePorts.size())
+      m_universePorts.resize(u + 1);
+    m_universePorts[u].push_back((unsigned int)c);
+    mapped = true;
+  }
+
+  // Ports are only told apart once one of them is mapped
+  if (mapped)
+    m_allPorts.clear();
 }
 
 void KiNetInterface::init() {
-  // Initialize buffer
-  if (m_buffer == nullptr)
-    free(m_buffer);
+  closeInt();
 
-  m_buffer = (unsigned char*)malloc(getBufferSize() * sizeof(unsigned char));
-  memset(m_buffer, 0, (int)getBufferSize());
-  for (int c = 0; c < getNumChannels(); c++)
+  // Header of each port. Channels are separate DMX streams on the same power supply.
+  m_headers.assign(getHeaderSize() * getNumChannels(), 0);
+  for (size_t c = 0; c < getNumChannels(); c++)
   {
-    memcpy(m_buffer + c * getPacketSize(), getHeaderBytes(), getHeaderSize());
-    // Looks like channels are like multiple DMX streams on the same power supply
-    // Current code doesn't account for this.
+    memcpy(&m_headers[c * getHeaderSize()], getHeaderBytes(), getHeaderSize());
     if (getNumChannels() > 1)
-      m_buffer[c * getPacketSize() + 16] = c + 1;
+      m_headers[c * getHeaderSize() + 16] = (unsigned char)(c + 1);
   }
 
   // Connect to power supply
@@ -98,36 +143,32 @@ void KiNetInterface::init() {
     stringstream msg;
     msg << "getaddrinfo: " << gai_strerror(result);
     Logger::log(ERR, msg.str());
+    return;
   }
 
   for (pr = pResult; pr != nullptr; pr = pr->ai_next) {
-    sock = socket(pr->ai_family, pr->ai_socktype, pr->ai_protocol);
+    sock = (int)socket(pr->ai_family, pr->ai_socktype, pr->ai_protocol);
     if (sock == -1)
       continue;
 
     if (::connect(sock, pr->ai_addr, (int)pr->ai_addrlen) == 0)
       break;
 
-#ifdef _WIN32
-    closesocket(sock);
-#else
-    close(sock);
-#endif
+    UDPBatch::closeSocket(sock);
   }
 
+  freeaddrinfo(pResult);
+
   if (pr == NULL)
   {
     Logger::log(ERR, "Could not connect to socket.");
     return;
   }
 
-  m_port = ((sockaddr_in*)(pr->ai_addr))->sin_port;
   stringstream ss;
   ss << "KiNetInterface initialized on " << m_host << ":" << m_port << "\n";
   Logger::log(INFO, ss.str());
 
-  freeaddrinfo(pResult);
-
 #ifdef _WIN32
   u_long mode = 0;
 
@@ -148,22 +189,34 @@ void KiNetInterface::init() {
 }
 
 void KiNetInterface::sendDMX(unsigned char* data, unsigned int universe) {
-  // Currently this function only really supports the old protocol.
-  // The new protocol layers universes, and this function assumes a single DMX universe (512)
-  for (int channel = 0; channel < getNumChannels(); channel++)
-  {
-    memcpy(m_buffer + getHeaderSize(), data, 512);
-    send(m_socket, (char *)m_buffer + getPacketSize() * channel, (int)getPacketSize(), 0);
+  if (!m_connected)
+    return;
+
+  const vector<unsigned int>* ports = &m_allPorts;
+  if (m_allPorts.empty()) {
+    if (universe >= m_universePorts.size())
+      return;
+    ports = &m_universePorts[universe];
   }
+
+  // The data stays where it is until flush(), only the header is per port
+  for (unsigned int c : *ports) {
+    m_batch.add(&m_headers[c * getHeaderSize()], getHeaderSize(), data, getDataSize(), nullptr);
+  }
+}
+
+void KiNetInterface::flush() {
+  if (!m_connected || m_batch.size() == 0)
+    return;
+
+  m_batch.send(m_socket);
 }
 
 void KiNetInterface::closeInt() {
+  m_batch.clear();
+
   if (m_connected) {
-#ifdef _WIN32
-    closesocket(m_socket);
-#else
-    close(m_socket);
-#endif
+    UDPBatch::closeSocket(m_socket);
     m_connected = false;
   }
 }
@@ -182,6 +235,12 @@ JSONNode KiNetInterface::toJSON() {
   root.push_back(JSONNode("port", m_port));
   root.push_back(JSONNode("protocolType", m_type));
 
+  JSONNode ports(JSON_ARRAY);
+  ports.set_name("ports");
+  for (int u : m_portUniverses)
+    ports.push_back(JSONNode("", u));
+  root.push_back(ports);
+
   return root;
 }
 
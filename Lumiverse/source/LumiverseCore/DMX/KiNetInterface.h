@@ -9,22 +9,14 @@
 
 #ifdef USE_KINET
 
-#ifdef _WIN32
-#include <WinSock2.h>
-#include <ws2tcpip.h>
-#pragma comment (lib, "Ws2_32.lib")
-#else
-#include <sys/socket.h>
-#include <netdb.h>
-#include <unistd.h>
-#endif
-
 #include "DMXInterface.h"
+#include "UDPBatch.h"
 #include "../lib/libjson/libjson.h"
 #include "Logger.h"
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <vector>
 #include <math.h>
 #include <fcntl.h>
 
@@ -43,6 +35,13 @@ namespace Lumiverse {
   *
   * Based off of Mike Dewberry's implementation of KiNet, which
   * can be found in his Streetlight project: https://github.com/Dewb/streetlight
+  *
+  * The new (v2) protocol addresses the ports of a power supply separately. Each port
+  * can be mapped to its own universe with setPortUniverse(), so one interface drives a
+  * whole power supply. If no port is mapped, every port outputs whichever universe is
+  * sent. A packet is a prebuilt per-port header followed by the universe data, which
+  * is sent straight from the DMXPatch buffer without a copy. flush() sends every port
+  * of the frame as one UDPBatch.
   */
   class KiNetInterface : public DMXInterface
   {
@@ -63,6 +62,8 @@ namespace Lumiverse {
 
     virtual void sendDMX(unsigned char* data, unsigned int universe);
 
+    virtual void flush();
+
     virtual void closeInt();
 
     virtual void reset();
@@ -77,20 +78,50 @@ namespace Lumiverse {
     int getPort() { return m_port; }
     void setPort(int port) { m_port = port; }
 
+    /*!
+    * \brief Maps a power supply port to a universe.
+    *
+    * \param port Power supply port, starting at 1
+    * \param universe Zero-indexed universe the port outputs, or -1 to turn the port off
+    * \return False if the power supply doesn't have the port
+    */
+    bool setPortUniverse(unsigned int port, int universe);
+
+    /*! \brief Universe a power supply port outputs, or -1 if the port isn't mapped. */
+    int getPortUniverse(unsigned int port);
+
+    /*! \brief Unmaps every port, so they all output whichever universe is sent. */
+    void clearPortUniverses();
+
+    KinetProtocolType getProtocolType() const { return m_type; }
     size_t getHeaderSize() const { return m_headerSize; }
     size_t getDataSize() const { return m_dataSize; }
     size_t getNumChannels() const { return m_numChannels; }
     size_t getPacketSize() const { return m_headerSize + m_dataSize; }
-    size_t getBufferSize() const { return getPacketSize() * m_numChannels; }
     const unsigned char* getHeaderBytes() const { return m_headerBytes; }
 
   private:
+    /*! \brief Rebuilds the universe to port lookup from the port map. */
+    void updatePorts();
+
     string m_host;
     int m_port;
     bool m_connected;
     int m_socket;
 
-    unsigned char* m_buffer;
+    /*! \brief Header of each power supply port, back to back */
+    vector<unsigned char> m_headers;
+
+    /*! \brief Universe of each power supply port, -1 if the port isn't mapped */
+    vector<int> m_portUniverses;
+
+    /*! \brief Ports (zero-indexed) that output each universe */
+    vector<vector<unsigned int> > m_universePorts;
+
+    /*! \brief Every port, for when no port is mapped */
+    vector<unsigned int> m_allPorts;
+
+    UDPBatch m_batch;
 
     // Protocol header
     const unsigned char* m_headerBytes;
@@ -0,0 +1,322 @@
+#include "SACNInterface.h"
+
+#ifdef USE_SACN
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+namespace Lumiverse {
+
+namespace {
+
+const unsigned char ACN_PACKET_ID[12] = {
+  0x41, 0x53, 0x43, 0x2d, 0x45, 0x31, 0x2e, 0x31, 0x37, 0x00, 0x00, 0x00
+};
+
+const uint32_t VECTOR_ROOT_E131_DATA = 0x00000004;
+const uint32_t VECTOR_ROOT_E131_EXTENDED = 0x00000008;
+const uint32_t VECTOR_E131_DATA_PACKET = 0x00000002;
+const uint32_t VECTOR_E131_EXTENDED_SYNCHRONIZATION = 0x00000001;
+const unsigned char VECTOR_DMP_SET_PROPERTY = 0x02;
+
+const unsigned char OPTION_STREAM_TERMINATED = 0x40;
+
+// Offsets into a data packet
+const size_t SYNC_ADDRESS = 109;
+const size_t SEQUENCE = 111;
+const size_t OPTIONS = 112;
+const size_t PROPERTY_VALUES = 125;
+
+void put16(unsigned char* p, uint16_t v) {
+  p[0] = v >> 8;
+  p[1] = v & 0xff;
+}
+
+void put32(unsigned char* p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = (v >> 16) & 0xff;
+  p[2] = (v >> 8) & 0xff;
+  p[3] = v & 0xff;
+}
+
+// Flags and length field of a PDU. The length counts from the start of the field.
+void putFlagsLength(unsigned char* p, size_t length) {
+  put16(p, (uint16_t)(0x7000 | (length & 0x0fff)));
+}
+
+// Preamble, postamble, packet identifier, root layer flags, vector and CID
+void putRootLayer(unsigned char* p, size_t packetSize, uint32_t vector, const unsigned char* cid) {
+  put16(p, 0x0010);
+  put16(p + 2, 0x0000);
+  memcpy(p + 4, ACN_PACKET_ID, 12);
+  putFlagsLength(p + 16, packetSize - 16);
+  put32(p + 18, vector);
+  memcpy(p + 22, cid, 16);
+}
+
+}
+
+const size_t SACNInterface::DATA_PACKET_SIZE;
+const size_t SACNInterface::SYNC_PACKET_SIZE;
+
+SACNInterface::SACNInterface(string id, string sourceName, int priority, string host, int port)
+  : m_sourceName(sourceName), m_host(host), m_port(port), m_syncUniverse(0), m_connected(false),
+  m_socket(-1), m_syncSequence(0)
+{
+  m_ifaceId = id;
+  setPriority(priority);
+
+  // Random version 4 UUID
+  random_device rd;
+  for (int i = 0; i < 16; i++)
+    m_cid[i] = (unsigned char)(rd() & 0xff);
+  m_cid[6] = (m_cid[6] & 0x0f) | 0x40;
+  m_cid[8] = (m_cid[8] & 0x3f) | 0x80;
+}
+
+SACNInterface::~SACNInterface() {
+  closeInt();
+}
+
+void SACNInterface::setPriority(int priority) {
+  m_priority = (priority < 0) ? 0 : (priority > 200) ? 200 : priority;
+
+  for (auto& out : m_outputs) {
+    if (out != nullptr)
+      out->packet[108] = (unsigned char)m_priority;
+  }
+}
+
+string SACNInterface::getCID() {
+  stringstream ss;
+  ss << hex;
+  for (int i = 0; i < 16; i++) {
+    ss.width(2);
+    ss.fill('0');
+    ss << (int)m_cid[i];
+  }
+
+  return ss.str();
+}
+
+bool SACNInterface::setCID(string cid) {
+  if (cid.size() != 32)
+    return false;
+
+  unsigned char parsed[16];
+  for (int i = 0; i < 16; i++) {
+    char* end;
+    string byte = cid.substr(i * 2, 2);
+    parsed[i] = (unsigned char)strtol(byte.c_str(), &end, 16);
+    if (*end != '\0')
+      return false;
+  }
+
+  memcpy(m_cid, parsed, 16);
+  m_outputs.clear();
+  m_queued.clear();
+  return true;
+}
+
+void SACNInterface::init() {
+  closeInt();
+
+#ifdef _WIN32
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR)
+    Logger::log(ERR, "Error at WSAStartup()");
+#endif
+
+  if (m_host != "") {
+    if (!UDPBatch::resolve(m_host, m_hostAddr)) {
+      Logger::log(ERR, "sACN interface " + m_ifaceId + " can't resolve " + m_host);
+      return;
+    }
+  }
+
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    Logger::log(ERR, "sACN interface " + m_ifaceId + " could not create a socket.");
+    return;
+  }
+
+  if (m_host == "") {
+    // Hop through a few routers and let other programs on this machine listen in
+    unsigned char ttl = 16;
+    unsigned char loop = 1;
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl, sizeof(ttl));
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&loop, sizeof(loop));
+
+    if (m_multicastIface != "") {
+      in_addr iface;
+      iface.s_addr = inet_addr(m_multicastIface.c_str());
+      if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&iface, sizeof(iface)) != 0)
+        Logger::log(WARN, "sACN interface " + m_ifaceId + " can't send multicast from " + m_multicastIface);
+    }
+  }
+
+  // Destinations depend on the host
+  m_outputs.clear();
+  m_queued.clear();
+
+  m_socket = sock;
+  m_connected = true;
+
+  stringstream ss;
+  ss << "SACNInterface " << m_ifaceId << " initialized, sending to " << ((m_host == "") ? "multicast" : m_host)
+    << " port " << m_port;
+  Logger::log(INFO, ss.str());
+}
+
+sockaddr_in SACNInterface::getDestination(unsigned int sacnUniverse) {
+  sockaddr_in dest;
+  memset(&dest, 0, sizeof(dest));
+  dest.sin_family = AF_INET;
+  dest.sin_port = htons((unsigned short)m_port);
+
+  if (m_host != "")
+    dest.sin_addr = m_hostAddr;
+  else
+    dest.sin_addr.s_addr = htonl(0xefff0000 | (sacnUniverse & 0xffff));
+
+  return dest;
+}
+
+SACNInterface::Output* SACNInterface::getOutput(unsigned int universe) {
+  if (universe >= m_outputs.size())
+    m_outputs.resize(universe + 1);
+
+  if (m_outputs[universe] != nullptr)
+    return m_outputs[universe].get();
+
+  Output* out = new Output();
+  unsigned int sacnUniverse = universe + 1;
+  unsigned char* p = out->packet;
+  memset(p, 0, DATA_PACKET_SIZE);
+
+  putRootLayer(p, DATA_PACKET_SIZE, VECTOR_ROOT_E131_DATA, m_cid);
+
+  // Framing layer
+  putFlagsLength(p + 38, DATA_PACKET_SIZE - 38);
+  put32(p + 40, VECTOR_E131_DATA_PACKET);
+  strncpy((char*)p + 44, m_sourceName.c_str(), 63);
+  p[108] = (unsigned char)m_priority;
+  put16(p + 113, (uint16_t)sacnUniverse);
+
+  // DMP layer: 512 slots after a zero start code
+  putFlagsLength(p + 115, DATA_PACKET_SIZE - 115);
+  p[117] = VECTOR_DMP_SET_PROPERTY;
+  p[118] = 0xa1;
+  put16(p + 119, 0x0000);
+  put16(p + 121, 0x0001);
+  put16(p + 123, 513);
+  p[PROPERTY_VALUES] = 0x00;
+
+  out->sequence = 0;
+  out->dest = getDestination(sacnUniverse);
+  out->queued = false;
+
+  m_outputs[universe].reset(out);
+  return out;
+}
+
+void SACNInterface::sendDMX(unsigned char* data, unsigned int universe) {
+  if (!m_connected || universe >= 63999)
+    return;
+
+  Output* out = getOutput(universe);
+  memcpy(out->packet + PROPERTY_VALUES + 1, data, 512);
+
+  if (!out->queued) {
+    out->queued = true;
+    m_queued.push_back(universe);
+  }
+}
+
+void SACNInterface::flush() {
+  if (!m_connected || m_queued.empty())
+    return;
+
+  for (unsigned int u : m_queued) {
+    Output* out = m_outputs[u].get();
+    out->queued = false;
+    put16(out->packet + SYNC_ADDRESS, (uint16_t)m_syncUniverse);
+    out->packet[SEQUENCE] = out->sequence++;
+
+    m_batch.add(out->packet, DATA_PACKET_SIZE, &out->dest);
+  }
+  m_queued.clear();
+
+  if (m_syncUniverse != 0) {
+    unsigned char* sync = m_syncPacket;
+    memset(sync, 0, SYNC_PACKET_SIZE);
+
+    putRootLayer(sync, SYNC_PACKET_SIZE, VECTOR_ROOT_E131_EXTENDED, m_cid);
+    putFlagsLength(sync + 38, SYNC_PACKET_SIZE - 38);
+    put32(sync + 40, VECTOR_E131_EXTENDED_SYNCHRONIZATION);
+    sync[44] = m_syncSequence++;
+    put16(sync + 45, (uint16_t)m_syncUniverse);
+
+    m_syncDest = getDestination(m_syncUniverse);
+    m_batch.add(sync, SYNC_PACKET_SIZE, &m_syncDest);
+  }
+
+  m_batch.send(m_socket);
+}
+
+void SACNInterface::closeInt() {
+  if (!m_connected)
+    return;
+
+  // The standard asks for three packets with the terminated option
+  m_batch.clear();
+  try {
+    for (int i = 0; i < 3; i++) {
+      for (auto& out : m_outputs) {
+        if (out == nullptr)
+          continue;
+
+        out->packet[OPTIONS] |= OPTION_STREAM_TERMINATED;
+        put16(out->packet + SYNC_ADDRESS, 0);
+        out->packet[SEQUENCE] = out->sequence++;
+        m_batch.add(out->packet, DATA_PACKET_SIZE, &out->dest);
+      }
+      m_batch.send(m_socket);
+    }
+  }
+  catch (exception& e) {
+    Logger::log(WARN, e.what());
+  }
+
+  UDPBatch::closeSocket(m_socket);
+  m_socket = -1;
+  m_connected = false;
+  m_outputs.clear();
+  m_queued.clear();
+}
+
+void SACNInterface::reset() {
+  closeInt();
+  init();
+}
+
+JSONNode SACNInterface::toJSON() {
+  JSONNode root;
+
+  root.set_name(getInterfaceId());
+  root.push_back(JSONNode("type", getInterfaceType()));
+  root.push_back(JSONNode("sourceName", m_sourceName));
+  root.push_back(JSONNode("priority", m_priority));
+  root.push_back(JSONNode("host", m_host));
+  root.push_back(JSONNode("port", m_port));
+  root.push_back(JSONNode("syncUniverse", m_syncUniverse));
+  root.push_back(JSONNode("multicastInterface", m_multicastIface));
+  root.push_back(JSONNode("cid", getCID()));
+
+  return root;
+}
+
+}
+
+#endif
@@ -0,0 +1,152 @@
+/*! \file SACNInterface.h
+* \brief Class for sending DMX over streaming ACN (E1.31).
+*/
+#ifndef _SACNINTERFACE_H_
+#define _SACNINTERFACE_H_
+
+#pragma once
+#include "LumiverseCoreConfig.h"
+
+#ifdef USE_SACN
+
+#include "DMXInterface.h"
+#include "UDPBatch.h"
+#include "../lib/libjson/libjson.h"
+#include "Logger.h"
+#include <memory>
+#include <string>
+#include <sstream>
+#include <vector>
+
+namespace Lumiverse {
+  /*!
+  * \brief Sends DMX as streaming ACN (ANSI E1.31).
+  *
+  * Universes are sent to their standard multicast group, 239.255.x.y, or to a single
+  * host if one is given. The sACN universe number is the zero-indexed DMXPatch
+  * universe plus one, so DMX universe 1 is sACN universe 1.
+  *
+  * sendDMX() only fills in the universe's packet. flush(), called by the DMXPatch
+  * once per frame, sends every waiting packet as one UDPBatch. If a synchronization
+  * universe is set, data packets carry its address and flush() follows them with an
+  * E1.31 synchronization packet, so receivers that support it apply all universes of
+  * a frame at the same time.
+  */
+  class SACNInterface : public DMXInterface
+  {
+  public:
+    /*!
+    * \brief Creates a new sACN Interface
+    * \param id Identifier for this interface
+    * \param sourceName Name receivers show for this source. Up to 63 characters.
+    * \param priority Priority of the data, 0 to 200. Receivers take the highest priority
+    * source of a universe.
+    * \param host Host to send to. Empty to send to the multicast group of each universe.
+    * \param port Port to send to. 5568 is the standard port.
+    */
+    SACNInterface(string id, string sourceName = "Lumiverse", int priority = 100, string host = "", int port = 5568);
+
+    ~SACNInterface();
+
+    virtual void init();
+
+    virtual void sendDMX(unsigned char* data, unsigned int universe);
+
+    virtual void flush();
+
+    /*!
+    * \brief Tells receivers the stream is over and closes the socket.
+    */
+    virtual void closeInt();
+
+    virtual void reset();
+
+    virtual JSONNode toJSON();
+
+    virtual string getInterfaceType() { return "SACNInterface"; }
+
+    string getSourceName() { return m_sourceName; }
+    void setSourceName(string name) { m_sourceName = name; }
+
+    int getPriority() { return m_priority; }
+    void setPriority(int priority);
+
+    /*! \brief Unicast host, or empty for multicast. Takes effect on init(). */
+    string getHost() { return m_host; }
+    void setHost(string host) { m_host = host; }
+
+    int getPort() { return m_port; }
+    void setPort(int port) { m_port = port; }
+
+    /*!
+    * \brief Universe that synchronization packets are sent on.
+    *
+    * 0 turns synchronization off.
+    */
+    unsigned int getSyncUniverse() { return m_syncUniverse; }
+    void setSyncUniverse(unsigned int universe) { m_syncUniverse = universe; }
+
+    /*!
+    * \brief IP address of the network interface multicast is sent from.
+    *
+    * Empty uses the system default. Takes effect on init().
+    */
+    string getMulticastInterface() { return m_multicastIface; }
+    void setMulticastInterface(string ip) { m_multicastIface = ip; }
+
+    /*! \brief Component identifier of this source, as a 32 digit hex string. */
+    string getCID();
+
+    /*! \brief Sets the component identifier from a 32 digit hex string. */
+    bool setCID(string cid);
+
+    /*! \brief Size of a data packet with 512 slots. */
+    static const size_t DATA_PACKET_SIZE = 638;
+
+    /*! \brief Size of a synchronization packet. */
+    static const size_t SYNC_PACKET_SIZE = 49;
+
+  private:
+    /*! \brief Packet and sequence number of a universe. */
+    struct Output {
+      unsigned char packet[DATA_PACKET_SIZE];
+      unsigned char sequence;
+      sockaddr_in dest;
+      bool queued;
+    };
+
+    string m_sourceName;
+    int m_priority;
+    string m_host;
+    int m_port;
+    unsigned int m_syncUniverse;
+    string m_multicastIface;
+    unsigned char m_cid[16];
+
+    bool m_connected;
+    int m_socket;
+    in_addr m_hostAddr;
+
+    /*! \brief Output for each universe, created the first time a universe is sent. */
+    vector<unique_ptr<Output> > m_outputs;
+
+    /*! \brief Universes with a packet waiting for flush(). */
+    vector<unsigned int> m_queued;
+
+    unsigned char m_syncSequence;
+    unsigned char m_syncPacket[SYNC_PACKET_SIZE];
+    sockaddr_in m_syncDest;
+
+    UDPBatch m_batch;
+
+    /*! \brief Destination of an sACN universe. */
+    sockaddr_in getDestination(unsigned int sacnUniverse);
+
+    /*! \brief Creates the output for a universe with its packet headers filled in. */
+    Output* getOutput(unsigned int universe);
+  };
+}
+
+#endif
+
+#endif
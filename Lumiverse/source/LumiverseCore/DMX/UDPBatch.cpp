@@ -0,0 +1,122 @@
+#include "UDPBatch.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <errno.h>
+#endif
+
+namespace Lumiverse {
+
+void UDPBatch::add(const unsigned char* data, size_t size, const sockaddr_in* dest) {
+  add(data, size, nullptr, 0, dest);
+}
+
+void UDPBatch::add(const unsigned char* header, size_t headerSize, const unsigned char* body, size_t bodySize,
+  const sockaddr_in* dest)
+{
+  m_data.push_back(header);
+  m_data.push_back(body);
+  m_sizes.push_back(headerSize);
+  m_sizes.push_back(bodySize);
+  m_dests.push_back(dest);
+}
+
+void UDPBatch::clear() {
+  m_data.clear();
+  m_sizes.clear();
+  m_dests.clear();
+}
+
+void UDPBatch::send(int socket) {
+  size_t count = m_dests.size();
+
+#ifdef __linux__
+  if (m_msgs.size() < count) {
+    m_msgs.resize(count);
+    m_iovs.resize(count * 2);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    iovec* iov = &m_iovs[i * 2];
+    iov[0].iov_base = (void*)m_data[i * 2];
+    iov[0].iov_len = m_sizes[i * 2];
+    iov[1].iov_base = (void*)m_data[i * 2 + 1];
+    iov[1].iov_len = m_sizes[i * 2 + 1];
+
+    memset(&m_msgs[i], 0, sizeof(mmsghdr));
+    m_msgs[i].msg_hdr.msg_name = (void*)m_dests[i];
+    m_msgs[i].msg_hdr.msg_namelen = (m_dests[i] != nullptr) ? sizeof(sockaddr_in) : 0;
+    m_msgs[i].msg_hdr.msg_iov = iov;
+    m_msgs[i].msg_hdr.msg_iovlen = (iov[1].iov_len > 0) ? 2 : 1;
+  }
+
+  clear();
+
+  // sendmmsg can stop early, carry on from where it left off
+  size_t sent = 0;
+  while (sent < count) {
+    int res = sendmmsg(socket, m_msgs.data() + sent, (unsigned int)(count - sent), 0);
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      throw runtime_error("UDP send failed: " + string(strerror(errno)));
+    }
+
+    sent += res;
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    const char* data = (const char*)m_data[i * 2];
+    size_t size = m_sizes[i * 2];
+
+    // Join the parts of a datagram
+    if (m_sizes[i * 2 + 1] > 0) {
+      m_scratch.resize(size + m_sizes[i * 2 + 1]);
+      memcpy(m_scratch.data(), m_data[i * 2], size);
+      memcpy(m_scratch.data() + size, m_data[i * 2 + 1], m_sizes[i * 2 + 1]);
+      data = (const char*)m_scratch.data();
+      size = m_scratch.size();
+    }
+
+    int res;
+    if (m_dests[i] != nullptr)
+      res = sendto(socket, data, (int)size, 0, (const sockaddr*)m_dests[i], sizeof(sockaddr_in));
+    else
+      res = ::send(socket, data, (int)size, 0);
+
+    if (res < 0) {
+      clear();
+      throw runtime_error("UDP send failed");
+    }
+  }
+
+  clear();
+#endif
+}
+
+bool UDPBatch::resolve(string host, in_addr& addr) {
+  struct addrinfo hints;
+  struct addrinfo* result;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0)
+    return false;
+
+  addr = ((sockaddr_in*)result->ai_addr)->sin_addr;
+  freeaddrinfo(result);
+  return true;
+}
+
+void UDPBatch::closeSocket(int socket) {
+#ifdef _WIN32
+  closesocket(socket);
+#else
+  close(socket);
+#endif
+}
+
+}
@@ -0,0 +1,85 @@
+/*! \file UDPBatch.h
+* \brief Sends a batch of UDP datagrams with as few system calls as possible.
+*/
+#ifndef _UDPBATCH_H_
+#define _UDPBATCH_H_
+
+#pragma once
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <ws2tcpip.h>
+#pragma comment (lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Lumiverse {
+  /*!
+  * \brief Collects datagrams for a frame and sends them together.
+  *
+  * On Linux the whole batch goes out in one sendmmsg() call. Elsewhere each datagram is
+  * sent with sendto(). Datagrams aren't copied, so the data and addresses passed to
+  * add() have to stay valid until send() returns. The batch keeps its storage between
+  * frames, so it only allocates while it grows.
+  */
+  class UDPBatch
+  {
+  public:
+    UDPBatch() { }
+
+    /*! \brief Queues a datagram. A null dest sends on a connected socket. */
+    void add(const unsigned char* data, size_t size, const sockaddr_in* dest);
+
+    /*!
+    * \brief Queues a datagram made of a header followed by a body.
+    *
+    * The two parts are gathered by the kernel where it can, so neither is copied.
+    */
+    void add(const unsigned char* header, size_t headerSize, const unsigned char* body, size_t bodySize,
+      const sockaddr_in* dest);
+
+    /*! \brief Number of queued datagrams. */
+    size_t size() { return m_dests.size(); }
+
+    /*!
+    * \brief Sends every queued datagram and clears the batch.
+    *
+    * Throws a runtime_error if the socket reports an error. The batch is cleared either way.
+    */
+    void send(int socket);
+
+    /*! \brief Drops the queued datagrams. */
+    void clear();
+
+    /*! \brief Resolves an IPv4 host name or address. Returns false if it can't be resolved. */
+    static bool resolve(string host, in_addr& addr);
+
+    /*! \brief Closes a socket on any platform. */
+    static void closeSocket(int socket);
+
+  private:
+    /*! \brief Two parts per datagram. The second part is empty if there is only one. */
+    vector<const unsigned char*> m_data;
+    vector<size_t> m_sizes;
+    vector<const sockaddr_in*> m_dests;
+
+#ifdef __linux__
+    vector<mmsghdr> m_msgs;
+    vector<iovec> m_iovs;
+#else
+    vector<unsigned char> m_scratch;
+#endif
+  };
+}
+
+#endif
@@ -1,7 +1,15 @@
 #include "Device.h"
 namespace Lumiverse {
 
-Device::Device(string id, unsigned int channel, string type) {
+Device::ParamBlock::ParamBlock(const ParamBlock& other) :
+  values(other.values), owners(other.owners), frozen(false) {
+  for (const auto& p : owners) {
+    borrowed.insert(p.first);
+  }
+}
+
+Device::Device(string id, unsigned int channel, string type) :
+  m_params(make_shared<ParamBlock>()), m_snapshot(false) {
   this->m_id = id;
   this->m_channel = channel;
   this->m_type = type;
@@ -10,63 +18,101 @@ Device::Device(string id, unsigned int channel, string type) {
   // Right now we just leave the maps empty and stuff.
 }
 
-Device::Device(string id, const JSONNode data) {
+Device::Device(string id, const JSONNode data) :
+  m_params(make_shared<ParamBlock>()), m_snapshot(false) {
   m_id = id;
   loadJSON(data);
 }
 
-Device::Device(const Device& other) {
+Device::Device(const Device& other) :
+  m_params(make_shared<ParamBlock>()), m_snapshot(false) {
   m_id = other.m_id;
   m_channel = other.m_channel;
   m_type = other.m_type;
 
   // Need to do a deep copy of the parameters
-  for (auto kvp : other.m_parameters) {
-    m_parameters[kvp.first] = LumiverseTypeUtils::copy(kvp.second);
+  for (auto kvp : other.m_params->values) {
+    setParam(kvp.first, LumiverseTypeUtils::copy(kvp.second));
   }
 
   m_metadata = other.m_metadata;
   m_fp = other.m_fp;
 }
 
-Device::Device(Device* other) {
+Device::Device(Device* other) :
+  m_params(make_shared<ParamBlock>()), m_snapshot(false) {
   m_id = other->m_id;
   m_channel = other->m_channel;
   m_type = other->m_type;
 
   // Need to do a deep copy of the parameters
-  for (auto kvp : other->m_parameters) {
-    m_parameters[kvp.first] = LumiverseTypeUtils::copy(kvp.second);
+  for (auto kvp : other->m_params->values) {
+    setParam(kvp.first, LumiverseTypeUtils::copy(kvp.second));
   }
 
   m_metadata = other->m_metadata;
   m_fp = other->m_fp;
 }
 
-Device::Device(string id, Device* other) {
+Device::Device(string id, Device* other) :
+  m_params(make_shared<ParamBlock>()), m_snapshot(false) {
   m_id = id;
   m_channel = other->m_channel;
   m_type = other->m_type;
 
   // Need to do a deep copy of the parameters
-  for (auto kvp : other->m_parameters) {
-    m_parameters[kvp.first] = LumiverseTypeUtils::copy(kvp.second);
+  for (auto kvp : other->m_params->values) {
+    setParam(kvp.first, LumiverseTypeUtils::copy(kvp.second));
   }
 
   m_metadata = other->m_metadata;
   m_fp = other->m_fp;
 }
 
-Device::~Device() {
-  for (auto& kv : m_parameters) {
-    delete kv.second;
+Device::Device(Device* other, Device* base) : m_snapshot(true) {
+  m_id = other->m_id;
+  m_channel = other->m_channel;
+  m_type = other->m_type;
+
+  if (other->m_snapshot) {
+    // Snapshots are only written through this class, so the whole block can be shared
+    m_params = other->shareParams();
+  }
+  else {
+    shared_ptr<ParamBlock> baseParams = (base != nullptr && base->m_snapshot) ? base->shareParams() : nullptr;
+    m_params = make_shared<ParamBlock>();
+
+    for (const auto& kvp : other->m_params->values) {
+      shared_ptr<LumiverseType> param;
+
+      if (baseParams != nullptr) {
+        auto it = baseParams->owners.find(kvp.first);
+        if (it != baseParams->owners.end() && isSameParamState(it->second.get(), kvp.second)) {
+          param = it->second;
+          m_params->borrowed.insert(kvp.first);
+        }
+      }
+
+      if (param == nullptr)
+        param = shared_ptr<LumiverseType>(LumiverseTypeUtils::copy(kvp.second));
+
+      m_params->owners[kvp.first] = param;
+      m_params->values[kvp.first] = param.get();
+    }
   }
+
+  m_metadata = other->m_metadata;
+  m_fp = other->m_fp;
+}
+
+Device::~Device() {
+  // Parameters are released with m_params
 }
 
 bool Device::getParam(string param, float& val) {
-  if (m_parameters.count(param) > 0) {
-    if (m_parameters[param]->getTypeName() == "float") {
-      val = ((LumiverseFloat*)m_parameters[param])->getVal();
+  if (m_params->values.count(param) > 0) {
+    if (m_params->values[param]->getTypeName() == "float") {
+      val = ((LumiverseFloat*)m_params->values[param])->getVal();
       return true;
     }
   }
@@ -75,8 +121,8 @@ bool Device::getParam(string param, float& val) {
 }
 
 LumiverseType* Device::getParam(string param) {
-  unordered_map<string, LumiverseType*>::iterator it = m_parameters.find(param);
-  if (it != m_parameters.end()) {
+  unordered_map<string, LumiverseType*>::iterator it = m_params->values.find(param);
+  if (it != m_params->values.end()) {
     return it->second;
   }
   return nullptr;
@@ -146,16 +192,22 @@ LumiverseOrientation * Device::getOri(string param)
 bool Device::setParam(string param, LumiverseType* val) {
   bool ret = true;
 
-  if (m_parameters.count(param) == 0) {
+  ParamBlock& params = writableParams();
+  auto it = params.values.find(param);
+
+  if (it == params.values.end()) {
     ret = false;
   }
-  else {
-    // Delete old value to avoid leaking memory.
-    // tbh this function feels a bit unsafe, considering ways to change it.
-    delete m_parameters[param];
+  else if (it->second == val) {
+    // Already owned
+    return ret;
   }
 
-  m_parameters[param] = val;
+  // The old value is deleted when nothing else shares it.
+  // tbh this function feels a bit unsafe, considering ways to change it.
+  params.owners[param] = shared_ptr<LumiverseType>(val);
+  params.values[param] = val;
+  params.borrowed.erase(param);
 
   // callback
   onParameterChanged();
@@ -185,18 +237,20 @@ bool Device::setParam(string param, float val) {
   bool ret = true;
 
   // Checks param type
-  if (m_parameters.count(param) == 0 ||
-      (m_parameters[param]->getTypeName() != "float" &&
-      m_parameters[param]->getTypeName() != "orientation")) {
+  if (m_params->values.count(param) == 0 ||
+      (m_params->values[param]->getTypeName() != "float" &&
+      m_params->values[param]->getTypeName() != "orientation")) {
       Logger::log(ERR, "Parameter doesn't exist or trying to assign float value to a non-float type.");
       
       return false;
   }
     
-  if (m_parameters[param]->getTypeName() == "float")
-    *((LumiverseFloat *)m_parameters[param]) = val;
+  detachParam(param);
+
+  if (m_params->values[param]->getTypeName() == "float")
+    *((LumiverseFloat *)m_params->values[param]) = val;
   else 
-    *((LumiverseOrientation *)m_parameters[param]) = val;
+    *((LumiverseOrientation *)m_params->values[param]) = val;
 
   // callback
   onParameterChanged();
@@ -205,18 +259,19 @@ bool Device::setParam(string param, float val) {
 }
 
 bool Device::setParam(string param, string val, float val2) {
-  if (m_parameters.count(param) == 0) {
+  if (m_params->values.count(param) == 0) {
     return false;
   }
 
   // Checks param type
-  if (m_parameters[param]->getTypeName() != "enum") {
+  if (m_params->values[param]->getTypeName() != "enum") {
     Logger::log(ERR, "Trying to assign enum value to a non-enum type.");
         
     return false;
   }
     
-  LumiverseEnum* data = (LumiverseEnum *)m_parameters[param];
+  detachParam(param);
+  LumiverseEnum* data = (LumiverseEnum *)m_params->values[param];
   if (!data->setVal(val))
     return false;
 
@@ -231,12 +286,13 @@ bool Device::setParam(string param, string val, float val2) {
 }
 
 bool Device::setParam(string param, string val, float val2, LumiverseEnum::Mode mode, LumiverseEnum::InterpolationMode interpMode) {
-  if (m_parameters.count(param) == 0 ||
-      m_parameters[param]->getTypeName() != "enum") {
+  if (m_params->values.count(param) == 0 ||
+      m_params->values[param]->getTypeName() != "enum") {
     return false;
   }
     
-  ((LumiverseEnum *)m_parameters[param])->setVal(val, val2, mode, interpMode);
+  detachParam(param);
+  ((LumiverseEnum *)m_params->values[param])->setVal(val, val2, mode, interpMode);
 
   // callback
   onParameterChanged();
@@ -245,12 +301,13 @@ bool Device::setParam(string param, string val, float val2, LumiverseEnum::Mode
 }
 
 bool Device::setParam(string param, string channel, double val) {
-  if (m_parameters.count(param) == 0 ||
-      m_parameters[param]->getTypeName() != "color") {
+  if (m_params->values.count(param) == 0 ||
+      m_params->values[param]->getTypeName() != "color") {
     return false;
   }
 
-  LumiverseColor* data = (LumiverseColor*)m_parameters[param];
+  detachParam(param);
+  LumiverseColor* data = (LumiverseColor*)m_params->values[param];
   bool ret;
   if ((ret = data->setColorChannel(channel, val))) {
     // callback
@@ -261,12 +318,13 @@ bool Device::setParam(string param, string channel, double val) {
 }
 
 bool Device::setParam(string param, double x, double y, double weight) {
-  if (m_parameters.count(param) == 0 ||
-      m_parameters[param]->getTypeName() != "color") {
+  if (m_params->values.count(param) == 0 ||
+      m_params->values[param]->getTypeName() != "color") {
     return false;
   }
 
-  ((LumiverseColor*)m_parameters[param])->setxy(x, y, weight);
+  detachParam(param);
+  ((LumiverseColor*)m_params->values[param])->setxy(x, y, weight);
 
   // callback
   onParameterChanged();
@@ -295,12 +353,13 @@ bool Device::addColorParam(string name, int m)
 }
 
 bool Device::setColorRGBRaw(string param, double r, double g, double b, double weight) {
-  if (m_parameters.count(param) == 0 ||
-      m_parameters[param]->getTypeName() != "color") {
+  if (m_params->values.count(param) == 0 ||
+      m_params->values[param]->getTypeName() != "color") {
     return false;
   }
 
-  ((LumiverseColor*)m_parameters[param])->setRGBRaw(r, g, b, weight);
+  detachParam(param);
+  ((LumiverseColor*)m_params->values[param])->setRGBRaw(r, g, b, weight);
 
   // callback
   onParameterChanged();
@@ -309,12 +368,13 @@ bool Device::setColorRGBRaw(string param, double r, double g, double b, double w
 }
 
 bool Device::setColorRGB(string param, double r, double g, double b, double weight, RGBColorSpace cs) {
-  if (m_parameters.count(param) == 0 ||
-      m_parameters[param]->getTypeName() != "color") {
+  if (m_params->values.count(param) == 0 ||
+      m_params->values[param]->getTypeName() != "color") {
     return false;
   }
 
-  ((LumiverseColor*)m_parameters[param])->setRGB(r, g, b, weight, cs);
+  detachParam(param);
+  ((LumiverseColor*)m_params->values[param])->setRGB(r, g, b, weight, cs);
 
   // callback
   onParameterChanged();
@@ -324,23 +384,25 @@ bool Device::setColorRGB(string param, double r, double g, double b, double weig
 
 bool Device::setColorHSV(string param, double H, double S, double V, double weight)
 {
-  if (m_parameters.count(param) == 0 ||
-    m_parameters[param]->getTypeName() != "color") {
+  if (m_params->values.count(param) == 0 ||
+    m_params->values[param]->getTypeName() != "color") {
     return false;
   }
 
-  ((LumiverseColor*)m_parameters[param])->setHSV(H, S, V, weight);
+  detachParam(param);
+  ((LumiverseColor*)m_params->values[param])->setHSV(H, S, V, weight);
   return true;
 }
 
 bool Device::setColorWeight(string param, double weight)
 {
-  if (m_parameters.count(param) == 0 ||
-    m_parameters[param]->getTypeName() != "color") {
+  if (m_params->values.count(param) == 0 ||
+    m_params->values[param]->getTypeName() != "color") {
     return false;
   }
 
-  ((LumiverseColor*)m_parameters[param])->setWeight(weight);
+  detachParam(param);
+  ((LumiverseColor*)m_params->values[param])->setWeight(weight);
   return true;
 }
 
@@ -353,23 +415,29 @@ LumiverseFloat* Device::getIntensity() {
 }
 
 bool Device::setColorChannel(string param, string channel, double val) {
-  if (m_parameters.count(param) == 0 ||
-      m_parameters[param]->getTypeName() != "color") {
+  if (m_params->values.count(param) == 0 ||
+      m_params->values[param]->getTypeName() != "color") {
       return false;
   }
 
-  ((LumiverseColor*)m_parameters[param])->setColorChannel(channel, val);
+  detachParam(param);
+  ((LumiverseColor*)m_params->values[param])->setColorChannel(channel, val);
   
   onParameterChanged();
   return true;
 }
     
 void Device::copyParamByValue(string param, LumiverseType* source) {
-  LumiverseType *target = m_parameters[param];
-    
+  auto it = m_params->values.find(param);
+  if (it == m_params->values.end())
+    return;
+
 	// Skips this copy if types don't match.
-  if (!LumiverseTypeUtils::areSameType(source, target))
+  if (!LumiverseTypeUtils::areSameType(source, it->second))
     return;
+
+  detachParam(param);
+  LumiverseType *target = m_params->values[param];
     
   if (source->getTypeName() == "float") {
     *((LumiverseFloat*)target) = *((LumiverseFloat*)source);
@@ -390,14 +458,81 @@ void Device::copyParamByValue(string param, LumiverseType* source) {
 //  onParameterChanged();
 }
     
+size_t Device::numSharedParams() {
+  shared_ptr<ParamBlock> params = atomic_load(&m_params);
+
+  // params itself is one reference
+  if (params.use_count() > 2)
+    return params->owners.size();
+
+  size_t count = 0;
+  for (const auto& p : params->owners) {
+    if (p.second.use_count() > 1)
+      count++;
+  }
+
+  return count;
+}
+
+Device::ParamBlock& Device::writableParams() {
+  if (m_params->frozen.load(memory_order_acquire)) {
+    // Other snapshots may be reading the old block, so the copy is published atomically
+    atomic_store(&m_params, make_shared<ParamBlock>(*m_params));
+  }
+
+  return *m_params;
+}
+
+shared_ptr<Device::ParamBlock> Device::shareParams() {
+  shared_ptr<ParamBlock> params = atomic_load(&m_params);
+  params->frozen.store(true, memory_order_release);
+
+  return params;
+}
+
+void Device::detachParam(const string& param) {
+  ParamBlock& params = writableParams();
+  if (params.borrowed.empty() || params.borrowed.erase(param) == 0)
+    return;
+
+  shared_ptr<LumiverseType>& owner = params.owners[param];
+  owner = shared_ptr<LumiverseType>(LumiverseTypeUtils::copy(owner.get()));
+  params.values[param] = owner.get();
+}
+
+bool Device::isSameParamState(LumiverseType* a, LumiverseType* b) {
+  if (!LumiverseTypeUtils::equals(a, b))
+    return false;
+
+  // equals() only compares values. Ranges need to match as well to share storage.
+  if (a->getTypeName() == "float") {
+    LumiverseFloat* fa = (LumiverseFloat*)a;
+    LumiverseFloat* fb = (LumiverseFloat*)b;
+    return fa->getMax() == fb->getMax() && fa->getMin() == fb->getMin() && fa->getDefault() == fb->getDefault();
+  }
+  else if (a->getTypeName() == "orientation") {
+    LumiverseOrientation* oa = (LumiverseOrientation*)a;
+    LumiverseOrientation* ob = (LumiverseOrientation*)b;
+    return oa->getUnit() == ob->getUnit() && oa->getMax() == ob->getMax() &&
+      oa->getMin() == ob->getMin() && oa->getDefault() == ob->getDefault();
+  }
+  else if (a->getTypeName() == "enum") {
+    LumiverseEnum* ea = (LumiverseEnum*)a;
+    LumiverseEnum* eb = (LumiverseEnum*)b;
+    return ea->getMode() == eb->getMode() && ea->getInterpMode() == eb->getInterpMode();
+  }
+
+  return true;
+}
+
 bool Device::paramExists(string param) {
-  unordered_map<string, LumiverseType*>::iterator it = m_parameters.find(param);
-  if (it != m_parameters.end()) {
+  unordered_map<string, LumiverseType*>::iterator it = m_params->values.find(param);
+  if (it != m_params->values.end()) {
     if (it->second != nullptr)
       return true;
     else {
       // remove parameter to be safe if it's null
-      m_parameters.erase(param);
+      writableParams().values.erase(param);
       return false;
     }
   }
@@ -405,12 +540,12 @@ bool Device::paramExists(string param) {
 }
 
 size_t Device::numParams() {
-  return m_parameters.size();
+  return m_params->values.size();
 }
 
 vector<string> Device::getParamNames() {
   vector<string> keys;
-  for (const auto& kv : m_parameters) {
+  for (const auto& kv : m_params->values) {
     keys.push_back(kv.first);
   }
 
@@ -463,9 +598,11 @@ void Device::deleteMetadata(string key) {
 }
 
 void Device::deleteParameter(string key) {
-  if (m_parameters.count(key) != 0) {
-    delete m_parameters[key];
-    m_parameters.erase(key);
+  if (m_params->values.count(key) != 0) {
+    ParamBlock& params = writableParams();
+    params.values.erase(key);
+    params.owners.erase(key);
+    params.borrowed.erase(key);
 
     onParameterChanged();
   }
@@ -501,7 +638,13 @@ vector<string> Device::getMetadataKeyNames() {
 }
 
 void Device::reset() {
-  for (auto p : m_parameters) {
+  ParamBlock& params = writableParams();
+  vector<string> borrowed(params.borrowed.begin(), params.borrowed.end());
+  for (const string& p : borrowed) {
+    detachParam(p);
+  }
+
+  for (auto p : m_params->values) {
     p.second->reset();
   }
     
@@ -589,10 +732,10 @@ bool Device::isIdentical(Device* d) {
   if (m_type != d->getType()) return false;
 
   // parameter check
-  if (m_parameters.size() != d->m_parameters.size())
+  if (m_params->values.size() != d->m_params->values.size())
     return false;
 
-  for (auto p : m_parameters) {
+  for (auto p : m_params->values) {
     // If a parameter doesn't exist in the other device, return false
     // immediately, they must have the same parameter count at this point.
     if (!d->paramExists(p.first))
@@ -731,7 +874,7 @@ JSONNode Device::parametersToJSON() {
   JSONNode params;
   params.set_name("parameters");
 
-  for (std::pair<string, LumiverseType*> p : m_parameters) {
+  for (std::pair<string, LumiverseType*> p : m_params->values) {
     params.push_back(p.second->toJSON(p.first));
   }
 
@@ -11,6 +11,9 @@
 #include <string>
 #include <memory>
 #include <sstream>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "LumiverseCoreConfig.h"
 #include "Logger.h"
@@ -92,6 +95,26 @@ namespace Lumiverse {
     */
     Device(string id, Device* other);
 
+    /*!
+    \brief Creates a copy-on-write snapshot of a device.
+
+    If `other` is itself a snapshot, the new snapshot shares all of its parameter data and
+    taking it doesn't depend on the number of parameters. Otherwise `other` is a regular
+    device that may be written through raw parameter pointers, so its values are copied.
+    Parameters whose values are unchanged from the ones stored in `base` are shared with
+    `base` instead, so a series of snapshots of the same device only allocates storage for
+    the parameters that changed between them. `base` should be a previous snapshot (or nullptr).
+
+    Parameter data that has been shared is never written again. Modifying a snapshot with
+    setParam(), copyParamByValue() or reset() gives it a private copy of the affected data
+    first. Parameter data reached through raw pointers (getParam(), getRawParameters())
+    may be shared and must be treated as read-only. A device must not be modified while
+    a snapshot of it is being taken.
+    \param other Device to copy
+    \param base Previous snapshot to share unchanged parameters with
+    */
+    Device(Device* other, Device* base);
+
     /*! 
     * \brief Destroys a device.
     */
@@ -516,7 +539,16 @@ namespace Lumiverse {
     * in a calling function.
     * \return Reference to the map of parameter data.
     */
-    unordered_map<string, LumiverseType*>& getRawParameters() { return m_parameters; }
+    unordered_map<string, LumiverseType*>& getRawParameters() { return m_params->values; }
+
+    /*!
+    \brief Returns the number of parameters whose data is shared with another snapshot.
+
+    Meant for diagnostics. The count can be out of date as soon as it's returned if other
+    snapshots are created or deleted on other threads.
+    \sa Device(Device*, Device*)
+    */
+    size_t numSharedParams();
       
     /** Indicates the function signature for parameter and metadata callbacks.
     Currently a device has to pass in "this" pointer. It seems to be other
@@ -669,6 +701,57 @@ namespace Lumiverse {
     * \sa onParameterChanged()
     */
     void onMetadataChanged();
+
+    /*!
+    \brief Storage for the parameters of a device.
+
+    Snapshots share blocks with each other. A block is frozen when it is first shared
+    and is never modified after that: a device that needs to change a frozen block
+    replaces it with its own copy. Parameters that a block shares with another block
+    are listed in `borrowed` and are copied before they are written. Whether data can be
+    written in place is decided from the device's own block only.
+    \sa Device(Device*, Device*)
+    */
+    struct ParamBlock {
+      ParamBlock() : frozen(false) { }
+
+      /*! \brief Creates an unfrozen block that borrows every parameter of other. */
+      ParamBlock(const ParamBlock& other);
+
+      /*! \brief Raw pointers to the parameters held in owners. */
+      unordered_map<string, LumiverseType*> values;
+
+      /*! \brief Parameter storage. Borrowed parameters are also held by other blocks. */
+      unordered_map<string, shared_ptr<LumiverseType> > owners;
+
+      /*! \brief Parameters shared with another block. */
+      unordered_set<string> borrowed;
+
+      /*! \brief Set once the block is shared with another device. */
+      atomic<bool> frozen;
+    };
+
+    /*!
+    \brief Returns the parameter block, replacing it with a private copy if it's frozen.
+    */
+    ParamBlock& writableParams();
+
+    /*!
+    \brief Freezes the parameter block and returns it so another snapshot can share it.
+    */
+    shared_ptr<ParamBlock> shareParams();
+
+    /*!
+    \brief Gives this device a private copy of a shared snapshot parameter.
+
+    Called before a parameter is modified. Does nothing for parameters that aren't shared.
+    */
+    void detachParam(const string& param);
+
+    /*!
+    \brief Returns true if two parameters can share storage in a snapshot.
+    */
+    static bool isSameParamState(LumiverseType* a, LumiverseType* b);
       
     /*!
     * \brief Unique identifier for the device.
@@ -692,14 +775,22 @@ namespace Lumiverse {
     string m_type;
 
     /*!
-    * \brief Map for time-varying parameters.
+    * \brief Time-varying parameters.
     *
     * These parameters correspond to network-controllable functions of
     * the lighting fixtures. If you can't control it over DMX, Ethernet, or
     * other protocol, it's not a parameter.
+    *
+    * Never null. Snapshots may share the block with other snapshots. It is replaced
+    * with std::atomic_store so that other threads can take snapshots of it.
+    */
+    shared_ptr<ParamBlock> m_params;
+
+    /*!
+    \brief True for snapshots, whose parameters are only modified through this class.
+    \sa Device(Device*, Device*)
     */
-    // Type may change in the future as more specialized datatypes come up.
-    unordered_map<string, LumiverseType*> m_parameters;
+    bool m_snapshot;
 
     /*!
     * \brief Map for program-side information.
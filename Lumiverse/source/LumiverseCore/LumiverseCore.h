@@ -56,6 +56,10 @@
 
 #include "lib/Eigen/Dense"
 #include "Logger.h"
+#include "Profiler.h"
+#include "Clock.h"
+#include "ThreadPool.h"
+#include "Simulation/PhotoAccumulator.h"
 #include "Device.h"
 #include "Rig.h"
 #include "DeviceSet.h"
@@ -68,8 +72,13 @@
 #include "types/LumiverseTypeUtils.h"
 #include "types/LumiverseColorLib.h"
 #include "DMX/DMXPatch.h"
+#include "DMX/DMXCurve.h"
 #include "DMX/DMXDevicePatch.h"
+#include "DMX/DMXInput.h"
 #include "DMX/DMXInterface.h"
+#include "DMX/DMXOutputThread.h"
+#include "DMX/DMXShow.h"
+#include "DMX/DMXUniverseSlab.h"
 #include "lib/libjson/libjson.h"
 
 #ifdef USE_DMXPRO2
@@ -84,6 +93,10 @@
 #include "DMX/ArtNetInterface.h"
 #endif
 
+#ifdef USE_SACN
+#include "DMX/SACNInterface.h"
+#endif
+
 #ifdef USE_OSC
 #include "OscPatch.h"
 #endif
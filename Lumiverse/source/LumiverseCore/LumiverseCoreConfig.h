@@ -0,0 +1,14 @@
+// Configruation file for Lumiverse Core library
+
+#define LumiverseCore_VERSION_MAJOR 2
+#define LumiverseCore_VERSION_MINOR 5
+
+
+#define USE_KINET
+
+
+#define USE_SACN
+
+
+
+
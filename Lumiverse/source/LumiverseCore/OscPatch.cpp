@@ -1,21 +1,72 @@
 #include "OscPatch.h"
+#include "Rig.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <regex>
+#include <thread>
 
 namespace Lumiverse {
 
+const size_t OscPatch::DEFAULT_MAX_PACKET_SIZE;
+
+// Bundle header: "#bundle" and the immediate time tag
+static const char bundleHeader[16] = { '#', 'b', 'u', 'n', 'd', 'l', 'e', 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+
+OscCommandQueue::OscCommandQueue(size_t capacity) : m_head(0), m_tail(0)
+{
+  size_t size = 1;
+  while (size < capacity)
+    size *= 2;
+
+  m_slots.resize(size);
+  m_mask = size - 1;
+}
+
+bool OscCommandQueue::push(OscCommand& cmd)
+{
+  size_t tail = m_tail.load(memory_order_relaxed);
+  if (tail - m_head.load(memory_order_acquire) > m_mask)
+    return false;
+
+  swap(m_slots[tail & m_mask], cmd);
+  m_tail.store(tail + 1, memory_order_release);
+  return true;
+}
+
+bool OscCommandQueue::pop(OscCommand& cmd)
+{
+  size_t head = m_head.load(memory_order_relaxed);
+  if (head == m_tail.load(memory_order_acquire))
+    return false;
+
+  // swapping leaves the slot's old storage for the producer to reuse
+  swap(cmd, m_slots[head & m_mask]);
+  m_head.store(head + 1, memory_order_release);
+  return true;
+}
+
 OscPatch::OscPatch(string address, int port, OscFormat mode, string pattern) :
-  _address(address), _port(port), _mode(mode), _pattern(pattern), _running(false), _inPort(9000)
+  _mode(mode), _pattern(pattern), _address(address), _port(port), _inPort(9000), _running(false),
+  _t(nullptr), _receive(false), _rcv(nullptr), _commandsReceived(0), _commandsDropped(0),
+  _scratch(1024), _maxPacketSize(DEFAULT_MAX_PACKET_SIZE), _sendRate(0), _keepAlive(1000),
+  _packetsSent(0), _messagesSent(0), _messagesSaved(0),
+  _eosWindow(64), _eosPending(0), _eosLastAck(0), _eosCommandsLastFrame(0), _eosCommandsSent(0),
+  _syncReady(true)
 {
-  _t = nullptr;
 }
 
-OscPatch::OscPatch(JSONNode data)
+OscPatch::OscPatch(JSONNode data) :
+  _running(false), _t(nullptr), _rcv(nullptr), _commandsReceived(0), _commandsDropped(0),
+  _scratch(1024), _packetsSent(0), _messagesSent(0), _messagesSaved(0),
+  _eosPending(0), _eosLastAck(0), _eosCommandsLastFrame(0), _eosCommandsSent(0), _syncReady(true)
 {
   loadJSON(data);
 }
 
 OscPatch::~OscPatch()
 {
+  stopReceiving();
   if (_t != nullptr)
     delete _t;
 }
@@ -25,6 +76,18 @@ void OscPatch::init()
   _t = new UdpTransmitSocket(IpEndpointName(_address.c_str(), _port));
   _running = true;
 
+  // Everything goes out on the first update
+  _cache.clear();
+  _eosSent.clear();
+  _eosPending = 0;
+  _cacheMode = _mode;
+  _cachePattern = _pattern;
+  _lastSend = chrono::steady_clock::time_point();
+  _lastKeepAlive = chrono::steady_clock::now();
+
+  if (_receive)
+    startReceiving();
+
   if (_mode == ETC_EOS) {
     char buf[64];
     osc::OutboundPacketStream p(buf, 64);
@@ -42,23 +105,51 @@ void OscPatch::update(set<Device*> devices)
   if (!_running)
     return;
 
+  auto now = chrono::steady_clock::now();
+  if (_sendRate > 0 && now - _lastSend < chrono::duration<float>(1 / _sendRate))
+    return;
+  _lastSend = now;
+
+  if (_mode == ETC_EOS) {
+    updateEos(devices);
+    return;
+  }
+
+  // Addresses depend on the mode and pattern, which can be changed at any time
+  if (_mode != _cacheMode || _pattern != _cachePattern) {
+    _cache.clear();
+    _cacheMode = _mode;
+    _cachePattern = _pattern;
+  }
+
+  bool keepAlive = _keepAlive == 0 || now - _lastKeepAlive >= chrono::milliseconds(_keepAlive);
+  if (keepAlive)
+    _lastKeepAlive = now;
+
   for (auto d : devices) {
-    if (_mode == ETC_EOS) {
-      deviceToEos(d);
+    DeviceCache& cache = _cache[d->getId()];
+    if (cache.address.empty()) {
+      cache.address = (_mode == PREFIXED_ADDR) ? "/" + _pattern + "/" + d->getId() : "/" + d->getId();
     }
-    else {
-      // if somehow there's a message over 10000 characters long we may have a problem
-      char buffer[10000];
-      osc::OutboundPacketStream packet(buffer, 10000);
 
-      deviceToOsc(packet, d);
-      _t->Send(packet.Data(), packet.Size());
+    size_t size = encodeDevice(d, cache.address);
+
+    if (!keepAlive && size == cache.message.size() && memcmp(_scratch.data(), cache.message.data(), size) == 0) {
+      _messagesSaved++;
+      continue;
     }
+
+    cache.message.assign(_scratch.data(), _scratch.data() + size);
+    addToBundle(_scratch.data(), size);
   }
+
+  sendBundle();
 }
 
 void OscPatch::close()
 {
+  stopReceiving();
+
   if (_t != nullptr) {
     delete _t;
     _t = nullptr;
@@ -78,13 +169,19 @@ JSONNode OscPatch::toJSON()
   root.push_back(JSONNode("pattern", _pattern));
   root.push_back(JSONNode("mode", _mode));
   root.push_back(JSONNode("inPort", _inPort));
+  root.push_back(JSONNode("inAddress", _inAddress));
+  root.push_back(JSONNode("maxPacketSize", _maxPacketSize));
+  root.push_back(JSONNode("sendRate", _sendRate));
+  root.push_back(JSONNode("keepAliveInterval", _keepAlive));
+  root.push_back(JSONNode("receive", _receive));
+  root.push_back(JSONNode("eosCommandWindow", _eosWindow));
 
   return root;
 }
 
 void OscPatch::deleteDevice(string id)
 {
-  // oscpatch maintains no state
+  _cache.erase(id);
 }
 
 void OscPatch::changeAddress(string address, int port)
@@ -103,6 +200,28 @@ void OscPatch::changeAddress(string address, int port)
 void OscPatch::changeInPort(int port)
 {
   _inPort = port;
+
+  // rebind a running server
+  if (isReceiving()) {
+    stopReceiving();
+    startReceiving();
+  }
+}
+
+void OscPatch::changeInAddress(string address)
+{
+  _inAddress = address;
+
+  // rebind a running server
+  if (isReceiving()) {
+    stopReceiving();
+    startReceiving();
+  }
+}
+
+string OscPatch::getInAddress()
+{
+  return _inAddress;
 }
 
 string OscPatch::getAddress()
@@ -125,6 +244,252 @@ bool OscPatch::isRunning()
   return _running;
 }
 
+void OscPatch::setMaxPacketSize(size_t bytes)
+{
+  _maxPacketSize = bytes;
+}
+
+size_t OscPatch::getMaxPacketSize()
+{
+  return _maxPacketSize;
+}
+
+void OscPatch::setSendRate(float hz)
+{
+  _sendRate = (hz < 0) ? 0 : hz;
+}
+
+float OscPatch::getSendRate()
+{
+  return _sendRate;
+}
+
+void OscPatch::setKeepAliveInterval(unsigned int ms)
+{
+  _keepAlive = ms;
+}
+
+unsigned int OscPatch::getKeepAliveInterval()
+{
+  return _keepAlive;
+}
+
+void OscPatch::resetPacketCounters()
+{
+  _packetsSent = 0;
+  _messagesSent = 0;
+  _messagesSaved = 0;
+  _eosCommandsSent = 0;
+}
+
+void OscPatch::setEosCommandWindow(size_t commands)
+{
+  _eosWindow = commands;
+}
+
+size_t OscPatch::getEosCommandWindow()
+{
+  return _eosWindow;
+}
+
+void OscPatch::setReceive(bool receive)
+{
+  _receive = receive;
+
+  if (!_running)
+    return;
+
+  if (_receive && !isReceiving())
+    startReceiving();
+  else if (!_receive)
+    stopReceiving();
+}
+
+bool OscPatch::getReceive()
+{
+  return _receive;
+}
+
+bool OscPatch::isReceiving()
+{
+  return _rcv != nullptr;
+}
+
+bool OscPatch::startReceiving()
+{
+  if (_rcv != nullptr)
+    return true;
+
+  try {
+    string address = (_inAddress == "" && _mode == ETC_EOS) ? _address : _inAddress;
+    IpEndpointName endpoint = (address == "") ? IpEndpointName(IpEndpointName::ANY_ADDRESS, _inPort) :
+      IpEndpointName(address.c_str(), _inPort);
+    _rcv = new UdpListeningReceiveSocket(endpoint, this);
+  }
+  catch (exception& e) {
+    Logger::log(ERR, "Failed to start OSC server: " + string(e.what()));
+    return false;
+  }
+
+  _rcvPrefix = "/" + _pattern + "/";
+  _rcvThread = thread([this] { _rcv->Run(); });
+
+  stringstream ss;
+  ss << "OSC server listening on port " << _inPort;
+  Logger::log(INFO, ss.str());
+  return true;
+}
+
+void OscPatch::stopReceiving()
+{
+  if (_rcv == nullptr)
+    return;
+
+  _rcv->AsynchronousBreak();
+  _rcvThread.join();
+
+  delete _rcv;
+  _rcv = nullptr;
+}
+
+bool OscPatch::isCommand(const string& pattern)
+{
+  if (pattern.compare(0, _rcvPrefix.size(), _rcvPrefix) != 0)
+    return false;
+
+  // Eos replies can share the prefix if the pattern is "eos"
+  return _mode != ETC_EOS || pattern.compare(0, 9, "/eos/out/") != 0;
+}
+
+void OscPatch::queueCommand(const osc::ReceivedMessage& m)
+{
+  string action = string(m.AddressPattern()).substr(_rcvPrefix.size());
+
+  OscCommand cmd;
+  if (action == "select")
+    cmd.type = OscCommand::SELECT;
+  else if (action == "select/add")
+    cmd.type = OscCommand::SELECT_ADD;
+  else if (action == "select/clear")
+    cmd.type = OscCommand::SELECT_CLEAR;
+  else {
+    // [id]/[param], where the id "selected" means the selection
+    size_t slash = action.find('/');
+    if (slash == string::npos || slash == 0 || slash == action.size() - 1)
+      return;
+
+    cmd.type = OscCommand::SET;
+    cmd.param = action.substr(slash + 1);
+
+    string id = action.substr(0, slash);
+    if (id != "selected")
+      cmd.ids.push_back(id);
+  }
+
+  for (auto arg = m.ArgumentsBegin(); arg != m.ArgumentsEnd(); arg++) {
+    if (cmd.type == OscCommand::SELECT || cmd.type == OscCommand::SELECT_ADD) {
+      if (arg->IsString())
+        cmd.ids.push_back(arg->AsStringUnchecked());
+    }
+    else if (arg->IsString()) {
+      cmd.text = arg->AsStringUnchecked();
+    }
+    else if (arg->IsFloat()) {
+      cmd.values.push_back(arg->AsFloatUnchecked());
+    }
+    else if (arg->IsInt32()) {
+      cmd.values.push_back((float)arg->AsInt32Unchecked());
+    }
+    else if (arg->IsDouble()) {
+      cmd.values.push_back((float)arg->AsDoubleUnchecked());
+    }
+  }
+
+  _commandsReceived++;
+  if (!_commands.push(cmd))
+    _commandsDropped++;
+}
+
+bool OscPatch::popCommand(OscCommand& cmd)
+{
+  return _commands.pop(cmd);
+}
+
+set<string> OscPatch::applyCommands(const map<string, Device*>& devices)
+{
+  return applyCommands([&devices](const string& id) -> Device* {
+    auto d = devices.find(id);
+    return (d == devices.end()) ? nullptr : d->second;
+  });
+}
+
+set<string> OscPatch::applyCommands(Rig* rig)
+{
+  return applyCommands([rig](const string& id) { return rig->getDevice(id); });
+}
+
+set<string> OscPatch::applyCommands(function<Device*(const string&)> find)
+{
+  set<string> changed;
+  OscCommand cmd;
+
+  while (_commands.pop(cmd)) {
+    switch (cmd.type) {
+    case (OscCommand::SELECT) :
+      _selection.clear();
+      // fall through
+    case (OscCommand::SELECT_ADD) :
+      for (auto& id : cmd.ids) {
+        if (find(id) != nullptr)
+          _selection.insert(id);
+      }
+      break;
+    case (OscCommand::SELECT_CLEAR) :
+      _selection.clear();
+      break;
+    case (OscCommand::SET) :
+      for (auto& id : (cmd.ids.empty()) ? _selection : set<string>(cmd.ids.begin(), cmd.ids.end())) {
+        Device* d = find(id);
+        if (d != nullptr && applyCommand(cmd, d))
+          changed.insert(id);
+      }
+      break;
+    }
+  }
+
+  return changed;
+}
+
+bool OscPatch::applyCommand(const OscCommand& cmd, Device* d)
+{
+  LumiverseType* param = d->getParam(cmd.param);
+
+  // values go through the Device setters, which give shared parameters their own copy
+  if (LumiverseFloat* f = dynamic_cast<LumiverseFloat*>(param)) {
+    if (cmd.values.empty())
+      return false;
+    return d->setParam(cmd.param, f->getMin() + cmd.values[0] * (f->getMax() - f->getMin()));
+  }
+  else if (dynamic_cast<LumiverseOrientation*>(param) != nullptr) {
+    if (cmd.values.empty())
+      return false;
+    return d->setParam(cmd.param, cmd.values[0]);
+  }
+  else if (dynamic_cast<LumiverseColor*>(param) != nullptr) {
+    if (cmd.values.size() < 3)
+      return false;
+    float weight = (cmd.values.size() > 3) ? cmd.values[3] : 1;
+    return d->setColorRGB(cmd.param, cmd.values[0], cmd.values[1], cmd.values[2], weight);
+  }
+  else if (dynamic_cast<LumiverseEnum*>(param) != nullptr) {
+    if (cmd.text.empty())
+      return false;
+    return d->setParam(cmd.param, cmd.text, (cmd.values.empty()) ? -1.0f : cmd.values[0]);
+  }
+
+  return false;
+}
+
 bool OscPatch::sync(const set<Device*> devices)
 {
   // bit clunky here but Eos echoes current parameter settings when something is selected
@@ -134,17 +499,16 @@ bool OscPatch::sync(const set<Device*> devices)
   // wait for loop to finish
   this_thread::sleep_for(chrono::milliseconds(100));
 
+  bool ownServer = false;
   try {
-    UdpListeningReceiveSocket rcv(IpEndpointName(_address.c_str(), _inPort), this);
-
-    if (!rcv.IsBound()) {
+    // use the OSC server if it's already up
+    ownServer = !isReceiving();
+    if (ownServer && !startReceiving()) {
       Logger::log(ERR, "Eos sync: Failed to bind port.");
       _running = true;
       return false;
     }
 
-    std::thread rcvt(function<void()>([&rcv] { rcv.Run(); }));
-
     // feed it some stuff to clear
     char buf1[64];
     osc::OutboundPacketStream forceReset(buf1, 64);
@@ -162,8 +526,8 @@ bool OscPatch::sync(const set<Device*> devices)
         // track how long we're waiting and abort if wait too long
         timeoutCounter += 5;
         if (timeoutCounter > 5000) {
-          rcv.AsynchronousBreak();
-          rcvt.join();
+          if (ownServer)
+            stopReceiving();
           Logger::log(ERR, "Eos sync timeout. Operation cancelled. Some devices may have been synchronized before abort.");
           _running = true;
           return false;
@@ -215,11 +579,14 @@ bool OscPatch::sync(const set<Device*> devices)
     }
 
     // reinit
-    rcv.AsynchronousBreak();
-    rcvt.join();
+    if (ownServer)
+      stopReceiving();
   }
   catch (exception &e) {
+    if (ownServer)
+      stopReceiving();
     Logger::log(ERR, "Error syncing data: " + string(e.what()));
+    _running = true;
     return false;
   }
 
@@ -234,17 +601,16 @@ set<int> OscPatch::getEosSelection()
   // wait for loop to finish
   this_thread::sleep_for(chrono::milliseconds(100));
 
+  bool ownServer = false;
   try {
-    UdpListeningReceiveSocket rcv(IpEndpointName(_address.c_str(), _inPort), this);
-
-    if (!rcv.IsBound()) {
+    // use the OSC server if it's already up
+    ownServer = !isReceiving();
+    if (ownServer && !startReceiving()) {
       Logger::log(ERR, "Eos sync: Failed to bind port.");
       _running = true;
       return set<int>();
     }
 
-    std::thread rcvt(function<void()>([&rcv] { rcv.Run(); }));
-
     // feed it some stuff to clear
     _syncChan = set<int>();
     _syncReady = false;
@@ -265,20 +631,24 @@ set<int> OscPatch::getEosSelection()
       // track how long we're waiting and abort if wait too long
       timeoutCounter += 5;
       if (timeoutCounter > 5000) {
-        rcv.AsynchronousBreak();
-        rcvt.join();
+        if (ownServer)
+          stopReceiving();
         Logger::log(ERR, "Eos sync timeout. Operation cancelled. Some devices may have been synchronized before abort.");
         _running = true;
         return set<int>();
       }
     }
 
-    rcv.AsynchronousBreak();
-    rcvt.join();
+    if (ownServer)
+      stopReceiving();
+    _running = true;
     return _syncChan;
   }
   catch (exception &e) {
+    if (ownServer)
+      stopReceiving();
     Logger::log(ERR, "Error getting channel selection " + string(e.what()));
+    _running = true;
     return set<int>();
   }
 }
@@ -288,6 +658,14 @@ void OscPatch::ProcessMessage(const osc::ReceivedMessage & m, const IpEndpointNa
   try {
     // looking for particular things in _syncParams
     string pattern = string(m.AddressPattern());
+
+    // Eos echoes the command line after each command it processes
+    if (pattern == "/eos/out/cmd") {
+      size_t pending = _eosPending;
+      while (pending > 0 && !_eosPending.compare_exchange_weak(pending, pending - 1)) { }
+      _eosLastAck = chrono::steady_clock::now().time_since_epoch().count();
+    }
+
     if (!_syncReady && _syncParams.count(pattern) > 0) {
       // if we have what we're looking for
       if (pattern == "/eos/out/active/chan") {
@@ -348,117 +726,250 @@ void OscPatch::ProcessMessage(const osc::ReceivedMessage & m, const IpEndpointNa
       if (!_syncReady && _syncParams.size() == 0) {
         _syncReady = true;
       }
-    } 
+    }
+    else if (isCommand(pattern)) {
+      queueCommand(m);
+    }
   }
   catch (osc::Exception& e) {
     Logger::log(ERR, "Error parsing osc message: " + string(m.AddressPattern()));
   }
 }
 
-void OscPatch::deviceToOsc(osc::OutboundPacketStream & p, Device * d)
+void OscPatch::deviceToOsc(osc::OutboundPacketStream & p, Device * d, const string& address)
 {
-  if (_mode == PREFIXED_ADDR) {
-    p << osc::BeginMessage(string("/" + _pattern + "/" + d->getId()).c_str());
-  }
-  else if (_mode == PER_DEVICE_ADDR) {
-    p << osc::BeginMessage(string("/" + d->getId()).c_str());
-  }
+  p << osc::BeginMessage(address.c_str());
 
-  // convert params
-  for (auto dp : d->getRawParameters()) {
+  // convert params. Casts are cheaper than comparing type names for every parameter
+  for (auto& dp : d->getRawParameters()) {
     LumiverseType* param = dp.second;
-    string name = dp.first;
 
-    p << name.c_str();
-
-    if (param->getTypeName() == "float") {
+    if (LumiverseOrientation* o = dynamic_cast<LumiverseOrientation*>(param)) {
+      // orientations are basically floats but with an extra units value
+      p << dp.first.c_str() << "orientation";
+      p << (float)o->getVal();
+      p << o->getUnit();
+    }
+    else if (LumiverseFloat* f = dynamic_cast<LumiverseFloat*>(param)) {
       // floats returned as percentages
-      p << "float";
-      p << (float)((LumiverseFloat*)(param))->asPercent();
+      p << dp.first.c_str() << "float";
+      p << (float)f->asPercent();
     }
-    else if (param->getTypeName() == "color") {
+    else if (LumiverseColor* c = dynamic_cast<LumiverseColor*>(param)) {
       // colors are RGB
-      LumiverseColor* c = (LumiverseColor*)(param);
-      p << "color";
+      p << dp.first.c_str() << "color";
       auto rgb = c->getRGB();
       p << (float)rgb[0] << (float)rgb[1] << (float)rgb[2];
     }
-    else if (param->getTypeName() == "enum") {
+    else if (LumiverseEnum* e = dynamic_cast<LumiverseEnum*>(param)) {
       // enums will send their value as a percent and the name of the current setting
-      p << "enum";
-      LumiverseEnum* e = (LumiverseEnum*)(param);
+      p << dp.first.c_str() << "enum";
       p << (float)e->asPercent();
       p << e->getVal().c_str();
     }
-    else if (param->getTypeName() == "orientation") {
-      // orientations are basically floats but with an extra units value
-      p << "orientation";
-      LumiverseOrientation* o = (LumiverseOrientation*)(param);
-      p << (float)o->getVal();
-      p << o->getUnit();
+    else {
+      p << dp.first.c_str();
     }
   }
 
   p << osc::EndMessage;
 }
 
-void OscPatch::deviceToEos(Device * d)
+size_t OscPatch::encodeDevice(Device * d, const string& address)
 {
+  while (true) {
+    try {
+      osc::OutboundPacketStream p(_scratch.data(), _scratch.size());
+      deviceToOsc(p, d, address);
+      return p.Size();
+    }
+    catch (osc::OutOfBufferMemoryException&) {
+      _scratch.resize(_scratch.size() * 2);
+    }
+  }
+}
 
-  // select the proper channel and intensity at the same time
-  char buffer[128];
-  osc::OutboundPacketStream packet(buffer, 128);
-
-  int intens = (int)(d->getIntensity()->asPercent() * 100);
+void OscPatch::addToBundle(const char * data, size_t size)
+{
+  _messagesSent++;
 
-  stringstream ss;
-  ss << "/eos/newcmd/chan/" << d->getChannel() << "/at/";
-  
-  if (intens < 10) {
-    ss << "0";
+  // too big to share a packet, send it on its own
+  if (sizeof(bundleHeader) + 4 + size > _maxPacketSize) {
+    _t->Send(data, size);
+    _packetsSent++;
+    return;
   }
-  ss << intens << "/enter";
 
-  packet << osc::BeginMessage(ss.str().c_str()) << osc::EndMessage;
-  _t->Send(packet.Data(), packet.Size());
+  if (_bundle.size() + 4 + size > _maxPacketSize)
+    sendBundle();
+
+  if (_bundle.empty())
+    _bundle.assign(bundleHeader, bundleHeader + sizeof(bundleHeader));
+
+  // each element is prefixed with its big endian size
+  char prefix[4] = { (char)(size >> 24), (char)(size >> 16), (char)(size >> 8), (char)size };
+  _bundle.insert(_bundle.end(), prefix, prefix + 4);
+  _bundle.insert(_bundle.end(), data, data + size);
+}
 
-  // set the proper values
-  for (auto param : d->getRawParameters()) {
-    char pbuffer[256];
-    osc::OutboundPacketStream p(pbuffer, 256);
+void OscPatch::sendBundle()
+{
+  if (_bundle.empty())
+    return;
 
-    if (param.first == "color") {
-      // color maps to RGB color right now.
-      p << osc::BeginMessage("/eos/color/rgb");
+  _t->Send(_bundle.data(), _bundle.size());
+  _packetsSent++;
+  _bundle.clear();
+}
 
-      auto color = ((LumiverseColor*)(param.second))->getRGB();
-      p << (float)color[0] << (float)color[1] << (float)color[2];
+void OscPatch::updateEos(const set<Device*>& devices)
+{
+  _eosCommandsLastFrame = 0;
+
+  // Without a server nothing is acknowledged, so the window applies per update.
+  // A console that stops answering shouldn't stall output either.
+  auto now = chrono::steady_clock::now().time_since_epoch();
+  auto timeout = chrono::duration_cast<chrono::steady_clock::duration>(chrono::seconds(1));
+  if (!isReceiving() || now.count() - _eosLastAck > timeout.count())
+    _eosPending = 0;
+
+  // Find what changed, grouped by the new value
+  map<int, vector<int> > levels;
+  map<array<float, 3>, vector<int> > colors;
+  map<pair<float, float>, vector<int> > panTilts;
+
+  for (auto d : devices) {
+    int chan = d->getChannel();
+    EosChannel& last = _eosSent[chan];
+
+    LumiverseFloat* intensity = d->getParam<LumiverseFloat>("intensity");
+    if (intensity != nullptr) {
+      int intens = (int)(intensity->asPercent() * 100);
+      if (intens != last.intensity)
+        levels[intens].push_back(chan);
     }
-    else if (param.first == "pan") {
-      // specifically pull out pan in the pan/tilt pair
-      p << osc::BeginMessage("/eos/pantilt/xy");
-      
-      float pan = ((LumiverseOrientation*)(param.second))->asPercent();
-      float tilt = d->getParam<LumiverseOrientation>("tilt")->asPercent();
-
-      p << pan << tilt;
+
+    // color maps to RGB color right now.
+    LumiverseColor* color = d->getParam<LumiverseColor>("color");
+    if (color != nullptr) {
+      auto rgb = color->getRGB();
+      array<float, 3> c = { { roundf(rgb[0] * 1000) / 1000, roundf(rgb[1] * 1000) / 1000, roundf(rgb[2] * 1000) / 1000 } };
+      if (!last.hasColor || c != last.color)
+        colors[c].push_back(chan);
     }
-    else {
-      continue;
+
+    LumiverseOrientation* pan = d->getParam<LumiverseOrientation>("pan");
+    LumiverseOrientation* tilt = d->getParam<LumiverseOrientation>("tilt");
+    if (pan != nullptr && tilt != nullptr) {
+      pair<float, float> pt(roundf(pan->asPercent() * 1000) / 1000, roundf(tilt->asPercent() * 1000) / 1000);
+      if (!last.hasPanTilt || pt != last.panTilt)
+        panTilts[pt].push_back(chan);
     }
+  }
+
+  // Changes that don't fit in the window stay different from _eosSent and go out next time.
+  // Selecting channels at a level also sets the level, so intensities are one command per level.
+  for (auto& l : levels) {
+    if (!eosWindowHas(1))
+      return;
 
-    p << osc::EndMessage;
+    stringstream cmd;
+    cmd << eosSelection(l.second) << " At " << ((l.first < 10) ? "0" : "") << l.first;
+    sendEosCommand(cmd.str());
 
-    // clear the command line
-    //newEosCmd();
+    for (int chan : l.second)
+      _eosSent[chan].intensity = l.first;
+  }
 
-    // first resend the channel command
+  // Color and pan/tilt apply to the selected channels, so each group selects first
+  for (auto& c : colors) {
+    if (!eosWindowHas(1))
+      return;
 
-    // then send the paramer
-    _t->Send(p.Data(), p.Size());
+    sendEosCommand(eosSelection(c.second));
+
+    char buffer[128];
+    osc::OutboundPacketStream p(buffer, 128);
+    p << osc::BeginMessage("/eos/color/rgb") << c.first[0] << c.first[1] << c.first[2] << osc::EndMessage;
+    sendEos(p);
+
+    for (int chan : c.second) {
+      _eosSent[chan].hasColor = true;
+      _eosSent[chan].color = c.first;
+    }
+  }
+
+  for (auto& pt : panTilts) {
+    if (!eosWindowHas(1))
+      return;
+
+    sendEosCommand(eosSelection(pt.second));
+
+    char buffer[128];
+    osc::OutboundPacketStream p(buffer, 128);
+    p << osc::BeginMessage("/eos/pantilt/xy") << pt.first.first << pt.first.second << osc::EndMessage;
+    sendEos(p);
+
+    for (int chan : pt.second) {
+      _eosSent[chan].hasPanTilt = true;
+      _eosSent[chan].panTilt = pt.first;
+    }
   }
 }
 
+bool OscPatch::eosWindowHas(size_t commands)
+{
+  return _eosWindow == 0 || _eosPending + commands <= _eosWindow;
+}
+
+void OscPatch::sendEos(const osc::OutboundPacketStream& p)
+{
+  _t->Send(p.Data(), p.Size());
+  _packetsSent++;
+  _eosCommandsLastFrame++;
+  _eosCommandsSent++;
+}
+
+void OscPatch::sendEosCommand(const string& cmd)
+{
+  // # is Enter on the Eos command line
+  char buffer[512];
+  osc::OutboundPacketStream p(buffer, 512);
+  p << osc::BeginMessage("/eos/newcmd") << (cmd + "#").c_str() << osc::EndMessage;
+
+  // Only command lines are echoed, so only they wait for the console.
+  // The acknowledgement timeout runs from the first command that waits.
+  if (_eosPending++ == 0)
+    _eosLastAck = chrono::steady_clock::now().time_since_epoch().count();
+
+  sendEos(p);
+}
+
+string OscPatch::eosSelection(vector<int>& chans)
+{
+  sort(chans.begin(), chans.end());
+  chans.erase(unique(chans.begin(), chans.end()), chans.end());
+
+  // runs of consecutive channels become ranges
+  stringstream ss;
+  ss << "Chan";
+  for (size_t i = 0; i < chans.size();) {
+    size_t j = i;
+    while (j + 1 < chans.size() && chans[j + 1] == chans[j] + 1)
+      j++;
+
+    if (i > 0)
+      ss << " +";
+    ss << " " << chans[i];
+    if (j > i)
+      ss << " Thru " << chans[j];
+
+    i = j + 1;
+  }
+
+  return ss.str();
+}
+
 void OscPatch::newEosCmd()
 {
   char buffer[128];
@@ -498,6 +1009,42 @@ void OscPatch::loadJSON(JSONNode data)
     _inPort = inPort->as_float();
   else
     _inPort = 9000;
+
+  auto inAddress = data.find("inAddress");
+  if (inAddress != data.end())
+    _inAddress = inAddress->as_string();
+  else
+    _inAddress = "";
+
+  auto maxPacketSize = data.find("maxPacketSize");
+  if (maxPacketSize != data.end())
+    _maxPacketSize = maxPacketSize->as_int();
+  else
+    _maxPacketSize = DEFAULT_MAX_PACKET_SIZE;
+
+  auto sendRate = data.find("sendRate");
+  if (sendRate != data.end())
+    _sendRate = sendRate->as_float();
+  else
+    _sendRate = 0;
+
+  auto keepAlive = data.find("keepAliveInterval");
+  if (keepAlive != data.end())
+    _keepAlive = keepAlive->as_int();
+  else
+    _keepAlive = 1000;
+
+  auto receive = data.find("receive");
+  if (receive != data.end())
+    _receive = receive->as_bool();
+  else
+    _receive = false;
+
+  auto eosWindow = data.find("eosCommandWindow");
+  if (eosWindow != data.end())
+    _eosWindow = eosWindow->as_int();
+  else
+    _eosWindow = 64;
 }
 
 void Lumiverse::OscPatch::processSelection(string chans)
@@ -9,6 +9,14 @@
 #ifdef USE_OSC
 
 #include "Patch.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "lib/oscpack/osc/OscOutboundPacketStream.h"
 #include "lib/oscpack/osc/OscPacketListener.h"
 #include "lib/oscpack/osc/OscReceivedElements.h"
@@ -22,9 +30,64 @@ enum OscFormat {
   ETC_EOS = 2
 };
 
+class Rig;
+
+/*!
+\brief A control message received by an OscPatch, waiting to be applied to devices.
+\sa OscPatch::setReceive()
+*/
+struct OscCommand {
+  enum Type {
+    SELECT,       /*!< Replace the selection with ids */
+    SELECT_ADD,   /*!< Add ids to the selection */
+    SELECT_CLEAR, /*!< Empty the selection */
+    SET           /*!< Set param on the device in ids, or on the selection if ids is empty */
+  };
+
+  Type type;
+  vector<string> ids;
+  string param;
+
+  /*! \brief Numeric arguments of the message */
+  vector<float> values;
+
+  /*! \brief String argument of the message, used for enumerations */
+  string text;
+};
+
+/*!
+\brief Bounded queue passing commands from one producer thread to one consumer thread.
+
+Neither side takes a lock. push() fails when the queue is full.
+*/
+class OscCommandQueue {
+public:
+  /*! \param capacity Number of commands the queue holds. Rounded up to a power of 2. */
+  OscCommandQueue(size_t capacity = 4096);
+
+  /*! \brief Adds a command. Only call from the producer thread. */
+  bool push(OscCommand& cmd);
+
+  /*! \brief Removes the oldest command. Only call from the consumer thread. */
+  bool pop(OscCommand& cmd);
+
+private:
+  vector<OscCommand> m_slots;
+  size_t m_mask;
+
+  /*! \brief Next slot to read, written by the consumer */
+  atomic<size_t> m_head;
+
+  /*! \brief Next slot to write, written by the producer */
+  atomic<size_t> m_tail;
+};
+
 class OscPatch : public Patch, public osc::OscPacketListener {
 
 public:
+  /*! \brief Largest UDP payload that fits in an Ethernet frame without being fragmented. */
+  static const size_t DEFAULT_MAX_PACKET_SIZE = 1472;
+
   OscPatch(string address, int port, OscFormat mode = PREFIXED_ADDR, string pattern = "lumiverse");
   OscPatch(JSONNode data);
   ~OscPatch();
@@ -43,11 +106,157 @@ public:
 
   void changeAddress(string address, int port);
   void changeInPort(int port);
+
+  /*!
+  \brief Sets the local address the OSC server binds to.
+
+  Empty by default. An empty address binds to the patch address in ETC_EOS mode,
+  the same as sync() always has, and to any address in the other modes.
+  */
+  void changeInAddress(string address);
+  string getInAddress();
   string getAddress();
   int getPort();
   int getInPort();
   bool isRunning();
 
+  /*!
+  \brief Sets the largest packet the patch sends.
+
+  Device messages are packed into OSC bundles of up to this many bytes. A device whose
+  message doesn't fit in a bundle on its own is sent as a single message.
+  Defaults to DEFAULT_MAX_PACKET_SIZE.
+  */
+  void setMaxPacketSize(size_t bytes);
+
+  /*! \brief Returns the largest packet the patch sends, in bytes. */
+  size_t getMaxPacketSize();
+
+  /*!
+  \brief Limits how often the patch sends, independent of the Rig refresh rate.
+
+  Updates that arrive sooner than 1 / hz seconds after the last send are skipped.
+  Changes made in between go out with the next send.
+  \param hz Sends per second. 0 sends on every update.
+  */
+  void setSendRate(float hz);
+
+  /*! \brief Returns the send rate in sends per second, 0 if every update is sent. */
+  float getSendRate();
+
+  /*!
+  \brief Sets how often devices that haven't changed are sent again.
+
+  A device goes out when any of its parameters changed since it was last sent, or
+  when the keep-alive interval has passed. Defaults to 1000ms.
+  \param ms Keep-alive interval in milliseconds. 0 sends every device on every send.
+  */
+  void setKeepAliveInterval(unsigned int ms);
+
+  /*! \brief Returns the keep-alive interval in milliseconds. */
+  unsigned int getKeepAliveInterval();
+
+  /*! \brief Number of UDP packets sent. */
+  size_t getPacketsSent() { return _packetsSent; }
+
+  /*! \brief Number of device messages sent. */
+  size_t getMessagesSent() { return _messagesSent; }
+
+  /*! \brief Number of device messages skipped because nothing changed. */
+  size_t getMessagesSaved() { return _messagesSaved; }
+
+  /*! \brief Sets the packet and message counters back to 0. */
+  void resetPacketCounters();
+
+  /*!
+  \brief Runs an OSC server on the input port while the patch is running.
+
+  The server has its own thread. Messages addressed to /[pattern]/ are parsed into
+  OscCommands and queued for the update loop, which applies them at the next frame
+  with applyCommands(), or through a Programmer. Off by default.
+
+  Recognized messages:
+  - /[pattern]/select id... replaces the selection
+  - /[pattern]/select/add id... adds to the selection
+  - /[pattern]/select/clear empties the selection
+  - /[pattern]/[id]/[param] value... sets a parameter of one device
+  - /[pattern]/selected/[param] value... sets a parameter of the selected devices
+
+  In ETC_EOS mode, console replies under /eos/out/ are never taken as commands, even
+  if the pattern is "eos".
+
+  Floats take a value from 0 to 1 across their range, orientations take their value,
+  colors take r, g, b and an optional weight, and enums take a name and an optional tweak.
+  */
+  void setReceive(bool receive);
+
+  /*! \brief Returns true if the OSC server runs while the patch is running. */
+  bool getReceive();
+
+  /*! \brief Returns true if the OSC server is running. */
+  bool isReceiving();
+
+  /*!
+  \brief Removes the oldest received command from the queue.
+  \return false if there are no commands waiting
+  */
+  bool popCommand(OscCommand& cmd);
+
+  /*!
+  \brief Applies every waiting command to a set of devices.
+
+  Call this from the thread that updates the devices, for example from a Rig update
+  function. Only one thread should consume commands.
+  \param devices Devices by id
+  \return Ids of the devices that were changed
+  */
+  set<string> applyCommands(const map<string, Device*>& devices);
+
+  /*! \brief Applies every waiting command to the devices of a Rig. */
+  set<string> applyCommands(Rig* rig);
+
+  /*! \brief Ids of the devices selected through OSC. */
+  const set<string>& getSelection() { return _selection; }
+
+  /*! \brief Number of commands received. */
+  size_t getCommandsReceived() { return _commandsReceived; }
+
+  /*! \brief Number of commands dropped because the queue was full. */
+  size_t getCommandsDropped() { return _commandsDropped; }
+
+  /*!
+  \brief Limits the Eos commands waiting for the console.
+
+  In ETC_EOS mode, only changes are sent, and channels going to the same level are
+  grouped into one command such as "Chan 1 Thru 40 At 50 Enter". Each command line
+  update Eos echoes back acknowledges a command. Messages that don't change the
+  command line, such as colors, aren't echoed and don't count. Once this many
+  commands are unacknowledged, the remaining changes wait for the next update. Without a running
+  OSC server nothing is acknowledged, so the window limits the commands per update.
+  If the console stops answering for a second the window is opened again.
+  Defaults to 64.
+  \param commands Window size. 0 sends every change on every update.
+  */
+  void setEosCommandWindow(size_t commands);
+
+  /*! \brief Returns the Eos command window. */
+  size_t getEosCommandWindow();
+
+  /*! \brief Number of Eos commands the console hasn't acknowledged yet. */
+  size_t getEosCommandsPending() { return _eosPending; }
+
+  /*! \brief Number of Eos commands sent by the last update. */
+  size_t getEosCommandsLastFrame() { return _eosCommandsLastFrame; }
+
+  /*! \brief Number of Eos commands sent. */
+  size_t getEosCommandsSent() { return _eosCommandsSent; }
+
+  /*!
+  \brief Applies a SET command to a single device.
+  \return false if the device doesn't have the parameter or the arguments don't fit its type
+  */
+  static bool applyCommand(const OscCommand& cmd, Device* d);
+
   /*!
   \brief Only active in ETC_EOS mode. Synchronizes device values with what's in EOS
   \return true on success, false on failure
@@ -79,22 +288,131 @@ private:
   string _address;
   int _port;
   int _inPort;
+  string _inAddress;
   bool _running;
 
   UdpTransmitSocket* _t;
 
+  bool _receive;
+  UdpListeningReceiveSocket* _rcv;
+  thread _rcvThread;
+
+  /*! \brief Address prefix of control messages, set when the server starts */
+  string _rcvPrefix;
+
+  OscCommandQueue _commands;
+  atomic<size_t> _commandsReceived;
+  atomic<size_t> _commandsDropped;
+
+  /*! \brief Devices selected through OSC. Only used by the consumer thread. */
+  set<string> _selection;
+
+  /*! \brief Returns true if a received message is a command for this patch. */
+  bool isCommand(const string& pattern);
+
+  /*! \brief Starts the OSC server on the input port. */
+  bool startReceiving();
+
+  /*! \brief Stops the OSC server. */
+  void stopReceiving();
+
+  /*! \brief Parses a control message and queues it */
+  void queueCommand(const osc::ReceivedMessage& m);
+
+  /*! \brief Applies waiting commands, finding devices with the given function */
+  set<string> applyCommands(function<Device*(const string&)> find);
+
+  /*! \brief Cached address and last sent message of a device */
+  struct DeviceCache {
+    string address;
+    vector<char> message;
+  };
+
+  /*! \brief Devices sent in PREFIXED_ADDR or PER_DEVICE_ADDR mode, by id */
+  unordered_map<string, DeviceCache> _cache;
+
+  /*! \brief Mode and pattern the cached addresses were built with */
+  OscFormat _cacheMode;
+  string _cachePattern;
+
+  /*! \brief Buffer device messages are encoded in. Grows to fit the largest message. */
+  vector<char> _scratch;
+
+  /*! \brief Bundle being filled */
+  vector<char> _bundle;
+
+  size_t _maxPacketSize;
+  float _sendRate;
+  unsigned int _keepAlive;
+  chrono::steady_clock::time_point _lastSend;
+  chrono::steady_clock::time_point _lastKeepAlive;
+
+  size_t _packetsSent;
+  size_t _messagesSent;
+  size_t _messagesSaved;
+
   /*!
   \brief Converts a device to OSC and places the conversion in the outbound packet stream
   */
-  void deviceToOsc(osc::OutboundPacketStream& p, Device* d);
+  void deviceToOsc(osc::OutboundPacketStream& p, Device* d, const string& address);
 
   /*!
-  \brief Outputs a series of ETC Eos commands to update the state
+  \brief Encodes the message of a device into _scratch
+  \return Size of the message in bytes
+  */
+  size_t encodeDevice(Device* d, const string& address);
+
+  /*!
+  \brief Adds a message to the current bundle, sending the bundle first if the message doesn't fit
+  */
+  void addToBundle(const char* data, size_t size);
+
+  /*!
+  \brief Sends the current bundle, if it has any messages
+  */
+  void sendBundle();
+
+  /*! \brief Values last sent to an Eos channel */
+  struct EosChannel {
+    EosChannel() : intensity(-1), hasColor(false), hasPanTilt(false) { }
+
+    int intensity;
+    bool hasColor;
+    array<float, 3> color;
+    bool hasPanTilt;
+    pair<float, float> panTilt;
+  };
+
+  /*! \brief Eos state by channel */
+  map<int, EosChannel> _eosSent;
+
+  size_t _eosWindow;
+  atomic<size_t> _eosPending;
+  atomic<chrono::steady_clock::rep> _eosLastAck;
+  size_t _eosCommandsLastFrame;
+  size_t _eosCommandsSent;
+
+  /*!
+  \brief Outputs the ETC Eos commands needed to bring the console to the state of the devices
 
   Note that this function operates on specified device paramter names. If the paramter names don't match,
   nothing will be transmitted.
   */
-  void deviceToEos(Device* d);
+  void updateEos(const set<Device*>& devices);
+
+  /*! \brief Returns true if the Eos command window has room for a number of commands */
+  bool eosWindowHas(size_t commands);
+
+  /*! \brief Sends a message to Eos and counts it as a command */
+  void sendEos(const osc::OutboundPacketStream& p);
+
+  /*! \brief Sends a new command line to Eos, followed by Enter, and counts it as unacknowledged */
+  void sendEosCommand(const string& cmd);
+
+  /*!
+  \brief Formats a set of channels as an Eos selection, such as "Chan 1 Thru 40 + 45"
+  */
+  static string eosSelection(vector<int>& chans);
 
   /*!
   \brief Resets the Eos command line
@@ -0,0 +1,193 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace Lumiverse {
+
+const size_t Profiler::BUSY;
+const size_t Profiler::EMPTY;
+
+Profiler::Profiler(size_t capacity) :
+  m_enabled(false), m_next(0), m_first(0), m_dropped(0), m_frame(0)
+{
+  if (capacity == 0)
+    capacity = 1;
+
+  m_capacity = capacity;
+  m_slots.reset(new Slot[capacity]);
+  for (size_t i = 0; i < capacity; i++) {
+    m_slots[i].seq.store(EMPTY, memory_order_relaxed);
+  }
+
+  m_epoch = clock::now();
+}
+
+int Profiler::getSectionId(const string& name) {
+  lock_guard<mutex> lock(m_sectionMutex);
+
+  auto it = m_sectionIds.find(name);
+  if (it != m_sectionIds.end())
+    return it->second;
+
+  int id = (int)m_sectionNames.size();
+  m_sectionNames.push_back(name);
+  m_sectionIds[name] = id;
+  return id;
+}
+
+vector<string> Profiler::getSectionNames() {
+  lock_guard<mutex> lock(m_sectionMutex);
+  return m_sectionNames;
+}
+
+void Profiler::record(int section, clock::time_point start, clock::time_point end) {
+  if (!isEnabled())
+    return;
+
+  size_t index = m_next.fetch_add(1, memory_order_relaxed);
+  Slot& s = m_slots[index % m_capacity];
+
+  // Claim the slot. Writers never wait: if another writer that lapped the buffer is
+  // still in this slot, the sample is dropped.
+  size_t seq = s.seq.load(memory_order_relaxed);
+  if (seq == BUSY || !s.seq.compare_exchange_strong(seq, BUSY, memory_order_acquire)) {
+    m_dropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  atomic_thread_fence(memory_order_release);
+
+  s.section.store(section, memory_order_relaxed);
+  s.thread.store(threadIndex(), memory_order_relaxed);
+  s.frame.store(m_frame.load(memory_order_relaxed), memory_order_relaxed);
+  s.start.store(chrono::duration_cast<chrono::nanoseconds>(start - m_epoch).count(), memory_order_relaxed);
+  s.duration.store(chrono::duration_cast<chrono::nanoseconds>(end - start).count(), memory_order_relaxed);
+
+  // Publish
+  s.seq.store(index, memory_order_release);
+}
+
+ProfileStats Profiler::getStats(const string& section) {
+  ProfileStats stats;
+
+  int id;
+  {
+    lock_guard<mutex> lock(m_sectionMutex);
+    auto it = m_sectionIds.find(section);
+    if (it == m_sectionIds.end())
+      return stats;
+    id = it->second;
+  }
+
+  vector<double> times;
+  for (const auto& s : getSamples()) {
+    if (s.section == id)
+      times.push_back(s.duration / 1e6);
+  }
+
+  if (times.empty())
+    return stats;
+
+  sort(times.begin(), times.end());
+
+  double total = 0;
+  for (double t : times)
+    total += t;
+
+  stats.count = times.size();
+  stats.min = times.front();
+  stats.max = times.back();
+  stats.avg = total / times.size();
+  stats.p99 = times[min(times.size() - 1, (size_t)(0.99 * times.size()))];
+
+  return stats;
+}
+
+void Profiler::clear() {
+  // Slots keep their sequence numbers, so samples are skipped instead of erased
+  m_first.store(m_next.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+JSONNode Profiler::toChromeTrace() {
+  vector<string> names = getSectionNames();
+
+  JSONNode events;
+  events.set_name("traceEvents");
+  events.cast(JSON_ARRAY);
+
+  for (const auto& s : getSamples()) {
+    JSONNode e;
+    e.push_back(JSONNode("name", (s.section >= 0 && s.section < (int)names.size()) ? names[s.section] : "unknown"));
+    e.push_back(JSONNode("cat", "Lumiverse"));
+    e.push_back(JSONNode("ph", "X"));
+    // Trace event times are in microseconds
+    e.push_back(JSONNode("ts", s.start / 1e3));
+    e.push_back(JSONNode("dur", s.duration / 1e3));
+    e.push_back(JSONNode("pid", 1));
+    e.push_back(JSONNode("tid", s.thread));
+
+    JSONNode args;
+    args.set_name("args");
+    args.push_back(JSONNode("frame", (double)s.frame));
+    e.push_back(args);
+
+    events.push_back(e);
+  }
+
+  JSONNode root;
+  root.push_back(events);
+  root.push_back(JSONNode("displayTimeUnit", "ms"));
+
+  return root;
+}
+
+bool Profiler::saveChromeTrace(string filename) {
+  ofstream traceFile;
+  traceFile.open(filename, ios::out | ios::trunc);
+
+  if (!traceFile.is_open()) {
+    Logger::log(ERR, "Unable to open trace file " + filename);
+    return false;
+  }
+
+  traceFile << toChromeTrace().write();
+  return true;
+}
+
+vector<Profiler::Sample> Profiler::getSamples() {
+  size_t written = m_next.load(memory_order_relaxed);
+  size_t first = max(m_first.load(memory_order_relaxed), (written > m_capacity) ? written - m_capacity : 0);
+
+  vector<Profiler::Sample> samples;
+  samples.reserve(written - min(first, written));
+
+  // Oldest first
+  for (size_t i = first; i < written; i++) {
+    const Slot& s = m_slots[i % m_capacity];
+
+    // Skips slots that are being written or already hold a newer sample
+    if (s.seq.load(memory_order_acquire) != i)
+      continue;
+
+    Sample sample;
+    sample.section = s.section.load(memory_order_relaxed);
+    sample.thread = s.thread.load(memory_order_relaxed);
+    sample.frame = s.frame.load(memory_order_relaxed);
+    sample.start = s.start.load(memory_order_relaxed);
+    sample.duration = s.duration.load(memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_acquire);
+    if (s.seq.load(memory_order_relaxed) != i)
+      continue;
+
+    samples.push_back(sample);
+  }
+
+  return samples;
+}
+
+unsigned int Profiler::threadIndex() {
+  return (unsigned int)hash<thread::id>()(this_thread::get_id());
+}
+
+}
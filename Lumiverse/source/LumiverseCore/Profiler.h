@@ -0,0 +1,199 @@
+/*! \file Profiler.h
+* \brief Lightweight timing instrumentation for the Rig update loop.
+*/
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+
+#include "Logger.h"
+#include "lib/libjson/libjson.h"
+
+using namespace std;
+
+namespace Lumiverse {
+  /*! \brief Timing statistics for a profiled section. All times are in milliseconds. */
+  struct ProfileStats {
+    ProfileStats() : count(0), min(0), avg(0), p99(0), max(0) { }
+
+    size_t count;   /*!< Number of samples the statistics were computed from. */
+    double min;     /*!< Shortest sample */
+    double avg;     /*!< Mean of all samples */
+    double p99;     /*!< 99th percentile sample */
+    double max;     /*!< Longest sample */
+  };
+
+  /*!
+  \brief Records how long named sections of the update pipeline take.
+
+  Samples go into a fixed size ring buffer, so the statistics and traces cover the most
+  recent frames only. Recording is lock-free and does nothing but an atomic load while
+  the profiler is disabled, which is the default.
+
+  Sections are identified by an integer id obtained once from getSectionId(), so the hot
+  path never touches strings. Each slot of the buffer is published with its own sequence
+  number, so statistics and traces can be read while the Rig is running. Slots that are
+  being written when they're read are left out.
+  \sa ProfileScope, Rig::getProfiler()
+  */
+  class Profiler
+  {
+  public:
+    typedef chrono::high_resolution_clock clock;
+
+    /*!
+    \brief Creates a profiler.
+    \param capacity Number of samples kept in the ring buffer.
+    */
+    Profiler(size_t capacity = 16384);
+
+    /*! \brief Turns recording on or off. */
+    void setEnabled(bool enabled) { m_enabled.store(enabled, memory_order_relaxed); }
+
+    /*! \brief Returns true if samples are being recorded. */
+    bool isEnabled() const { return m_enabled.load(memory_order_relaxed); }
+
+    /*!
+    \brief Returns the id for a section name, creating it if needed.
+
+    This locks, so call it once and hold onto the id rather than calling it every frame.
+    */
+    int getSectionId(const string& name);
+
+    /*! \brief Returns the names of every section known to the profiler. */
+    vector<string> getSectionNames();
+
+    /*! \brief Adds a sample for a section. */
+    void record(int section, clock::time_point start, clock::time_point end);
+
+    /*! \brief Marks the start of a new Rig frame. Frame numbers are attached to samples. */
+    void nextFrame() { m_frame.fetch_add(1, memory_order_relaxed); }
+
+    /*! \brief Computes statistics for a section over the samples currently buffered. */
+    ProfileStats getStats(const string& section);
+
+    /*! \brief Discards all recorded samples. */
+    void clear();
+
+    /*!
+    \brief Returns the number of samples dropped because their slot was still being written.
+
+    Only happens when writers lap the whole buffer while a write is in progress.
+    */
+    size_t getDropped() const { return m_dropped.load(memory_order_relaxed); }
+
+    /*!
+    \brief Converts the buffered samples to the Chrome trace event format.
+
+    The result can be loaded in chrome://tracing or any other viewer that understands
+    the format.
+    */
+    JSONNode toChromeTrace();
+
+    /*!
+    \brief Writes the output of toChromeTrace() to a file.
+    \return False if the file could not be opened.
+    */
+    bool saveChromeTrace(string filename);
+
+  private:
+    /*! \brief A single timed section. Times are in nanoseconds since m_epoch. */
+    struct Sample {
+      int section;
+      unsigned int thread;
+      unsigned long long frame;
+      long long start;
+      long long duration;
+    };
+
+    /*!
+    \brief A ring buffer slot.
+
+    seq is the index of the sample the slot holds, or BUSY while it's written. Readers
+    check it before and after reading the fields and discard the copy if it changed.
+    */
+    struct Slot {
+      atomic<size_t> seq;
+      atomic<int> section;
+      atomic<unsigned int> thread;
+      atomic<unsigned long long> frame;
+      atomic<long long> start;
+      atomic<long long> duration;
+    };
+
+    /*! \brief Slot sequence number while a sample is being written. */
+    static const size_t BUSY = (size_t)-1;
+
+    /*! \brief Slot sequence number of a slot that was never written. */
+    static const size_t EMPTY = (size_t)-2;
+
+    /*! \brief Copies the valid part of the ring buffer. */
+    vector<Sample> getSamples();
+
+    /*! \brief Identifies the calling thread. Used as the trace tid. */
+    static unsigned int threadIndex();
+
+    atomic<bool> m_enabled;
+
+    /*! \brief Ring buffer of samples. */
+    unique_ptr<Slot[]> m_slots;
+
+    /*! \brief Number of slots in m_slots. */
+    size_t m_capacity;
+
+    /*! \brief Total number of samples ever written. The next slot is m_next % m_capacity. */
+    atomic<size_t> m_next;
+
+    /*! \brief Index of the first sample since the last clear(). */
+    atomic<size_t> m_first;
+
+    atomic<size_t> m_dropped;
+
+    atomic<unsigned long long> m_frame;
+
+    /*! \brief Time that sample timestamps are relative to. */
+    clock::time_point m_epoch;
+
+    /*! \brief Section name -> id, and id -> name. Only touched when registering sections. */
+    mutex m_sectionMutex;
+    unordered_map<string, int> m_sectionIds;
+    vector<string> m_sectionNames;
+  };
+
+  /*!
+  \brief Times the enclosing scope and records it to a Profiler on exit.
+
+  If the profiler is disabled when the scope starts, nothing is recorded.
+  */
+  class ProfileScope
+  {
+  public:
+    ProfileScope(Profiler& profiler, int section) :
+      m_profiler(profiler.isEnabled() ? &profiler : nullptr), m_section(section)
+    {
+      if (m_profiler != nullptr)
+        m_start = Profiler::clock::now();
+    }
+
+    ~ProfileScope() {
+      if (m_profiler != nullptr)
+        m_profiler->record(m_section, m_start, Profiler::clock::now());
+    }
+
+  private:
+    Profiler* m_profiler;
+    int m_section;
+    Profiler::clock::time_point m_start;
+  };
+}
+
+#endif
@@ -8,12 +8,18 @@ Rig::Rig() {
   m_running = false;
   setRefreshRate(40);
   m_updateLoop = nullptr;
+  m_deviceVersion = 0;
+  m_clock = make_shared<SystemClock>();
+  m_frameSection = m_profiler.getSectionId("Rig::frame");
 }
 
 Rig::Rig(string filename) {
   m_running = false;
   setRefreshRate(40);
   m_updateLoop = nullptr;
+  m_deviceVersion = 0;
+  m_clock = make_shared<SystemClock>();
+  m_frameSection = m_profiler.getSectionId("Rig::frame");
 
   if (!load(filename)) {
     Logger::log(WARN, "Proceeding with default rig initialization");
@@ -248,9 +254,12 @@ void Rig::reset() {
 
   m_devices.clear();
   m_patches.clear();
+  m_patchSections.clear();
   m_devicesById.clear();
   m_devicesByChannel.clear();
+  m_deviceVersion++;
   m_updateFunctions.clear();
+  m_functionSections.clear();
 }
 
 Rig::~Rig() {
@@ -324,7 +333,7 @@ bool Rig::load(string filename) {
     // This could get to be a large function, so let's break off into a helper.
     loadJSON(n);
 
-    delete memblock;
+    delete[] memblock;
     return true;
   }
   else {
@@ -354,6 +363,7 @@ void Rig::addDevice(Device* device) {
   m_devices.insert(device);
   m_devicesById[device->getId()] = device;
   m_devicesByChannel.insert(make_pair(device->getChannel(), device));
+  m_deviceVersion++;
 }
 
 Device* Rig::getDevice(string id) {
@@ -394,6 +404,7 @@ void Rig::deleteDevice(string id) {
   // Delete the memory used by the device using the id->device map
   delete m_devicesById[id];
   m_devicesById.erase(id);
+  m_deviceVersion++;
 }
 
 void Rig::addPatch(string id, Patch* patch) {
@@ -407,6 +418,7 @@ void Rig::addPatch(string id, Patch* patch) {
     return;
 
   m_patches[id] = patch;
+  getPatchSection(id);
 }
 
 Patch* Rig::getPatch(string id) {
@@ -425,6 +437,16 @@ void Rig::deletePatch(string id) {
   // Free up space and erase the patch from the map
   delete m_patches[id];
   m_patches.erase(id);
+  m_patchSections.erase(id);
+}
+
+void Rig::setClock(shared_ptr<Clock> clock) {
+  if (m_running) {
+    Logger::log(ERR, "Can't change the clock while the Rig is running.");
+    return;
+  }
+
+  m_clock = (clock == nullptr) ? make_shared<SystemClock>() : clock;
 }
 
 void Rig::setRefreshRate(unsigned int rate) {
@@ -456,6 +478,11 @@ void Rig::update() {
 }
 
 void Rig::updateOnce() {
+  if (m_profiler.isEnabled()) {
+    updateOnceProfiled();
+    return;
+  }
+
   // Run additional functions before sending to patches
   // These functions can be update functions you run in your own code
   // or other things that need to be in sync with stuff going over the network.
@@ -469,11 +496,44 @@ void Rig::updateOnce() {
   }
 }
 
-void Rig::setAllDevices(map<string, Device*> devices) {
+void Rig::updateOnceProfiled() {
+  m_profiler.nextFrame();
+  ProfileScope frame(m_profiler, m_frameSection);
+
+  for (auto& f : m_updateFunctions) {
+    ProfileScope scope(m_profiler, getFunctionSection(f.first));
+    f.second();
+  }
+
+  for (auto& p : m_patches) {
+    ProfileScope scope(m_profiler, getPatchSection(p.first));
+    p.second->update(m_devices);
+  }
+}
+
+int Rig::getFunctionSection(int pid) {
+  auto it = m_functionSections.find(pid);
+  if (it != m_functionSections.end())
+    return it->second;
+
+  stringstream section;
+  section << "Function " << pid;
+  return m_functionSections[pid] = m_profiler.getSectionId(section.str());
+}
+
+int Rig::getPatchSection(const string& id) {
+  auto it = m_patchSections.find(id);
+  if (it != m_patchSections.end())
+    return it->second;
+
+  return m_patchSections[id] = m_profiler.getSectionId("Patch " + id);
+}
+
+void Rig::setAllDevices(const map<string, Device*>& devices) {
   for (auto& kvp : devices) {
     try {
       auto d = m_devicesById.at(kvp.first);
-      auto params = kvp.second->getRawParameters();
+      auto& params = kvp.second->getRawParameters();
       for (auto& param : params) {
         // We want to copy instead of assign since we don't know where that LumiverseType data
         // is going to end up. Maybe it'd be better if devices did a copy instead...
@@ -604,6 +664,8 @@ bool Rig::addFunction(int pid, function<void()> func) {
     m_updateFunctions[pid] = func;
     success = true;
 
+    getFunctionSection(pid);
+
     stringstream ss;
     ss << "Adding additional function to update loop with pid " << pid;
     Logger::log(INFO, ss.str());
@@ -631,6 +693,7 @@ bool Rig::removeFunction(int pid) {
 
   if (m_updateFunctions.count(pid) > 0) {
     m_updateFunctions.erase(pid);
+    m_functionSections.erase(pid);
 
     stringstream ss;
     ss << "Removed additional function from update loop with pid " << pid;
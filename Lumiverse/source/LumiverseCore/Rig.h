@@ -20,6 +20,8 @@
 #include "DMX/DMXPatch.h"
 #include "Device.h"
 #include "Logger.h"
+#include "Profiler.h"
+#include "Clock.h"
 #include "DeviceSet.h"
 #include "lib/libjson/libjson.h"
 
@@ -381,13 +383,20 @@ namespace Lumiverse {
     * This function will only update parameters not metadata
     * \param devices Map of device id -> Device* containing the data to update the rig with.
     */
-    void setAllDevices(map<string, Device*> devices);
+    void setAllDevices(const map<string, Device*>& devices);
 
     /*!
     \brief Returns the number of devices in the Rig.
     */
     size_t getNumDevices() { return m_devices.size(); }
 
+    /*!
+    \brief Incremented whenever a device is added to or removed from the Rig.
+
+    Lets code that holds on to device or parameter pointers know when to look them up again.
+    */
+    unsigned int getDeviceVersion() { return m_deviceVersion; }
+
     /*!
     \brief Resets all devices in the rig to defaults.
     */
@@ -398,6 +407,63 @@ namespace Lumiverse {
     */
     bool isSlow() { return m_slow; }
 
+    /*!
+    \brief Returns the Rig's profiler.
+
+    Other parts of the update pipeline, such as Playback, record their timings here
+    so a whole frame can be viewed together.
+    */
+    Profiler& getProfiler() { return m_profiler; }
+
+    /*!
+    \brief Returns the clock that Playback and Layers read the time from.
+
+    A SystemClock unless another clock was given to setClock().
+    */
+    Clock& getClock() { return *m_clock; }
+
+    /*!
+    \brief Returns the Rig's clock for objects that need to keep a reference to it.
+    */
+    shared_ptr<Clock> getSharedClock() { return m_clock; }
+
+    /*!
+    \brief Replaces the Rig's clock.
+
+    Can't be changed while the Rig is running. Note that the update loop started by run()
+    always paces itself in real time, so a SteppingClock should be driven by calling
+    updateOnce() instead.
+    \param clock New clock. nullptr goes back to a SystemClock.
+    \sa SteppingClock
+    */
+    void setClock(shared_ptr<Clock> clock);
+
+    /*! \brief Returns true if the update loop started by run() is running. */
+    bool isRunning() { return m_running; }
+
+    /*!
+    \brief Turns per-frame timing of the update loop on or off.
+
+    Off by default. When on, the Rig records how long each frame, update function and
+    patch takes.
+    */
+    void setProfilingEnabled(bool enabled) { m_profiler.setEnabled(enabled); }
+
+    /*!
+    \brief Returns rolling timing statistics for a profiled section.
+
+    The Rig records "Rig::frame", "Function <pid>" for each function added with
+    addFunction() and "Patch <id>" for each patch.
+    \param section Name of the section
+    */
+    ProfileStats getProfileStats(string section) { return m_profiler.getStats(section); }
+
+    /*!
+    \brief Saves the recorded timings as a Chrome trace event file.
+    \return False if the file couldn't be written.
+    */
+    bool saveProfileTrace(string filename) { return m_profiler.saveChromeTrace(filename); }
+
     /*!
     \brief Returns a set containing all of the unique values for a metadata key.
     \param key Metadata key to get values for
@@ -419,6 +485,11 @@ namespace Lumiverse {
     */
     void loadDevices(JSONNode root);
 
+    /*!
+    \brief Same as updateOnce(), but records timings for each step to the profiler.
+    */
+    void updateOnceProfiled();
+
     /*!
     * \brief Load patches in the JSON file.
     * \param root JSONNode containing the Patches in the Rig.
@@ -481,6 +552,12 @@ namespace Lumiverse {
     /*! \brief Devices mapped by channel number. */
     multimap<unsigned int, Device *> m_devicesByChannel;
 
+    /*! \brief Incremented whenever m_devices changes. */
+    unsigned int m_deviceVersion;
+
+    /*! \brief Time source for everything driven by the Rig. */
+    shared_ptr<Clock> m_clock;
+
     /*!
     * \brief List of functions to run at the end of the update loop
     *
@@ -503,6 +580,24 @@ namespace Lumiverse {
     */
     bool m_slow;
 
+    /*! \brief Timing instrumentation for the update loop. */
+    Profiler m_profiler;
+
+    /*!
+    \brief Profiler section ids for the whole frame, update functions, and patches.
+
+    Function and patch sections are registered when they're added to the Rig.
+    */
+    int m_frameSection;
+    map<int, int> m_functionSections;
+    map<string, int> m_patchSections;
+
+    /*! \brief Returns the profiler section of an update function, registering it if needed. */
+    int getFunctionSection(int pid);
+
+    /*! \brief Returns the profiler section of a patch, registering it if needed. */
+    int getPatchSection(const string& id);
+
     // May have more indicies in the future, like mapping by channel number.
   };
 }
@@ -402,8 +402,7 @@ void ArnoldAnimationPatch::createFrameInfoBody(set<Device *> devices, FrameDevic
 		if (forceUpdate || (m_lights.count(d->getMetadata("Arnold Node Name")) > 0 &&
 			m_lights[d->getMetadata("Arnold Node Name")]->rerender_req)) {
 			// Makes copy of this device
-			Device *d_copy = new Device(*d);
-			frame.devices.insert(d_copy);
+			frame.devices.insert(snapshotDevice(d));
 		}
 	}
 }
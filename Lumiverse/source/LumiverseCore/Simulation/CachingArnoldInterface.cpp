@@ -244,15 +244,18 @@ namespace Lumiverse {
 			if (!force_cache_reload && (cached_devices.count(device_name) > 0)) {
 				Device *cached = cached_devices.at(device_name);
 				if (!isValidCacheCopy(cached, device)) {
-          if (cached_devices[device_name] != nullptr)
-            delete cached_devices[device_name];
+					// Only the parameters that changed are copied, the rest are shared with the old copy
+					cached_devices[device_name] = new Device(device, cached);
+					delete cached;
 
-					cached_devices[device_name] = new Device(device);
 					to_update[device_name] = device;
 				}
 			}
 			else {
-				cached_devices[device_name] = new Device(device);
+				Device *old = (cached_devices.count(device_name) > 0) ? cached_devices[device_name] : nullptr;
+				cached_devices[device_name] = new Device(device, old);
+				delete old;
+
 				to_update[device_name] = device;
 			}
 		}
@@ -526,11 +529,11 @@ namespace Lumiverse {
           load_exr(d->getFocusPalette(id)->_image);
         }
 
-        cached_devices[d->getId()] = new Device(d);
+        cached_devices[d->getId()] = new Device(d, nullptr);
       }
       else {
         if (load_exr(d->getMetadata("Arnold Node Name")) == 0) {
-          cached_devices[d->getId()] = new Device(d);
+          cached_devices[d->getId()] = new Device(d, nullptr);
         }
       }
     }
@@ -114,6 +114,12 @@ void Compositor::render(const std::set<Device*> &devices) {
   // clear previous rendering
   std::memset((void *)compose_buffer, 0, sizeof(Pixel4) * w * h);
 
+  // Find the layers that contribute this frame and batch convert their colors.
+  vector<EXRLayer*> activeLayers;
+  vector<float> intensities;
+  vector<LumiverseColor*> colors;
+  vector<int> colorIndex;
+
   for (Device *device : devices) {
 	  std::string name = device->getMetadata("Arnold Node Name");
 
@@ -134,10 +140,31 @@ void Compositor::render(const std::set<Device*> &devices) {
     if (intensity_shift == 0)
       continue;
 
+    activeLayers.push_back(layer);
+    intensities.push_back(intensity_shift);
+
+    if (device->getColor() != nullptr) {
+      colorIndex.push_back((int)colors.size());
+      colors.push_back(device->getColor());
+    }
+    else {
+      colorIndex.push_back(-1);
+    }
+  }
+
+  vector<double> rgb(colors.size() * 3);
+  LumiverseColor::getRGB(colors, rgb.data());
+
+  for (size_t l = 0; l < activeLayers.size(); l++) {
+    EXRLayer *layer = activeLayers[l];
+    float intensity_shift = intensities[l];
+
     Eigen::Vector3d modulator(1, 1, 1);
-    
-    if (device->getColor() != nullptr)
-	    modulator = device->getColor()->getRGB();
+
+    if (colorIndex[l] >= 0) {
+      int c = colorIndex[l] * 3;
+      modulator = Eigen::Vector3d(rgb[c], rgb[c + 1], rgb[c + 2]);
+    }
 
 	  float r = modulator.x() * intensity_shift * _exposure;
 	  float g = modulator.y() * intensity_shift * _exposure;
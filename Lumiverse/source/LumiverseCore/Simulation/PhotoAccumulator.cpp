@@ -0,0 +1,156 @@
+#include "PhotoAccumulator.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define PHOTO_ACCUMULATOR_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PHOTO_ACCUMULATOR_SSE
+#endif
+
+// GCC and Clang can compile a single function for AVX2 and FMA. The rest of the file
+// keeps the baseline instruction set, so the library still runs on older processors.
+#if !defined(__AVX2__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PHOTO_ACCUMULATOR_AVX2_DISPATCH
+#endif
+
+namespace Lumiverse {
+
+const size_t PhotoAccumulator::DEFAULT_TILE_SIZE;
+
+#ifdef PHOTO_ACCUMULATOR_AVX2_DISPATCH
+namespace {
+  bool hasAVX2() {
+    static const bool supported = (__builtin_cpu_init(),
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+    return supported;
+  }
+
+  __attribute__((target("avx2,fma")))
+  void accumulateTileAVX2(float* dst, size_t offset, size_t count, const PhotoAccumulator::Light* lights,
+    size_t numLights) {
+    memset(dst, 0, count * sizeof(float));
+
+    for (size_t l = 0; l < numLights; l++) {
+      const float* src = lights[l].photo + offset;
+      const float* s = lights[l].scale;
+      size_t i = 0;
+
+      __m256 scale = _mm256_setr_ps(s[0], s[1], s[2], s[3], s[0], s[1], s[2], s[3]);
+      for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_fmadd_ps(_mm256_loadu_ps(src + i), scale, _mm256_loadu_ps(dst + i));
+        __m256 b = _mm256_fmadd_ps(_mm256_loadu_ps(src + i + 8), scale, _mm256_loadu_ps(dst + i + 8));
+        _mm256_storeu_ps(dst + i, a);
+        _mm256_storeu_ps(dst + i + 8, b);
+      }
+
+      for (; i < count; i++)
+        dst[i] += src[i] * s[i & 3];
+    }
+  }
+}
+#endif
+
+PhotoAccumulator::PhotoAccumulator(shared_ptr<ThreadPool> pool) :
+  m_pool(pool), m_tileSize(DEFAULT_TILE_SIZE) {
+}
+
+bool PhotoAccumulator::accumulate(float* out, size_t numPixels, const vector<Light>& lights,
+  const function<bool()>& interrupted) {
+  size_t tileFloats = m_tileSize * 4;
+  size_t numFloats = numPixels * 4;
+  size_t numTiles = (numFloats + tileFloats - 1) / tileFloats;
+
+  // Once one tile sees the interrupt, the rest are skipped
+  atomic<bool> stop(false);
+
+  auto tile = [&](size_t tile) {
+    if (stop.load(memory_order_relaxed))
+      return;
+
+    if (interrupted && interrupted()) {
+      stop = true;
+      return;
+    }
+
+    size_t offset = tile * tileFloats;
+    accumulateTile(out, offset, min(tileFloats, numFloats - offset), lights);
+  };
+
+  if (m_pool != nullptr) {
+    m_pool->parallelFor(numTiles, tile);
+  }
+  else {
+    for (size_t i = 0; i < numTiles; i++)
+      tile(i);
+  }
+
+  return !stop;
+}
+
+void PhotoAccumulator::accumulateTile(float* out, size_t offset, size_t count, const vector<Light>& lights) {
+  float* dst = out + offset;
+
+#ifdef PHOTO_ACCUMULATOR_AVX2_DISPATCH
+  if (hasAVX2()) {
+    accumulateTileAVX2(dst, offset, count, lights.data(), lights.size());
+    return;
+  }
+#endif
+
+  memset(dst, 0, count * sizeof(float));
+
+  // offset is a whole number of pixels, so index i of the tile is channel i % 4
+  for (const Light& light : lights) {
+    const float* src = light.photo + offset;
+    const float* s = light.scale;
+    size_t i = 0;
+
+#if defined(PHOTO_ACCUMULATOR_AVX)
+    __m256 scale = _mm256_setr_ps(s[0], s[1], s[2], s[3], s[0], s[1], s[2], s[3]);
+    for (; i + 16 <= count; i += 16) {
+#ifdef __FMA__
+      __m256 a = _mm256_fmadd_ps(_mm256_loadu_ps(src + i), scale, _mm256_loadu_ps(dst + i));
+      __m256 b = _mm256_fmadd_ps(_mm256_loadu_ps(src + i + 8), scale, _mm256_loadu_ps(dst + i + 8));
+#else
+      __m256 a = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), _mm256_loadu_ps(dst + i));
+      __m256 b = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), _mm256_loadu_ps(dst + i + 8));
+#endif
+      _mm256_storeu_ps(dst + i, a);
+      _mm256_storeu_ps(dst + i + 8, b);
+    }
+#elif defined(PHOTO_ACCUMULATOR_SSE)
+    __m128 scale = _mm_setr_ps(s[0], s[1], s[2], s[3]);
+    for (; i + 8 <= count; i += 8) {
+      __m128 a = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), _mm_loadu_ps(dst + i));
+      __m128 b = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), _mm_loadu_ps(dst + i + 4));
+      _mm_storeu_ps(dst + i, a);
+      _mm_storeu_ps(dst + i + 4, b);
+    }
+#endif
+
+    for (; i < count; i++)
+      dst[i] += src[i] * s[i & 3];
+  }
+}
+
+const char* PhotoAccumulator::getInstructionSet() {
+#ifdef PHOTO_ACCUMULATOR_AVX2_DISPATCH
+  if (hasAVX2())
+    return "avx2";
+#endif
+
+#if defined(PHOTO_ACCUMULATOR_AVX)
+  return "avx";
+#elif defined(PHOTO_ACCUMULATOR_SSE)
+  return "sse";
+#else
+  return "scalar";
+#endif
+}
+
+}
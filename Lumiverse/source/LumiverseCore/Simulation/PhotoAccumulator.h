@@ -0,0 +1,94 @@
+/*! \file PhotoAccumulator.h
+* \brief Sums weighted light photos into an image.
+*/
+#ifndef _PHOTOACCUMULATOR_H_
+#define _PHOTOACCUMULATOR_H_
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "../ThreadPool.h"
+
+using namespace std;
+
+namespace Lumiverse {
+  /*!
+  \brief Composites RGBA float photos of individual lights into one image.
+
+  Each pixel of the result is the sum of the same pixel in every light's photo,
+  scaled per channel. The image is split into tiles that fit in cache, and tiles
+  are processed in parallel on a ThreadPool. Within a tile every light is added in
+  one pass, so the result is written once per frame instead of once per light, and
+  each photo is read once.
+
+  The inner loop uses AVX (with FMA when available) or SSE, whichever the library
+  was compiled for, and plain C++ otherwise. With GCC and Clang on x86, an AVX2 and
+  FMA version of the loop is also built and used when the processor supports it.
+  \sa PhotoPatch
+  */
+  class PhotoAccumulator
+  {
+  public:
+    /*! \brief A light to add to the image. */
+    struct Light {
+      /*! \brief RGBA photo, 4 floats per pixel. */
+      const float* photo;
+
+      /*! \brief Factor for each of the R, G, B and A channels. */
+      float scale[4];
+    };
+
+    /*! \brief Default tile size in pixels. 2048 pixels take 32KB. */
+    static const size_t DEFAULT_TILE_SIZE = 2048;
+
+    /*!
+    \brief Creates an accumulator.
+    \param pool Pool the tiles run on. It can be shared with other accumulators, for
+    example ThreadPool::getShared(). Without a pool, tiles run on the calling thread.
+    */
+    PhotoAccumulator(shared_ptr<ThreadPool> pool = nullptr);
+
+    /*! \brief Sets the pool the tiles run on. nullptr runs them on the calling thread. */
+    void setThreadPool(shared_ptr<ThreadPool> pool) { m_pool = pool; }
+
+    /*! \brief Returns the pool the tiles run on. */
+    const shared_ptr<ThreadPool>& getThreadPool() { return m_pool; }
+
+    /*!
+    \brief Sets the number of pixels in a tile.
+
+    Tiles should be small enough that the part of the result being written
+    stays in cache while every light is added to it.
+    */
+    void setTileSize(size_t pixels) { m_tileSize = (pixels == 0) ? 1 : pixels; }
+
+    /*! \brief Returns the number of pixels in a tile. */
+    size_t getTileSize() { return m_tileSize; }
+
+    /*!
+    \brief Sets out to the sum of the lights.
+    \param out Result, 4 floats per pixel.
+    \param numPixels Number of pixels in out and in every photo.
+    \param lights Lights to add.
+    \param interrupted Called before each tile. Once it returns true no more tiles are
+    started and out is left partially written. May be called from any thread.
+    \return false if interrupted.
+    */
+    bool accumulate(float* out, size_t numPixels, const vector<Light>& lights,
+      const function<bool()>& interrupted = nullptr);
+
+    /*! \brief Returns the instruction set the inner loop runs with: "avx2", "avx", "sse" or "scalar". */
+    static const char* getInstructionSet();
+
+  private:
+    /*! \brief Sets count floats of out, starting at offset, to the sum of the lights. */
+    static void accumulateTile(float* out, size_t offset, size_t count, const vector<Light>& lights);
+
+    shared_ptr<ThreadPool> m_pool;
+    size_t m_tileSize;
+  };
+}
+
+#endif
@@ -68,8 +68,7 @@ void PhotoAnimationPatch::createFrameInfoBody(set<Device *> devices, FrameDevice
 		if (forceUpdate || (m_lights.count(d->getId()) > 0 &&
 			m_lights[d->getId()]->rerender_req)) {
 			// Makes copy of this device
-			Device *d_copy = new Device(*d);
-			frame.devices.insert(d_copy);
+			frame.devices.insert(snapshotDevice(d));
 		}
 	}
 }
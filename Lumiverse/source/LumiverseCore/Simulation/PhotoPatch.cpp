@@ -9,7 +9,7 @@
 namespace Lumiverse {
 
 PhotoPatch::PhotoPatch(const JSONNode data) :
-m_blend(NULL), m_blend_buffer(NULL) {
+m_blend(NULL), m_blend_buffer(NULL), m_accumulator(ThreadPool::getShared()) {
 	m_interrupt_flag.test_and_set();
 	loadJSON(data);
 }
@@ -118,47 +118,36 @@ PhotoPatch::~PhotoPatch() {
 }
     
 void PhotoPatch::updateLight(set<Device *> devices) {
+	// Colors are collected and converted in one batch after the loop.
+	vector<LumiverseColor*> colors;
+	vector<PhotoLightRecord*> colorLights;
+
 	for (Device* d : devices) {
 		std::string name = d->getId();
 		if (m_lights.count(name) == 0)
 			continue;
 
-		PhotoLightRecord *light = (PhotoLightRecord *)m_lights[d->getId()];
+		PhotoLightRecord *light = (PhotoLightRecord *)m_lights[name];
 		if (light->photo == NULL)
 			loadLight(d);
 
 		LumiverseColor *color = d->getColor();
 		if (color != NULL) {
-			light->color[0] = (float)color->getRGB()[0];
-			light->color[1] = (float)color->getRGB()[1];
-			light->color[2] = (float)color->getRGB()[2];
+			colors.push_back(color);
+			colorLights.push_back(light);
 		}
 		if (!d->getParam("intensity", light->intensity))
 			light->intensity = 0;
 	}
-}
 
-bool PhotoPatch::blendFloat(float* blended, float* light, 
-	float intensity, Eigen::Vector3f color) {
-	Eigen::Vector4f rgba(color[0], color[1], color[2], 1.f);
+	vector<double> rgb(colors.size() * 3);
+	LumiverseColor::getRGB(colors, rgb.data());
 
-	// Assume they are of size (m_width, m_height)
-	for (int i = 0; i < m_height; i++) {
-		for (int j = 0; j < m_width; j++) {
-			for (size_t ch = 0; ch < 4; ch++) {
-				size_t offset = (m_width * i + j) * 4 + ch;
-				size_t offset_des = (m_width * (m_height - 1 - i) + j) * 4 + ch;
-				if (ch < 3)
-					blended[offset] += light[offset] * rgba[ch] * intensity;
-				else
-					blended[offset] += light[offset] * rgba[ch];
-			}
-		}
-		if (!m_interrupt_flag.test_and_set())
-			return false;
+	for (size_t i = 0; i < colorLights.size(); i++) {
+		colorLights[i]->color[0] = (float)rgb[i * 3];
+		colorLights[i]->color[1] = (float)rgb[i * 3 + 1];
+		colorLights[i]->color[2] = (float)rgb[i * 3 + 2];
 	}
-
-	return true;
 }
 
 bool PhotoPatch::blendUint8(float* blended, unsigned char* light, 
@@ -192,36 +181,37 @@ void PhotoPatch::bindRenderLoop() {
 }
 
 bool PhotoPatch::renderLoop() {
-	// Set to zeros.
-	bool toclear = true;
 	size_t img_size = (size_t)(m_height * m_width * 4);
-	bool success = true;
 
 	m_interrupt_flag.test_and_set();
 
-	// Blend one by one
+	// Collect the lights that contribute
+	vector<PhotoAccumulator::Light> lights;
 	for (auto record : m_lights) {
 		PhotoLightRecord *light = (PhotoLightRecord *)record.second;
 
-		if (toclear) {
-			toclear = false;
-			std::memset(m_blend_buffer, 0, img_size * sizeof(float));
-		}
-		
 		if (light->photo && light->intensity > 0 &&
-			!light->color.isZero())
-			success = blendFloat(m_blend_buffer, light->photo, light->intensity, light->color);
+			!light->color.isZero()) {
+			PhotoAccumulator::Light l = { light->photo, {
+				light->color[0] * light->intensity,
+				light->color[1] * light->intensity,
+				light->color[2] * light->intensity,
+				1.f } };
+			lights.push_back(l);
+		}
 		else if (!light->photo) {
 			std::stringstream sstm;
 			sstm << "Empty file: " << light->metadata.c_str();
 
 			Logger::log(WARN, sstm.str());
 		}
-
-		if (!success)
-			break;
 	}
 
+	// Blend all lights at once, a tile at a time. The interrupt flag is checked
+	// before each tile, and the first tile to find it cleared stops the others.
+	bool success = m_accumulator.accumulate(m_blend_buffer, (size_t)(m_height * m_width), lights,
+		[this]() { return !m_interrupt_flag.test_and_set(); });
+
 	if (success)
 		std::memcpy(m_blend, m_blend_buffer, img_size * sizeof(float));
 
@@ -17,6 +17,7 @@
 
 #include "../Patch.h"
 #include "SimulationPatch.h"
+#include "PhotoAccumulator.h"
 #include "../lib/libjson/libjson.h"
 
 namespace Lumiverse {
@@ -57,7 +58,7 @@ namespace Lumiverse {
     /*!
     * \brief Constructs a PhotoPatch object.
     */
-	PhotoPatch() : m_blend(NULL), m_blend_buffer(NULL),
+	PhotoPatch() : m_blend(NULL), m_blend_buffer(NULL), m_accumulator(ThreadPool::getShared()),
 				SimulationPatch() { }
 
     /*!
@@ -157,10 +158,13 @@ namespace Lumiverse {
 
 	bool blendUint8(float* blended, unsigned char* light, float intensity, Eigen::Vector3f color);
 
-	bool blendFloat(float* blended, float* light, float intensity, Eigen::Vector3f color);
-
 	float *m_blend_buffer;
 
+	/*!
+	* \brief Sums the lights into m_blend_buffer, in tiles on the shared ThreadPool.
+	*/
+	PhotoAccumulator m_accumulator;
+
   };
 }
 
@@ -27,6 +27,10 @@ SimulationAnimationPatch::~SimulationAnimationPatch() {
   // If close() hasn't been called, closes here.
   if (m_worker != NULL)
     close();
+
+  for (auto& d : m_lastFrameDevices) {
+    delete d.second;
+  }
 }
 
 void SimulationAnimationPatch::loadJSON(const JSONNode data) {
@@ -103,6 +107,16 @@ void SimulationAnimationPatch::enqueueFrameInfo(const FrameDeviceInfo &frame) {
 	m_queue.unlock();
 }
 
+Device *SimulationAnimationPatch::snapshotDevice(Device *d) {
+	Device *&last = m_lastFrameDevices[d->getId()];
+	Device *current = new Device(d, last);
+
+	delete last;
+	last = current;
+
+	return new Device(current, current);
+}
+
 void SimulationAnimationPatch::createFrameInfoHeader(FrameDeviceInfo &frame) {
 	chrono::time_point<chrono::system_clock> current = chrono::system_clock::now();
 
@@ -54,12 +54,12 @@ namespace Lumiverse {
 		  devices.clear();
       }
       
-	  /*! \brief Deep copy. */
+	  /*! \brief Copies the frame. Device copies share parameter data with other. */
       void copyByValue(const FrameDeviceInfo &other) {
           time = other.time;
           mode = other.mode;
           for (Device *d : other.devices) {
-              devices.insert(new Device(d));
+              devices.insert(new Device(d, d));
           }
       }
   };
@@ -254,6 +254,15 @@ namespace Lumiverse {
 
 	virtual void enqueueFrameInfo(const FrameDeviceInfo &frame);
 
+	/*!
+	* \brief Makes the device copy stored in a queued frame.
+	*
+	* The copy is a copy-on-write snapshot that shares unchanged parameters with the
+	* copy made for the previous frame, so long RECORDING sessions only store the
+	* parameters that actually change between frames.
+	*/
+	Device *snapshotDevice(Device *d);
+
     // The worker thread.
     std::thread *m_worker;
 
@@ -281,6 +290,10 @@ namespace Lumiverse {
 	/*! \brief The list for callback functions.
 	*/
     map<int, FinishedCallbackFunction> m_onFinishedFunctions;
+
+    /*! \brief Most recent snapshot of each device. Base for the next frame's copies.
+    */
+    map<string, Device *> m_lastFrameDevices;
   };
     
 }
@@ -0,0 +1,98 @@
+#include "ThreadPool.h"
+
+namespace Lumiverse {
+
+ThreadPool::ThreadPool(int numThreads) : m_job(nullptr), m_count(0), m_next(0),
+  m_generation(0), m_working(0), m_shutdown(false)
+{
+  if (numThreads < 0)
+    numThreads = max(0, (int)thread::hardware_concurrency() - 1);
+
+  for (int i = 0; i < numThreads; i++) {
+    m_threads.push_back(thread(&ThreadPool::workerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_shutdown = true;
+  }
+  m_start.notify_all();
+
+  for (auto& t : m_threads) {
+    t.join();
+  }
+}
+
+shared_ptr<ThreadPool> ThreadPool::getShared() {
+  static shared_ptr<ThreadPool> pool = make_shared<ThreadPool>(-1);
+  return pool;
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& f) {
+  if (count == 0)
+    return;
+
+  // Nested or concurrent calls run serially rather than waiting on the workers.
+  unique_lock<mutex> call(m_callMutex, try_to_lock);
+  if (m_threads.empty() || count == 1 || !call.owns_lock()) {
+    for (size_t i = 0; i < count; i++) {
+      f(i);
+    }
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_job = &f;
+    m_count = count;
+    m_next.store(0);
+    m_working = m_threads.size();
+    m_generation++;
+  }
+  m_start.notify_all();
+
+  runJob(f, count);
+
+  unique_lock<mutex> lock(m_mutex);
+  m_finished.wait(lock, [this] { return m_working == 0; });
+  m_job = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+  unsigned long generation = 0;
+
+  while (true) {
+    const function<void(size_t)>* job;
+    size_t count;
+
+    {
+      unique_lock<mutex> lock(m_mutex);
+      m_start.wait(lock, [&] { return m_shutdown || m_generation != generation; });
+
+      if (m_shutdown)
+        return;
+
+      generation = m_generation;
+      job = m_job;
+      count = m_count;
+    }
+
+    runJob(*job, count);
+
+    {
+      lock_guard<mutex> lock(m_mutex);
+      if (--m_working == 0)
+        m_finished.notify_all();
+    }
+  }
+}
+
+void ThreadPool::runJob(const function<void(size_t)>& f, size_t count) {
+  for (size_t i = m_next.fetch_add(1); i < count; i = m_next.fetch_add(1)) {
+    f(i);
+  }
+}
+
+}
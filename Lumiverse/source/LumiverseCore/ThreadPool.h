@@ -0,0 +1,95 @@
+/*! \file ThreadPool.h
+* \brief Fixed set of worker threads for splitting per-frame work.
+*/
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace Lumiverse {
+  /*!
+  \brief Runs loops across a fixed set of worker threads.
+
+  The pool is built for the update loop: one parallelFor() at a time, called once or
+  twice a frame, with the calling thread doing work alongside the workers. Workers
+  sleep between calls.
+
+  Calls made while another parallelFor() is running, including calls from inside a
+  loop body, run serially on the calling thread instead of waiting.
+  */
+  class ThreadPool
+  {
+  public:
+    /*!
+    \brief Starts the worker threads.
+    \param numThreads Number of workers. The default of 0 runs everything on the
+    calling thread. With -1, one less than the number of hardware threads is used,
+    since the calling thread also does work.
+    */
+    ThreadPool(int numThreads = 0);
+
+    /*! \brief Stops and joins the worker threads. */
+    ~ThreadPool();
+
+    /*!
+    \brief Calls f(i) for every i in [0, count) and returns when all calls are done.
+
+    Calls may run in any order and on any thread. f must be safe to call concurrently
+    for different indices.
+    */
+    void parallelFor(size_t count, const function<void(size_t)>& f);
+
+    /*! \brief Number of worker threads, not counting the calling thread. */
+    size_t getNumThreads() { return m_threads.size(); }
+
+    /*!
+    \brief Returns a pool shared by the whole process, created on first use.
+
+    It has one worker less than the number of hardware threads. Use it for work that
+    would otherwise start a pool per object, so the process doesn't end up with more
+    threads than cores.
+    */
+    static shared_ptr<ThreadPool> getShared();
+
+  private:
+    vector<thread> m_threads;
+
+    /*! \brief Held for the duration of a parallelFor(). */
+    mutex m_callMutex;
+
+    /*! \brief Protects everything below. */
+    mutex m_mutex;
+    condition_variable m_start;
+    condition_variable m_finished;
+
+    const function<void(size_t)>* m_job;
+    size_t m_count;
+    atomic<size_t> m_next;
+
+    /*! \brief Incremented for every parallelFor() so workers can tell a new job started. */
+    unsigned long m_generation;
+
+    /*! \brief Number of workers that haven't finished the current job. */
+    size_t m_working;
+
+    bool m_shutdown;
+
+    void workerLoop();
+
+    /*! \brief Takes indices from the current job until there are none left. */
+    void runJob(const function<void(size_t)>& f, size_t count);
+  };
+}
+
+#endif
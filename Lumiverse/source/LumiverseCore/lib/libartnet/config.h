@@ -0,0 +1,2 @@
+/* Define to 1 if you have the <endian.h> header file. */
+#define HAVE_ENDIAN_H
@@ -241,6 +241,39 @@ namespace Lumiverse {
     return ColorUtils::convXYZtoRGB(Eigen::Vector3d(getX(), getY(), getZ()), cs);
   }
 
+  void LumiverseColor::getRGB(const vector<LumiverseColor*>& colors, double* rgb, RGBColorSpace cs) {
+    // Gather XYZ values for everything that needs converting, then convert in one pass.
+    vector<double> xyz;
+    vector<size_t> converted;
+    xyz.reserve(colors.size() * 3);
+    converted.reserve(colors.size());
+
+    for (size_t i = 0; i < colors.size(); i++) {
+      LumiverseColor* c = colors[i];
+
+      if (c->m_mode == BASIC_RGB) {
+        rgb[i * 3] = c->m_deviceChannels["Red"];
+        rgb[i * 3 + 1] = c->m_deviceChannels["Green"];
+        rgb[i * 3 + 2] = c->m_deviceChannels["Blue"];
+        continue;
+      }
+
+      xyz.push_back(c->getX());
+      xyz.push_back(c->getY());
+      xyz.push_back(c->getZ());
+      converted.push_back(i);
+    }
+
+    ColorUtils::convXYZtoRGB(xyz.data(), xyz.data(), converted.size(), cs);
+
+    for (size_t j = 0; j < converted.size(); j++) {
+      size_t i = converted[j];
+      rgb[i * 3] = xyz[j * 3];
+      rgb[i * 3 + 1] = xyz[j * 3 + 1];
+      rgb[i * 3 + 2] = xyz[j * 3 + 2];
+    }
+  }
+
   void LumiverseColor::setxy(double x, double y, double weight) {
     if (m_mode == BASIC_RGB) {
       Logger::log(ERR, "Function setxy() not supported in BASIC_RGB mode. Use setRGB().");
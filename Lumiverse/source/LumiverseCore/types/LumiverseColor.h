@@ -203,6 +203,16 @@ namespace Lumiverse {
     */
     Eigen::Vector3d getRGB(RGBColorSpace cs = sRGB);
 
+    /*! \brief Gets the RGB colors of many colors at once.
+    *
+    * Equivalent to calling getRGB() on each color, but the color space conversion
+    * runs as a single batch. Intended for patches that need every device's color each frame.
+    * \param colors Colors to convert. Must not contain null pointers.
+    * \param rgb Output buffer of at least 3 * colors.size() doubles, filled with packed RGB triplets.
+    * \param cs Color space to use for the conversion
+    */
+    static void getRGB(const vector<LumiverseColor*>& colors, double* rgb, RGBColorSpace cs = sRGB);
+
 
     /*!
     * \brief Sets the color to match the specified xy coordinate (xyY color space)
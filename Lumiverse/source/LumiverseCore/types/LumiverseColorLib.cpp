@@ -105,11 +105,7 @@ Eigen::Vector3d getScaledColor(string gel, float intens) {
 Eigen::Vector3d convXYZtoRGB(Eigen::Vector3d color, RGBColorSpace cs) {
   // Vector is scaled by 1/100 bringing it inline withthe [0,1] range typically used by RGB.
   color /= 100;
-#ifdef USE_C11_MAPS
-  Eigen::Vector3d rgb = RGBToXYZ[cs].inverse() * color;
-#else
-  Eigen::Vector3d rgb = RGBToXYZ(cs).inverse() * color;
-#endif
+  Eigen::Vector3d rgb = getXYZToRGB(cs) * color;
 
   if (cs == sRGB) {
     rgb[0] = XYZtosRGBCompand(rgb[0]);
@@ -141,13 +137,8 @@ Eigen::Vector3d convRGBtoXYZ(double r, double g, double b, RGBColorSpace cs)
     b = ColorUtils::sRGBtoXYZCompand(b);
   }
 
-#ifdef USE_C11_MAPS
-  Eigen::Matrix3d M = RGBToXYZ[cs];
-#else
-  Eigen::Matrix3d M = RGBToXYZ(cs);
-#endif
   Eigen::Vector3d rgb(r, g, b);
-  Eigen::Vector3d XYZ = M * rgb;
+  Eigen::Vector3d XYZ = getRGBToXYZ(cs) * rgb;
 
   return XYZ;
 }
@@ -280,5 +271,133 @@ double getTotalTrans(string gel) {
   return trans;
 }
 
+const Eigen::Matrix3d& getRGBToXYZ(RGBColorSpace cs) {
+#ifdef USE_C11_MAPS
+  return RGBToXYZ[cs];
+#else
+  static Eigen::Matrix3d M[] = { RGBToXYZ(sRGB), RGBToXYZ(sharpRGB) };
+  return M[cs];
+#endif
+}
+
+const Eigen::Matrix3d& getXYZToRGB(RGBColorSpace cs) {
+  // Function statics are initialized once, and thread-safely, in C++11.
+  static const Eigen::Matrix3d M[] = { getRGBToXYZ(sRGB).inverse(), getRGBToXYZ(sharpRGB).inverse() };
+  return M[cs];
+}
+
+// Triplet buffers are mapped as 3xN column-major matrices so the matrix
+// products and companding run through Eigen's vectorized expression templates.
+typedef Eigen::Map<Eigen::Matrix<double, 3, Eigen::Dynamic> > TripletMap;
+typedef Eigen::Map<const Eigen::Matrix<double, 3, Eigen::Dynamic> > ConstTripletMap;
+
+void convXYZtoRGB(const double* xyz, double* rgb, size_t n, RGBColorSpace cs) {
+  if (n == 0)
+    return;
+
+  TripletMap out(rgb, 3, n);
+  // Fold the 1/100 scale into the matrix instead of scaling every input.
+  out = (getXYZToRGB(cs) / 100.0) * ConstTripletMap(xyz, 3, n);
+
+  if (cs == sRGB)
+    XYZtosRGBCompand(rgb, n * 3);
+
+  out = out.cwiseMax(0.0);
+}
+
+void convRGBtoXYZ(const double* rgb, double* xyz, size_t n, RGBColorSpace cs) {
+  if (n == 0)
+    return;
+
+  TripletMap out(xyz, 3, n);
+  out = ConstTripletMap(rgb, 3, n).cwiseMax(0.0).cwiseMin(1.0);
+
+  if (cs == sRGB)
+    sRGBtoXYZCompand(xyz, n * 3);
+
+  out = getRGBToXYZ(cs) * out;
+}
+
+void convXYZtoxyY(const double* xyz, double* xyY, size_t n) {
+  for (size_t i = 0; i < n * 3; i += 3) {
+    double X = xyz[i], Y = xyz[i + 1], Z = xyz[i + 2];
+    double denom = X + Y + Z;
+
+    if (X == 0 && Y == 0 && Z == 0) {
+      xyY[i] = xyY[i + 1] = xyY[i + 2] = 0;
+      continue;
+    }
+
+    xyY[i] = X / denom;
+    xyY[i + 1] = Y / denom;
+    xyY[i + 2] = Y;
+  }
+}
+
+void convXYZtoLab(const double* xyz, double* lab, size_t n, Eigen::Vector3d rw) {
+  double invX = 1 / rw[0], invY = 1 / rw[1], invZ = 1 / rw[2];
+
+  for (size_t i = 0; i < n * 3; i += 3) {
+    double fx = labf(xyz[i] * invX);
+    double fy = labf(xyz[i + 1] * invY);
+    double fz = labf(xyz[i + 2] * invZ);
+
+    lab[i] = 116 * fy - 16;
+    lab[i + 1] = 500 * (fx - fy);
+    lab[i + 2] = 200 * (fy - fz);
+  }
+}
+
+void convLabtoLCHab(const double* lab, double* lch, size_t n) {
+  for (size_t i = 0; i < n * 3; i += 3) {
+    double a = lab[i + 1], b = lab[i + 2];
+    double H = atan2(b, a) * (180 / M_PI);
+
+    if (H < 0) H += 360;
+    if (H >= 360) H -= 360;
+
+    lch[i] = lab[i];
+    lch[i + 1] = sqrt(a * a + b * b);
+    lch[i + 2] = H;
+  }
+}
+
+void convRGBtoHSV(const double* rgb, double* hsv, size_t n) {
+  for (size_t i = 0; i < n * 3; i += 3) {
+    double R = rgb[i], G = rgb[i + 1], B = rgb[i + 2];
+    double M = max(R, max(G, B));
+    double m = min(R, min(G, B));
+    double C = M - m;
+    double Hp = 0;
+
+    if (C == 0)
+      Hp = 0;
+    else if (M == R)
+      Hp = fmod(((G - B) / C), 6);
+    else if (M == G)
+      Hp = (B - R) / C + 2;
+    else
+      Hp = (R - G) / C + 4;
+
+    double H = 60 * Hp;
+    if (H < 0)
+      H += 360;
+
+    hsv[i] = H;
+    hsv[i + 1] = (M != 0) ? C / M : 0;
+    hsv[i + 2] = M;
+  }
+}
+
+void sRGBtoXYZCompand(double* vals, size_t n) {
+  Eigen::Map<Eigen::ArrayXd> v(vals, n);
+  v = (v > 0.04045).select(((v + 0.055) / 1.055).pow(2.4), v / 12.92);
+}
+
+void XYZtosRGBCompand(double* vals, size_t n) {
+  Eigen::Map<Eigen::ArrayXd> v(vals, n);
+  v = (v > 0.0031308).select(1.055 * v.pow(1 / 2.4) - 0.055, v * 12.92);
+}
+
+}
 }
-}
\ No newline at end of file
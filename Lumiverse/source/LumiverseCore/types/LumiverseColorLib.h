@@ -16,6 +16,7 @@
 #endif
 
 #include <unordered_map>
+#include <vector>
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -380,6 +381,59 @@ namespace Lumiverse {
     \brief Gets the total transparency of a gel or multiple gels.
     */
     double getTotalTrans(string gel);
+
+    /*!
+    \brief Returns the RGB to XYZ matrix for the given color space.
+    */
+    const Eigen::Matrix3d& getRGBToXYZ(RGBColorSpace cs);
+
+    /*!
+    \brief Returns the XYZ to RGB matrix for the given color space.
+
+    The inverse is computed once per color space and cached, so this is cheap to call
+    from per-frame code.
+    */
+    const Eigen::Matrix3d& getXYZToRGB(RGBColorSpace cs);
+
+    // Batch conversion kernels.
+    // All of the following operate on contiguous buffers of n packed triplets
+    // (x0, y0, z0, x1, y1, z1, ...). Input and output may be the same buffer.
+
+    /*!
+    \brief Converts n XYZ colors to RGB. Batch version of convXYZtoRGB(Eigen::Vector3d, RGBColorSpace).
+    */
+    void convXYZtoRGB(const double* xyz, double* rgb, size_t n, RGBColorSpace cs = sRGB);
+
+    /*!
+    \brief Converts n RGB colors to XYZ. Batch version of convRGBtoXYZ(Eigen::Vector3d, RGBColorSpace).
+    */
+    void convRGBtoXYZ(const double* rgb, double* xyz, size_t n, RGBColorSpace cs = sRGB);
+
+    /*!
+    \brief Converts n XYZ colors to xyY.
+    */
+    void convXYZtoxyY(const double* xyz, double* xyY, size_t n);
+
+    /*!
+    \brief Converts n XYZ colors to Lab using the given reference white.
+    */
+    void convXYZtoLab(const double* xyz, double* lab, size_t n, Eigen::Vector3d rw);
+
+    /*!
+    \brief Converts n Lab colors to LCHab. Hue is returned in degrees [0, 360).
+    */
+    void convLabtoLCHab(const double* lab, double* lch, size_t n);
+
+    /*!
+    \brief Converts n RGB colors to HSV. Hue is returned in degrees [0, 360).
+    */
+    void convRGBtoHSV(const double* rgb, double* hsv, size_t n);
+
+    /*! \brief Applies sRGBtoXYZCompand to n values in place. */
+    void sRGBtoXYZCompand(double* vals, size_t n);
+
+    /*! \brief Applies XYZtosRGBCompand to n values in place. */
+    void XYZtosRGBCompand(double* vals, size_t n);
   }
 }
 
@@ -146,6 +146,10 @@ float CueList::getNextCueNum(float num) {
   }
 
   current++;
+  if (current == _cues.end()) {
+    return -1;
+  }
+
   return current->first;
 }
 
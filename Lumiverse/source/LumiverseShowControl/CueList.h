@@ -75,7 +75,7 @@ public:
   string getNextCue(float num);
 
   // Same as getNextCue but returns the cue number.
-  // If the given cue number isn't in the list, returns -1
+  // If the given cue number isn't in the list or is the last cue, returns -1
   float getNextCueNum(float num);
 
   /*!
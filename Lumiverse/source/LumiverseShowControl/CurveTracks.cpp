@@ -0,0 +1,429 @@
+#include "CurveTracks.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Lumiverse {
+namespace ShowControl {
+
+BakedCurves::BakedCurves(const vector<KeyframeTrack>& tracks, unsigned int version) : m_version(version) {
+  m_scalarFirst.push_back(0);
+  m_colorFirst.push_back(0);
+  m_colorValueFirst.push_back(0);
+  m_enumFirst.push_back(0);
+
+  m_type.reserve(tracks.size());
+  m_curve.reserve(tracks.size());
+
+  for (const auto& track : tracks) {
+    CurveType type = bake(track);
+    m_type.push_back(type);
+
+    switch (type) {
+    case FLOAT:
+    case ORIENTATION:
+      m_curve.push_back((int)m_scalarFirst.size() - 2);
+      break;
+    case COLOR:
+      m_curve.push_back((int)m_colorFirst.size() - 2);
+      break;
+    case ENUM:
+      m_curve.push_back((int)m_enumFirst.size() - 2);
+      break;
+    default:
+      m_curve.push_back(-1);
+    }
+  }
+}
+
+BakedCurves::CurveType BakedCurves::getType(int track) const {
+  if (track < 0 || track >= (int)m_type.size())
+    return NONE;
+
+  return (CurveType)m_type[track];
+}
+
+size_t BakedCurves::getNumBaked() const {
+  size_t count = 0;
+  for (auto t : m_type) {
+    if (t != NONE)
+      count++;
+  }
+
+  return count;
+}
+
+BakedCurves::CurveType BakedCurves::bake(const KeyframeTrack& track) {
+  if (track.keys.size() == 0)
+    return NONE;
+
+  // Only tracks made entirely of values of one type can be baked.
+  // Nested timeline references need to be evaluated by the Timeline.
+  string typeName;
+  for (const auto& k : track.keys) {
+    if (k.timelineID != "" || k.val == nullptr)
+      return NONE;
+
+    if (typeName == "")
+      typeName = k.val->getTypeName();
+    else if (k.val->getTypeName() != typeName)
+      return NONE;
+  }
+
+  if (typeName == "float" || typeName == "orientation") {
+    bool orientation = (typeName == "orientation");
+
+    for (size_t i = 0; i < track.keys.size(); i++) {
+      m_scalarTimes.push_back(track.times[i]);
+
+      if (orientation) {
+        LumiverseOrientation* o = (LumiverseOrientation*)track.keys[i].val.get();
+        m_scalarValues.push_back(o->valAsUnit(DEGREE));
+        m_scalarMin.push_back(o->minAsUnit(DEGREE));
+        m_scalarMax.push_back(o->maxAsUnit(DEGREE));
+        m_scalarDefault.push_back(o->defaultAsUnit(DEGREE));
+        m_scalarUnit.push_back((unsigned char)o->getUnit());
+      }
+      else {
+        LumiverseFloat* f = (LumiverseFloat*)track.keys[i].val.get();
+        m_scalarValues.push_back(f->getVal());
+        m_scalarMin.push_back(f->getMin());
+        m_scalarMax.push_back(f->getMax());
+        m_scalarDefault.push_back(f->getDefault());
+        m_scalarUnit.push_back(0);
+      }
+    }
+
+    m_scalarFirst.push_back(m_scalarTimes.size());
+    return orientation ? ORIENTATION : FLOAT;
+  }
+  else if (typeName == "color") {
+    // Every keyframe needs the same channels
+    vector<string> channels;
+    for (const auto& c : ((LumiverseColor*)track.keys[0].val.get())->getColorParams()) {
+      channels.push_back(c.first);
+    }
+    sort(channels.begin(), channels.end());
+
+    for (const auto& k : track.keys) {
+      auto params = ((LumiverseColor*)k.val.get())->getColorParams();
+      if (params.size() != channels.size())
+        return NONE;
+
+      for (const auto& c : channels) {
+        if (params.count(c) == 0)
+          return NONE;
+      }
+    }
+
+    for (size_t i = 0; i < track.keys.size(); i++) {
+      LumiverseColor* color = (LumiverseColor*)track.keys[i].val.get();
+      auto params = color->getColorParams();
+
+      m_colorTimes.push_back(track.times[i]);
+      m_colorWeights.push_back(color->getWeight());
+      for (const auto& c : channels) {
+        m_colorValues.push_back(params[c]);
+      }
+    }
+
+    m_colorChannels.push_back(channels);
+    m_colorFirst.push_back(m_colorTimes.size());
+    m_colorValueFirst.push_back(m_colorValues.size());
+    return COLOR;
+  }
+  else if (typeName == "enum") {
+    for (size_t i = 0; i < track.keys.size(); i++) {
+      LumiverseEnum* e = (LumiverseEnum*)track.keys[i].val.get();
+
+      m_enumTimes.push_back(track.times[i]);
+      m_enumActive.push_back(e->getVal());
+      m_enumTweak.push_back(e->getTweak());
+      m_enumRange.push_back(e->getRangeVal());
+      m_enumInterp.push_back((unsigned char)e->getInterpMode());
+    }
+
+    m_enumFirst.push_back(m_enumTimes.size());
+    return ENUM;
+  }
+
+  return NONE;
+}
+
+CurvePlayhead::CurvePlayhead() : m_targetsStale(false) { }
+
+void CurvePlayhead::reset(shared_ptr<const BakedCurves> curves) {
+  m_curves = curves;
+
+  m_scalarCurve.clear();
+  m_scalarDest.clear();
+  m_scalarIsOrientation.clear();
+  m_lo.clear();
+  m_hi.clear();
+  m_t0.resize(0);
+  m_invDuration.resize(0);
+  m_v0.resize(0);
+  m_dv.resize(0);
+  m_out.resize(0);
+  m_rangeKey.clear();
+  m_min.resize(0);
+  m_max.resize(0);
+  m_target.clear();
+  m_targetUnit.clear();
+  m_targetsStale = false;
+
+  m_colorCurve.clear();
+  m_colorDest.clear();
+  m_colorPos.clear();
+
+  m_enumCurve.clear();
+  m_enumDest.clear();
+  m_enumPos.clear();
+}
+
+bool CurvePlayhead::bind(int track, LumiverseType* dest) {
+  if (m_curves == nullptr || dest == nullptr)
+    return false;
+
+  BakedCurves::CurveType type = m_curves->getType(track);
+  int curve = (type == BakedCurves::NONE) ? -1 : m_curves->m_curve[track];
+  string destType = dest->getTypeName();
+
+  if ((type == BakedCurves::FLOAT && destType == "float") ||
+    (type == BakedCurves::ORIENTATION && destType == "orientation"))
+  {
+    m_scalarCurve.push_back(curve);
+    m_scalarDest.push_back(dest);
+    m_scalarIsOrientation.push_back(type == BakedCurves::ORIENTATION);
+
+    // Start with an empty segment so the first evaluate() seeks.
+    m_lo.push_back(1);
+    m_hi.push_back(0);
+    m_rangeKey.push_back(m_curves->m_scalarFirst[curve]);
+    m_target.push_back(nullptr);
+    m_targetUnit.push_back(-1);
+
+    size_t n = m_scalarCurve.size();
+    m_t0.conservativeResize(n);
+    m_invDuration.conservativeResize(n);
+    m_v0.conservativeResize(n);
+    m_dv.conservativeResize(n);
+    m_out.conservativeResize(n);
+    m_min.conservativeResize(n);
+    m_max.conservativeResize(n);
+    m_t0[n - 1] = m_invDuration[n - 1] = m_v0[n - 1] = m_dv[n - 1] = m_out[n - 1] = 0;
+    m_min[n - 1] = m_max[n - 1] = 0;
+    return true;
+  }
+  else if (type == BakedCurves::COLOR && destType == "color") {
+    // Destination needs every channel in the curve
+    auto params = ((LumiverseColor*)dest)->getColorParams();
+    for (const auto& c : m_curves->m_colorChannels[curve]) {
+      if (params.count(c) == 0)
+        return false;
+    }
+
+    m_colorCurve.push_back(curve);
+    m_colorDest.push_back((LumiverseColor*)dest);
+    m_colorPos.push_back(0);
+    return true;
+  }
+  else if (type == BakedCurves::ENUM && destType == "enum") {
+    m_enumCurve.push_back(curve);
+    m_enumDest.push_back((LumiverseEnum*)dest);
+    m_enumPos.push_back(0);
+    return true;
+  }
+
+  return false;
+}
+
+void CurvePlayhead::evaluate(size_t time) {
+  if (m_curves == nullptr)
+    return;
+
+  const BakedCurves& c = *m_curves;
+  double t = (double)time;
+
+  // Scalars. Segment changes are rare, so this first pass is mostly compares.
+  for (size_t i = 0; i < m_lo.size(); i++) {
+    if (time < m_lo[i] || time >= m_hi[i])
+      seekScalar(i, time);
+  }
+
+  if (m_out.size() > 0) {
+    // Clamped the same way the parameters clamp their values
+    m_out = (m_v0 + m_dv * ((t - m_t0) * m_invDuration).max(0.0).min(1.0).cast<float>()).max(m_min).min(m_max);
+
+    for (size_t i = 0; i < m_scalarDest.size(); i++) {
+      if (m_target[i] == nullptr) {
+        writeParam(i);
+      }
+      else {
+        // Same conversion as LumiverseOrientation::asUnit
+        *m_target[i] = (m_targetUnit[i] == RADIAN) ? m_out[i] * (float)M_PI / 180.0f : m_out[i];
+        m_targetsStale = true;
+      }
+    }
+  }
+
+  // Colors. Matches LumiverseColor::lerp, which blends the left channel values with
+  // the weighted right channel values.
+  for (size_t i = 0; i < m_colorDest.size(); i++) {
+    int curve = m_colorCurve[i];
+    size_t first = c.m_colorFirst[curve];
+    size_t n = c.m_colorFirst[curve + 1] - first;
+    const vector<string>& channels = c.m_colorChannels[curve];
+    size_t numChannels = channels.size();
+
+    size_t pos = seek(c.m_colorTimes, first, first + n, m_colorPos[i], time);
+    m_colorPos[i] = pos;
+
+    size_t l = (pos == 0) ? 0 : pos - 1;
+    size_t r = (pos == n) ? n - 1 : pos;
+    double a = (r > l) ? (t - c.m_colorTimes[first + l]) / (double)(c.m_colorTimes[first + r] - c.m_colorTimes[first + l]) : 0;
+
+    const double* lv = &c.m_colorValues[c.m_colorValueFirst[curve] + l * numChannels];
+    const double* rv = &c.m_colorValues[c.m_colorValueFirst[curve] + r * numChannels];
+    double lw = c.m_colorWeights[first + l];
+    double rw = c.m_colorWeights[first + r];
+
+    for (size_t ch = 0; ch < numChannels; ch++) {
+      double rhs = (r > l) ? rv[ch] * rw : rv[ch];
+      m_colorDest[i]->setColorChannel(channels[ch], (1 - a) * lv[ch] + a * rhs);
+    }
+    m_colorDest[i]->setWeight((1 - a) * lw + a * rw);
+  }
+
+  // Enums. Matches LumiverseEnum::lerp, which starts from the right keyframe and
+  // uses the left keyframe's interpolation mode.
+  for (size_t i = 0; i < m_enumDest.size(); i++) {
+    int curve = m_enumCurve[i];
+    size_t first = c.m_enumFirst[curve];
+    size_t n = c.m_enumFirst[curve + 1] - first;
+
+    size_t pos = seek(c.m_enumTimes, first, first + n, m_enumPos[i], time);
+    m_enumPos[i] = pos;
+
+    size_t l = first + ((pos == 0) ? 0 : pos - 1);
+    size_t r = first + ((pos == n) ? n - 1 : pos);
+    float a = (r > l) ? (float)((t - c.m_enumTimes[l]) / (double)(c.m_enumTimes[r] - c.m_enumTimes[l])) : 0;
+
+    LumiverseEnum* dest = m_enumDest[i];
+    LumiverseEnum::InterpolationMode mode = (LumiverseEnum::InterpolationMode)c.m_enumInterp[l];
+
+    if (r == l) {
+      dest->setVal(c.m_enumActive[r], c.m_enumTweak[r]);
+    }
+    else if (mode == LumiverseEnum::SMOOTH) {
+      dest->setVal(c.m_enumRange[l] * (1 - a) + c.m_enumRange[r] * a);
+    }
+    else if (mode == LumiverseEnum::SMOOTH_WITHIN_OPTION && c.m_enumActive[l] == c.m_enumActive[r]) {
+      dest->setVal(c.m_enumActive[r], c.m_enumTweak[l] * (1 - a) + c.m_enumTweak[r] * a);
+    }
+    else {
+      dest->setVal(c.m_enumActive[r], c.m_enumTweak[r]);
+    }
+  }
+}
+
+void CurvePlayhead::setTarget(size_t i, float* target, int unit) {
+  m_target[i] = target;
+  m_targetUnit[i] = unit;
+}
+
+void CurvePlayhead::clearTargets() {
+  fill(m_target.begin(), m_target.end(), nullptr);
+  m_targetsStale = false;
+}
+
+void CurvePlayhead::writeParams() {
+  if (!m_targetsStale)
+    return;
+
+  for (size_t i = 0; i < m_scalarDest.size(); i++) {
+    if (m_target[i] != nullptr)
+      writeParam(i);
+  }
+
+  m_targetsStale = false;
+}
+
+void CurvePlayhead::writeParam(size_t i) {
+  const BakedCurves& c = *m_curves;
+  size_t k = m_rangeKey[i];
+
+  // Range and default come along with the value, as with LumiverseTypeUtils::copyByVal
+  if (m_scalarIsOrientation[i]) {
+    LumiverseOrientation* o = (LumiverseOrientation*)m_scalarDest[i];
+    o->setUnit((ORIENTATION_UNIT)c.m_scalarUnit[k]);
+    o->setMin(c.m_scalarMin[k], DEGREE);
+    o->setMax(c.m_scalarMax[k], DEGREE);
+    o->setDefault(c.m_scalarDefault[k], DEGREE);
+    o->setVal(m_out[i], DEGREE);
+  }
+  else {
+    ((LumiverseFloat*)m_scalarDest[i])->setVals(m_out[i], c.m_scalarDefault[k], c.m_scalarMin[k], c.m_scalarMax[k]);
+  }
+}
+
+void CurvePlayhead::seekScalar(size_t i, size_t time) {
+  const BakedCurves& c = *m_curves;
+  int curve = m_scalarCurve[i];
+  size_t first = c.m_scalarFirst[curve];
+  size_t n = c.m_scalarFirst[curve + 1] - first;
+  const size_t* times = &c.m_scalarTimes[first];
+  const float* vals = &c.m_scalarValues[first];
+
+  size_t pos = upper_bound(times, times + n, time) - times;
+
+  // The left keyframe of the segment, or the only one that applies
+  m_rangeKey[i] = first + ((pos == 0) ? 0 : pos - 1);
+  m_min[i] = c.m_scalarMin[m_rangeKey[i]];
+  m_max[i] = c.m_scalarMax[m_rangeKey[i]];
+
+  if (pos == 0) {
+    // Before the first keyframe
+    m_lo[i] = 0;
+    m_hi[i] = times[0];
+    m_t0[i] = 0;
+    m_invDuration[i] = 0;
+    m_v0[i] = vals[0];
+    m_dv[i] = 0;
+  }
+  else if (pos == n) {
+    // After the last keyframe
+    m_lo[i] = times[n - 1];
+    m_hi[i] = numeric_limits<size_t>::max();
+    m_t0[i] = 0;
+    m_invDuration[i] = 0;
+    m_v0[i] = vals[n - 1];
+    m_dv[i] = 0;
+  }
+  else {
+    m_lo[i] = times[pos - 1];
+    m_hi[i] = times[pos];
+    m_t0[i] = times[pos - 1];
+    m_invDuration[i] = 1.0 / (double)(times[pos] - times[pos - 1]);
+    m_v0[i] = vals[pos - 1];
+    m_dv[i] = vals[pos] - vals[pos - 1];
+  }
+}
+
+size_t CurvePlayhead::seek(const vector<size_t>& times, size_t first, size_t last, size_t pos, size_t time) {
+  size_t n = last - first;
+  const size_t* t = &times[first];
+
+  // Still in the same segment
+  if (pos <= n && (pos == 0 || t[pos - 1] <= time) && (pos == n || t[pos] > time))
+    return pos;
+
+  // Moved into the next segment
+  if (pos < n && t[pos] <= time && (pos + 1 == n || t[pos + 1] > time))
+    return pos + 1;
+
+  return upper_bound(t, t + n, time) - t;
+}
+
+}
+}
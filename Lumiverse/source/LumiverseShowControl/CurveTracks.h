@@ -0,0 +1,231 @@
+#ifndef _CURVETRACKS_H_
+#define _CURVETRACKS_H_
+
+#pragma once
+
+#include "LumiverseCore.h"
+#include "Keyframe.h"
+
+namespace Lumiverse {
+namespace ShowControl {
+
+/*!
+\brief Keyframe tracks converted to flat, typed arrays for fast evaluation.
+
+Baking takes the tracks of a Timeline and, for every track whose keyframes all hold
+a float, orientation, color or enum value, stores the keyframe times and values in
+struct-of-arrays form. Tracks that reference other timelines or mix types are left
+alone and should be evaluated through Timeline::getValueAtTime() as usual.
+
+Keyframe times are kept as integer milliseconds, like the Timeline's, so long
+running timelines evaluate at the same times as unbaked ones. Every keyframe also
+keeps the range and default of its value. The left keyframe of a segment gives its
+range to the evaluated value, the same as LumiverseTypeUtils::lerp().
+
+Baked curves are immutable. The Timeline throws them away and bakes new ones when
+its keyframes change.
+\sa CurvePlayhead, Timeline::getBakedCurves()
+*/
+class BakedCurves {
+public:
+  /*! \brief The kind of data a track was baked into. */
+  enum CurveType {
+    NONE,         /*!< Track was not baked */
+    FLOAT,        /*!< Scalar curve, value is the float value */
+    ORIENTATION,  /*!< Scalar curve, value is the orientation in degrees */
+    COLOR,        /*!< Color channels and weight */
+    ENUM          /*!< Enum option, tweak and numeric range value */
+  };
+
+  /*!
+  \brief Bakes a set of tracks.
+  \param tracks Tracks to bake. Curve indices match the indices of this vector.
+  \param version Track version the tracks came from.
+  */
+  BakedCurves(const vector<KeyframeTrack>& tracks, unsigned int version);
+
+  /*! \brief Returns how the given track was baked. */
+  CurveType getType(int track) const;
+
+  /*! \brief Track version these curves were baked from. */
+  unsigned int getVersion() const { return m_version; }
+
+  /*! \brief Number of tracks that were baked, of any type. */
+  size_t getNumBaked() const;
+
+private:
+  friend class CurvePlayhead;
+
+  unsigned int m_version;
+
+  /*! \brief CurveType for each track. */
+  vector<unsigned char> m_type;
+
+  /*! \brief Index into the typed curve arrays below for each track, or -1. */
+  vector<int> m_curve;
+
+  // Scalar curves (FLOAT and ORIENTATION). Keyframes for scalar curve i are
+  // in [m_scalarFirst[i], m_scalarFirst[i + 1]). Orientations are in degrees,
+  // with the unit of the keyframe kept in m_scalarUnit.
+  vector<size_t> m_scalarFirst;
+  vector<size_t> m_scalarTimes;
+  vector<float> m_scalarValues;
+  vector<float> m_scalarMin;
+  vector<float> m_scalarMax;
+  vector<float> m_scalarDefault;
+  vector<unsigned char> m_scalarUnit;
+
+  // Color curves. Channel names are per curve, channel values are stored
+  // per keyframe with m_colorChannels[i].size() values each.
+  vector<size_t> m_colorFirst;
+  vector<size_t> m_colorValueFirst;
+  vector<vector<string> > m_colorChannels;
+  vector<size_t> m_colorTimes;
+  vector<double> m_colorValues;
+  vector<double> m_colorWeights;
+
+  // Enum curves.
+  vector<size_t> m_enumFirst;
+  vector<size_t> m_enumTimes;
+  vector<string> m_enumActive;
+  vector<float> m_enumTweak;
+  vector<float> m_enumRange;
+  vector<unsigned char> m_enumInterp;
+
+  /*! \brief Attempts to bake a track, returning the type it was baked as. */
+  CurveType bake(const KeyframeTrack& track);
+};
+
+/*!
+\brief Evaluates baked curves for a set of Layer parameters.
+
+A playhead binds the baked curves of one Timeline to the parameters they drive. All
+scalar curves are evaluated together into a dense value buffer in two passes: the
+first moves each curve onto the segment containing the current time (this rarely
+does anything during normal playback), and the second interpolates every curve at
+once with vectorized array math. Color and enum curves are evaluated by their own
+typed loops. Results are written directly into the bound parameters, without
+allocating intermediate values.
+
+Scalar results can instead be sent straight to a LayerBuffer with setTarget(). The
+parameters of those bindings are only updated by writeParams().
+*/
+class CurvePlayhead {
+public:
+  CurvePlayhead();
+
+  /*!
+  \brief Clears all bindings and attaches the playhead to a set of baked curves.
+  */
+  void reset(shared_ptr<const BakedCurves> curves);
+
+  /*!
+  \brief Binds a track to a parameter.
+  \return true if the track was baked with a type that matches the parameter.
+  If false, the parameter should be evaluated some other way.
+  */
+  bool bind(int track, LumiverseType* dest);
+
+  /*!
+  \brief Evaluates every bound curve at the given time and writes the results into
+  the bound parameters.
+  \param time Time in the timeline in ms, after accounting for loops.
+  */
+  void evaluate(size_t time);
+
+  /*!
+  \brief Returns the dense scalar buffer filled by the last call to evaluate().
+
+  One value per bound float or orientation parameter, in bind order. Values are
+  clamped to their range, and orientations are in degrees.
+  */
+  const Eigen::ArrayXf& getScalarValues() const { return m_out; }
+
+  /*! \brief Number of bound float and orientation parameters. */
+  size_t getNumScalars() const { return m_scalarDest.size(); }
+
+  /*! \brief Parameter of scalar binding i. */
+  LumiverseType* getScalarParam(size_t i) const { return m_scalarDest[i]; }
+
+  /*!
+  \brief Makes evaluate() write scalar binding i to target instead of its parameter.
+  \param target Must stay valid until clearTargets() or reset().
+  \param unit Orientation unit of the target, or -1 for floats.
+  */
+  void setTarget(size_t i, float* target, int unit);
+
+  /*! \brief Sends every scalar binding back to its parameter. */
+  void clearTargets();
+
+  /*!
+  \brief Writes the values last sent to targets into their parameters.
+
+  Does nothing if nothing was evaluated since the last call.
+  */
+  void writeParams();
+
+  /*! \brief Number of parameters bound to this playhead. */
+  size_t getNumBound() const { return m_scalarDest.size() + m_colorDest.size() + m_enumDest.size(); }
+
+  /*! \brief Baked curves the playhead is attached to. */
+  const shared_ptr<const BakedCurves>& getCurves() const { return m_curves; }
+
+private:
+  shared_ptr<const BakedCurves> m_curves;
+
+  // Scalar bindings
+  vector<int> m_scalarCurve;
+  vector<LumiverseType*> m_scalarDest;
+  vector<bool> m_scalarIsOrientation;
+
+  // Active segment for each scalar binding. The segment is valid for times in [lo, hi).
+  // Segment times are in double precision so that the position within a segment
+  // stays exact for long running timelines.
+  vector<size_t> m_lo;
+  vector<size_t> m_hi;
+  Eigen::ArrayXd m_t0;
+  Eigen::ArrayXd m_invDuration;
+  Eigen::ArrayXf m_v0;
+  Eigen::ArrayXf m_dv;
+  Eigen::ArrayXf m_out;
+
+  /*! \brief Keyframe that the range and default of each scalar binding come from. */
+  vector<size_t> m_rangeKey;
+
+  // Range of the keyframe at m_rangeKey, in degrees for orientations.
+  Eigen::ArrayXf m_min;
+  Eigen::ArrayXf m_max;
+
+  // LayerBuffer location and unit for each scalar binding, or nullptr to write the parameter.
+  vector<float*> m_target;
+  vector<int> m_targetUnit;
+
+  /*! \brief Set when targets hold values that their parameters don't have yet. */
+  bool m_targetsStale;
+
+  // Color and enum bindings, with the position of the first keyframe after the
+  // last evaluated time.
+  vector<int> m_colorCurve;
+  vector<LumiverseColor*> m_colorDest;
+  vector<size_t> m_colorPos;
+
+  vector<int> m_enumCurve;
+  vector<LumiverseEnum*> m_enumDest;
+  vector<size_t> m_enumPos;
+
+  /*! \brief Copies the value, range and default of scalar binding i into its parameter. */
+  void writeParam(size_t i);
+
+  /*! \brief Moves scalar binding i onto the segment containing time. */
+  void seekScalar(size_t i, size_t time);
+
+  /*!
+  \brief Finds the first keyframe after time in [first, last), starting from pos.
+  \return Position relative to first.
+  */
+  static size_t seek(const vector<size_t>& times, size_t first, size_t last, size_t pos, size_t time);
+};
+
+}
+}
+#endif
@@ -87,6 +87,34 @@ struct Keyframe {
   JSONNode toJSON();
 };
 
+/*!
+\brief The keyframes for a single device-parameter pair, stored as sorted arrays.
+
+times[i] is the time of keys[i]. Tracks are built from the Timeline's keyframe maps
+as needed and are read-only copies.
+*/
+struct KeyframeTrack {
+  vector<size_t> times;
+  vector<Keyframe> keys;
+};
+
+/*!
+\brief Playhead position within a KeyframeTrack.
+
+A Layer keeps one cursor per parameter while it plays a Timeline. During normal
+playback time only moves forward a little each frame, so the cursor finds the active
+keyframes without searching. Jumps (seeks, loops) fall back to a binary search.
+*/
+struct TrackCursor {
+  TrackCursor() : track(-1), pos(0) { }
+
+  /*! \brief Index of the track in the Timeline, or -1 if the Timeline has no keyframes for it. */
+  int track;
+
+  /*! \brief Index of the first keyframe after the most recently evaluated time. */
+  size_t pos;
+};
+
 /*!
 \brief Events are special keyframes that call other functions when encountered.
 
@@ -17,7 +17,7 @@ namespace ShowControl {
   }
 
   Layer::Layer(DeviceSet set, Playback * pb, string name, int priority, BlendMode mode) :
-    m_name(name), m_priority(priority), m_pb(pb), m_mode(mode)
+    m_name(name), m_priority(priority), m_pb(pb), m_mode(mode), m_opacity(1)
   {
     auto devices = set.getDevices();
     for (const auto& d : devices) {
@@ -32,10 +32,16 @@ namespace ShowControl {
     m_playing = false;
     m_playbackData = nullptr;
     m_queuedPlayback = nullptr;
+    m_stateVersion = 0;
+    m_ownedVersion = 0;
+    m_evaluating = false;
+    m_curvesLinked = false;
+
+    ownAll();
   }
 
   Layer::Layer(Playback * pb, string name, int priority, BlendMode mode) :
-    m_name(name), m_pb(pb), m_priority(priority), m_mode(mode)
+    m_name(name), m_pb(pb), m_priority(priority), m_mode(mode), m_opacity(1)
   {
     // yup this layer's empty
     m_active = true;
@@ -44,9 +50,14 @@ namespace ShowControl {
     m_playing = false;
     m_playbackData = nullptr;
     m_queuedPlayback = nullptr;
+    m_stateVersion = 0;
+    m_ownedVersion = 0;
+    m_evaluating = false;
+    m_curvesLinked = false;
   }
 
-  Layer::Layer(Playback* pb, JSONNode node) : m_pb(pb) {
+  Layer::Layer(Playback* pb, JSONNode node) : m_pb(pb), m_opacity(1) {
+    bool hasOwned = false;
     auto it = node.begin();
     while (it != node.end()) {
       string name = it->name();
@@ -63,6 +74,15 @@ namespace ShowControl {
 #else
         m_mode = StringToBlendMode(it->as_string());
 #endif
+      else if (name == "typeModes") {
+        for (auto mode = it->begin(); mode != it->end(); mode++) {
+#ifdef USE_C11_MAPS
+          m_typeModes[mode->name()] = StringToBlendMode[mode->as_string()];
+#else
+          m_typeModes[mode->name()] = StringToBlendMode(mode->as_string());
+#endif
+        }
+      }
       else if (name == "opacity")
         m_opacity = it->as_float();
       else if (name == "currentCue")
@@ -80,6 +100,15 @@ namespace ShowControl {
           device++;
         }
       }
+      else if (name == "owned") {
+        hasOwned = true;
+
+        for (auto device = it->begin(); device != it->end(); device++) {
+          for (auto param = device->begin(); param != device->end(); param++) {
+            m_owned[device->name()].insert(param->as_string());
+          }
+        }
+      }
 
       it++;
     }
@@ -90,6 +119,14 @@ namespace ShowControl {
     m_playing = false;
     m_playbackData = nullptr;
     m_queuedPlayback = nullptr;
+    m_stateVersion = 0;
+    m_ownedVersion = 0;
+    m_evaluating = false;
+    m_curvesLinked = false;
+
+    // Layers saved before ownership was tracked blend everything
+    if (!hasOwned)
+      ownAll();
   }
 
   void Layer::init(Rig* rig) {
@@ -108,6 +145,10 @@ namespace ShowControl {
     m_playing = false;
     m_playbackData = nullptr;
     m_queuedPlayback = nullptr;
+    m_stateVersion = 0;
+    m_ownedVersion = 0;
+    m_evaluating = false;
+    m_curvesLinked = false;
   }
 
   Layer::~Layer() {
@@ -123,6 +164,29 @@ namespace ShowControl {
     m_opacity = (val > 1) ? 1 : ((val < 0) ? 0 : val);
   }
 
+  void Layer::activate() {
+    m_active = true;
+    if (m_pb != nullptr)
+      m_pb->invalidateLayerOrder();
+  }
+
+  void Layer::deactivate() {
+    m_active = false;
+    if (m_pb != nullptr)
+      m_pb->invalidateLayerOrder();
+  }
+
+  void Layer::setPriority(int priority) {
+    m_priority = priority;
+    if (m_pb != nullptr)
+      m_pb->invalidateLayerOrder();
+  }
+
+  Layer::BlendMode Layer::getTypeMode(string typeName) {
+    auto mode = m_typeModes.find(typeName);
+    return (mode == m_typeModes.end()) ? m_mode : mode->second;
+  }
+
   bool Layer::addDevices(DeviceSet d)
   {
     if (m_playing) {
@@ -134,9 +198,11 @@ namespace ShowControl {
     for (const auto& dv : devices) {
       for (const auto& p : dv->getRawParameters()) {
         m_layerState[dv->getId()][p.first] = LumiverseTypeUtils::copy(p.second);
+        own(dv->getId(), p.first);
       }
     }
 
+    m_stateVersion++;
     return true;
   }
 
@@ -154,7 +220,9 @@ namespace ShowControl {
     }
 
     m_layerState[d->getId()][param] = LumiverseTypeUtils::copy(d->getParam(param));
+    own(d->getId(), param);
 
+    m_stateVersion++;
     return true;
   }
 
@@ -175,9 +243,11 @@ namespace ShowControl {
 
         // Add new param val
         m_layerState[dv->getId()][p] = LumiverseTypeUtils::copy(dv->getParam(p));
+        own(dv->getId(), p);
       }
     }
 
+    m_stateVersion++;
     return true;
   }
 
@@ -195,8 +265,10 @@ namespace ShowControl {
       }
 
       d.second[param] = LumiverseTypeUtils::copy(type);
+      own(d.first, param);
     }
 
+    m_stateVersion++;
     return true;
   }
 
@@ -212,6 +284,9 @@ namespace ShowControl {
       m_layerState[id].erase(param);
     }
 
+    setParameterOwned(id, param, false);
+
+    m_stateVersion++;
     return true;
   }
 
@@ -230,6 +305,7 @@ namespace ShowControl {
       }
 
       m_layerState.erase(dv->getId());
+      m_owned.erase(dv->getId());
     }
 
     return true;
@@ -268,6 +344,43 @@ namespace ShowControl {
     return true;
   }
 
+  bool Layer::isParameterOwned(string id, string param) {
+    auto d = m_owned.find(id);
+    return d != m_owned.end() && d->second.count(param) > 0;
+  }
+
+  void Layer::setParameterOwned(string id, string param, bool owned) {
+    if (owned) {
+      auto d = m_layerState.find(id);
+      if (d != m_layerState.end() && d->second.count(param) > 0)
+        own(id, param);
+    }
+    else {
+      auto d = m_owned.find(id);
+      if (d != m_owned.end() && d->second.erase(param) > 0) {
+        if (d->second.empty())
+          m_owned.erase(d);
+
+        m_ownedVersion++;
+      }
+    }
+  }
+
+  void Layer::ownAll() {
+    for (const auto& d : m_layerState) {
+      for (const auto& p : d.second) {
+        m_owned[d.first].insert(p.first);
+      }
+    }
+
+    m_ownedVersion++;
+  }
+
+  void Layer::own(const string& id, const string& param) {
+    if (m_owned[id].insert(param).second)
+      m_ownedVersion++;
+  }
+
   void Layer::play(string id) {
     if (m_pb->getTimeline(id) == nullptr) {
       Logger::log(ERR, "Timeline with id " + id + " could not be found.");
@@ -287,6 +400,7 @@ namespace ShowControl {
       time = chrono::duration_cast<chrono::milliseconds>(m_playbackData->elapsed - m_playbackData->start).count();
     }
 
+    writeCurveValues();
     m_pb->getTimeline(id)->setCurrentState(m_layerState, m_pb->getTimeline(tlID), time);
 
     m_queue.unlock();
@@ -296,9 +410,10 @@ namespace ShowControl {
     PlaybackData* pbd = new PlaybackData();;
     pbd->timelineID = id;
     pbd->complete = false;
-    pbd->start = chrono::high_resolution_clock::now();
+    pbd->start = m_pb->getRig()->getClock().now();
     pbd->elapsed = pbd->start;
     pbd->length = m_pb->getTimeline(id)->getLength();
+    pbd->graph.build(m_pb->getTimeline(id), m_pb->getTimelines());
 
     // Delete anything in the up next slot if we got something there
     if (m_queuedPlayback != nullptr) {
@@ -326,16 +441,36 @@ namespace ShowControl {
     m_playing = false;
   }
 
+  bool Layer::isPlaying() {
+    lock_guard<mutex> lock(m_queue);
+    return m_playing || m_queuedPlayback != nullptr;
+  }
+
   string Layer::getRecentTimeline() {
     return m_lastPlayedTimeline;
   }
 
+  map<string, map<string, LumiverseType*> >& Layer::getLayerState() {
+    writeCurveValues();
+    return m_layerState;
+  }
+
   void Layer::update(chrono::time_point<chrono::high_resolution_clock> updateStart) {
+    size_t partitions = beginUpdate(updateStart);
+    for (size_t i = 0; i < partitions; i++) {
+      updatePartition(i);
+    }
+    endUpdate(updateStart);
+  }
+
+  size_t Layer::beginUpdate(chrono::time_point<chrono::high_resolution_clock> updateStart) {
     auto loopTime = updateStart - m_previousLoopStart;
+    m_evaluating = false;
 
     // Grab waiting playback objects from the queue
     m_queue.lock();
     if (m_queuedPlayback != nullptr) {
+      unlinkCurves();
       m_playbackData = m_queuedPlayback;
       m_queuedPlayback = nullptr;
 
@@ -347,6 +482,7 @@ namespace ShowControl {
 
     if (m_stop) {
       if (m_playbackData != nullptr) {
+        unlinkCurves();
         delete m_playbackData;
         m_playbackData = nullptr;
       }
@@ -367,86 +503,233 @@ namespace ShowControl {
         // - For each device, for each paramter, get the value at the given time.
         // - Set the value in the layer state to the returned value.
         // - End playback if the timeline says it's done.
-        shared_ptr<Timeline> tl = m_pb->getTimeline(m_playbackData->timelineID);
-        size_t t = chrono::duration_cast<chrono::milliseconds>(updateStart - m_playbackData->start).count();
-        size_t tp = chrono::duration_cast<chrono::milliseconds>(m_previousLoopStart - m_playbackData->start).count();
+        shared_ptr<Timeline> tl = m_playbackData->graph.getRoot();
+        m_playbackData->time = chrono::duration_cast<chrono::milliseconds>(updateStart - m_playbackData->start).count();
+        m_playbackData->prevTime = chrono::duration_cast<chrono::milliseconds>(m_previousLoopStart - m_playbackData->start).count();
+
+        // Anything that rebuilds shared timeline data happens here, before partitions
+        // are evaluated. Keyframe edits re-resolve timeline references.
+        if (!m_playbackData->graph.isCurrent())
+          m_playbackData->graph.build(tl, m_pb->getTimelines());
+
+        // Keyframe edits and Layer state changes invalidate the cursors.
+        unsigned int trackVersion = tl->getTrackVersion();
+        if (m_playbackData->trackVersion != trackVersion || m_playbackData->stateVersion != m_stateVersion) {
+          buildCursors(m_playbackData, tl, trackVersion);
+        }
 
-        for (const auto& device : m_layerState) {
-          for (auto& param : m_layerState[device.first]) {
-            shared_ptr<LumiverseType> val = tl->getValueAtTime(device.first, param.first, param.second, t, m_pb->getTimelines());
+        m_evaluating = true;
+        return m_playbackData->partitions.size();
+      }
+    }
 
-            // A value of nullptr indicates that the Timeline doesn't have any data for the specified device/paramter pair.
-            if (val == nullptr) {
-              continue;
-            }
+    return 0;
+  }
 
-            LumiverseTypeUtils::copyByVal(val.get(), param.second);
-          }
-        }
+  void Layer::updatePartition(size_t partition) {
+    if (!m_evaluating || partition >= m_playbackData->partitions.size())
+      return;
+
+    PlaybackPartition& p = m_playbackData->partitions[partition];
+    size_t t = m_playbackData->time;
+
+    p.curves.evaluate(m_playbackData->graph.getRoot()->getLoopTime(t));
+
+    for (auto& pc : p.cursors) {
+      shared_ptr<LumiverseType> val = m_playbackData->graph.getValue(pc.cursor, pc.id, pc.param, pc.val, t);
+
+      // A value of nullptr indicates that the Timeline doesn't have any data for the specified device/paramter pair.
+      if (val == nullptr) {
+        continue;
+      }
+
+      LumiverseTypeUtils::copyByVal(val.get(), pc.val);
 
-        tl->executeEvents(tp, t);
-
-        // this is not optimal. at the moment the locking is necessary due to c++ stl container
-        // access issues in some of the timeline methods (iterators getting reset, etc.)
-        m_queue.lock();
-        if (tl->isDone(t, m_pb->getTimelines())) {
-          tl->executeEndEvents();
-          delete m_playbackData;
-          m_playbackData = nullptr;
-          m_stop = true;
-          m_pause = false;
-          m_playing = false;
+      // Ownership is shared by all partitions, so it's updated in endUpdate()
+      if (!pc.owned) {
+        pc.owned = true;
+        p.newlyOwned.push_back(&pc - p.cursors.data());
+      }
+    }
+  }
+
+  void Layer::endUpdate(chrono::time_point<chrono::high_resolution_clock> updateStart) {
+    if (m_evaluating) {
+      shared_ptr<Timeline> tl = m_playbackData->graph.getRoot();
+      size_t t = m_playbackData->time;
+
+      for (auto& p : m_playbackData->partitions) {
+        for (size_t i : p.newlyOwned) {
+          own(p.cursors[i].id, p.cursors[i].param);
         }
-        m_queue.unlock();
+        p.newlyOwned.clear();
       }
+
+      tl->executeEvents(m_playbackData->prevTime, t);
+
+      // this is not optimal. at the moment the locking is necessary due to c++ stl container
+      // access issues in some of the timeline methods (iterators getting reset, etc.)
+      m_queue.lock();
+      if (m_playbackData->graph.isDone(t)) {
+        tl->executeEndEvents();
+        unlinkCurves();
+        delete m_playbackData;
+        m_playbackData = nullptr;
+        m_stop = true;
+        m_pause = false;
+        m_playing = false;
+      }
+      m_queue.unlock();
+
+      m_evaluating = false;
     }
 
     m_previousLoopStart = updateStart;
   }
 
-  void Layer::blend(map<string, Device*> currentState) {
+  void Layer::buildCursors(PlaybackData* pbd, shared_ptr<Timeline> tl, unsigned int trackVersion) {
+    unlinkCurves();
+    pbd->partitions.clear();
+
+    shared_ptr<const BakedCurves> curves = tl->getBakedCurves();
+    size_t count = PARTITION_SIZE;
+
+    for (const auto& device : m_layerState) {
+      // Start a new partition between devices once the current one is full
+      if (count >= PARTITION_SIZE) {
+        pbd->partitions.push_back(PlaybackPartition());
+        pbd->partitions.back().curves.reset(curves);
+        count = 0;
+      }
+
+      PlaybackPartition& p = pbd->partitions.back();
+
+      for (const auto& param : device.second) {
+        int track = tl->getTrackIndex(tl->getTimelineKey(device.first, param.first));
+        count++;
+
+        // Baked parameters are evaluated by the playhead, and always get a value.
+        if (track >= 0 && p.curves.bind(track, param.second)) {
+          own(device.first, param.first);
+          continue;
+        }
+
+        ParamCursor pc;
+        pc.id = device.first;
+        pc.param = param.first;
+        pc.val = param.second;
+        pc.cursor.track = track;
+        pc.owned = isParameterOwned(device.first, param.first);
+        p.cursors.push_back(pc);
+      }
+    }
+
+    pbd->trackVersion = trackVersion;
+    pbd->stateVersion = m_stateVersion;
+  }
+
+  void Layer::getBlendOps(LayerBuffer::Op ops[LayerBuffer::NUM_TYPES]) {
+    static const char* typeNames[LayerBuffer::NUM_TYPES] = { "float", "orientation", "color", "enum" };
+    float opacity = (m_opacity >= 1) ? 1 : m_opacity;
+
+    for (int t = 0; t < LayerBuffer::NUM_TYPES; t++) {
+      BlendMode mode = getTypeMode(typeNames[t]);
+
+      switch (mode) {
+      case MAX: ops[t].kernel = LayerBuffer::MAX; break;
+      case MIN: ops[t].kernel = LayerBuffer::MIN; break;
+      case ADD: ops[t].kernel = LayerBuffer::ADD; break;
+      case SUBTRACT: ops[t].kernel = LayerBuffer::SUBTRACT; break;
+      case MULTIPLY: ops[t].kernel = LayerBuffer::MULTIPLY; break;
+      default: ops[t].kernel = LayerBuffer::LERP; break;
+      }
+
+      // OVERWRITE is ALPHA at full opacity
+      ops[t].opacity = (mode == OVERWRITE) ? 1 : opacity;
+    }
+  }
+
+  void Layer::blend(const map<string, Device*>& currentState) {
     // We assume here that what you're passing in contains all the devices in the rig
     // and will not create new devices if they don't exist in the current state.
+    // Lay the state out the same way Playback does so both paths share the blend kernels.
+    // The layout is kept until the devices or their parameters change.
+    if (!m_stateLayout.isBuiltFrom(currentState))
+      m_stateLayout.build(currentState);
 
-    map<string, map<string, LumiverseType*> > active = m_layerState;
-
-    for (auto& device : active) {
-      try {
-        auto d = currentState.at(device.first);
-
-        // Go through each parameter in the device
-        for (auto& param : device.second) {
-          string paramName = param.first;
-          LumiverseType* src = param.second;
-          LumiverseType* dest = d->getParam(param.first);
-          
-          if (dest == nullptr) {
-            // Don't do anything if the destination doesn't have an existing value.
-            continue;
-          }
+    if (!m_stateBuffer.isBound(m_stateLayout, m_stateVersion, m_ownedVersion))
+      m_stateBuffer.bind(m_stateLayout, m_layerState, m_owned, m_stateVersion, m_ownedVersion, m_name);
 
-          if (m_mode == ALPHA) {
-            if (m_opacity >= 1) {
-              LumiverseTypeUtils::copyByVal(src, dest);
-            }
-            else {
-              // Generic alpha blending formula is res = src * opacity + dest * (1 - opacity)
-              // Looks an awful lot like a lerp no?
-              shared_ptr<LumiverseType> res = LumiverseTypeUtils::lerp(dest, src, m_opacity);
-              LumiverseTypeUtils::copyByVal(res.get(), dest);
-            }
-          }
-          else if (m_mode == OVERWRITE) {
-            LumiverseTypeUtils::copyByVal(src, dest);
-          }
-        }
+    writeCurveValues();
+    Eigen::ArrayXf values = m_stateLayout.read();
+    m_stateBuffer.gather();
+
+    LayerBuffer::Op ops[LayerBuffer::NUM_TYPES];
+    getBlendOps(ops);
+    m_stateBuffer.blend(values, m_stateLayout, ops);
+
+    m_stateLayout.write(values, m_stateBuffer.getSlots());
+  }
+
+  void Layer::blend(Eigen::ArrayXf& values, const ParamLayout& layout, SlotSet* touched) {
+    if (!m_buffer.isBound(layout, m_stateVersion, m_ownedVersion)) {
+      unlinkCurves();
+      m_buffer.bind(layout, m_layerState, m_owned, m_stateVersion, m_ownedVersion, m_name);
+    }
+
+    // Values from the playheads are already in the buffer once they're linked
+    m_buffer.gather();
+    linkCurves();
+
+    LayerBuffer::Op ops[LayerBuffer::NUM_TYPES];
+    getBlendOps(ops);
+    m_buffer.blend(values, layout, ops);
+
+    if (touched != nullptr) {
+      for (int slot : m_buffer.getSlots()) {
+        touched->insert(slot);
+      }
+    }
+  }
+
+  void Layer::linkCurves() {
+    if (m_curvesLinked || m_playbackData == nullptr)
+      return;
+
+    for (auto& p : m_playbackData->partitions) {
+      for (size_t i = 0; i < p.curves.getNumScalars(); i++) {
+        int unit;
+        float* target = m_buffer.feed(p.curves.getScalarParam(i), unit);
+        if (target != nullptr)
+          p.curves.setTarget(i, target, unit);
       }
-      catch (exception e) {
-        stringstream ss;
-        ss << "State given to layer " << m_name << " does not contain a device with id " << device.first;
-        Logger::log(WARN, ss.str());
+    }
+
+    m_curvesLinked = true;
+  }
+
+  void Layer::unlinkCurves() {
+    if (!m_curvesLinked)
+      return;
+
+    if (m_playbackData != nullptr) {
+      for (auto& p : m_playbackData->partitions) {
+        p.curves.writeParams();
+        p.curves.clearTargets();
       }
     }
+
+    m_buffer.clearFeeds();
+    m_curvesLinked = false;
+  }
+
+  void Layer::writeCurveValues() {
+    if (!m_curvesLinked || m_playbackData == nullptr)
+      return;
+
+    for (auto& p : m_playbackData->partitions) {
+      p.curves.writeParams();
+    }
   }
 
   JSONNode Layer::toJSON() {
@@ -462,6 +745,17 @@ namespace ShowControl {
     layer.push_back(JSONNode("mode", BlendModeToString(m_mode)));
 #endif
     layer.push_back(JSONNode("opacity", m_opacity));
+
+    JSONNode typeModes;
+    typeModes.set_name("typeModes");
+    for (const auto& kvp : m_typeModes) {
+#ifdef USE_C11_MAPS
+      typeModes.push_back(JSONNode(kvp.first, BlendModeToString[kvp.second]));
+#else
+      typeModes.push_back(JSONNode(kvp.first, BlendModeToString(kvp.second)));
+#endif
+    }
+    layer.push_back(typeModes);
     layer.push_back(JSONNode("lastPlayedTimeline", m_lastPlayedTimeline));
     layer.push_back(JSONNode("currentCue", m_currentCue));
 
@@ -473,6 +767,7 @@ namespace ShowControl {
     }
 
     // Copy state
+    writeCurveValues();
     JSONNode layerState;
     layerState.set_name("state");
     for (const auto& kvp : m_layerState) {
@@ -486,10 +781,24 @@ namespace ShowControl {
 
     layer.push_back(layerState);
 
+    JSONNode owned;
+    owned.set_name("owned");
+    for (const auto& kvp : m_owned) {
+      JSONNode params(JSON_ARRAY);
+      params.set_name(kvp.first);
+      for (const auto& p : kvp.second) {
+        params.push_back(JSONNode("", p));
+      }
+      owned.push_back(params);
+    }
+
+    layer.push_back(owned);
+
     return layer;
   }
 
   void Layer::reset() {
+    writeCurveValues();
     for (const auto& kvp : m_layerState) {
       for (const auto& pkvp : kvp.second) {
         pkvp.second->reset();
@@ -536,6 +845,7 @@ namespace ShowControl {
         play(nextCue);
       }
       else if (m_currentCue < 0) {
+        m_currentCue = m_cueList->getFirstCueNum();
         play(m_cueList->getFirstCue());
       }
     }
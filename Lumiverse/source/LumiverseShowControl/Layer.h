@@ -5,6 +5,8 @@
 
 #include "LumiverseCore.h"
 #include "Timeline.h"
+#include "TimelineGraph.h"
+#include "ParamLayout.h"
 #include "Playback.h"
 #include "CueList.h"
 #include "Cue.h"
@@ -18,6 +20,33 @@ namespace ShowControl {
   class Playback;
   class CueList;
   
+  /*! \brief A Layer parameter and its position in the Timeline being played. */
+  struct ParamCursor {
+    string id;
+    string param;
+    LumiverseType* val;
+    TrackCursor cursor;
+
+    /*! \brief True once the parameter is owned by the Layer. */
+    bool owned;
+  };
+
+  /*!
+  \brief A group of Layer parameters evaluated together.
+
+  Partitions hold whole devices and can be evaluated on different threads.
+  */
+  struct PlaybackPartition {
+    /*! \brief Cursors for parameters that couldn't be baked. */
+    vector<ParamCursor> cursors;
+
+    /*! \brief Evaluates parameters with baked curves. These parameters have no cursor. */
+    CurvePlayhead curves;
+
+    /*! \brief Cursors whose parameters got their first value during the last evaluation. */
+    vector<size_t> newlyOwned;
+  };
+
   /*! \brief Data that tracks the progress of a Timeline. */
   struct PlaybackData {
     chrono::time_point<chrono::high_resolution_clock> start;    // Timeline start time. More accurate to take difference between now and start instead of summing.
@@ -26,6 +55,24 @@ namespace ShowControl {
     bool complete;
     chrono::time_point<chrono::high_resolution_clock> elapsed;
     size_t length;
+
+    /*! \brief Every parameter in the Layer state, split into partitions. Rebuilt when either changes. */
+    vector<PlaybackPartition> partitions;
+
+    /*! \brief The Timeline being played and every timeline it references. */
+    TimelineGraph graph;
+
+    /*! \brief Timeline track version the cursors were built for. */
+    unsigned int trackVersion;
+
+    /*! \brief Layer state version the cursors were built for. */
+    unsigned int stateVersion;
+
+    /*! \brief Timeline time for the current update, in ms. */
+    size_t time;
+
+    /*! \brief Timeline time for the previous update, in ms. */
+    size_t prevTime;
   };
 
   /*!
@@ -37,15 +84,30 @@ namespace ShowControl {
   and perform the appropriate functions to flatten the layers.
   Layers work by creating duplicates of the devices in a Rig 
   and manipulating their state.
+
+  A Layer only blends the parameters it owns. Parameters are owned once they're
+  added to the Layer with one of the add functions, or once a Timeline played on
+  the Layer gives them a value. Layers built from the whole Rig start out owning
+  nothing, so they don't cover up lower layers with default values.
   */
   class Layer
   {
   public:
+    /*!
+    \brief Ways a Layer combines its parameters with the layers below it.
+
+    Every mode other than OVERWRITE is faded in by the layer opacity. ADD, SUBTRACT
+    and MULTIPLY clamp to the range of the parameter. Enums can't be added or
+    multiplied and are alpha blended in those modes.
+    */
     enum BlendMode {
       ALPHA,      /*!< Blend all parameters using traditional alpha blending. */
       OVERWRITE,  /*!< Overwrite all previous parameter values */
-      MAX,        /*!< Highest parameter value takes precedence */
-      MIN         /*!< Lowest parameter value takes precedence*/
+      MAX,        /*!< Highest parameter value takes precedence (HTP) */
+      MIN,        /*!< Lowest parameter value takes precedence*/
+      ADD,        /*!< Adds the layer value to the value below it */
+      SUBTRACT,   /*!< Subtracts the layer value from the value below it */
+      MULTIPLY    /*!< Scales the value below by the layer value as a fraction of its range */
     };
 
     /*!
@@ -53,6 +115,7 @@ namespace ShowControl {
 
     Copies all devices from the Rig, resets them to defaults, and sets the mode.
     By default the Layer will be set to ALPHA. A Layer is set to inactive on construction.
+    None of the copied parameters are owned.
     */
     Layer(Rig* rig, Playback* pb, string name, int priority, BlendMode mode = ALPHA);
 
@@ -114,12 +177,34 @@ namespace ShowControl {
     */
     void stop();
 
+    /*!
+    \brief Returns true if the Layer has a Timeline playing or waiting to start on the next update.
+
+    Paused Timelines don't count as playing.
+    */
+    bool isPlaying();
+
     /*! \brief Gets the layer's blend mode */
     BlendMode getMode() { return m_mode; }
 
     /*! \brief Sets the Layer's blend mode. */
     void setMode(BlendMode mode) { m_mode = mode; }
 
+    /*!
+    \brief Sets the blend mode used for one type of parameter.
+
+    Overrides the layer's blend mode for that type, so that a layer can, for example,
+    take the highest intensity while alpha blending everything else.
+    \param typeName Parameter type name, as returned by LumiverseType::getTypeName().
+    */
+    void setTypeMode(string typeName, BlendMode mode) { m_typeModes[typeName] = mode; }
+
+    /*! \brief Gets the blend mode used for a type of parameter. */
+    BlendMode getTypeMode(string typeName);
+
+    /*! \brief Removes a type's blend mode, so it uses the layer's blend mode again. */
+    void removeTypeMode(string typeName) { m_typeModes.erase(typeName); }
+
     /*! \brief Get the layer's opacity. */
     float getOpacity() { return m_opacity; }
 
@@ -130,10 +215,10 @@ namespace ShowControl {
     bool isActive() { return m_active; }
 
     /*! \brief Set m_active to true. */
-    void activate() { m_active = true; }
+    void activate();
     
     /*! \brief Set m_active to false. */
-    void deactivate() { m_active = false; }
+    void deactivate();
 
     /*! \brief Set the layer name */
     void setName(string name) { m_name = name; }
@@ -142,7 +227,7 @@ namespace ShowControl {
     string getName() { return m_name; }
 
     /*! \brief Sets the priority */
-    void setPriority(int priority) { m_priority = priority; }
+    void setPriority(int priority);
 
     /*! \brief Gets the priority. */
     int getPriority() { return m_priority; }
@@ -200,9 +285,27 @@ namespace ShowControl {
     /*!
     \brief Gets the layer state.
 
-    The layer state can be manipulated through this map.
+    The layer state can be manipulated through this map. Values written through the map
+    are only blended if the parameter is owned. \sa setParameterOwned()
+
+    Baked curves write their values into the blend buffer during playback, so the
+    parameters they drive are brought up to date here first.
     */
-    map<string, map<string, LumiverseType*> >& getLayerState() { return m_layerState; }
+    map<string, map<string, LumiverseType*> >& getLayerState();
+
+    /*! \brief Checks if the Layer owns, and therefore blends, a parameter. */
+    bool isParameterOwned(string id, string param);
+
+    /*!
+    \brief Sets whether the Layer owns a parameter.
+
+    Use this to blend values written directly into the layer state.
+    Parameters not in the layer state are ignored.
+    */
+    void setParameterOwned(string id, string param, bool owned);
+
+    /*! \brief Gets the owned parameters of each device. */
+    const map<string, set<string> >& getOwnedParameters() { return m_owned; }
 
     /*!
     \brief Updates the Layer. If cues a running, the cues get updated.
@@ -211,6 +314,34 @@ namespace ShowControl {
     */
     void update(chrono::time_point<chrono::high_resolution_clock> updateStart);
 
+    /*!
+    \brief First stage of update(). Starts queued playback and refreshes cached
+    timeline data.
+
+    update() is split into stages so Playback can evaluate several layers at once.
+    Call beginUpdate(), then updatePartition() for every partition, then endUpdate().
+    Only updatePartition() is safe to call concurrently.
+    \return Number of partitions to evaluate.
+    */
+    size_t beginUpdate(chrono::time_point<chrono::high_resolution_clock> updateStart);
+
+    /*!
+    \brief Evaluates one partition of the layer's parameters at the current time.
+
+    Different partitions, including partitions of different layers, may be evaluated
+    on different threads at the same time.
+    */
+    void updatePartition(size_t partition);
+
+    /*!
+    \brief Last stage of update(). Runs timeline events and ends playback if the
+    timeline is done.
+    */
+    void endUpdate(chrono::time_point<chrono::high_resolution_clock> updateStart);
+
+    /*! \brief Approximate number of parameters in each partition. */
+    static const size_t PARTITION_SIZE = 512;
+
     /*!
     \brief Blends this layer with the given state.
 
@@ -222,7 +353,20 @@ namespace ShowControl {
     will be modified, and thus we don't have to write the results into a separate
     return data structure.
     */
-    void blend(map<string, Device*> currentState);
+    void blend(const map<string, Device*>& currentState);
+
+    /*!
+    \brief Blends this layer into a dense state.
+
+    This is what Playback uses. The layer's parameters are matched up with the layout
+    once, and again whenever the layer gains or loses parameters, so blending doesn't
+    look anything up.
+    \param values Scalar values of the state, laid out by layout. Updated in place.
+    \param layout Layout of the state. Color and enum results are written directly into
+    the layout's parameters.
+    \param touched If given, every slot the layer blended into is added to it.
+    */
+    void blend(Eigen::ArrayXf& values, const ParamLayout& layout, SlotSet* touched = nullptr);
 
     /*! \brief Returns the JSON representation of a Layer. */
     JSONNode toJSON();
@@ -299,6 +443,9 @@ namespace ShowControl {
     /*! \brief Layer blend mode. */
     BlendMode m_mode;
 
+    /*! \brief Blend modes that override m_mode for a parameter type, by type name. */
+    map<string, BlendMode> m_typeModes;
+
     /*! \brief If using alpha blending, the opacity of the layer. */
     float m_opacity;
 
@@ -356,6 +503,63 @@ namespace ShowControl {
     PlaybackData* m_queuedPlayback;
 
     mutex m_queue;
+
+    /*!
+    \brief Incremented whenever parameters are added to or removed from m_layerState.
+
+    Lets playback know when its cached parameter pointers are stale.
+    */
+    unsigned int m_stateVersion;
+
+    /*! \brief Set by beginUpdate() when there are partitions to evaluate. */
+    bool m_evaluating;
+
+    /*! \brief Layer parameters lined up with the Playback state. */
+    LayerBuffer m_buffer;
+
+    /*! \brief Set while the playheads write their scalar values into m_buffer. */
+    bool m_curvesLinked;
+
+    /*!
+    \brief Layout of the last state passed to blend(const map<string, Device*>&).
+
+    Rebuilt when devices or parameters are added to or removed from that state.
+    */
+    ParamLayout m_stateLayout;
+
+    /*! \brief Layer parameters lined up with m_stateLayout. */
+    LayerBuffer m_stateBuffer;
+
+    /*! \brief Parameters of each device that the Layer blends. */
+    map<string, set<string> > m_owned;
+
+    /*! \brief Incremented whenever m_owned changes. */
+    unsigned int m_ownedVersion;
+
+    /*! \brief Kernel and opacity for each parameter type, from the blend modes. */
+    void getBlendOps(LayerBuffer::Op ops[LayerBuffer::NUM_TYPES]);
+
+    /*! \brief Marks every parameter in the layer state as owned. */
+    void ownAll();
+
+    /*! \brief Marks a parameter as owned. */
+    void own(const string& id, const string& param);
+
+    /*! \brief Creates the cursors for each parameter in the Layer state. */
+    void buildCursors(PlaybackData* pbd, shared_ptr<Timeline> tl, unsigned int trackVersion);
+
+    /*! \brief Points the playheads' scalar outputs at their values in m_buffer. */
+    void linkCurves();
+
+    /*!
+    \brief Sends the playheads' scalar outputs back to the layer state.
+
+    Must be called before m_buffer is rebound or the playback data is replaced.
+    */
+    void unlinkCurves();
+
+    /*! \brief Copies values that the playheads wrote into m_buffer to the layer state. */
+    void writeCurveValues();
   };
 
 #ifdef USE_C11_MAPS
@@ -364,7 +568,10 @@ namespace ShowControl {
       { Layer::ALPHA, "ALPHA" },
       { Layer::OVERWRITE, "OVERWRITE" },
       { Layer::MAX, "MAX" },
-      { Layer::MIN, "MIN" }
+      { Layer::MIN, "MIN" },
+      { Layer::ADD, "ADD" },
+      { Layer::SUBTRACT, "SUBTRACT" },
+      { Layer::MULTIPLY, "MULTIPLY" }
   };
 
   /*! \brief String translation back to Enum for data load */
@@ -372,7 +579,10 @@ namespace ShowControl {
       { "ALPHA", Layer::ALPHA },
       { "OVERWRITE", Layer::OVERWRITE },
       { "MAX", Layer::MAX },
-      { "MIN", Layer::MIN }
+      { "MIN", Layer::MIN },
+      { "ADD", Layer::ADD },
+      { "SUBTRACT", Layer::SUBTRACT },
+      { "MULTIPLY", Layer::MULTIPLY }
   };
 #else
 	static string BlendModeToString(Layer::BlendMode b) {
@@ -381,6 +591,9 @@ namespace ShowControl {
 		case Layer::OVERWRITE: return "OVERWRITE";
 		case Layer::MAX: return "MAX";
 		case Layer::MIN: return "MIN";
+		case Layer::ADD: return "ADD";
+		case Layer::SUBTRACT: return "SUBTRACT";
+		case Layer::MULTIPLY: return "MULTIPLY";
 		default: return "";
 		}
 	}
@@ -390,7 +603,10 @@ namespace ShowControl {
 		if (b == "OVERWRITE") return Layer::OVERWRITE;
 		if (b == "MAX") return Layer::MAX;
 		if (b == "MIN") return Layer::MIN;
-		return Layer::BLEND_OPAQUE;
+		if (b == "ADD") return Layer::ADD;
+		if (b == "SUBTRACT") return Layer::SUBTRACT;
+		if (b == "MULTIPLY") return Layer::MULTIPLY;
+		return Layer::ALPHA;
 	}
 #endif
 
@@ -1,9 +1,13 @@
 // Header that includes all the files in the LumiverseShowControl project
 
 #include "Timeline.h"
+#include "CurveTracks.h"
+#include "TimelineGraph.h"
+#include "ParamLayout.h"
 #include "Layer.h"
 #include "Programmer.h"
 #include "Playback.h"
+#include "OfflineRunner.h"
 #include "Snapshot.h"
 #include "SineWave.h"
 #include "Cue.h"
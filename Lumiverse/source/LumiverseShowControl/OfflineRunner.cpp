@@ -0,0 +1,104 @@
+#include "OfflineRunner.h"
+
+namespace Lumiverse {
+namespace ShowControl {
+
+OfflineRunner::OfflineRunner(Playback* pb, unsigned int frameRate) : m_pb(pb), m_rig(pb->getRig()),
+  m_frame(0), m_clockInstalled(false)
+{
+  if (frameRate == 0)
+    frameRate = m_rig->getRefreshRate();
+
+  m_frameTime = chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / frameRate));
+
+  // Carry on from the current time so that anything already playing doesn't jump.
+  m_clock = make_shared<SteppingClock>(m_rig->getClock().now());
+
+  // Swapping the clock under a running update loop would make it jump, so leave
+  // a running Rig alone.
+  if (m_rig->isRunning()) {
+    Logger::log(ERR, "Offline rendering requires the Rig to be stopped.");
+    return;
+  }
+
+  m_rig->setClock(m_clock);
+  m_clockInstalled = true;
+
+  if (!m_pb->isRunning())
+    m_pb->start();
+}
+
+OfflineRunner::~OfflineRunner() {
+  if (m_clockInstalled)
+    m_rig->setClock(nullptr);
+}
+
+bool OfflineRunner::step(FrameCallback onFrame) {
+  if (!m_clockInstalled || m_rig->isRunning())
+    return false;
+
+  // A Playback attached to the Rig is updated by Rig::updateOnce()
+  if (!m_pb->isAttached())
+    m_pb->update();
+  m_rig->updateOnce();
+
+  if (onFrame)
+    onFrame(m_frame, m_clock->now());
+
+  m_frame++;
+  m_clock->step(m_frameTime);
+  return true;
+}
+
+size_t OfflineRunner::run(size_t frames, FrameCallback onFrame) {
+  size_t count = 0;
+  while (count < frames && step(onFrame)) {
+    count++;
+  }
+
+  return count;
+}
+
+size_t OfflineRunner::runUntilIdle(size_t maxFrames, FrameCallback onFrame) {
+  size_t count = 0;
+  while (count < maxFrames && step(onFrame)) {
+    count++;
+
+    if (!isPlaying())
+      break;
+  }
+
+  return count;
+}
+
+size_t OfflineRunner::renderCueList(string layerName, size_t maxFramesPerCue, FrameCallback onFrame) {
+  shared_ptr<Layer> layer = m_pb->getLayer(layerName);
+  if (layer == nullptr || !layer->hasCueList()) {
+    Logger::log(ERR, "Layer " + layerName + " does not exist or has no cue list to render.");
+    return 0;
+  }
+
+  // Start from the top of the list
+  layer->setCueList(layer->getCueList(), true);
+  size_t numCues = layer->getCueList()->getCueList().size();
+  size_t count = 0;
+
+  for (size_t i = 0; i < numCues; i++) {
+    layer->go();
+    count += runUntilIdle(maxFramesPerCue, onFrame);
+  }
+
+  return count;
+}
+
+bool OfflineRunner::isPlaying() {
+  for (const auto& l : m_pb->getLayers()) {
+    if (l.second->isPlaying())
+      return true;
+  }
+
+  return false;
+}
+
+}
+}
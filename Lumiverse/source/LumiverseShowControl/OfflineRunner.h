@@ -0,0 +1,105 @@
+#ifndef _OFFLINERUNNER_H_
+#define _OFFLINERUNNER_H_
+
+#pragma once
+
+#include "LumiverseCore.h"
+#include "Playback.h"
+
+namespace Lumiverse {
+namespace ShowControl {
+
+/*!
+\brief Runs a Playback on a virtual clock, as fast as frames can be computed.
+
+The runner gives the Rig a SteppingClock and drives the update loop itself: each frame
+updates the Playback and the Rig's patches at the current virtual time, then moves the
+clock forward by one frame. Layers see exactly the same frame times every run, so
+renders are repeatable and can be used to export, validate or benchmark a show.
+
+The Rig must not be running while the runner is in use. Read device states or DMX
+universes (DMXPatch::getUniverse() or DMXPatch::getUniverses()) from the frame callback.
+*/
+class OfflineRunner
+{
+public:
+  /*!
+  \brief Called after every frame.
+  \param frame Number of the frame, counting from 0 for the first frame the runner made.
+  \param time Virtual time of the frame.
+  */
+  typedef function<void(size_t frame, Clock::time_point time)> FrameCallback;
+
+  /*!
+  \brief Prepares a Playback for offline rendering.
+
+  Replaces the Rig's clock and starts the Playback if it isn't running. If the Rig is
+  running, nothing is changed and step() always returns false.
+  \param pb Playback to run.
+  \param frameRate Frames per virtual second. 0 uses the Rig's refresh rate.
+  */
+  OfflineRunner(Playback* pb, unsigned int frameRate = 0);
+
+  /*! \brief Puts the Rig back on a SystemClock, if the runner replaced its clock. */
+  ~OfflineRunner();
+
+  /*!
+  \brief Renders one frame.
+  \return False if the frame couldn't be rendered because the Rig is running.
+  */
+  bool step(FrameCallback onFrame = nullptr);
+
+  /*!
+  \brief Renders a number of frames.
+  \return Number of frames rendered.
+  */
+  size_t run(size_t frames, FrameCallback onFrame = nullptr);
+
+  /*!
+  \brief Renders frames until no Layer in the Playback is playing a Timeline.
+
+  At least one frame is rendered so that Timelines started since the last frame get to
+  begin playing.
+  \param maxFrames Stops after this many frames even if Layers are still playing, for
+  example when a Timeline loops forever.
+  \return Number of frames rendered.
+  */
+  size_t runUntilIdle(size_t maxFrames, FrameCallback onFrame = nullptr);
+
+  /*!
+  \brief Renders every cue in a Layer's CueList, from the first cue to the last.
+
+  Each cue is started with Layer::go() once the previous one has finished.
+  \param layerName Layer with the CueList to render.
+  \param maxFramesPerCue Limit on the frames rendered for each cue.
+  \return Number of frames rendered.
+  */
+  size_t renderCueList(string layerName, size_t maxFramesPerCue, FrameCallback onFrame = nullptr);
+
+  /*! \brief Number of frames rendered so far. */
+  size_t getFrame() { return m_frame; }
+
+  /*! \brief Virtual time between frames. */
+  Clock::duration getFrameTime() { return m_frameTime; }
+
+  /*! \brief The clock given to the Rig. */
+  SteppingClock& getClock() { return *m_clock; }
+
+private:
+  Playback* m_pb;
+  Rig* m_rig;
+  shared_ptr<SteppingClock> m_clock;
+  Clock::duration m_frameTime;
+  size_t m_frame;
+
+  /*! \brief Set if the constructor gave m_clock to the Rig. */
+  bool m_clockInstalled;
+
+  /*! \brief Returns true if any Layer of the Playback is playing. */
+  bool isPlaying();
+};
+
+}
+}
+
+#endif
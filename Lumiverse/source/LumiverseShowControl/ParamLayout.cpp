@@ -0,0 +1,468 @@
+#include "ParamLayout.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Lumiverse {
+namespace ShowControl {
+
+// Layout ids start at 1 so that 0 never matches a bound layout.
+static atomic<unsigned int> nextLayoutId(1);
+
+ParamLayout::ParamLayout() : m_id(nextLayoutId++) { }
+
+void ParamLayout::build(const map<string, Device*>& devices) {
+  m_id = nextLayoutId++;
+  m_slots.clear();
+  m_params.clear();
+  m_units.clear();
+  m_deviceIds.clear();
+  m_devices.clear();
+  m_names.clear();
+  m_sourceDevices.clear();
+  m_sourceParams.clear();
+
+  vector<float> defaults;
+  vector<float> lo;
+  vector<float> hi;
+  vector<pair<int, string> > others;
+
+  // Scalars first
+  for (const auto& d : devices) {
+    int device = (int)m_deviceIds.size();
+    m_deviceIds.push_back(d.first);
+    m_slots[d.first];
+    m_sourceDevices.push_back(d.second);
+
+    for (const auto& p : d.second->getRawParameters()) {
+      LumiverseType* param = p.second;
+      m_sourceParams.push_back(param);
+
+      if (param->getTypeName() == "float") {
+        LumiverseFloat* f = (LumiverseFloat*)param;
+        m_units.push_back(-1);
+        defaults.push_back(f->getDefault());
+        lo.push_back(f->getMin());
+        hi.push_back(f->getMax());
+      }
+      else if (param->getTypeName() == "orientation") {
+        LumiverseOrientation* o = (LumiverseOrientation*)param;
+        m_units.push_back(o->getUnit());
+        defaults.push_back(o->getDefault());
+        lo.push_back(o->getMin());
+        hi.push_back(o->getMax());
+      }
+      else {
+        others.push_back(make_pair(device, p.first));
+        continue;
+      }
+
+      m_slots[d.first][p.first] = (int)m_params.size();
+      m_params.push_back(param);
+      m_devices.push_back(device);
+      m_names.push_back(p.first);
+    }
+  }
+
+  for (const auto& o : others) {
+    const string& id = m_deviceIds[o.first];
+    m_slots[id][o.second] = (int)m_params.size();
+    m_params.push_back(devices.at(id)->getParam(o.second));
+    m_units.push_back(-1);
+    m_devices.push_back(o.first);
+    m_names.push_back(o.second);
+  }
+
+  m_defaults = Eigen::Map<Eigen::ArrayXf>(defaults.data(), defaults.size());
+  m_min = Eigen::Map<Eigen::ArrayXf>(lo.data(), lo.size());
+  m_max = Eigen::Map<Eigen::ArrayXf>(hi.data(), hi.size());
+  m_invRange = (m_max > m_min).select((m_max - m_min).inverse(), 0);
+}
+
+bool ParamLayout::isBuiltFrom(const map<string, Device*>& devices) const {
+  if (devices.size() != m_sourceDevices.size())
+    return false;
+
+  // Walk the devices the same way build() does
+  size_t device = 0;
+  size_t param = 0;
+  for (const auto& d : devices) {
+    if (d.second != m_sourceDevices[device] || d.first != m_deviceIds[device])
+      return false;
+    device++;
+
+    for (const auto& p : d.second->getRawParameters()) {
+      if (param >= m_sourceParams.size() || p.second != m_sourceParams[param])
+        return false;
+      param++;
+    }
+  }
+
+  return param == m_sourceParams.size();
+}
+
+int ParamLayout::getSlot(const string& id, const string& param) const {
+  auto d = m_slots.find(id);
+  if (d == m_slots.end())
+    return -1;
+
+  auto p = d->second.find(param);
+  if (p == d->second.end())
+    return -1;
+
+  return p->second;
+}
+
+float ParamLayout::toSlotValue(LumiverseType* val, int unit) {
+  if (unit < 0)
+    return ((LumiverseFloat*)val)->getVal();
+
+  return ((LumiverseOrientation*)val)->valAsUnit((ORIENTATION_UNIT)unit);
+}
+
+void ParamLayout::resetNonScalars() const {
+  for (size_t i = getNumScalars(); i < m_params.size(); i++) {
+    m_params[i]->reset();
+  }
+}
+
+void ParamLayout::reset(Eigen::ArrayXf& values, const vector<int>& slots) const {
+  int numScalars = (int)getNumScalars();
+
+  for (int slot : slots) {
+    if (slot < numScalars)
+      values[slot] = m_defaults[slot];
+    else
+      m_params[slot]->reset();
+  }
+}
+
+void ParamLayout::write(const Eigen::ArrayXf& values, const vector<int>& slots) const {
+  int numScalars = (int)getNumScalars();
+
+  for (int slot : slots) {
+    if (slot >= numScalars)
+      continue;
+
+    if (m_units[slot] < 0)
+      ((LumiverseFloat*)m_params[slot])->setVal(values[slot]);
+    else
+      ((LumiverseOrientation*)m_params[slot])->setVal(values[slot], (ORIENTATION_UNIT)m_units[slot]);
+  }
+}
+
+Eigen::ArrayXf ParamLayout::read() const {
+  Eigen::ArrayXf values(getNumScalars());
+
+  for (size_t i = 0; i < getNumScalars(); i++) {
+    values[i] = toSlotValue(m_params[i], m_units[i]);
+  }
+
+  return values;
+}
+
+void ParamLayout::write(const Eigen::ArrayXf& values) const {
+  size_t numScalars = getNumScalars();
+
+  for (size_t i = 0; i < numScalars; i++) {
+    if (m_units[i] < 0)
+      ((LumiverseFloat*)m_params[i])->setVal(values[i]);
+    else
+      ((LumiverseOrientation*)m_params[i])->setVal(values[i], (ORIENTATION_UNIT)m_units[i]);
+  }
+}
+
+void SlotSet::resize(size_t numSlots) {
+  m_contains.assign(numSlots, 0);
+  m_slots.clear();
+}
+
+void SlotSet::clear() {
+  for (int slot : m_slots) {
+    m_contains[slot] = 0;
+  }
+  m_slots.clear();
+}
+
+// Kernel result for a single scalar slot.
+static inline float applyKernel(LayerBuffer::Kernel kernel, float s, float l, float lo, float hi, float invRange) {
+  switch (kernel) {
+  case LayerBuffer::MAX: return max(s, l);
+  case LayerBuffer::MIN: return min(s, l);
+  case LayerBuffer::ADD: return min(max(s + l, lo), hi);
+  case LayerBuffer::SUBTRACT: return min(max(s - l, lo), hi);
+  case LayerBuffer::MULTIPLY: return min(max(s * ((l - lo) * invRange), lo), hi);
+  default: return l;
+  }
+}
+
+// values = values * (1 - a) + f * a, with a = weights * opacity. Same formula as
+// LumiverseTypeUtils::lerp, so with a weight of 1 a LERP gives exactly the layer value
+// and with a weight of 0 every kernel leaves the state value alone.
+template<typename Expr>
+static inline void mix(Eigen::ArrayXf& values, const Eigen::ArrayXf& weights, float opacity, const Expr& f) {
+  values = values * (1 - weights * opacity) + f * (weights * opacity);
+}
+
+LayerBuffer::LayerBuffer() : m_layoutId(0), m_stateVersion(0), m_ownedVersion(0), m_numScalars(0),
+  m_feedsChanged(false) { }
+
+bool LayerBuffer::isBound(const ParamLayout& layout, unsigned int stateVersion, unsigned int ownedVersion) const {
+  return m_layoutId == layout.getId() && m_stateVersion == stateVersion && m_ownedVersion == ownedVersion;
+}
+
+void LayerBuffer::bind(const ParamLayout& layout, const map<string, map<string, LumiverseType*> >& state,
+  const map<string, set<string> >& owned, unsigned int stateVersion, unsigned int ownedVersion,
+  const string& layerName)
+{
+  m_slots.clear();
+  m_colors.clear();
+  m_enums.clear();
+  m_scalarIndex.clear();
+
+  for (ScalarGroup& g : m_scalars) {
+    g.slots.clear();
+    g.units.clear();
+    g.src.clear();
+  }
+
+  m_numScalars = layout.getNumScalars();
+  int numScalars = (int)m_numScalars;
+  vector<pair<int, LumiverseType*> > others;
+
+  for (const auto& device : owned) {
+    auto params = state.find(device.first);
+    if (params == state.end())
+      continue;
+
+    if (!layout.hasDevice(device.first)) {
+      stringstream ss;
+      ss << "State given to layer " << layerName << " does not contain a device with id " << device.first;
+      Logger::log(WARN, ss.str());
+      continue;
+    }
+
+    for (const auto& name : device.second) {
+      auto param = params->second.find(name);
+      if (param == params->second.end())
+        continue;
+
+      int slot = layout.getSlot(device.first, name);
+      if (slot < 0 || !LumiverseTypeUtils::areSameType(param->second, layout.getParam(slot)))
+        continue;
+
+      if (slot < numScalars) {
+        int unit = layout.getUnit(slot);
+        int group = (unit < 0) ? FLOAT : ORIENTATION;
+        ScalarGroup& g = m_scalars[group];
+        m_scalarIndex[param->second] = make_pair(group, (int)g.slots.size());
+        g.slots.push_back(slot);
+        g.units.push_back(unit);
+        g.src.push_back(param->second);
+      }
+      else {
+        others.push_back(make_pair(slot, param->second));
+      }
+    }
+  }
+
+  for (ScalarGroup& g : m_scalars) {
+    finishGroup(g);
+    m_slots.insert(m_slots.end(), g.slots.begin(), g.slots.end());
+  }
+
+  clearFeeds();
+
+  for (const auto& o : others) {
+    m_slots.push_back(o.first);
+
+    if (o.second->getTypeName() == "color")
+      m_colors.push_back(make_pair((LumiverseColor*)o.second, (LumiverseColor*)layout.getParam(o.first)));
+    else if (o.second->getTypeName() == "enum")
+      m_enums.push_back(make_pair((LumiverseEnum*)o.second, (LumiverseEnum*)layout.getParam(o.first)));
+  }
+
+  m_layoutId = layout.getId();
+  m_stateVersion = stateVersion;
+  m_ownedVersion = ownedVersion;
+}
+
+void LayerBuffer::finishGroup(ScalarGroup& g) {
+  g.dense = !g.slots.empty() && (g.slots.size() * DENSE_FRACTION >= m_numScalars);
+  g.valueIndex.clear();
+
+  if (g.dense) {
+    g.values = Eigen::ArrayXf::Zero(m_numScalars);
+    g.weights = Eigen::ArrayXf::Zero(m_numScalars);
+
+    for (int slot : g.slots) {
+      g.valueIndex.push_back(slot);
+      g.weights[slot] = 1;
+    }
+  }
+  else {
+    g.values = Eigen::ArrayXf::Zero(g.slots.size());
+    g.weights.resize(0);
+
+    for (size_t i = 0; i < g.slots.size(); i++) {
+      g.valueIndex.push_back((int)i);
+    }
+  }
+}
+
+void LayerBuffer::gather() {
+  if (m_feedsChanged) {
+    for (ScalarGroup& g : m_scalars) {
+      g.gathered.clear();
+      for (size_t i = 0; i < g.slots.size(); i++) {
+        if (!g.fed[i])
+          g.gathered.push_back((int)i);
+      }
+    }
+
+    m_feedsChanged = false;
+  }
+
+  for (ScalarGroup& g : m_scalars) {
+    for (int i : g.gathered) {
+      g.values[g.valueIndex[i]] = ParamLayout::toSlotValue(g.src[i], g.units[i]);
+    }
+  }
+}
+
+float* LayerBuffer::feed(LumiverseType* src, int& unit) {
+  auto it = m_scalarIndex.find(src);
+  if (it == m_scalarIndex.end())
+    return nullptr;
+
+  ScalarGroup& g = m_scalars[it->second.first];
+  int i = it->second.second;
+
+  g.fed[i] = true;
+  m_feedsChanged = true;
+  unit = g.units[i];
+  return &g.values[g.valueIndex[i]];
+}
+
+void LayerBuffer::clearFeeds() {
+  for (ScalarGroup& g : m_scalars) {
+    g.fed.assign(g.slots.size(), false);
+    g.gathered.resize(g.slots.size());
+    for (size_t i = 0; i < g.slots.size(); i++) {
+      g.gathered[i] = (int)i;
+    }
+  }
+
+  m_feedsChanged = false;
+}
+
+void LayerBuffer::blend(Eigen::ArrayXf& values, const ParamLayout& layout, const Op ops[NUM_TYPES]) {
+  if ((size_t)values.size() != m_numScalars || layout.getId() != m_layoutId)
+    return;
+
+  blendGroup(values, layout, m_scalars[FLOAT], ops[FLOAT]);
+  blendGroup(values, layout, m_scalars[ORIENTATION], ops[ORIENTATION]);
+  blendColors(ops[COLOR]);
+  blendEnums(ops[ENUM]);
+}
+
+void LayerBuffer::blendGroup(Eigen::ArrayXf& values, const ParamLayout& layout, ScalarGroup& g, const Op& op) {
+  if (g.slots.empty())
+    return;
+
+  const Eigen::ArrayXf& lo = layout.getMin();
+  const Eigen::ArrayXf& hi = layout.getMax();
+  const Eigen::ArrayXf& invRange = layout.getInvRange();
+
+  if (g.dense) {
+    switch (op.kernel) {
+    case MAX:
+      mix(values, g.weights, op.opacity, values.max(g.values));
+      break;
+    case MIN:
+      mix(values, g.weights, op.opacity, values.min(g.values));
+      break;
+    case ADD:
+      mix(values, g.weights, op.opacity, (values + g.values).max(lo).min(hi));
+      break;
+    case SUBTRACT:
+      mix(values, g.weights, op.opacity, (values - g.values).max(lo).min(hi));
+      break;
+    case MULTIPLY:
+      mix(values, g.weights, op.opacity, (values * ((g.values - lo) * invRange)).max(lo).min(hi));
+      break;
+    default:
+      mix(values, g.weights, op.opacity, g.values);
+      break;
+    }
+  }
+  else {
+    for (size_t i = 0; i < g.slots.size(); i++) {
+      int slot = g.slots[i];
+      float& v = values[slot];
+      float f = applyKernel(op.kernel, v, g.values[i], lo[slot], hi[slot], invRange[slot]);
+      v = v * (1 - op.opacity) + f * op.opacity;
+    }
+  }
+}
+
+void LayerBuffer::blendColors(const Op& op) {
+  for (const auto& p : m_colors) {
+    LumiverseColor* src = p.first;
+    LumiverseColor* dest = p.second;
+
+    if (op.kernel == LERP) {
+      if (op.opacity >= 1) {
+        LumiverseTypeUtils::copyByVal(src, dest);
+      }
+      else {
+        shared_ptr<LumiverseType> res = LumiverseTypeUtils::lerp(dest, src, op.opacity);
+        LumiverseTypeUtils::copyByVal(res.get(), dest);
+      }
+      continue;
+    }
+
+    // Channels and the weight all live in [0, 1], so they share the kernels of a
+    // scalar with that range.
+    auto srcChannels = src->getColorParams();
+    auto destChannels = dest->getColorParams();
+
+    for (const auto& c : srcChannels) {
+      auto d = destChannels.find(c.first);
+      if (d == destChannels.end())
+        continue;
+
+      float s = (float)d->second;
+      float f = applyKernel(op.kernel, s, (float)c.second, 0, 1, 1);
+      dest->setColorChannel(c.first, s * (1 - op.opacity) + f * op.opacity);
+    }
+
+    float w = (float)dest->getWeight();
+    float f = applyKernel(op.kernel, w, (float)src->getWeight(), 0, 1, 1);
+    dest->setWeight(w * (1 - op.opacity) + f * op.opacity);
+  }
+}
+
+void LayerBuffer::blendEnums(const Op& op) {
+  for (const auto& p : m_enums) {
+    LumiverseEnum* src = p.first;
+    LumiverseEnum* dest = p.second;
+
+    // Only the highest or lowest enum takes part in the blend
+    if (op.kernel == MAX && src->getRangeVal() <= dest->getRangeVal())
+      continue;
+    if (op.kernel == MIN && src->getRangeVal() >= dest->getRangeVal())
+      continue;
+
+    if (op.opacity >= 1) {
+      LumiverseTypeUtils::copyByVal(src, dest);
+    }
+    else {
+      shared_ptr<LumiverseType> res = LumiverseTypeUtils::lerp(dest, src, op.opacity);
+      LumiverseTypeUtils::copyByVal(res.get(), dest);
+    }
+  }
+}
+
+}
+}
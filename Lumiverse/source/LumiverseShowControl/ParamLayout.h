@@ -0,0 +1,318 @@
+#ifndef _PARAMLAYOUT_H_
+#define _PARAMLAYOUT_H_
+
+#pragma once
+
+#include "LumiverseCore.h"
+
+namespace Lumiverse {
+namespace ShowControl {
+
+/*!
+\brief Assigns every parameter of a device state a slot in a dense value buffer.
+
+Float and orientation parameters are scalars and come first, so that their values
+can be held in a single Eigen array and blended with vectorized math. Scalar
+values are stored in the units of the parameter the slot was made for. Color and
+enum parameters get slots after the scalars and are blended through their own
+objects.
+
+The layout keeps pointers to the parameters it was built from, so the devices
+must outlive it and must not gain or lose parameters.
+\sa LayerBuffer
+*/
+class ParamLayout {
+public:
+  ParamLayout();
+
+  /*! \brief Assigns slots to every parameter of the given devices. */
+  void build(const map<string, Device*>& devices);
+
+  /*!
+  \brief Checks if the layout was built from exactly these devices and parameters.
+
+  Returns false if a device was added, removed or replaced, or if a device gained,
+  lost or replaced a parameter since build(). Doesn't allocate, so callers can use it
+  to decide whether to rebuild a cached layout.
+  */
+  bool isBuiltFrom(const map<string, Device*>& devices) const;
+
+  /*! \brief Identifies this build of the layout. Different for every call to build(). */
+  unsigned int getId() const { return m_id; }
+
+  /*! \brief Number of float and orientation slots. These are slots [0, getNumScalars()). */
+  size_t getNumScalars() const { return (size_t)m_defaults.size(); }
+
+  /*! \brief Total number of slots. */
+  size_t getNumSlots() const { return m_params.size(); }
+
+  /*! \brief Returns the slot of a parameter, or -1 if it isn't in the layout. */
+  int getSlot(const string& id, const string& param) const;
+
+  /*! \brief Checks if the layout was built with a device. */
+  bool hasDevice(const string& id) const { return m_slots.count(id) > 0; }
+
+  /*! \brief Returns the parameter the slot was made for. */
+  LumiverseType* getParam(int slot) const { return m_params[slot]; }
+
+  /*!
+  \brief Orientation unit of a scalar slot, or -1 if the slot holds a float.
+  */
+  int getUnit(int slot) const { return m_units[slot]; }
+
+  /*! \brief Default value of every scalar slot. */
+  const Eigen::ArrayXf& getDefaults() const { return m_defaults; }
+
+  /*! \brief Minimum value of every scalar slot. */
+  const Eigen::ArrayXf& getMin() const { return m_min; }
+
+  /*! \brief Maximum value of every scalar slot. */
+  const Eigen::ArrayXf& getMax() const { return m_max; }
+
+  /*! \brief 1 / (max - min) for every scalar slot, or 0 if the range is empty. */
+  const Eigen::ArrayXf& getInvRange() const { return m_invRange; }
+
+  /*!
+  \brief Converts a float or orientation value into a scalar slot value.
+  \param unit Unit of the slot, from getUnit().
+  */
+  static float toSlotValue(LumiverseType* val, int unit);
+
+  /*! \brief ID of the device a slot belongs to. */
+  const string& getDeviceId(int slot) const { return m_deviceIds[m_devices[slot]]; }
+
+  /*! \brief Name of the parameter a slot was made for. */
+  const string& getParamName(int slot) const { return m_names[slot]; }
+
+  /*! \brief Resets the color and enum parameters of the layout to their defaults. */
+  void resetNonScalars() const;
+
+  /*!
+  \brief Resets the given slots to their defaults.
+
+  Scalar slots are reset in values, other slots are reset in their parameters.
+  */
+  void reset(Eigen::ArrayXf& values, const vector<int>& slots) const;
+
+  /*! \brief Reads the current scalar values of the parameters of the layout. */
+  Eigen::ArrayXf read() const;
+
+  /*! \brief Writes scalar values back into the parameters of the layout. */
+  void write(const Eigen::ArrayXf& values) const;
+
+  /*! \brief Writes the given scalar slots back into the parameters of the layout. */
+  void write(const Eigen::ArrayXf& values, const vector<int>& slots) const;
+
+private:
+  unsigned int m_id;
+
+  /*! \brief Slot of each device parameter. */
+  map<string, map<string, int> > m_slots;
+
+  vector<LumiverseType*> m_params;
+
+  /*! \brief Devices and parameters the layout was built from, in the order build() saw them. */
+  vector<Device*> m_sourceDevices;
+  vector<LumiverseType*> m_sourceParams;
+
+  vector<int> m_units;
+  Eigen::ArrayXf m_defaults;
+  Eigen::ArrayXf m_min;
+  Eigen::ArrayXf m_max;
+  Eigen::ArrayXf m_invRange;
+
+  // Device and parameter names for each slot
+  vector<string> m_deviceIds;
+  vector<int> m_devices;
+  vector<string> m_names;
+};
+
+/*!
+\brief A set of slots in a ParamLayout.
+
+Slots can be added and checked in constant time, and the set keeps a list of its
+slots so it can be walked and cleared in time proportional to its size rather than
+the size of the layout.
+*/
+class SlotSet {
+public:
+  /*! \brief Empties the set and sizes it for a layout with numSlots slots. */
+  void resize(size_t numSlots);
+
+  /*! \brief Adds a slot to the set. */
+  void insert(int slot) {
+    if (!m_contains[slot]) {
+      m_contains[slot] = 1;
+      m_slots.push_back(slot);
+    }
+  }
+
+  /*! \brief Checks if a slot is in the set. */
+  bool contains(int slot) const { return m_contains[slot] != 0; }
+
+  /*! \brief Removes every slot from the set. */
+  void clear();
+
+  /*! \brief Slots in the set, in the order they were added. */
+  const vector<int>& getSlots() const { return m_slots; }
+
+  /*! \brief Number of slots in the set. */
+  size_t size() const { return m_slots.size(); }
+
+private:
+  vector<unsigned char> m_contains;
+  vector<int> m_slots;
+};
+
+/*!
+\brief A Layer's parameters, lined up with a ParamLayout.
+
+Only parameters the layer owns are bound, so blending costs are proportional to
+what the layer actually controls. Float and orientation parameters are kept in
+separate groups so each type can be blended its own way. A group that covers a
+large share of the state keeps a full size array along with a weight for every
+slot, 1 where the layer has the parameter and 0 where it doesn't, and blends with
+a single vectorized pass. Smaller groups keep their values packed and blend slot
+by slot.
+*/
+class LayerBuffer {
+public:
+  /*! \brief Ways of combining a layer value with the state value below it. */
+  enum Kernel {
+    LERP,       /*!< The layer value */
+    MAX,        /*!< The larger of the two values */
+    MIN,        /*!< The smaller of the two values */
+    ADD,        /*!< The sum of the values, clamped to the parameter's range */
+    SUBTRACT,   /*!< The state value minus the layer value, clamped */
+    MULTIPLY    /*!< The state value scaled by the layer value as a fraction of its range, clamped */
+  };
+
+  /*! \brief Parameter types that can be blended with different kernels. */
+  enum ParamType { FLOAT, ORIENTATION, COLOR, ENUM, NUM_TYPES };
+
+  /*!
+  \brief How one type of parameter is blended.
+
+  The result is state * (1 - opacity) + kernel(state, layer) * opacity.
+  */
+  struct Op {
+    Kernel kernel;
+    float opacity;
+  };
+
+  LayerBuffer();
+
+  /*!
+  \brief Checks if the buffer was bound to this layout and these versions of the
+  layer state and ownership.
+  */
+  bool isBound(const ParamLayout& layout, unsigned int stateVersion, unsigned int ownedVersion) const;
+
+  /*!
+  \brief Binds layer parameters to the slots of a layout.
+
+  Parameters that aren't owned, aren't in the layout or don't match the type of their
+  slot are ignored.
+  \param owned Parameters the layer owns, by device.
+  \param layerName Used in warnings about missing devices.
+  */
+  void bind(const ParamLayout& layout, const map<string, map<string, LumiverseType*> >& state,
+    const map<string, set<string> >& owned, unsigned int stateVersion, unsigned int ownedVersion,
+    const string& layerName);
+
+  /*!
+  \brief Copies the current scalar values of the layer parameters into the buffer.
+
+  Parameters passed to feed() are skipped.
+  */
+  void gather();
+
+  /*!
+  \brief Lets a layer parameter's value be written straight into the buffer.
+
+  gather() skips the parameter until clearFeeds() or the next bind().
+  \param src A bound float or orientation parameter.
+  \param unit Set to the orientation unit of the parameter's slot, or -1 for floats.
+  \return Where the value goes, valid until the next bind(), or nullptr if src isn't
+  bound to a scalar slot.
+  */
+  float* feed(LumiverseType* src, int& unit);
+
+  /*! \brief Makes gather() copy every parameter again. */
+  void clearFeeds();
+
+  /*!
+  \brief Blends the layer into the given state.
+
+  Colors are blended channel by channel, with each channel in [0, 1]. Enums only
+  support MAX and MIN, which compare the enums' numeric values, and use LERP for
+  everything else.
+  \param values Scalar values of the state, laid out by the bound layout.
+  \param layout The bound layout.
+  \param ops Kernel and opacity for each ParamType.
+  */
+  void blend(Eigen::ArrayXf& values, const ParamLayout& layout, const Op ops[NUM_TYPES]);
+
+  /*! \brief Every bound slot, scalars first. */
+  const vector<int>& getSlots() const { return m_slots; }
+
+  /*! \brief Number of layer parameters bound to a slot. */
+  size_t getNumBound() const { return m_slots.size(); }
+
+  /*!
+  \brief Groups binding at least 1 / DENSE_FRACTION of the scalar slots blend with
+  the full size kernel.
+  */
+  static const int DENSE_FRACTION = 8;
+
+private:
+  /*!
+  \brief Bindings for float or orientation parameters.
+
+  With a dense group, values and weights are full size and valueIndex is the slot.
+  Otherwise values is packed and valueIndex is the position in it. gathered holds
+  the bindings that aren't fed.
+  */
+  struct ScalarGroup {
+    bool dense;
+    vector<int> slots;
+    vector<int> valueIndex;
+    vector<int> units;
+    vector<LumiverseType*> src;
+    vector<bool> fed;
+    vector<int> gathered;
+    Eigen::ArrayXf values;
+    Eigen::ArrayXf weights;
+  };
+
+  unsigned int m_layoutId;
+  unsigned int m_stateVersion;
+  unsigned int m_ownedVersion;
+
+  vector<int> m_slots;
+  size_t m_numScalars;
+
+  /*! \brief Float and orientation groups. */
+  ScalarGroup m_scalars[2];
+
+  /*! \brief Group and binding of each scalar parameter. */
+  unordered_map<LumiverseType*, pair<int, int> > m_scalarIndex;
+
+  /*! \brief Set by feed() until gather() rebuilds the gathered lists. */
+  bool m_feedsChanged;
+
+  // Color and enum bindings as (layer, state) parameter pairs.
+  vector<pair<LumiverseColor*, LumiverseColor*> > m_colors;
+  vector<pair<LumiverseEnum*, LumiverseEnum*> > m_enums;
+
+  /*! \brief Sets up the arrays of a group once its slots are known. */
+  void finishGroup(ScalarGroup& g);
+
+  void blendGroup(Eigen::ArrayXf& values, const ParamLayout& layout, ScalarGroup& g, const Op& op);
+  void blendColors(const Op& op);
+  void blendEnums(const Op& op);
+};
+
+}
+}
+#endif
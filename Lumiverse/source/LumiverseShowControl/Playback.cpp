@@ -1,5 +1,6 @@
 #include "Playback.h"
 #include "SineWave.h"
+#include <algorithm>
 
 namespace Lumiverse {
 namespace ShowControl {
@@ -10,15 +11,21 @@ namespace ShowControl {
 
     auto devices = m_rig->getAllDevices().getDevices();
     for (Device* d : devices) {
-      // Copy and reset to defaults
-      m_state[d->getId()] = new Device(*d);
+      // Snapshot and reset to defaults. reset() gives the snapshot private copies of
+      // its parameters, which the layout then writes in place.
+      m_state[d->getId()] = new Device(d, nullptr);
       m_state[d->getId()]->reset();
     }
 
+    initState();
+    m_sortLayers = true;
     m_funcId = -1;
 
     // Make a single programmer for this playback object
     m_prog = unique_ptr<Programmer>(new Programmer(m_rig));
+    m_workers = ThreadPool::getShared();
+
+    registerProfileSections();
   }
 
   Playback::Playback(Rig* rig, string filename) : m_rig(rig) {
@@ -26,15 +33,21 @@ namespace ShowControl {
 
     auto devices = m_rig->getAllDevices().getDevices();
     for (Device* d : devices) {
-      // Copy and reset to defaults
-      m_state[d->getId()] = new Device(*d);
+      // Snapshot and reset to defaults. reset() gives the snapshot private copies of
+      // its parameters, which the layout then writes in place.
+      m_state[d->getId()] = new Device(d, nullptr);
       m_state[d->getId()]->reset();
     }
 
+    initState();
+    m_sortLayers = true;
     m_funcId = -1;
 
     // Make a single programmer for this playback object
     m_prog = unique_ptr<Programmer>(new Programmer(m_rig));
+    m_workers = ThreadPool::getShared();
+
+    registerProfileSections();
 
     // Load up cue and layer data.
     load(filename);
@@ -50,6 +63,7 @@ namespace ShowControl {
   }
 
   void Playback::start() {
+    m_writeAll = true;
     m_running = true;
     Logger::log(INFO, "Started playback update loop");
   }
@@ -66,56 +80,120 @@ namespace ShowControl {
   //  m_loopTime = 1.0f / (float)m_refreshRate;
   //}
 
+  void Playback::setNumWorkerThreads(int numThreads) {
+    m_workers = make_shared<ThreadPool>(numThreads);
+  }
+
   void Playback::update() {
     if (m_running) {
+      Profiler& profiler = m_rig->getProfiler();
+
       // Gets start time
-      auto start = chrono::high_resolution_clock::now();
+      auto start = m_rig->getClock().now();
 
       // Update layers
-      for (auto& kvp : m_layers) {
-        kvp.second->update(start);
+      // Partitions from every layer are evaluated together so that both a few large
+      // layers and many small ones spread across the workers. Everything else about
+      // the layer update stays on this thread, in layer order.
+      {
+        ProfileScope scope(profiler, m_profileSections[LAYER_UPDATE]);
+
+        vector<pair<Layer*, size_t> > partitions;
+        for (auto& kvp : m_layers) {
+          size_t count = kvp.second->beginUpdate(start);
+          for (size_t i = 0; i < count; i++) {
+            partitions.push_back(make_pair(kvp.second.get(), i));
+          }
+        }
+
+        m_workers->parallelFor(partitions.size(), [&](size_t i) {
+          partitions[i].first->updatePartition(partitions[i].second);
+        });
+
+        for (auto& kvp : m_layers) {
+          kvp.second->endUpdate(start);
+        }
       }
 
       // Flatten layers
-      // Reset state to defaults to start.
-      for (auto& kvp : m_state) {
-        kvp.second->reset();
-      }
+      // Reset state to defaults to start. Only slots written last time can differ
+      // from their defaults.
+      m_layout.reset(m_values, m_prevTouched.getSlots());
+      m_touched.clear();
 
       // Sort active layers
-      set<shared_ptr<Layer>, function<bool(shared_ptr<Layer>, shared_ptr<Layer>)> >
-        sortedLayers([](shared_ptr<Layer> lhs, shared_ptr<Layer> rhs) { return (*lhs) < (*rhs); });
-
-      for (auto& kvp : m_layers) {
-        if (kvp.second->isActive()) {
-          // sorting is handled automatically by set<> according to the stl spec
-          sortedLayers.insert(kvp.second);
-        }
+      // The order only changes when layers are added, removed, activated or re-prioritized.
+      {
+        ProfileScope scope(profiler, m_profileSections[LAYER_SORT]);
+        if (m_sortLayers.exchange(false))
+          sortLayers();
       }
 
       // Blend active layers
       // Blending is done from the bottom up, with the state being passed to each
       // layer in order.
-      for (auto& l : sortedLayers) {
-        l->blend(m_state);
+      {
+        ProfileScope scope(profiler, m_profileSections[LAYER_BLEND]);
+        for (auto& l : m_activeLayers) {
+          l->blend(m_values, m_layout, &m_touched);
+        }
       }
 
       // Blend the programmer layer
       // This layer sits on top of everything else and anything captured by it
       // will take precedence over everything.
-      m_prog->blend(m_state);
+      {
+        ProfileScope scope(profiler, m_profileSections[PROGRAMMER_BLEND]);
+        m_prog->blend(m_values, m_layout, m_touched);
+      }
 
       // If we have a GM value less than 1, do some scaling
+      // The grandmaster applies to every parameter, written by a layer or not, so
+      // every slot is scaled and marked as written.
       if (m_grandmaster < 1) {
-        for (const auto& d : m_state) {
-          for (auto p : d.second->getRawParameters()) {
-            LumiverseTypeUtils::scaleParam(p.second, m_grandmaster);
-          }
+        ProfileScope scope(profiler, m_profileSections[GRANDMASTER]);
+        int numScalars = (int)m_layout.getNumScalars();
+        int numSlots = (int)m_layout.getNumSlots();
+
+        m_values.head(numScalars) *= m_grandmaster;
+        for (int slot = numScalars; slot < numSlots; slot++) {
+          LumiverseTypeUtils::scaleParam(m_layout.getParam(slot), m_grandmaster);
+        }
+
+        for (int slot = 0; slot < numSlots; slot++) {
+          m_touched.insert(slot);
         }
       }
 
       // Write state to rig.
-      m_rig->setAllDevices(m_state);
+      // Slots written last time but not this time have been reset and need to be
+      // written too.
+      {
+        ProfileScope scope(profiler, m_profileSections[WRITE_TO_RIG]);
+
+        m_written.clear();
+        if (m_writeAll) {
+          for (int i = 0; i < (int)m_layout.getNumSlots(); i++) {
+            m_written.push_back(i);
+          }
+          m_writeAll = false;
+        }
+        else {
+          m_written = m_touched.getSlots();
+          for (int slot : m_prevTouched.getSlots()) {
+            if (!m_touched.contains(slot))
+              m_written.push_back(slot);
+          }
+
+          // Keeps each device's parameters together
+          sort(m_written.begin(), m_written.end());
+        }
+
+        m_layout.write(m_values, m_written);
+        writeToRig(m_written);
+
+        swap(m_touched, m_prevTouched);
+      }
 
       // For now I'm locking this to the update loop in rig
       // We'll see how it goes
@@ -135,6 +213,89 @@ namespace ShowControl {
     }
   }
 
+  void Playback::initState() {
+    m_layout.build(m_state);
+    m_values = m_layout.getDefaults();
+    m_touched.resize(m_layout.getNumSlots());
+    m_prevTouched.resize(m_layout.getNumSlots());
+    m_writeAll = true;
+    bindRig();
+  }
+
+  void Playback::sortLayers() {
+    m_activeLayers.clear();
+    for (auto& kvp : m_layers) {
+      if (kvp.second->isActive())
+        m_activeLayers.push_back(kvp.second);
+    }
+
+    // Stable, so layers with the same priority stay in name order
+    stable_sort(m_activeLayers.begin(), m_activeLayers.end(),
+      [](const shared_ptr<Layer>& lhs, const shared_ptr<Layer>& rhs) { return (*lhs) < (*rhs); });
+  }
+
+  void Playback::bindRig() {
+    m_rigParams.assign(m_layout.getNumSlots(), nullptr);
+    m_rigDeviceVersion = m_rig->getDeviceVersion();
+
+    const string* id = nullptr;
+    Device* d = nullptr;
+
+    for (int slot = 0; slot < (int)m_layout.getNumSlots(); slot++) {
+      // Slots of the same device share the id string
+      const string& slotId = m_layout.getDeviceId(slot);
+      if (&slotId != id) {
+        id = &slotId;
+        d = m_rig->getDevice(slotId);
+      }
+
+      if (d == nullptr)
+        continue;
+
+      LumiverseType* param = d->getParam(m_layout.getParamName(slot));
+      if (param != nullptr && LumiverseTypeUtils::areSameType(param, m_layout.getParam(slot)))
+        m_rigParams[slot] = param;
+    }
+  }
+
+  void Playback::writeToRig(const vector<int>& slots) {
+    if (m_rig->getDeviceVersion() != m_rigDeviceVersion)
+      bindRig();
+
+    int numScalars = (int)m_layout.getNumScalars();
+
+    // Same copies as Device::copyParamByValue, without looking up the device and parameter.
+    for (int slot : slots) {
+      LumiverseType* target = m_rigParams[slot];
+      LumiverseType* source = m_layout.getParam(slot);
+      if (target == nullptr)
+        continue;
+
+      if (slot < numScalars) {
+        if (m_layout.getUnit(slot) < 0)
+          *((LumiverseFloat*)target) = *((LumiverseFloat*)source);
+        else
+          *((LumiverseOrientation*)target) = *((LumiverseOrientation*)source);
+      }
+      else if (source->getTypeName() == "color") {
+        *((LumiverseColor*)target) = *((LumiverseColor*)source);
+      }
+      else if (source->getTypeName() == "enum") {
+        *((LumiverseEnum*)target) = *((LumiverseEnum*)source);
+      }
+    }
+  }
+
+  void Playback::registerProfileSections() {
+    Profiler& profiler = m_rig->getProfiler();
+    m_profileSections[LAYER_UPDATE] = profiler.getSectionId("Playback::layerUpdate");
+    m_profileSections[LAYER_SORT] = profiler.getSectionId("Playback::sort");
+    m_profileSections[LAYER_BLEND] = profiler.getSectionId("Playback::blend");
+    m_profileSections[PROGRAMMER_BLEND] = profiler.getSectionId("Playback::programmerBlend");
+    m_profileSections[GRANDMASTER] = profiler.getSectionId("Playback::grandmaster");
+    m_profileSections[WRITE_TO_RIG] = profiler.getSectionId("Playback::writeToRig");
+  }
+
   bool Playback::addLayer(shared_ptr<Layer> layer) {
     if (m_layers.count(layer->getName()) > 0) {
       // Key already exists
@@ -142,6 +303,7 @@ namespace ShowControl {
     }
     else {
       m_layers[layer->getName()] = layer;
+      m_sortLayers = true;
       return true;
     }
   }
@@ -157,6 +319,7 @@ namespace ShowControl {
   void Playback::deleteLayer(string name) {
     if (m_layers.count(name) > 0) {
       m_layers.erase(name);
+      m_sortLayers = true;
     }
   }
 
@@ -196,8 +359,9 @@ namespace ShowControl {
   }
   
   bool Playback::detachFromRig() {
-    if (m_funcId > 0) {
-      return m_rig->removeFunction(m_funcId);
+    if (m_funcId > 0 && m_rig->removeFunction(m_funcId)) {
+      m_funcId = -1;
+      return true;
     }
     else
       return false;
@@ -336,6 +500,7 @@ namespace ShowControl {
   bool Playback::loadJSON(JSONNode node) {
     m_layers.clear();
     m_timelines.clear();
+    m_sortLayers = true;
 
     auto data = node.find("playback");
     if (data == node.end()) {
@@ -5,9 +5,11 @@
 
 #include <memory>
 #include <chrono>
+#include <atomic>
 
 #include <LumiverseCore.h>
 #include "Timeline.h"
+#include "ParamLayout.h"
 #include "Layer.h"
 #include "Programmer.h"
 
@@ -78,6 +80,11 @@ namespace ShowControl{
 
     /*!
     \brief Updates the layers contained by the Playback object and updates the Rig.
+
+    Only parameters that a layer or the programmer wrote in this update or the one before
+    are copied into the Rig. Everything is copied on the first update after start(), and
+    on every update while the grandmaster is below 1, since the grandmaster scales
+    every parameter.
     */
     void update();
 
@@ -102,6 +109,13 @@ namespace ShowControl{
     */
     void deleteLayer(string name);
 
+    /*!
+    \brief Makes the next update() sort the active layers again.
+
+    Layers call this when they're activated, deactivated or change priority.
+    */
+    void invalidateLayerOrder() { m_sortLayers = true; }
+
     /*!
     \brief Add a Timeline to the Playback.
 
@@ -144,6 +158,25 @@ namespace ShowControl{
     */
     bool detachFromRig();
 
+    /*! \brief Returns true if the playback's update function is bound to the Rig. */
+    bool isAttached() { return m_funcId > 0; }
+
+    /*!
+    \brief Gives the Playback its own worker threads for updating layers.
+
+    Layer parameters are split into partitions, and partitions from every layer are
+    evaluated in parallel on the workers and the update thread. Results are the same as
+    updating each layer in turn, and timeline events still run in layer order on the
+    update thread. By default Playbacks use ThreadPool::getShared(), so only call this
+    to override it. Don't call this while the Playback is running.
+    \param numThreads Number of workers, or -1 for one less than the number of hardware
+    threads. 0 updates everything on the update thread.
+    */
+    void setNumWorkerThreads(int numThreads);
+
+    /*! \brief Gets the number of worker threads used to update layers. */
+    size_t getNumWorkerThreads() { return m_workers->getNumThreads(); }
+
     /*! \brief Gets a reference to the programmer object stored by the playback */
     const unique_ptr<Programmer>& getProgrammer() { return m_prog; }
 
@@ -318,9 +351,57 @@ namespace ShowControl{
     /*! \brief Map of layer names to layers. */
     map<string, shared_ptr<Layer> > m_layers;
 
-    /*! \brief Copy of all devices in the rig. Current state of the playback. */
+    /*!
+    \brief Active layers from lowest to highest priority.
+
+    Layers with the same priority are kept in name order. Only rebuilt when
+    m_sortLayers is set.
+    */
+    vector<shared_ptr<Layer> > m_activeLayers;
+
+    /*! \brief Set when layers are added, removed, activated or re-prioritized. */
+    atomic<bool> m_sortLayers;
+
+    /*!
+    \brief Snapshots of all devices in the rig. Current state of the playback.
+
+    Every parameter is private to the playback, since m_layout writes them in place.
+    */
     map<string, Device*> m_state;
 
+    /*! \brief Slots of the parameters in m_state. */
+    ParamLayout m_layout;
+
+    /*!
+    \brief Scalar values of m_state while layers are blended, laid out by m_layout.
+
+    Written back into m_state after the layers are blended. Slots that weren't written
+    in the last update hold their default values.
+    */
+    Eigen::ArrayXf m_values;
+
+    /*! \brief Slots written by layers or the programmer in the current update. */
+    SlotSet m_touched;
+
+    /*! \brief Slots written in the previous update. These need to go back to defaults. */
+    SlotSet m_prevTouched;
+
+    /*! \brief Slots copied into the Rig in the current update. */
+    vector<int> m_written;
+
+    /*! \brief When set, the next update copies every parameter into the Rig. */
+    bool m_writeAll;
+
+    /*!
+    \brief Rig parameter for each slot of m_layout, or nullptr if the Rig doesn't have it.
+
+    Looked up again when the Rig gains or loses devices.
+    */
+    vector<LumiverseType*> m_rigParams;
+
+    /*! \brief Rig device version m_rigParams was looked up for. */
+    unsigned int m_rigDeviceVersion;
+
     /*! \brief Stores named groups (DeviceSets) created by the user. */
     map<string, DeviceSet> m_groups;
 
@@ -357,8 +438,34 @@ namespace ShowControl{
     /*! \brief Programmer object owned by the Playback */
     unique_ptr<Programmer> m_prog;
 
+    /*! \brief Threads that evaluate layer partitions during update(). The shared pool unless overridden. */
+    shared_ptr<ThreadPool> m_workers;
+
     /*! \brief Load Playback data from a file. */
     bool load(string filename);
+
+    /*! \brief Sets up the dense state for m_state. */
+    void initState();
+
+    /*! \brief Rebuilds m_activeLayers. */
+    void sortLayers();
+
+    /*! \brief Looks up the Rig parameter for every slot of m_layout. */
+    void bindRig();
+
+    /*! \brief Copies the given slots of m_state into the Rig. */
+    void writeToRig(const vector<int>& slots);
+
+    /*! \brief Stages of update() that are timed by the Rig's profiler. */
+    enum ProfileSection {
+      LAYER_UPDATE, LAYER_SORT, LAYER_BLEND, PROGRAMMER_BLEND, GRANDMASTER, WRITE_TO_RIG, NUM_PROFILE_SECTIONS
+    };
+
+    /*! \brief Profiler section ids, indexed by ProfileSection. */
+    int m_profileSections[NUM_PROFILE_SECTIONS];
+
+    /*! \brief Gets the profiler section ids for update() from the Rig. */
+    void registerProfileSections();
   };
 }
 }
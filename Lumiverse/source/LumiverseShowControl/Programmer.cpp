@@ -1,5 +1,6 @@
 #include "Programmer.h"
 #include "types/LumiverseTypeUtils.h"
+#include <algorithm>
 
 namespace Lumiverse {
 namespace ShowControl {
@@ -200,13 +201,52 @@ bool Programmer::isCaptured(string id) {
   return captured.contains(id);
 }
 
-void Programmer::blend(map<string, Device*> state) {
+void Programmer::blend(const map<string, Device*>& state) {
   m_progMutex.lock();
 
+#ifdef USE_OSC
+  applyOscInput();
+#endif
+
   // Take each captured device, and write the parameters in.
   for (Device* d : captured.getDevices()) {
+    auto dest = state.find(d->getId());
+    if (dest == state.end())
+      continue;
+
+    Device* src = m_devices[d->getId()];
     for (auto& p : d->getRawParameters()) {
-      LumiverseTypeUtils::copyByVal(m_devices[d->getId()]->getParam(p.first), state[d->getId()]->getParam(p.first));
+      LumiverseTypeUtils::copyByVal(src->getParam(p.first), dest->second->getParam(p.first));
+    }
+  }
+
+  m_progMutex.unlock();
+}
+
+void Programmer::blend(Eigen::ArrayXf& values, const ParamLayout& layout, SlotSet& touched) {
+  m_progMutex.lock();
+
+#ifdef USE_OSC
+  applyOscInput();
+#endif
+
+  int numScalars = (int)layout.getNumScalars();
+
+  for (Device* d : captured.getDevices()) {
+    Device* src = m_devices[d->getId()];
+
+    for (auto& p : d->getRawParameters()) {
+      int slot = layout.getSlot(d->getId(), p.first);
+      LumiverseType* val = src->getParam(p.first);
+      if (slot < 0 || !LumiverseTypeUtils::areSameType(val, layout.getParam(slot)))
+        continue;
+
+      if (slot < numScalars)
+        values[slot] = ParamLayout::toSlotValue(val, layout.getUnit(slot));
+      else
+        LumiverseTypeUtils::copyByVal(val, layout.getParam(slot));
+
+      touched.insert(slot);
     }
   }
 
@@ -326,5 +366,32 @@ void Programmer::addCaptured(string id) {
   m_progMutex.unlock();
 }
 
+#ifdef USE_OSC
+void Programmer::addOscInput(OscPatch* patch) {
+  m_progMutex.lock();
+
+  if (find(m_oscInputs.begin(), m_oscInputs.end(), patch) == m_oscInputs.end())
+    m_oscInputs.push_back(patch);
+
+  m_progMutex.unlock();
+}
+
+void Programmer::removeOscInput(OscPatch* patch) {
+  m_progMutex.lock();
+
+  m_oscInputs.erase(remove(m_oscInputs.begin(), m_oscInputs.end(), patch), m_oscInputs.end());
+
+  m_progMutex.unlock();
+}
+
+void Programmer::applyOscInput() {
+  for (OscPatch* patch : m_oscInputs) {
+    for (const string& id : patch->applyCommands(m_devices)) {
+      captured = captured.add(id);
+    }
+  }
+}
+#endif
+
 }
 }
\ No newline at end of file
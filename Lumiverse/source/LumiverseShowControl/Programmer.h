@@ -6,6 +6,7 @@
 #include "Rig.h"
 #include "Timeline.h"
 #include "Cue.h"
+#include "ParamLayout.h"
 
 namespace Lumiverse {
 namespace ShowControl {
@@ -152,7 +153,16 @@ public:
   Blend in this case means overwrite. Given a map of Devices by ID, this function will
   write the current state of the captured devices into the state map.
   */
-  void blend(map<string, Device*> state);
+  void blend(const map<string, Device*>& state);
+
+  /*!
+  \brief Writes the programmer's captured channels on top of a dense state.
+  \param values Scalar values of the state, laid out by layout.
+  \param layout Layout of the state. Color and enum values are written directly into
+  the layout's parameters.
+  \param touched Every slot written by the programmer is added to this set.
+  */
+  void blend(Eigen::ArrayXf& values, const ParamLayout& layout, SlotSet& touched);
 
   /*!
   \brief Gets the set of the Devices the Programmer has.
@@ -210,6 +220,21 @@ public:
   */
   Cue* getCue(float up, float down, float delay);
 
+#ifdef USE_OSC
+  /*!
+  \brief Applies commands received by an OscPatch to this Programmer.
+
+  Waiting commands are applied at the start of each blend, so changes from control
+  surfaces land on a frame boundary of the Playback. Devices set through OSC are captured.
+  The patch must be removed before it is deleted.
+  \sa OscPatch::setReceive()
+  */
+  void addOscInput(OscPatch* patch);
+
+  /*! \brief Stops applying commands from an OscPatch. */
+  void removeOscInput(OscPatch* patch);
+#endif
+
 private:
   /*!
   \brief Set of devices managed by this Programmer
@@ -236,6 +261,14 @@ private:
 
   /*! \brief Safely adds an ID to the set of captured devices. */
   void addCaptured(string id);
+
+#ifdef USE_OSC
+  /*! \brief Patches whose received commands are applied to the programmer. */
+  vector<OscPatch*> m_oscInputs;
+
+  /*! \brief Applies waiting OSC commands. Call with m_progMutex held. */
+  void applyOscInput();
+#endif
 };
 
 }
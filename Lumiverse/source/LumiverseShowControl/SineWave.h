@@ -59,6 +59,9 @@ namespace ShowControl {
     */
     virtual shared_ptr<LumiverseType> getValueAtTime(string id, string paramName, LumiverseType* currentVal, size_t time, map<string, shared_ptr<Timeline> >& tls) override;
 
+    /*! \brief Sine waves don't use keyframes, so this always returns -1. */
+    virtual int getTrackIndex(const string&) override { return -1; }
+
     /*!
     \brief Returns the amount of time it takes to cycle through the sine wave once in milliseconds.
     */
@@ -14,8 +14,9 @@ namespace ShowControl {
 
   Snapshot::Snapshot(Snapshot & other)
   {
+    // Snapshot devices are copy-on-write, so this shares all parameter data with other.
     for (const auto& kvp : other.m_rigData) {
-      m_rigData[kvp.first] = new Device(kvp.second);
+      m_rigData[kvp.first] = new Device(kvp.second, kvp.second);
     }
 
     _metadata = map<string, string>(other._metadata);
@@ -29,16 +30,19 @@ namespace ShowControl {
   }
 
   void Snapshot::saveSnapshot(Rig* rig) {
-    // clear old devices
-    for (auto d : m_rigData) {
-      delete d.second;
-    }
-    m_rigData.clear();
+    map<string, Device*> previous;
+    previous.swap(m_rigData);
 
+    // Share unchanged parameters with the previously saved state
     DeviceSet allDevices = rig->getAllDevices();
     const set<Device*>& devices = allDevices.getDevices();
     for (auto d : devices) {
-      m_rigData[d->getId()] = new Device(d);
+      auto prev = previous.find(d->getId());
+      m_rigData[d->getId()] = new Device(d, (prev != previous.end()) ? prev->second : nullptr);
+    }
+
+    for (auto d : previous) {
+      delete d.second;
     }
   }
 
@@ -68,21 +72,15 @@ namespace ShowControl {
       m_playbackData = pb->toJSON();
   }
 
-  PlaybackSnapshot::PlaybackSnapshot(PlaybackSnapshot & other)
+  PlaybackSnapshot::PlaybackSnapshot(PlaybackSnapshot & other) :
+    Snapshot(other)
   {
-    for (const auto& kvp : other.m_rigData) {
-      m_rigData[kvp.first] = new Device(kvp.second);
-    }
-
     m_playbackData = other.m_playbackData;
   }
 
   PlaybackSnapshot::~PlaybackSnapshot()
   {
-    for (const auto& kvp : m_rigData) {
-      // Delete all device data since we copied all of it
-      delete kvp.second;
-    }
+    // Device data is deleted by ~Snapshot
   }
 
   void PlaybackSnapshot::saveSnapshot(Rig * rig, Playback * pb)
@@ -17,6 +17,10 @@ namespace ShowControl {
 
   Snapshots do not store state information about the rig's update loop, patches, or attached
   functions. Snapshots operate purely on the state of the devices at a particular time.
+
+  Devices are stored as copy-on-write snapshots (see Device(Device*, Device*)). Copying a
+  Snapshot shares all parameter data, and saving over an existing Snapshot only allocates
+  parameters that changed since the previous save.
   */
   class Snapshot
   {
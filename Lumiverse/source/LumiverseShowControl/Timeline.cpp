@@ -1,19 +1,19 @@
 #include "Timeline.h"
 
+#include <algorithm>
+
 namespace Lumiverse {
 namespace ShowControl {
 
-Timeline::Timeline() {
+Timeline::Timeline() : _loopLength(0), _tracksDirty(true), _trackVersion(0) {
   _loops = 1;
-  _lengthIsUpdated = false;
-  _loopLengthIsUpdated = false;
 }
 
-Timeline::Timeline(JSONNode data) {
+Timeline::Timeline(JSONNode data) : _loopLength(0), _tracksDirty(true), _trackVersion(0) {
   loadJSON(data);
 }
 
-Timeline::Timeline(const Timeline& other) {
+Timeline::Timeline(const Timeline& other) : _loopLength(other._loopLength.load()), _tracksDirty(true), _trackVersion(0) {
   _loops = other._loops;
   _timelineData = other._timelineData;
   _events = other._events;
@@ -50,15 +50,13 @@ map<string, Keyframe> Timeline::getKeyframes(Device* d, size_t time) {
 }
 
 map<string, map<size_t, Keyframe> >& Timeline::getAllKeyframes() {
-  _lengthIsUpdated = false;
-  _loopLengthIsUpdated = false;
+  invalidate();
   return _timelineData;
 }
 
 void Timeline::setKeyframe(string identifier, size_t time, LumiverseType* data, bool ucs) {
   _timelineData[identifier][time] = Keyframe(time, shared_ptr<LumiverseType>(LumiverseTypeUtils::copy(data)), ucs);
-  _lengthIsUpdated = false;
-  _loopLengthIsUpdated = false;
+  invalidate();
 }
 
 void Timeline::setKeyframe(Device* d, size_t time, bool ucs) {
@@ -79,8 +77,7 @@ void Timeline::setKeyframe(DeviceSet devices, size_t time, bool ucs) {
 
 void Timeline::setKeyframe(string identifier, size_t time, string timelineID, size_t offset) {
   _timelineData[identifier][time] = Keyframe(time, timelineID, offset);
-  _lengthIsUpdated = false;
-  _loopLengthIsUpdated = false;
+  invalidate();
 }
 
 void Timeline::setKeyframe(Device* d, size_t time, string timelineID, size_t offset) {
@@ -97,8 +94,7 @@ void Timeline::setKeyframe(DeviceSet devices, size_t time, string timelineID, si
 
 void Timeline::deleteKeyframe(string identifier, size_t time) {
   _timelineData[identifier].erase(time);
-  _lengthIsUpdated = false;
-  _loopLengthIsUpdated = false;
+  invalidate();
 }
 
 void Timeline::deleteKeyframe(Device* d, size_t time) {
@@ -117,7 +113,9 @@ void Timeline::moveKeyframe(string id, size_t oldTime, size_t newTime)
 {
   Keyframe temp = getKeyframe(id, oldTime);
   deleteKeyframe(id, oldTime);
+  temp.t = newTime;
   _timelineData[id][newTime] = temp;
+  invalidate();
 }
 
 void Timeline::deleteKeyframesAfter(string id, size_t start)
@@ -165,6 +163,7 @@ void Timeline::deleteEndEvent(string id) {
 
 bool Timeline::addEvent(size_t time, shared_ptr<Event> e) {
   _events.insert(pair<size_t, shared_ptr<Event> >(time, e));
+  updateLoopLength();
 return true;
 }
 
@@ -184,6 +183,8 @@ void Timeline::deleteEvent(size_t time, string id) {
   else {
     _events.erase(time);
   }
+
+  updateLoopLength();
 }
 
 vector<shared_ptr<Event> > Timeline::getEvents(size_t time, string id) {
@@ -221,84 +222,147 @@ map<string, shared_ptr<Event> >& Timeline::getAllEndEvents() {
 }
 
 shared_ptr<LumiverseType> Timeline::getValueAtTime(string  id, string paramName, LumiverseType* currentVal, size_t time, map<string, shared_ptr<Timeline> >& tls) {
-  string identifier = getTimelineKey(id, paramName);
+  TrackCursor cursor;
+  cursor.track = Timeline::getTrackIndex(getTimelineKey(id, paramName));
+
+  // If the id has no keyframes, we do nothing and return null.
+  if (cursor.track < 0)
+    return nullptr;
+
+  return getValueAtCursor(cursor, id, paramName, currentVal, time, tls);
+}
+
+shared_ptr<LumiverseType> Timeline::getValueAtCursor(TrackCursor& cursor, const string& id, const string& paramName,
+  LumiverseType* currentVal, size_t time, map<string, shared_ptr<Timeline> >& tls)
+{
+  if (cursor.track < 0)
+    return getValueAtTime(id, paramName, currentVal, time, tls);
+
+  shared_ptr<const TrackSet> tracks = getTracks();
+  if (cursor.track >= (int)tracks->tracks.size())
+    return nullptr;
+
+  const KeyframeTrack& track = tracks->tracks[cursor.track];
   time = getLoopTime(time);
+  cursor.pos = seekTrack(track, cursor.pos, time);
 
-  try {
-    auto keyframes = _timelineData.at(identifier);
+  return evaluateTrack(track, cursor.pos, id, paramName, currentVal, time, tls);
+}
 
-    // If the id has a keyframe map, but no keyframes, we do nothing and return null.
-    if (keyframes.size() == 0)
-      return nullptr;
+int Timeline::getTrackIndex(const string& identifier) {
+  shared_ptr<const TrackSet> tracks = getTracks();
 
-    Keyframe first;
-    Keyframe next;
-    bool nextFound = false;
+  auto it = tracks->index.find(identifier);
+  return (it == tracks->index.end()) ? -1 : it->second;
+}
 
-    for (auto keyframe = keyframes.begin(); keyframe != keyframes.end();) {
-      if (keyframe->first > time) {
-        next = keyframe->second;
+unsigned int Timeline::getTrackVersion() {
+  return getTracks()->version;
+}
 
-        // Special case if they keyframe we found is after the current time but there is no keyframe
-        // before the keyframe we found. Example: no keyframe at t = 0 but keyframe at t = 1200, with
-        // t currently equal to 50.
-        if (keyframe == keyframes.begin()) {
-          first = next;
-        }
-        else {
-          first = prev(keyframe)->second;
-        }
-        nextFound = true;
-        break;
-      }
+shared_ptr<const BakedCurves> Timeline::getBakedCurves() {
+  return getTracks()->baked;
+}
 
-      ++keyframe;
-    }
+shared_ptr<const Timeline::TrackSet> Timeline::getTracks() {
+  updateTracks();
+  return atomic_load(&_tracks);
+}
 
-    if (!nextFound) {
-      // We are at the end of the defined keyframes, so return the value of the most
-      // recent keyframe
-      auto last = keyframes.rbegin()->second;
+void Timeline::invalidate() {
+  updateLoopLength();
+  _tracksDirty.store(true);
+}
 
-      if (last.timelineID != "") {
-        if (tls.count(last.timelineID) > 0) {
-          return tls[last.timelineID]->getValueAtTime(id, paramName, currentVal, time - last.t + last.timelineOffset, tls);
-        }
-        else return nullptr;
-      }
+void Timeline::updateLoopLength() {
+  size_t time = 0;
 
-      return last.val;
-    }
+  // Go through and find the maximum time that a keyframe is set to.
+  for (const auto& id : _timelineData) {
+    // Get the last keyframe, this is sorted.
+    if (id.second.size() == 0)
+      continue;
 
-    // Note that in the instance when we use the current state, that value is pre-filled
-    // at the time of timeline run initialization.
+    auto lastKeyframe = id.second.rbegin()->first;
 
-    // Otherwise we have our keyframes and can now do some ops.
-    float a = (float)(time - first.t) / (float)(next.t - first.t);
+    // Time is equal to transition time + largest keyframe time.
+    time = (lastKeyframe > time) ? lastKeyframe : time;
+  }
 
-    shared_ptr<LumiverseType> x = first.val;
-    shared_ptr<LumiverseType> y = next.val;
+  // also check events
+  if (_events.size() > 0) {
+    time = (_events.rbegin()->first > time) ? _events.rbegin()->first : time;
+  }
 
-    // Check if any keyframe references timelines
-    // If no such timeline exists in the playback, return nullptr (indicate to layer to skip value for this)
-    if (first.timelineID != "") {
-      if (tls.count(first.timelineID) > 0) {
-        x = tls[first.timelineID]->getValueAtTime(id, paramName, currentVal, time - first.t + first.timelineOffset, tls);
-      }
-      else return nullptr;
-    }
-    if (next.timelineID != "") {
-      if (tls.count(next.timelineID) > 0) {
-        y = tls[next.timelineID]->getValueAtTime(id, paramName, currentVal, time - next.t + next.timelineOffset, tls);
-      }
-      else return nullptr;
+  _loopLength.store(time);
+}
+
+void Timeline::updateTracks() {
+  if (!_tracksDirty.load())
+    return;
+
+  lock_guard<mutex> lock(_trackMutex);
+
+  // Someone else may have rebuilt the tracks while we were waiting. Clearing the
+  // flag before reading the keyframes means an edit made during the rebuild
+  // marks the tracks dirty again instead of being lost.
+  if (!_tracksDirty.exchange(false))
+    return;
+
+  shared_ptr<TrackSet> tracks = make_shared<TrackSet>();
+
+  for (const auto& id : _timelineData) {
+    // Empty keyframe maps are treated the same as missing ones.
+    if (id.second.size() == 0)
+      continue;
+
+    KeyframeTrack track;
+    track.times.reserve(id.second.size());
+    track.keys.reserve(id.second.size());
+
+    // The map is already sorted by time.
+    for (const auto& kf : id.second) {
+      track.times.push_back(kf.first);
+      track.keys.push_back(kf.second);
     }
 
-    return LumiverseTypeUtils::lerp(x.get(), y.get(), a);
-  }
-  catch (exception e) {
-    return nullptr;
+    tracks->index[id.first] = (int)tracks->tracks.size();
+    tracks->tracks.push_back(move(track));
   }
+
+  tracks->version = ++_trackVersion;
+  tracks->baked = make_shared<const BakedCurves>(tracks->tracks, tracks->version);
+
+  // Readers still holding the old set keep it alive until they're done with it
+  atomic_store(&_tracks, shared_ptr<const TrackSet>(tracks));
+}
+
+size_t Timeline::seekTrack(const KeyframeTrack& track, size_t pos, size_t time) {
+  const vector<size_t>& times = track.times;
+  size_t n = times.size();
+
+  // Still in the same segment
+  if (pos <= n && (pos == 0 || times[pos - 1] <= time) && (pos == n || times[pos] > time))
+    return pos;
+
+  // Moved into the next segment
+  if (pos < n && times[pos] <= time && (pos + 1 == n || times[pos + 1] > time))
+    return pos + 1;
+
+  return upper_bound(times.begin(), times.end(), time) - times.begin();
+}
+
+shared_ptr<LumiverseType> Timeline::evaluateTrack(const KeyframeTrack& track, size_t pos, const string& id, const string& paramName,
+  LumiverseType* currentVal, size_t time, map<string, shared_ptr<Timeline> >& tls)
+{
+  // If no such timeline exists in the playback, return nullptr (indicate to layer to skip value for this)
+  return interpolateTrack(track, pos, time, [&](const Keyframe& k, size_t localTime) -> shared_ptr<LumiverseType> {
+    auto tl = tls.find(k.timelineID);
+    if (tl == tls.end())
+      return nullptr;
+
+    return tl->second->getValueAtTime(id, paramName, currentVal, localTime, tls);
+  });
 }
 
 void Timeline::executeEvents(size_t prevTime, size_t currentTime) {
@@ -431,109 +495,55 @@ void Timeline::updateKeyframeState(string id, string paramName, LumiverseType* p
       else {
         kf.second.val = shared_ptr<LumiverseType>(LumiverseTypeUtils::copy(param));
       }
+
+      invalidate();
     }
   }
 }
 
 Keyframe Timeline::getPreviousKeyframe(string identifier, size_t time) {
-  // at the moment this function is horribly slow.
-  // TODO: update keyframe datastructure to access elements faster.
-
-  // get the keyframes if they exist, otherwise return null immediately.
-  time = getLoopTime(time);
-
-  auto keyframes = _timelineData[identifier];
-  Keyframe first;
-  Keyframe next;
-  bool nextFound = false;
-
-  for (auto keyframe = keyframes.begin(); keyframe != keyframes.end();) {
-    if (keyframe->first > time) {
-      next = keyframe->second;
-      first = prev(keyframe)->second;
-      nextFound = true;
-      break;
-    }
+  shared_ptr<const TrackSet> tracks = getTracks();
+  auto it = tracks->index.find(identifier);
+  if (it == tracks->index.end())
+    return Keyframe();
 
-    ++keyframe;
-  }
+  const KeyframeTrack& track = tracks->tracks[it->second];
+  size_t pos = seekTrack(track, 0, getLoopTime(time));
 
-  if (!nextFound) {
-    // We are at the end of the defined keyframes, so return the value of the most
-    // recent keyframe
-    auto last = keyframes.rbegin()->second;
-    return last;
+  if (pos >= track.keys.size()) {
+    // We are at the end of the defined keyframes, so return the most recent keyframe
+    return track.keys.back();
   }
 
-  return first;
+  return (pos == 0) ? track.keys[0] : track.keys[pos - 1];
 }
 
 size_t Timeline::getLength() {
-  if (_lengthIsUpdated) {
-    return _length;
+  if (_loops == -1) {
+    // this should be max int in whatever unsigned int representation is used for size_t.
+    return (size_t)-1;
   }
-  else {
-    if (_loops == -1) {
-      // this should be max int in whatever unsigned int representation is used for size_t.
-      _length = -1;
-      _lengthIsUpdated = true;
-      return _length;
-    }
-    else {
-      _length = getLoopLength() * _loops;
 
-      // Cache it.
-      _lengthIsUpdated = true;
-      return _length;
-    }
-  }
+  return getLoopLength() * _loops;
 }
 
 size_t Timeline::getLoopLength() {
-  if (_loopLengthIsUpdated) {
-    return _loopLength;
-  }
-  else {
-    size_t time = 0;
-
-    // the hard way.
-    // Go through and find the maximum time that a keyframe is set to.
-    for (const auto& id : _timelineData) {
-      // Get the last keyframe, this is sorted.
-      if (id.second.size() == 0)
-        continue;
-      
-      auto lastKeyframe = id.second.rbegin()->first;
-
-      // Time is equal to transition time + largest keyframe time.
-      time = (lastKeyframe > time) ? lastKeyframe : time;
-    }
-
-    // also check events
-    if (_events.size() > 0) {
-      time = (_events.rbegin()->first > time) ? _events.rbegin()->first : time;
-    }
-
-    _loopLength = time;
-
-    // Cache it.
-    _loopLengthIsUpdated = true;
-    return _loopLength;
-  }
+  return _loopLength.load();
 }
 
 size_t Timeline::getLoopTime(size_t time) {
   // determine where we are in the loop
-  if (getLoopLength() == 0)
+  size_t loopLength = getLoopLength();
+  if (loopLength == 0)
     return 0;
 
-  int loopNum = (int)(time / getLoopLength());
+  int loopNum = (int)(time / loopLength);
   if (_loops != -1 && loopNum >= _loops) {
     // if we've exceeded our number of loops, set to the end keyframe.
     return time;
   }
   else {
-    time -= loopNum * getLoopLength();
+    time -= loopNum * loopLength;
   }
 
   return time;
@@ -581,6 +591,8 @@ void Timeline::loadJSON(JSONNode node) {
     }
   }
 
+  invalidate();
+
   auto events = node.find("events");
   if (events == node.end()) {
     // We don't really need to note anything here
@@ -595,6 +607,7 @@ void Timeline::loadJSON(JSONNode node) {
         string t = type->as_string();
         if (t == "event") {
           _events.insert(pair<size_t, shared_ptr<Event> >(time->as_int(), shared_ptr<Event>(new Event(*e))));
+          updateLoopLength();
         }
       }
       else {
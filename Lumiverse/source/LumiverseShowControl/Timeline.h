@@ -5,10 +5,16 @@
 
 #include "LumiverseCore.h"
 #include "Keyframe.h"
+#include "CurveTracks.h"
+
+#include <atomic>
+#include <mutex>
 
 namespace Lumiverse {
 namespace ShowControl {
 
+class TimelineGraph;
+
 /*!
 \brief A Timeline is a list of device parameter values at arbitrary times
 
@@ -83,6 +89,9 @@ public:
 
   /*!
   \brief Gets the keyframes for the entire timeline.
+
+  Playback data is rebuilt from this map the next time it's needed, so don't hold
+  onto the reference while the Timeline is playing.
   */
   map<string, map<size_t, Keyframe> >& getAllKeyframes();
 
@@ -225,6 +234,46 @@ public:
   */
   virtual shared_ptr<LumiverseType> getValueAtTime(string id, string paramName, LumiverseType* currentVal, size_t time, map<string, shared_ptr<Timeline> >& tls);
 
+  /*!
+  \brief Returns the value of a parameter at the specified time, starting the keyframe
+  search from a cursor.
+
+  Gives the same result as getValueAtTime(), but is much faster when called repeatedly
+  with increasing times. The cursor is updated to the new position. Cursors with no track
+  are passed to getValueAtTime().
+
+  \param cursor Cursor for the parameter, created with getTrackIndex().
+  \sa getTrackVersion()
+  */
+  shared_ptr<LumiverseType> getValueAtCursor(TrackCursor& cursor, const string& id, const string& paramName,
+    LumiverseType* currentVal, size_t time, map<string, shared_ptr<Timeline> >& tls);
+
+  /*!
+  \brief Gets the index of the keyframe track for an identifier.
+
+  Subclasses that override getValueAtTime() with something that doesn't use keyframes
+  should override this to return -1.
+  \return Track index, or -1 if there are no keyframes for the identifier.
+  */
+  virtual int getTrackIndex(const string& identifier);
+
+  /*!
+  \brief Gets the current version of the keyframe tracks.
+
+  The version changes whenever keyframes are edited. Track indices and cursors
+  from a different version are invalid.
+  */
+  unsigned int getTrackVersion();
+
+  /*!
+  \brief Gets the keyframe tracks baked into typed curve arrays.
+
+  Curves are baked along with the tracks, so they are replaced automatically when
+  keyframes are edited. Curve indices match getTrackIndex().
+  \sa CurvePlayhead
+  */
+  shared_ptr<const BakedCurves> getBakedCurves();
+
   /*!
   \brief Executes the events between the specified times
 
@@ -315,20 +364,13 @@ public:
   virtual string getTimelineTypeName() { return "timeline"; }
 
 protected:
-  /*!
-  \brief Stores the length of the timeline.
-
-  The length is calculated as needed, as it is a potentially time consuming thing
-  to figure out.
-  */
-  size_t _length;
-
   /*!
   \brief Stores the loop length of the timleine.
 
-  Calculated as needed and cached.
+  Recalculated whenever keyframes or events change, so that playback threads only
+  ever read it.
   */
-  size_t _loopLength;
+  atomic<size_t> _loopLength;
   
   /*!
   \brief Describes how many times the timeline should loop.
@@ -337,24 +379,14 @@ protected:
   */
   int _loops;
 
-  /*!
-  \brief Indicates if the timeline's length is updated.
-  */
-  bool _lengthIsUpdated;
-
-  /*!
-  \brief Indicates if the timeline's loop length is updated.
-  */
-  bool _loopLengthIsUpdated;
-
-  // right so the map should at some point be changed to a specialized data structure that meets
-  // the following properties:
-  // -given a time, can find the first and next keyframes (if they exist) as quickly as possible
-  // -can handle insertions and deletions quickly (doesn't have to be as fast as possible)
   /*!
   \brief Map from unique identifier to timeline keyframes.
 
   The unique identifier for device parameter pair is: [deviceID]:[paramName]
+
+  This is the editable copy of the keyframes. Playback reads from sorted array copies
+  (see KeyframeTrack) that are rebuilt after edits, so call invalidate() after
+  changing this directly.
   */
   map<string, map<size_t, Keyframe> > _timelineData;
 
@@ -380,8 +412,131 @@ protected:
   \brief Initializes the timeline with the given JSONNode's data.
   */
   void loadJSON(JSONNode node);
+
+  /*!
+  \brief Updates the loop length and marks the keyframe tracks as out of date.
+
+  Call this after modifying _timelineData.
+  */
+  void invalidate();
+
+  /*!
+  \brief Recalculates _loopLength from the keyframes and events.
+  */
+  void updateLoopLength();
+
+private:
+  friend class TimelineGraph;
+
+  /*!
+  \brief Sorted array copies of _timelineData.
+
+  A set is never modified once it's published. Edits build a new set, so readers
+  that hold a set can keep using it while the timeline changes.
+  */
+  struct TrackSet {
+    /*! \brief Tracks, indexed by index. */
+    vector<KeyframeTrack> tracks;
+
+    /*! \brief Map from identifier to index in tracks. */
+    unordered_map<string, int> index;
+
+    /*! \brief tracks baked into typed curves. */
+    shared_ptr<const BakedCurves> baked;
+
+    /*! \brief Value of _trackVersion when the set was built. */
+    unsigned int version;
+  };
+
+  /*!
+  \brief Current tracks. Read and replaced with std::atomic_load and std::atomic_store.
+
+  Rebuilt from _timelineData the next time they're needed after an edit.
+  */
+  shared_ptr<const TrackSet> _tracks;
+
+  /*! \brief Set when _tracks no longer matches _timelineData. */
+  atomic<bool> _tracksDirty;
+
+  /*! \brief Incremented every time _tracks is rebuilt. */
+  atomic<unsigned int> _trackVersion;
+
+  /*! \brief Prevents multiple layers from rebuilding the tracks at the same time. */
+  mutex _trackMutex;
+
+  /*! \brief Rebuilds _tracks if keyframes have changed. */
+  void updateTracks();
+
+  /*! \brief Returns the current tracks, rebuilding them first if needed. Never null. */
+  shared_ptr<const TrackSet> getTracks();
+
+  /*!
+  \brief Moves a track position so that it points to the first keyframe after time.
+
+  Checks the current and next segment before doing a binary search.
+  */
+  static size_t seekTrack(const KeyframeTrack& track, size_t pos, size_t time);
+
+  /*!
+  \brief Interpolates a track at a time, given the position from seekTrack().
+
+  Keyframes that reference other timelines are passed to
+  resolve(const Keyframe&, size_t localTime), which returns the value of the
+  referenced timeline or nullptr.
+  */
+  template<typename Resolve>
+  static shared_ptr<LumiverseType> interpolateTrack(const KeyframeTrack& track, size_t pos, size_t time, Resolve resolve);
+
+  /*! \brief Evaluates a track at a time, given the position from seekTrack(). */
+  shared_ptr<LumiverseType> evaluateTrack(const KeyframeTrack& track, size_t pos, const string& id, const string& paramName,
+    LumiverseType* currentVal, size_t time, map<string, shared_ptr<Timeline> >& tls);
 };
 
+template<typename Resolve>
+shared_ptr<LumiverseType> Timeline::interpolateTrack(const KeyframeTrack& track, size_t pos, size_t time, Resolve resolve) {
+  if (pos >= track.keys.size()) {
+    // We are at the end of the defined keyframes, so return the value of the most
+    // recent keyframe
+    const Keyframe& last = track.keys.back();
+
+    if (last.timelineID != "")
+      return resolve(last, time - last.t + last.timelineOffset);
+
+    return last.val;
+  }
+
+  const Keyframe& next = track.keys[pos];
+
+  // Special case if they keyframe we found is after the current time but there is no keyframe
+  // before the keyframe we found. Example: no keyframe at t = 0 but keyframe at t = 1200, with
+  // t currently equal to 50.
+  const Keyframe& first = (pos == 0) ? next : track.keys[pos - 1];
+
+  // Note that in the instance when we use the current state, that value is pre-filled
+  // at the time of timeline run initialization.
+
+  // Otherwise we have our keyframes and can now do some ops.
+  float a = (next.t > first.t) ? (float)(time - first.t) / (float)(next.t - first.t) : 0;
+
+  shared_ptr<LumiverseType> x = first.val;
+  shared_ptr<LumiverseType> y = next.val;
+
+  // Check if any keyframe references timelines
+  if (first.timelineID != "") {
+    x = resolve(first, time - first.t + first.timelineOffset);
+    if (x == nullptr)
+      return nullptr;
+  }
+  if (next.timelineID != "") {
+    y = resolve(next, time - next.t + next.timelineOffset);
+  }
+
+  if (x == nullptr || y == nullptr)
+    return nullptr;
+
+  return LumiverseTypeUtils::lerp(x.get(), y.get(), a);
+}
+
 }
 }
 #endif
\ No newline at end of file
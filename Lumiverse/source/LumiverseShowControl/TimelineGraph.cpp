@@ -0,0 +1,208 @@
+#include "TimelineGraph.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Lumiverse {
+namespace ShowControl {
+
+TimelineGraph::TimelineGraph() : m_tls(nullptr) { }
+
+bool TimelineGraph::build(shared_ptr<Timeline> root, map<string, shared_ptr<Timeline> >& tls) {
+  m_nodes.clear();
+  m_tls = &tls;
+
+  if (root == nullptr)
+    return true;
+
+  // The root may not be in tls, so find its name for error messages.
+  string name = "";
+  for (const auto& tl : tls) {
+    if (tl.second == root) {
+      name = tl.first;
+      break;
+    }
+  }
+
+  map<Timeline*, int> nodes;
+  vector<int> path;
+  bool acyclic = true;
+  resolve(name, root, nodes, path, acyclic);
+
+  return acyclic;
+}
+
+bool TimelineGraph::isCurrent() {
+  for (const auto& n : m_nodes) {
+    if (n.tl->getTrackVersion() != n.tracks->version)
+      return false;
+  }
+
+  return true;
+}
+
+shared_ptr<LumiverseType> TimelineGraph::getValue(TrackCursor& cursor, const string& id, const string& paramName,
+  LumiverseType* currentVal, size_t time)
+{
+  if (m_nodes.empty())
+    return nullptr;
+
+  Timeline* root = m_nodes[0].tl.get();
+  const Timeline::TrackSet& tracks = *m_nodes[0].tracks;
+
+  if (cursor.track < 0)
+    return root->getValueAtTime(id, paramName, currentVal, time, *m_tls);
+
+  if (cursor.track >= (int)tracks.tracks.size())
+    return nullptr;
+
+  time = root->getLoopTime(time);
+  cursor.pos = Timeline::seekTrack(tracks.tracks[cursor.track], cursor.pos, time);
+
+  return evaluate(0, cursor.track, cursor.pos, id, paramName, currentVal, time);
+}
+
+bool TimelineGraph::isDone(size_t time) {
+  if (m_nodes.empty())
+    return true;
+
+  return isDone(0, time);
+}
+
+int TimelineGraph::resolve(const string& name, shared_ptr<Timeline> tl, map<Timeline*, int>& nodes, vector<int>& path, bool& acyclic) {
+  auto existing = nodes.find(tl.get());
+  if (existing != nodes.end())
+    return existing->second;
+
+  int index = (int)m_nodes.size();
+  nodes[tl.get()] = index;
+
+  Node node;
+  node.name = name;
+  node.tl = tl;
+  node.tracks = tl->getTracks();
+  node.doneAt = numeric_limits<size_t>::max();
+  m_nodes.push_back(node);
+
+  path.push_back(index);
+
+  shared_ptr<const Timeline::TrackSet> tracks = m_nodes[index].tracks;
+  vector<vector<Reference> > refs(tracks->tracks.size());
+  vector<EndReference> endRefs;
+  set<int> cycles;
+
+  for (const auto& ti : tracks->index) {
+    const KeyframeTrack& track = tracks->tracks[ti.second];
+
+    for (size_t k = 0; k < track.keys.size(); k++) {
+      const Keyframe& key = track.keys[k];
+      if (key.timelineID == "")
+        continue;
+
+      if (refs[ti.second].empty()) {
+        Reference none = { -1, -1 };
+        refs[ti.second].resize(track.keys.size(), none);
+      }
+
+      Reference& r = refs[ti.second][k];
+
+      auto child = m_tls->find(key.timelineID);
+      if (child == m_tls->end() || child->second == nullptr)
+        continue;
+
+      // A reference to a timeline we're still resolving closes a cycle.
+      auto visited = nodes.find(child->second.get());
+      if (visited != nodes.end() && find(path.begin(), path.end(), visited->second) != path.end()) {
+        if (cycles.count(visited->second) == 0) {
+          string cycle = "";
+          for (auto p = find(path.begin(), path.end(), visited->second); p != path.end(); p++) {
+            cycle += m_nodes[*p].name + " -> ";
+          }
+          Logger::log(ERR, "Timeline reference cycle: " + cycle + key.timelineID + ". Reference will be ignored.");
+
+          cycles.insert(visited->second);
+        }
+
+        acyclic = false;
+        continue;
+      }
+
+      r.node = resolve(child->first, child->second, nodes, path, acyclic);
+      // Subclasses without tracks return -1 here and are evaluated through getValueAtTime()
+      const Timeline::TrackSet& childTracks = *m_nodes[r.node].tracks;
+      auto childTrack = childTracks.index.find(ti.first);
+      r.track = (childTrack == childTracks.index.end() || m_nodes[r.node].tl->getTrackIndex(ti.first) < 0) ?
+        -1 : childTrack->second;
+
+      if (k + 1 == track.keys.size()) {
+        bool seen = false;
+        for (const auto& e : endRefs) {
+          if (e.node == r.node && e.t == key.t && e.offset == key.timelineOffset) {
+            seen = true;
+            break;
+          }
+        }
+
+        if (!seen) {
+          EndReference e = { r.node, key.t, key.timelineOffset };
+          endRefs.push_back(e);
+        }
+      }
+    }
+  }
+
+  m_nodes[index].refs = move(refs);
+  m_nodes[index].endRefs = move(endRefs);
+  path.pop_back();
+
+  return index;
+}
+
+shared_ptr<LumiverseType> TimelineGraph::evaluate(int node, int track, size_t pos, const string& id, const string& paramName,
+  LumiverseType* currentVal, size_t time)
+{
+  const Node& n = m_nodes[node];
+  const KeyframeTrack& keys = n.tracks->tracks[track];
+  const vector<Reference>& refs = n.refs[track];
+
+  return Timeline::interpolateTrack(keys, pos, time, [&](const Keyframe& k, size_t localTime) -> shared_ptr<LumiverseType> {
+    size_t i = &k - keys.keys.data();
+    if (i >= refs.size() || refs[i].node < 0)
+      return nullptr;
+
+    const Reference& r = refs[i];
+    Timeline* child = m_nodes[r.node].tl.get();
+
+    // No track, let the timeline decide. This is also how timelines without keyframes are evaluated.
+    if (r.track < 0)
+      return child->getValueAtTime(id, paramName, currentVal, localTime, *m_tls);
+
+    localTime = child->getLoopTime(localTime);
+    size_t childPos = Timeline::seekTrack(m_nodes[r.node].tracks->tracks[r.track], 0, localTime);
+    return evaluate(r.node, r.track, childPos, id, paramName, currentVal, localTime);
+  });
+}
+
+bool TimelineGraph::isDone(int node, size_t time) {
+  Node& n = m_nodes[node];
+
+  if (time >= n.doneAt)
+    return true;
+
+  // Automatically return false if set to infinite loop.
+  if (n.tl->getLoops() == -1 || time <= n.tl->getLength())
+    return false;
+
+  // Check to see if any timelines are still running in the end keyframes
+  for (const auto& e : n.endRefs) {
+    if (!isDone(e.node, time - e.t + e.offset))
+      return false;
+  }
+
+  // Timelines don't become un-done as time moves forward.
+  n.doneAt = time;
+  return true;
+}
+
+}
+}
@@ -0,0 +1,122 @@
+#ifndef _TIMELINEGRAPH_H_
+#define _TIMELINEGRAPH_H_
+
+#pragma once
+
+#include "LumiverseCore.h"
+#include "Timeline.h"
+
+namespace Lumiverse {
+namespace ShowControl {
+
+/*!
+\brief Timeline references resolved to direct pointers for playback.
+
+Keyframes may reference other timelines by name. Looking those names up in the
+Playback on every frame gets expensive when cues chain "use current state"
+keyframes through several earlier cues, so a Layer builds a TimelineGraph when it
+starts playing a Timeline instead. Every timeline reachable from the played one is
+resolved once, along with the track each reference lands on, and evaluation walks
+the graph directly.
+
+References that would form a cycle are logged and treated the same as references
+to missing timelines. Done state is cached per timeline, since a finite timeline
+stays done once it is done.
+*/
+class TimelineGraph {
+public:
+  TimelineGraph();
+
+  /*!
+  \brief Resolves every timeline reachable from root.
+
+  \param root Timeline being played.
+  \param tls Timelines to resolve references against, usually Playback::getTimelines().
+  The map must outlive the graph.
+  \return false if any references formed a cycle.
+  */
+  bool build(shared_ptr<Timeline> root, map<string, shared_ptr<Timeline> >& tls);
+
+  /*!
+  \brief Returns false if any timeline in the graph has been edited since build().
+  */
+  bool isCurrent();
+
+  /*!
+  \brief Gets the value of a parameter in the root timeline.
+
+  Same as Timeline::getValueAtCursor(), with nested references resolved through the graph.
+  */
+  shared_ptr<LumiverseType> getValue(TrackCursor& cursor, const string& id, const string& paramName,
+    LumiverseType* currentVal, size_t time);
+
+  /*!
+  \brief Same as Timeline::isDone() for the root timeline.
+  */
+  bool isDone(size_t time);
+
+  /*! \brief Returns the Timeline being played, or nullptr if the graph hasn't been built. */
+  shared_ptr<Timeline> getRoot() { return m_nodes.empty() ? nullptr : m_nodes[0].tl; }
+
+  /*! \brief Number of timelines in the graph, including the root. */
+  size_t getNumTimelines() { return m_nodes.size(); }
+
+private:
+  /*! \brief A resolved timeline reference. node is -1 if the timeline is missing. */
+  struct Reference {
+    int node;
+    int track;
+  };
+
+  /*! \brief A distinct timeline referenced by the last keyframe of a track. */
+  struct EndReference {
+    int node;
+    size_t t;
+    size_t offset;
+  };
+
+  struct Node {
+    string name;
+    shared_ptr<Timeline> tl;
+
+    /*!
+    \brief Tracks of tl when it was resolved.
+
+    Evaluation only reads these, so edits to tl can't change them underneath it.
+    */
+    shared_ptr<const Timeline::TrackSet> tracks;
+
+    /*!
+    \brief References for each keyframe of each track.
+
+    Empty for tracks that don't reference other timelines.
+    */
+    vector<vector<Reference> > refs;
+
+    /*! \brief References checked by isDone(). */
+    vector<EndReference> endRefs;
+
+    /*! \brief Earliest time the timeline was found to be done. */
+    size_t doneAt;
+  };
+
+  vector<Node> m_nodes;
+  map<string, shared_ptr<Timeline> >* m_tls;
+
+  /*!
+  \brief Adds a timeline and everything it references to the graph.
+
+  \param path Nodes currently being resolved, for cycle detection.
+  \return Node index.
+  */
+  int resolve(const string& name, shared_ptr<Timeline> tl, map<Timeline*, int>& nodes, vector<int>& path, bool& acyclic);
+
+  shared_ptr<LumiverseType> evaluate(int node, int track, size_t pos, const string& id, const string& paramName,
+    LumiverseType* currentVal, size_t time);
+
+  bool isDone(int node, size_t time);
+};
+
+}
+}
+#endif
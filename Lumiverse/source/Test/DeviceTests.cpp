@@ -11,6 +11,7 @@ int DeviceTests::runTests() {
   (runTest([=]{ return this->deviceMetadataManipulation(); }, "deviceMetadataManipulation", 6)) ? numPassed++ : numPassed;
   (runTest([=]{ return this->devicePropertyInfo(); }, "devicePropertyInfo", 7)) ? numPassed++ : numPassed;
   (runTest([=]{ return this->deviceCallbacks(); }, "deviceCallbacks", 8)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->deviceSnapshot(); }, "deviceSnapshot", 9)) ? numPassed++ : numPassed;
 
   return numPassed;
 }
@@ -360,4 +361,80 @@ bool DeviceTests::deviceCallbacks() {
   }
 
   return ret;
-}
\ No newline at end of file
+}
+
+bool DeviceTests::deviceSnapshot() {
+  Device d("test1", 1, "Moving Light");
+  d.setParam("intensity", new LumiverseFloat(0, 0, 1, 0));
+  d.setParam("pan", new LumiverseFloat(0.5f, 0.5f, 1, 0));
+  d.setParam("tilt", new LumiverseFloat(0.5f, 0.5f, 1, 0));
+  d.setParam("zoom", new LumiverseFloat(0.2f, 0.2f, 1, 0));
+
+  // Simulate a recording session where only intensity changes each frame.
+  const int frames = 100;
+  vector<Device*> snapshots;
+  Device* last = nullptr;
+  for (int i = 0; i < frames; i++) {
+    d.setParam("intensity", i / (float)frames);
+    last = new Device(&d, last);
+    snapshots.push_back(last);
+  }
+
+  set<LumiverseType*> allocated;
+  for (auto s : snapshots) {
+    for (auto& p : s->getRawParameters())
+      allocated.insert(p.second);
+  }
+
+  bool ret = true;
+  size_t deepCopyCount = frames * d.numParams();
+  cout << "Snapshot parameter allocations over " << frames << " frames: " << allocated.size()
+    << " (deep copies: " << deepCopyCount << ")\n";
+
+  if (allocated.size() != frames + d.numParams() - 1) {
+    cout << "[ERROR] deviceSnapshot: Unchanged parameters were not shared between snapshots\n";
+    ret = false;
+  }
+
+  float val;
+  snapshots[10]->getParam("intensity", val);
+  if (val != 10 / (float)frames) {
+    cout << "[ERROR] deviceSnapshot: Snapshot does not hold the value at the time it was taken\n";
+    ret = false;
+  }
+
+  // Writing to a snapshot must not affect the snapshots it shares data with
+  snapshots[1]->setParam("pan", 0.9f);
+  snapshots[0]->getParam("pan", val);
+  if (val != 0.5f) {
+    cout << "[ERROR] deviceSnapshot: Modifying a snapshot changed a shared parameter\n";
+    ret = false;
+  }
+
+  if (snapshots[1]->numSharedParams() != 2) {
+    cout << "[ERROR] deviceSnapshot: Expected 2 shared parameters after write, found " << snapshots[1]->numSharedParams() << "\n";
+    ret = false;
+  }
+
+  // A snapshot of a snapshot shares the whole parameter block
+  Device* copy = new Device(snapshots[50], snapshots[50]);
+  for (auto& p : snapshots[50]->getRawParameters()) {
+    if (copy->getParam(p.first) != p.second) {
+      cout << "[ERROR] deviceSnapshot: Snapshot of a snapshot copied parameter " << p.first << "\n";
+      ret = false;
+    }
+  }
+
+  copy->setParam("zoom", 0.7f);
+  snapshots[50]->getParam("zoom", val);
+  if (val != 0.2f || copy->getParam("intensity") != snapshots[50]->getParam("intensity")) {
+    cout << "[ERROR] deviceSnapshot: Writing to a shared block wasn't copy-on-write\n";
+    ret = false;
+  }
+  delete copy;
+
+  for (auto s : snapshots)
+    delete s;
+
+  return ret;
+}
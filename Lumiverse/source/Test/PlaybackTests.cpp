@@ -17,6 +17,16 @@ int PlaybackTests::runTests() {
   (runTest([=]{ return this->layerToggle(); }, "layerToggle", 7)) ? numPassed++ : numPassed;
   (runTest([=]{ return this->snapshot(); }, "snapshot", 8)) ? numPassed++ : numPassed;
   (runTest([=]{ return this->groups(); }, "groups", 9)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->trackCursor(); }, "trackCursor", 10)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->bakedCurves(); }, "bakedCurves", 11)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->timelineGraph(); }, "timelineGraph", 12)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->parallelUpdate(); }, "parallelUpdate", 13)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->denseBlend(); }, "denseBlend", 14)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->layerOwnership(); }, "layerOwnership", 15)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->blendModes(); }, "blendModes", 16)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->layerOrder(); }, "layerOrder", 17)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->offlineRender(); }, "offlineRender", 18)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->grandmaster(); }, "grandmaster", 19)) ? numPassed++ : numPassed;
 
   return numPassed;
 }
@@ -273,4 +283,941 @@ bool PlaybackTests::groups() {
     return false;
   }
   return true;
-}
\ No newline at end of file
+}
+
+bool PlaybackTests::trackCursor() {
+  Timeline tl;
+  map<string, shared_ptr<Timeline> > tls;
+  LumiverseFloat val(0.0f);
+
+  // Intensity ramps 0 -> 1 -> 0.5 -> 0.5
+  size_t times[] = { 1000, 2000, 4000, 6000 };
+  float vals[] = { 0, 1, 0.5f, 0.5f };
+  for (int i = 0; i < 4; i++) {
+    val.setVal(vals[i]);
+    tl.setKeyframe("s41:intensity", times[i], &val);
+  }
+
+  auto expected = [&](size_t t) -> float {
+    if (t <= times[0]) return vals[0];
+    for (int i = 1; i < 4; i++) {
+      if (t < times[i])
+        return vals[i - 1] + (vals[i] - vals[i - 1]) * (float)(t - times[i - 1]) / (float)(times[i] - times[i - 1]);
+    }
+    return vals[3];
+  };
+
+  TrackCursor cursor;
+  cursor.track = tl.getTrackIndex("s41:intensity");
+  if (cursor.track < 0 || tl.getTrackIndex("s41:color") != -1) {
+    cout << "Track index lookup failed\n";
+    return false;
+  }
+
+  // Play forward, then jump backwards and forwards again.
+  vector<size_t> steps;
+  for (size_t t = 0; t < 7000; t += 37) steps.push_back(t);
+  steps.push_back(1500);
+  steps.push_back(5000);
+  steps.push_back(0);
+
+  for (size_t t : steps) {
+    auto res = tl.getValueAtCursor(cursor, "s41", "intensity", &val, t, tls);
+    if (res == nullptr || abs(((LumiverseFloat*)res.get())->getVal() - expected(t)) > 1e-5) {
+      cout << "Cursor value at " << t << " expected " << expected(t) << "\n";
+      return false;
+    }
+  }
+
+  // Editing keyframes should invalidate the tracks.
+  unsigned int version = tl.getTrackVersion();
+  val.setVal(1);
+  tl.setKeyframe("s41:intensity", 6000, &val);
+
+  if (tl.getTrackVersion() == version) {
+    cout << "Track version did not change after keyframe edit\n";
+    return false;
+  }
+
+  auto res = tl.getValueAtTime("s41", "intensity", &val, 5000, tls);
+  if (res == nullptr || abs(((LumiverseFloat*)res.get())->getVal() - 0.75) > 1e-5) {
+    cout << "Timeline value not updated after keyframe edit\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool PlaybackTests::bakedCurves() {
+  Timeline tl;
+  map<string, shared_ptr<Timeline> > tls;
+
+  LumiverseFloat intensity(0.0f);
+  LumiverseOrientation pan(0.0f, DEGREE, 0, 540, 0);
+  LumiverseColor color;
+  color.addColorChannel("Red");
+  color.addColorChannel("Blue");
+  map<string, int> options = { { "Open", 0 }, { "Gobo 1", 64 }, { "Gobo 2", 128 } };
+  LumiverseEnum gobo(options, LumiverseEnum::CENTER, 255, "Open", LumiverseEnum::SMOOTH_WITHIN_OPTION);
+
+  size_t times[] = { 1000, 2000, 4000 };
+  for (int i = 0; i < 3; i++) {
+    intensity.setVal(0.5f * i);
+    pan.setVal(100.0f * i);
+    color.setColorChannel("Red", 1 - 0.5 * i);
+    color.setColorChannel("Blue", 0.4 * i);
+    color.setWeight(1 - 0.25 * i);
+    gobo.setVal((i == 2) ? "Gobo 1" : "Open", 0.2f * i);
+
+    tl.setKeyframe("s41:intensity", times[i], &intensity);
+    tl.setKeyframe("s41:pan", times[i], &pan);
+    tl.setKeyframe("s41:color", times[i], &color);
+    tl.setKeyframe("s41:gobo", times[i], &gobo);
+  }
+
+  // Tracks referencing other timelines can't be baked.
+  tl.setKeyframe("s42:intensity", 1000, string("Other"), 0);
+
+  auto curves = tl.getBakedCurves();
+  if (curves == nullptr || curves->getNumBaked() != 4 ||
+    curves->getType(tl.getTrackIndex("s42:intensity")) != BakedCurves::NONE) {
+    cout << "Unexpected tracks baked\n";
+    return false;
+  }
+
+  // Evaluate into copies of the values and compare against the Timeline.
+  LumiverseFloat bIntensity(0.0f);
+  LumiverseOrientation bPan(pan);
+  LumiverseColor bColor(color);
+  LumiverseEnum bGobo(gobo);
+  map<string, LumiverseType*> baked = { { "intensity", &bIntensity }, { "pan", &bPan }, { "color", &bColor }, { "gobo", &bGobo } };
+
+  CurvePlayhead playhead;
+  playhead.reset(curves);
+  for (const auto& b : baked) {
+    if (!playhead.bind(tl.getTrackIndex("s41:" + b.first), b.second)) {
+      cout << "Unable to bind " << b.first << "\n";
+      return false;
+    }
+  }
+
+  for (size_t t = 0; t < 5000; t += 125) {
+    playhead.evaluate(t);
+
+    for (const auto& b : baked) {
+      auto expected = tl.getValueAtTime("s41", b.first, b.second, t, tls);
+      bool match = (expected != nullptr);
+      if (match && b.first == "color") {
+        // Channel order in asString() isn't fixed, compare channels directly.
+        LumiverseColor* e = (LumiverseColor*)expected.get();
+        match = abs(e->getWeight() - bColor.getWeight()) < 1e-5;
+        for (const auto& c : e->getColorParams())
+          match = match && abs(c.second - bColor.getColorParams()[c.first]) < 1e-5;
+      }
+      else if (match) {
+        match = (expected->asString() == b.second->asString());
+      }
+
+      if (!match) {
+        cout << "Baked " << b.first << " at " << t << " is " << b.second->asString() << " expected " << (expected ? expected->asString() : "null") << "\n";
+        return false;
+      }
+    }
+  }
+
+  // Scalars can go straight into a LayerBuffer, converted to the units of the state.
+  Device device("s41", 1, "test");
+  device.setParam("intensity", new LumiverseFloat(0.0f));
+  device.setParam("pan", new LumiverseOrientation(0.0f, RADIAN, 0, 10, 0));
+  map<string, Device*> state = { { "s41", &device } };
+  ParamLayout layout;
+  layout.build(state);
+
+  LumiverseFloat lIntensity(0.0f);
+  LumiverseOrientation lPan(pan);
+  map<string, map<string, LumiverseType*> > layerState = { { "s41", { { "intensity", &lIntensity }, { "pan", &lPan } } } };
+  map<string, set<string> > owned = { { "s41", { "intensity", "pan" } } };
+  LayerBuffer buffer;
+  buffer.bind(layout, layerState, owned, 0, 0, "Baked");
+
+  playhead.reset(curves);
+  for (const auto& p : layerState["s41"]) {
+    int unit;
+    float* target = buffer.feed(p.second, unit);
+    if (target == nullptr || !playhead.bind(tl.getTrackIndex("s41:" + p.first), p.second)) {
+      cout << "Unable to send " << p.first << " to the layer buffer\n";
+      return false;
+    }
+    playhead.setTarget(playhead.getNumScalars() - 1, target, unit);
+  }
+
+  LayerBuffer::Op ops[LayerBuffer::NUM_TYPES];
+  for (auto& op : ops)
+    op = { LayerBuffer::LERP, 1 };
+
+  for (size_t t = 0; t < 5000; t += 250) {
+    playhead.evaluate(t);
+
+    // Sets the gathered values, which shouldn't replace the ones from the playhead
+    lIntensity.setVal(0.99f);
+    buffer.gather();
+    Eigen::ArrayXf values = layout.getDefaults();
+    buffer.blend(values, layout, ops);
+    layout.write(values);
+
+    auto eIntensity = tl.getValueAtTime("s41", "intensity", &bIntensity, t, tls);
+    auto ePan = tl.getValueAtTime("s41", "pan", &bPan, t, tls);
+    float actual;
+    device.getParam("intensity", actual);
+    LumiverseOrientation* dPan = (LumiverseOrientation*)device.getParam("pan");
+
+    if (abs(actual - ((LumiverseFloat*)eIntensity.get())->getVal()) > 1e-5 ||
+      abs(dPan->valAsUnit(DEGREE) - ((LumiverseOrientation*)ePan.get())->valAsUnit(DEGREE)) > 1e-3) {
+      cout << "Buffered values at " << t << " are " << actual << ", " << dPan->asString() << " expected " << eIntensity->asString() << ", " << ePan->asString() << "\n";
+      return false;
+    }
+  }
+
+  // The parameters only get the buffered values when asked to.
+  playhead.writeParams();
+  if (lIntensity.asString() != tl.getValueAtTime("s41", "intensity", &bIntensity, 4750, tls)->asString()) {
+    cout << "Buffered intensity wasn't written back, it's " << lIntensity.asString() << "\n";
+    return false;
+  }
+
+  // Editing a keyframe rebakes the curves.
+  intensity.setVal(0.0f);
+  tl.setKeyframe("s41:intensity", 4000, &intensity);
+  if (tl.getBakedCurves() == curves || tl.getBakedCurves()->getVersion() != tl.getTrackVersion()) {
+    cout << "Curves not rebaked after keyframe edit\n";
+    return false;
+  }
+
+  // Long running timelines keep ms resolution, and the range of the keyframes
+  // is copied into the parameter along with the value.
+  Timeline longTl;
+  size_t hours = 5 * 60 * 60 * 1000;
+  LumiverseFloat zoom(0.0f, 5.0f, 20.0f, 0.0f);
+  longTl.setKeyframe("s41:zoom", hours, &zoom);
+  zoom.setVal(20.0f);
+  longTl.setKeyframe("s41:zoom", hours + 4, &zoom);
+
+  LumiverseFloat bZoom(0.0f, 0.0f, 1.0f, 0.0f);
+  playhead.reset(longTl.getBakedCurves());
+  playhead.bind(longTl.getTrackIndex("s41:zoom"), &bZoom);
+
+  for (size_t t = hours; t <= hours + 4; t++) {
+    playhead.evaluate(t);
+    auto expected = longTl.getValueAtTime("s41", "zoom", &bZoom, t, tls);
+    if (expected == nullptr || expected->asString() != bZoom.asString() ||
+      bZoom.getMax() != 20.0f || bZoom.getDefault() != 5.0f) {
+      cout << "Baked zoom at " << t << " is " << bZoom.asString() << " expected " << (expected ? expected->asString() : "null") << "\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool PlaybackTests::timelineGraph() {
+  map<string, shared_ptr<Timeline> > tls;
+  LumiverseFloat val(0.0f);
+
+  // Three chained cues, each fading in from wherever the previous one is.
+  tls["cue1"] = shared_ptr<Timeline>(new Timeline());
+  val.setVal(0.0f);
+  tls["cue1"]->setKeyframe("s41:intensity", 0, &val);
+  val.setVal(1.0f);
+  tls["cue1"]->setKeyframe("s41:intensity", 2000, &val);
+
+  tls["cue2"] = shared_ptr<Timeline>(new Timeline());
+  tls["cue2"]->setKeyframe("s41:intensity", 0, string("cue1"), 1000);
+  val.setVal(0.2f);
+  tls["cue2"]->setKeyframe("s41:intensity", 3000, &val);
+
+  tls["cue3"] = shared_ptr<Timeline>(new Timeline());
+  tls["cue3"]->setKeyframe("s41:intensity", 0, string("cue2"), 500);
+  tls["cue3"]->setKeyframe("s41:intensity", 1000, string("cue2"), 1500);
+  tls["cue3"]->setKeyframe("s41:intensity", 2000, string("missing"), 0);
+
+  TimelineGraph graph;
+  if (!graph.build(tls["cue3"], tls) || graph.getNumTimelines() != 3) {
+    cout << "Graph did not resolve all timelines\n";
+    return false;
+  }
+
+  TrackCursor cursor;
+  cursor.track = tls["cue3"]->getTrackIndex("s41:intensity");
+
+  for (size_t t = 0; t < 6000; t += 50) {
+    auto expected = tls["cue3"]->getValueAtTime("s41", "intensity", &val, t, tls);
+    auto actual = graph.getValue(cursor, "s41", "intensity", &val, t);
+
+    if ((expected == nullptr) != (actual == nullptr) ||
+      (expected != nullptr && abs(((LumiverseFloat*)expected.get())->getVal() - ((LumiverseFloat*)actual.get())->getVal()) > 1e-5)) {
+      cout << "Graph value at " << t << " does not match Timeline\n";
+      return false;
+    }
+
+    if (graph.isDone(t) != tls["cue3"]->isDone(t, tls)) {
+      cout << "Graph done state at " << t << " does not match Timeline\n";
+      return false;
+    }
+  }
+
+  // Edits are picked up after a rebuild.
+  if (!graph.isCurrent())
+    return false;
+
+  tls["cue1"]->setKeyframe("s41:intensity", 4000, &val);
+  if (graph.isCurrent()) {
+    cout << "Graph not invalidated by keyframe edit\n";
+    return false;
+  }
+
+  // Cycles are reported and treated as missing timelines.
+  tls["cue1"]->setKeyframe("s41:intensity", 5000, string("cue3"), 0);
+  if (graph.build(tls["cue3"], tls)) {
+    cout << "Cycle not detected\n";
+    return false;
+  }
+
+  return graph.isDone(100000) && graph.getValue(cursor, "s41", "intensity", &val, 100000) == nullptr;
+}
+
+bool PlaybackTests::parallelUpdate() {
+  // Playbacks use the shared pool unless given their own.
+  {
+    Playback pb(m_testRig);
+    if (pb.getNumWorkerThreads() != ThreadPool::getShared()->getNumThreads()) {
+      cout << "Playback didn't use the shared pool by default\n";
+      return false;
+    }
+
+    pb.setNumWorkerThreads(2);
+    size_t own = pb.getNumWorkerThreads();
+    pb.setNumWorkerThreads(0);
+    if (own != 2 || pb.getNumWorkerThreads() != 0 || ThreadPool::getShared()->getNumThreads() !=
+      (size_t)max(0, (int)thread::hardware_concurrency() - 1)) {
+      cout << "Overriding the worker threads changed the shared pool\n";
+      return false;
+    }
+  }
+
+  // Enough devices to split the layer into several partitions.
+  size_t numDevices = Layer::PARTITION_SIZE * 3 / 2;
+  shared_ptr<Layer> layer(new Layer(m_pb, "Parallel", 100));
+  shared_ptr<Timeline> tl(new Timeline());
+  vector<shared_ptr<Device> > devices;
+  LumiverseFloat val(0.0f);
+
+  for (size_t i = 0; i < numDevices; i++) {
+    string id = "parallel" + to_string(i);
+    shared_ptr<Device> d(new Device(id, (unsigned int)i + 1, "test"));
+    d->setParam("intensity", new LumiverseFloat(0.0f));
+    layer->addDevice(d.get(), "intensity");
+    devices.push_back(d);
+
+    val.setVal((i % 10) / 10.0f);
+    tl->setKeyframe(id + ":intensity", 0, &val);
+    val.setVal(1 - (i % 7) / 7.0f);
+    tl->setKeyframe(id + ":intensity", 10000, &val);
+  }
+
+  // A nested reference, so some parameters are evaluated without baked curves.
+  tl->setKeyframe("parallel5:intensity", 5000, string("Parallel nested"), 0);
+
+  vector<size_t> events;
+  for (size_t t = 1000; t < 5000; t += 1000) {
+    tl->addEvent(t, shared_ptr<Event>(new Event([&events, t]() { events.push_back(t); })));
+  }
+
+  m_pb->addTimeline("Parallel", tl);
+  layer->play("Parallel");
+
+  auto& state = layer->getLayerState();
+  auto reset = [&]() {
+    for (auto& d : state)
+      ((LumiverseFloat*)d.second["intensity"])->setVal(0.123f);
+  };
+
+  ThreadPool pool(3);
+  auto start = chrono::high_resolution_clock::now();
+  bool ok = true;
+
+  for (int frame = 0; frame < 6 && ok; frame++) {
+    auto updateStart = start + chrono::milliseconds(frame * 1000 + 500);
+
+    reset();
+    size_t count = layer->beginUpdate(updateStart);
+    if (count < 2) {
+      cout << "Layer was not partitioned\n";
+      ok = false;
+      break;
+    }
+    pool.parallelFor(count, [&](size_t i) { layer->updatePartition(i); });
+    layer->endUpdate(updateStart);
+
+    map<string, float> parallel;
+    for (auto& d : state)
+      parallel[d.first] = ((LumiverseFloat*)d.second["intensity"])->getVal();
+
+    // Running the same frame serially should give exactly the same values.
+    reset();
+    layer->update(updateStart);
+
+    for (auto& d : state) {
+      if (((LumiverseFloat*)d.second["intensity"])->getVal() != parallel[d.first]) {
+        cout << "Parallel value for " << d.first << " differs from serial update\n";
+        ok = false;
+        break;
+      }
+    }
+  }
+
+  m_pb->deleteTimeline("Parallel");
+
+  if (ok && (events.size() != 4 || !is_sorted(events.begin(), events.end()))) {
+    cout << "Events did not run once each in order\n";
+    ok = false;
+  }
+
+  return ok;
+}
+
+bool PlaybackTests::denseBlend() {
+  // Two copies of the same devices. One is blended parameter by parameter, one through a ParamLayout.
+  map<string, Device*> reference;
+  map<string, Device*> dense;
+  vector<shared_ptr<Device> > devices;
+  map<string, int> options = { { "Open", 0 }, { "Gobo 1", 64 }, { "Gobo 2", 128 } };
+
+  for (int i = 0; i < 4; i++) {
+    string id = "dense" + to_string(i);
+
+    for (auto state : { &reference, &dense }) {
+      shared_ptr<Device> d(new Device(id, (unsigned int)i + 1, "test"));
+      LumiverseColor* color = new LumiverseColor();
+      color->addColorChannel("Red");
+      color->addColorChannel("Blue");
+
+      d->setParam("intensity", new LumiverseFloat(0.0f));
+      d->setParam("pan", new LumiverseOrientation(0.0f, DEGREE, 270, 540, 0));
+      d->setParam("color", color);
+      d->setParam("gobo", new LumiverseEnum(options, LumiverseEnum::CENTER, 255, "Open", LumiverseEnum::SMOOTH_WITHIN_OPTION));
+      (*state)[id] = d.get();
+      devices.push_back(d);
+    }
+  }
+
+  vector<shared_ptr<Layer> > layers;
+  layers.push_back(shared_ptr<Layer>(new Layer(m_pb, "Dense base", 1, Layer::ALPHA)));
+  layers.push_back(shared_ptr<Layer>(new Layer(m_pb, "Dense alpha", 2, Layer::ALPHA)));
+  layers.push_back(shared_ptr<Layer>(new Layer(m_pb, "Dense overwrite", 3, Layer::OVERWRITE)));
+  layers.push_back(shared_ptr<Layer>(new Layer(m_pb, "Dense radians", 4, Layer::ALPHA)));
+  layers[1]->setOpacity(0.35f);
+  layers[3]->setOpacity(0.6f);
+
+  for (const auto& d : reference) {
+    for (const auto& p : d.second->getRawParameters())
+      layers[0]->addDevice(d.second, p.first);
+  }
+  for (string id : { "dense1", "dense2" }) {
+    for (string param : { "intensity", "pan", "color" })
+      layers[1]->addDevice(reference[id], param);
+  }
+  layers[2]->addDevice(reference["dense3"], "intensity");
+  layers[2]->addDevice(reference["dense3"], "gobo");
+  layers[3]->addDevice(reference["dense2"], "pan");
+
+  auto setValues = [&](int frame) {
+    for (size_t l = 0; l < layers.size(); l++) {
+      for (auto& d : layers[l]->getLayerState()) {
+        float v = ((frame * 7 + l * 3 + d.first.back()) % 11) / 10.0f;
+        for (auto& p : d.second) {
+          if (p.first == "intensity")
+            ((LumiverseFloat*)p.second)->setVal(v);
+          else if (p.first == "pan")
+            ((LumiverseOrientation*)p.second)->setVal(v * 500);
+          else if (p.first == "color")
+            ((LumiverseColor*)p.second)->setColorChannel("Red", 1 - v);
+          else if (p.first == "gobo")
+            ((LumiverseEnum*)p.second)->setVal(v * 200);
+        }
+      }
+    }
+  };
+
+  // Parameter by parameter alpha blend of the owned parameters of a layer.
+  auto referenceBlend = [&](shared_ptr<Layer> layer) {
+    for (const auto& d : layer->getOwnedParameters()) {
+      for (const auto& name : d.second) {
+        LumiverseType* src = layer->getLayerState()[d.first][name];
+        LumiverseType* dest = reference[d.first]->getParam(name);
+
+        if (layer->getMode() == Layer::OVERWRITE || layer->getOpacity() >= 1) {
+          LumiverseTypeUtils::copyByVal(src, dest);
+        }
+        else {
+          shared_ptr<LumiverseType> res = LumiverseTypeUtils::lerp(dest, src, layer->getOpacity());
+          LumiverseTypeUtils::copyByVal(res.get(), dest);
+        }
+      }
+    }
+  };
+
+  // Orientations given in other units are converted into the state's units.
+  ((LumiverseOrientation*)layers[3]->getLayerState()["dense2"]["pan"])->setUnit(RADIAN);
+
+  ParamLayout layout;
+  layout.build(dense);
+  if (layout.getNumScalars() != 8 || layout.getNumSlots() != 16) {
+    cout << "Unexpected layout size\n";
+    return false;
+  }
+
+  Eigen::ArrayXf values;
+
+  for (int frame = 0; frame < 4; frame++) {
+    setValues(frame);
+
+    for (auto& d : reference)
+      d.second->reset();
+    for (auto& l : layers)
+      referenceBlend(l);
+
+    values = layout.getDefaults();
+    layout.resetNonScalars();
+    for (auto& l : layers)
+      l->blend(values, layout);
+    layout.write(values);
+
+    for (const auto& d : reference) {
+      for (const auto& p : d.second->getRawParameters()) {
+        LumiverseType* expected = p.second;
+        LumiverseType* actual = dense[d.first]->getParam(p.first);
+        bool match;
+
+        if (p.first == "pan") {
+          match = abs(((LumiverseOrientation*)expected)->valAsUnit(DEGREE) - ((LumiverseOrientation*)actual)->valAsUnit(DEGREE)) < 1e-3;
+        }
+        else if (p.first == "color") {
+          match = true;
+          for (const auto& c : ((LumiverseColor*)expected)->getColorParams())
+            match = match && abs(c.second - ((LumiverseColor*)actual)->getColorParams()[c.first]) < 1e-5;
+        }
+        else {
+          match = (expected->asString() == actual->asString());
+        }
+
+        if (!match) {
+          cout << "Dense blend of " << d.first << ":" << p.first << " is " << actual->asString() << " expected " << expected->asString() << "\n";
+          return false;
+        }
+      }
+    }
+  }
+
+  // Layers keep the layout of a device map until its devices or parameters change.
+  if (!layout.isBuiltFrom(dense)) {
+    cout << "Layout doesn't match the devices it was built from\n";
+    return false;
+  }
+
+  dense["dense0"]->setParam("intensity", new LumiverseFloat(0.0f));
+  if (layout.isBuiltFrom(dense)) {
+    cout << "Layout matched after a parameter was replaced\n";
+    return false;
+  }
+
+  for (float v : { 0.7f, 0.2f }) {
+    ((LumiverseFloat*)layers[0]->getLayerState()["dense0"]["intensity"])->setVal(v);
+    layers[0]->blend(dense);
+
+    float actual;
+    dense["dense0"]->getParam("intensity", actual);
+    if (actual != v) {
+      cout << "Blend into a device map gave " << actual << " expected " << v << "\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool PlaybackTests::layerOwnership() {
+  map<string, Device*> state;
+  DeviceSet all = m_testRig->getAllDevices();
+  for (Device* d : all.getDevices()) {
+    state[d->getId()] = new Device(*d);
+    state[d->getId()]->reset();
+  }
+
+  ParamLayout layout;
+  layout.build(state);
+
+  // The base layer owns everything it was built with, the layer built from the Rig owns nothing.
+  shared_ptr<Layer> base(new Layer(all, m_pb, "Own base", 1));
+  shared_ptr<Layer> top(new Layer(m_testRig, m_pb, "Own top", 2));
+
+  for (auto& d : base->getLayerState()) {
+    if (d.second.count("intensity") > 0)
+      ((LumiverseFloat*)d.second["intensity"])->setVal(0.5f);
+  }
+
+  shared_ptr<Timeline> tl(new Timeline());
+  LumiverseFloat val(0.25f);
+  tl->setKeyframe("s41:intensity", 0, &val);
+  tl->setKeyframe("s41:intensity", 100000, &val);
+  m_pb->addTimeline("Ownership", tl);
+
+  auto blend = [&](SlotSet& touched) {
+    Eigen::ArrayXf values = layout.getDefaults();
+    touched.resize(layout.getNumSlots());
+    base->blend(values, layout, &touched);
+    top->blend(values, layout, &touched);
+    layout.write(values);
+  };
+
+  auto intensity = [&](string id) { return ((LumiverseFloat*)state[id]->getParam("intensity"))->getVal(); };
+
+  SlotSet touched;
+  bool ok = true;
+
+  if (!top->getOwnedParameters().empty() || base->getOwnedParameters().size() != state.size()) {
+    cout << "Unexpected initial ownership\n";
+    ok = false;
+  }
+
+  blend(touched);
+  if (ok && (intensity("s41") != 0.5f || touched.size() != layout.getNumSlots())) {
+    cout << "Layer without owned parameters covered the base layer\n";
+    ok = false;
+  }
+
+  // Playing a timeline takes ownership of what it animates.
+  top->play("Ownership");
+  top->update(chrono::high_resolution_clock::now());
+
+  if (ok && (!top->isParameterOwned("s41", "intensity") || top->isParameterOwned("s42", "intensity"))) {
+    cout << "Timeline did not take ownership of exactly s41:intensity\n";
+    ok = false;
+  }
+
+  blend(touched);
+  if (ok && (intensity("s41") != 0.25f || intensity("s42") != 0.5f)) {
+    cout << "Owned parameter blended incorrectly\n";
+    ok = false;
+  }
+
+  // Owned parameters survive a save and load.
+  shared_ptr<Layer> loaded(new Layer(m_pb, top->toJSON()));
+  if (ok && loaded->getOwnedParameters() != top->getOwnedParameters()) {
+    cout << "Owned parameters not restored from JSON\n";
+    ok = false;
+  }
+
+  // Values written directly to the state only count once the parameter is owned.
+  top->stop();
+  ((LumiverseFloat*)top->getLayerState()["s42"]["intensity"])->setVal(1.0f);
+  top->setParameterOwned("s42", "intensity", true);
+  blend(touched);
+  if (ok && intensity("s42") != 1.0f) {
+    cout << "Parameter owned with setParameterOwned was not blended\n";
+    ok = false;
+  }
+
+  m_pb->deleteTimeline("Ownership");
+  for (auto& d : state)
+    delete d.second;
+
+  return ok;
+}
+
+bool PlaybackTests::blendModes() {
+  map<string, Device*> state;
+  vector<shared_ptr<Device> > devices;
+  map<string, int> options = { { "Open", 0 }, { "Gobo 1", 64 }, { "Gobo 2", 128 } };
+
+  for (int i = 0; i < 16; i++) {
+    string id = "mode" + to_string(i);
+    shared_ptr<Device> d(new Device(id, (unsigned int)i + 1, "test"));
+    LumiverseColor* color = new LumiverseColor();
+    color->addColorChannel("Red");
+
+    d->setParam("intensity", new LumiverseFloat(0.0f));
+    d->setParam("pan", new LumiverseOrientation(0.0f, DEGREE, 0, 540, 0));
+    d->setParam("color", color);
+    d->setParam("gobo", new LumiverseEnum(options, LumiverseEnum::CENTER, 255, "Open", LumiverseEnum::SMOOTH_WITHIN_OPTION));
+    state[id] = d.get();
+    devices.push_back(d);
+  }
+
+  ParamLayout layout;
+  layout.build(state);
+
+  // The base layer sets every parameter, the top layer blends over all of them and
+  // the spot layer over a single intensity, which is too few to use the dense kernel.
+  shared_ptr<Layer> base(new Layer(m_pb, "Mode base", 1, Layer::ALPHA));
+  shared_ptr<Layer> top(new Layer(m_pb, "Mode top", 2, Layer::ALPHA));
+  shared_ptr<Layer> spot(new Layer(m_pb, "Mode spot", 3, Layer::ALPHA));
+  spot->setOpacity(0.5f);
+
+  for (const auto& d : state) {
+    for (const auto& p : d.second->getRawParameters()) {
+      base->addDevice(d.second, p.first);
+      top->addDevice(d.second, p.first);
+    }
+  }
+  spot->addDevice(state["mode3"], "intensity");
+
+  for (int i = 0; i < 16; i++) {
+    auto& b = base->getLayerState()["mode" + to_string(i)];
+    auto& t = top->getLayerState()["mode" + to_string(i)];
+    ((LumiverseFloat*)b["intensity"])->setVal(i / 16.0f);
+    ((LumiverseOrientation*)b["pan"])->setVal(i * 30.0f);
+    ((LumiverseColor*)b["color"])->setColorChannel("Red", 0.3);
+    ((LumiverseEnum*)b["gobo"])->setVal("Gobo 2");
+    ((LumiverseFloat*)t["intensity"])->setVal(0.5f);
+    ((LumiverseOrientation*)t["pan"])->setVal(270.0f);
+    ((LumiverseColor*)t["color"])->setColorChannel("Red", 0.5);
+    ((LumiverseEnum*)t["gobo"])->setVal("Gobo 1");
+  }
+  ((LumiverseFloat*)spot->getLayerState()["mode3"]["intensity"])->setVal(0.9f);
+
+  auto expected = [](Layer::BlendMode mode, float s, float l, float hi) {
+    float f = l;
+    if (mode == Layer::MAX) f = max(s, l);
+    else if (mode == Layer::MIN) f = min(s, l);
+    else if (mode == Layer::ADD) f = s + l;
+    else if (mode == Layer::SUBTRACT) f = s - l;
+    else if (mode == Layer::MULTIPLY) f = s * (l / hi);
+    return min(max(f, 0.0f), hi);
+  };
+
+  auto blend = [&]() {
+    Eigen::ArrayXf values = layout.getDefaults();
+    layout.resetNonScalars();
+    base->blend(values, layout);
+    top->blend(values, layout);
+    spot->blend(values, layout);
+    return values;
+  };
+
+  vector<pair<Layer::BlendMode, string> > modes = { { Layer::MAX, "MAX" }, { Layer::MIN, "MIN" },
+    { Layer::ADD, "ADD" }, { Layer::SUBTRACT, "SUBTRACT" }, { Layer::MULTIPLY, "MULTIPLY" } };
+
+  for (const auto& m : modes) {
+    Layer::BlendMode mode = m.first;
+    top->setMode(mode);
+    spot->setMode(mode);
+    Eigen::ArrayXf values = blend();
+
+    for (int i = 0; i < 16; i++) {
+      string id = "mode" + to_string(i);
+      float intensity = expected(mode, i / 16.0f, 0.5f, 1);
+      if (i == 3)
+        intensity = intensity * 0.5f + expected(mode, intensity, 0.9f, 1) * 0.5f;
+      float pan = expected(mode, i * 30.0f, 270.0f, 540);
+
+      if (abs(values[layout.getSlot(id, "intensity")] - intensity) > 1e-5 ||
+        abs(values[layout.getSlot(id, "pan")] - pan) > 1e-3)
+      {
+        cout << "Blend mode " << m.second << " gave " << values[layout.getSlot(id, "intensity")] <<
+          ", " << values[layout.getSlot(id, "pan")] << " for " << id << " expected " << intensity << ", " << pan << "\n";
+        return false;
+      }
+    }
+
+    float red = (float)((LumiverseColor*)state["mode0"]->getParam("color"))->getColorChannel("Red");
+    if (abs(red - expected(mode, 0.3f, 0.5f, 1)) > 1e-5) {
+      cout << "Blend mode " << m.second << " gave red " << red << "\n";
+      return false;
+    }
+
+    // Gobo 2 is higher than Gobo 1, so only MAX keeps the base layer's enum.
+    string gobo = ((LumiverseEnum*)state["mode0"]->getParam("gobo"))->getVal();
+    if (gobo != ((mode == Layer::MAX) ? "Gobo 2" : "Gobo 1")) {
+      cout << "Blend mode " << m.second << " gave gobo " << gobo << "\n";
+      return false;
+    }
+  }
+
+  // HTP intensity, everything else from the top layer.
+  top->setMode(Layer::ALPHA);
+  top->setTypeMode("float", Layer::MAX);
+  spot->setMode(Layer::ALPHA);
+  spot->setOpacity(0);
+  Eigen::ArrayXf values = blend();
+
+  if (values[layout.getSlot("mode15", "intensity")] != 15 / 16.0f || values[layout.getSlot("mode1", "intensity")] != 0.5f ||
+    values[layout.getSlot("mode15", "pan")] != 270.0f)
+  {
+    cout << "Per type blend mode not applied\n";
+    return false;
+  }
+
+  shared_ptr<Layer> loaded(new Layer(m_pb, top->toJSON()));
+  if (loaded->getMode() != Layer::ALPHA || loaded->getTypeMode("float") != Layer::MAX ||
+    loaded->getTypeMode("color") != Layer::ALPHA)
+  {
+    cout << "Blend modes not restored from JSON\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool PlaybackTests::layerOrder() {
+  shared_ptr<Layer> low(new Layer(m_testRig, m_pb, "Order low", 100));
+  shared_ptr<Layer> high(new Layer(m_testRig, m_pb, "Order high", 101));
+  ((LumiverseFloat*)low->getLayerState()["s42"]["intensity"])->setVal(0.25f);
+  ((LumiverseFloat*)high->getLayerState()["s42"]["intensity"])->setVal(0.75f);
+  low->setParameterOwned("s42", "intensity", true);
+  high->setParameterOwned("s42", "intensity", true);
+
+  m_pb->addLayer(low);
+  m_pb->addLayer(high);
+
+  auto intensity = [&]() {
+    this_thread::sleep_for(chrono::milliseconds(100));
+    return ((LumiverseFloat*)m_testRig->getDevice("s42")->getParam("intensity"))->getVal();
+  };
+
+  bool ok = true;
+
+  if (intensity() != 0.75f) {
+    cout << "Higher priority layer not on top\n";
+    ok = false;
+  }
+
+  low->setPriority(102);
+  if (ok && intensity() != 0.25f) {
+    cout << "Layers not re-sorted after a priority change\n";
+    ok = false;
+  }
+
+  low->deactivate();
+  if (ok && intensity() != 0.75f) {
+    cout << "Deactivated layer still blended\n";
+    ok = false;
+  }
+
+  low->activate();
+  m_pb->deleteLayer("Order low");
+  if (ok && intensity() != 0.75f) {
+    cout << "Deleted layer still blended\n";
+    ok = false;
+  }
+
+  m_pb->deleteLayer("Order high");
+
+  return ok;
+}
+
+bool PlaybackTests::offlineRender() {
+  // A Rig that is never run, so the runner can drive it.
+  Rig rig("../../source/Test/testRig.json");
+  Playback pb(&rig);
+  pb.attachToRig();
+
+  shared_ptr<Timeline> up(new Timeline());
+  shared_ptr<Timeline> down(new Timeline());
+  LumiverseFloat off(0.0f);
+  LumiverseFloat full(1.0f);
+  up->setKeyframe("s41:intensity", 0, &off);
+  up->setKeyframe("s41:intensity", 1000, &full);
+  down->setKeyframe("s41:intensity", 0, &full);
+  down->setKeyframe("s41:intensity", 500, &off);
+  pb.addTimeline("Up", up);
+  pb.addTimeline("Down", down);
+
+  shared_ptr<CueList> list(new CueList("Offline", &pb));
+  list->storeCue(1, "Up");
+  list->storeCue(2, "Down");
+  pb.addCueList(list);
+  pb.addLayer(shared_ptr<Layer>(new Layer(&rig, &pb, "Offline", 1)));
+  pb.addCueListToLayer("Offline", "Offline");
+
+  OfflineRunner runner(&pb, 40);
+
+  auto render = [&]() {
+    vector<float> trace;
+    runner.renderCueList("Offline", 1000, [&](size_t, Clock::time_point) {
+      trace.push_back(((LumiverseFloat*)rig.getDevice("s41")->getParam("intensity"))->getVal());
+    });
+    return trace;
+  };
+
+  vector<float> first = render();
+
+  // 25ms frames, so frame 20 is halfway through the first cue.
+  if (first.size() < 64 || abs(first[20] - 0.5f) > 1e-5 || first.back() != 0) {
+    cout << "Cue list rendered incorrectly over " << first.size() << " frames\n";
+    return false;
+  }
+
+  if (runner.getFrame() != first.size()) {
+    cout << "Frame count doesn't match the frames rendered\n";
+    return false;
+  }
+
+  // Virtual time makes renders repeatable.
+  if (render() != first) {
+    cout << "Rendering the cue list again gave different frames\n";
+    return false;
+  }
+
+  // A running Rig keeps its clock.
+  shared_ptr<Clock> clock = m_testRig->getSharedClock();
+  {
+    OfflineRunner running(m_pb);
+    if (m_testRig->getSharedClock() != clock || running.step()) {
+      cout << "Offline runner took over a running Rig\n";
+      return false;
+    }
+  }
+
+  if (m_testRig->getSharedClock() != clock) {
+    cout << "Offline runner replaced the clock of a running Rig\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool PlaybackTests::grandmaster() {
+  // s49_seachanger cyan defaults to 1 and isn't written by any layer once Layer 1 is
+  // off. The grandmaster still scales it.
+  m_pb->getLayer("Layer 1")->deactivate();
+  m_pb->getProgrammer()->clearAndReset();
+  m_pb->getProgrammer()->setParam("s41", "intensity", 1.0f);
+  m_pb->setGrandmaster(0.5f);
+  this_thread::sleep_for(chrono::milliseconds(100));
+
+  float intensity, cyan;
+  m_testRig->getDevice("s41")->getParam("intensity", intensity);
+  m_testRig->getDevice("s49_seachanger")->getParam("cyan", cyan);
+
+  bool ok = true;
+  if (intensity != 0.5f || cyan != 0.5f) {
+    cout << "Grandmaster at 0.5 gave s41 intensity " << intensity << " and s49_seachanger cyan " << cyan << ", expected 0.5\n";
+    ok = false;
+  }
+
+  // Raising the grandmaster puts untouched parameters back at their defaults.
+  m_pb->setGrandmaster(1.0f);
+  m_pb->getProgrammer()->clearAndReset();
+  this_thread::sleep_for(chrono::milliseconds(100));
+
+  m_testRig->getDevice("s41")->getParam("intensity", intensity);
+  m_testRig->getDevice("s49_seachanger")->getParam("cyan", cyan);
+  if (ok && (intensity != 0.0f || cyan != 1.0f)) {
+    cout << "Grandmaster at 1 gave s41 intensity " << intensity << " and s49_seachanger cyan " << cyan << "\n";
+    ok = false;
+  }
+
+  m_pb->getLayer("Layer 1")->activate();
+
+  return ok;
+}
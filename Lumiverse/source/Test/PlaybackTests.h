@@ -24,7 +24,7 @@ private:
   bool runTest(std::function<bool()> t, string testName, int testNum);
 
   // Update when new tests are written.
-  static const int m_numTests = 9;
+  static const int m_numTests = 19;
 
   // Initialized in PlaybackStart()
   Rig* m_testRig;
@@ -43,4 +43,14 @@ private:
   bool layerToggle();
   bool snapshot();
   bool groups();
+  bool trackCursor();
+  bool bakedCurves();
+  bool timelineGraph();
+  bool parallelUpdate();
+  bool denseBlend();
+  bool layerOwnership();
+  bool blendModes();
+  bool layerOrder();
+  bool offlineRender();
+  bool grandmaster();
 };
\ No newline at end of file
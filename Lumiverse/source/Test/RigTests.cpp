@@ -20,6 +20,20 @@ int RigTests::runTests() {
   (runTest([=]{ return this->queryMixed(); }, "queryMixed", 10)) ? numPassed++ : numPassed;
   (runTest([=]{ return this->queryFilter(); }, "queryFilter", 11)) ? numPassed++ : numPassed;
   (runTest([=]{ return this->dynamicQuery(); }, "dynamicQuery", 12)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->profileUpdate(); }, "profileUpdate", 13)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->dmxShowRecordReplay(); }, "dmxShowRecordReplay", 14)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->dmxOutputThreads(); }, "dmxOutputThreads", 15)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->dmxKeepAlive(); }, "dmxKeepAlive", 16)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->sacnLoopback(); }, "sacnLoopback", 17)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->artnetLoopback(); }, "artnetLoopback", 18)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->kinetPorts(); }, "kinetPorts", 19)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->dmxInputMerge(); }, "dmxInputMerge", 20)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->dmxCurves(); }, "dmxCurves", 21)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->dmxUniverseSlab(); }, "dmxUniverseSlab", 22)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->oscBundles(); }, "oscBundles", 23)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->oscInput(); }, "oscInput", 24)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->oscEosCoalescing(); }, "oscEosCoalescing", 25)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->photoAccumulator(); }, "photoAccumulator", 26)) ? numPassed++ : numPassed;
 
   return numPassed;
 }
@@ -429,4 +443,1481 @@ bool RigTests::dynamicQuery() {
     ret = false;
   }
   return ret;
-}
\ No newline at end of file
+}
+bool RigTests::profileUpdate() {
+  bool ret = true;
+  int calls = 0;
+
+  m_testRig->addFunction(42, [&]() { calls++; });
+  m_testRig->updateOnce();
+
+  if (m_testRig->getProfileStats("Function 42").count != 0) {
+    cout << "Profiler recorded samples while disabled\n";
+    ret = false;
+  }
+
+  m_testRig->setProfilingEnabled(true);
+  for (int i = 0; i < 5; i++) {
+    m_testRig->updateOnce();
+  }
+  m_testRig->setProfilingEnabled(false);
+
+  ProfileStats frame = m_testRig->getProfileStats("Rig::frame");
+  ProfileStats func = m_testRig->getProfileStats("Function 42");
+
+  if (calls != 6 || frame.count != 5 || func.count != 5) {
+    cout << "Expected 5 profiled frames, got " << frame.count << " frames and " << func.count << " function samples\n";
+    ret = false;
+  }
+
+  if (func.min > func.avg || func.avg > func.max || func.p99 > func.max || func.max > frame.max) {
+    cout << "Profile stats are inconsistent\n";
+    ret = false;
+  }
+
+  JSONNode trace = m_testRig->getProfiler().toChromeTrace();
+  if (trace["traceEvents"].size() < 10) {
+    cout << "Trace has " << trace["traceEvents"].size() << " events, expected at least 10\n";
+    ret = false;
+  }
+
+  m_testRig->removeFunction(42);
+  m_testRig->getProfiler().clear();
+
+  if (m_testRig->getProfileStats("Rig::frame").count != 0) {
+    cout << "Profiler kept samples after clear()\n";
+    ret = false;
+  }
+
+  // Read a small buffer while it's written and wrapped from two threads. Every sample's
+  // duration matches its section, so a torn sample would show up in the stats.
+  Profiler profiler(64);
+  profiler.setEnabled(true);
+  int a = profiler.getSectionId("a");
+  int b = profiler.getSectionId("b");
+  atomic<bool> writing(true);
+  auto writer = [&](int section, int ms) {
+    auto t = Profiler::clock::now();
+    while (writing)
+      profiler.record(section, t, t + chrono::milliseconds(ms));
+  };
+  thread wa(writer, a, 1);
+  thread wb(writer, b, 2);
+
+  for (int i = 0; i < 200; i++) {
+    ProfileStats sa = profiler.getStats("a");
+    ProfileStats sb = profiler.getStats("b");
+    if ((sa.count > 0 && (sa.min != 1 || sa.max != 1)) || (sb.count > 0 && (sb.min != 2 || sb.max != 2))) {
+      cout << "Profiler returned a torn sample\n";
+      ret = false;
+      break;
+    }
+  }
+
+  writing = false;
+  wa.join();
+  wb.join();
+
+  return ret;
+}
+
+// Keeps a copy of everything sent to it. Can be made slow or failing.
+class CaptureInterface : public DMXInterface {
+public:
+  CaptureInterface(string id) : delay(0), fail(false), failFlush(false) { m_ifaceId = id; m_ifaceName = id; }
+
+  virtual void init() { }
+  virtual void sendDMX(unsigned char* data, unsigned int universe) {
+    this_thread::sleep_for(chrono::milliseconds(delay));
+    if (fail)
+      throw runtime_error("send failed");
+
+    sent.push_back(make_pair(universe, vector<unsigned char>(data, data + 512)));
+  }
+  virtual void flush() {
+    if (failFlush)
+      throw runtime_error("flush failed");
+  }
+  virtual void closeInt() { }
+  virtual void reset() { }
+  virtual JSONNode toJSON() { return JSONNode(); }
+  virtual string getInterfaceType() { return "CaptureInterface"; }
+
+  vector<pair<unsigned int, vector<unsigned char> > > sent;
+  int delay;
+  atomic<bool> fail;
+  atomic<bool> failFlush;
+};
+
+bool RigTests::dmxShowRecordReplay() {
+  bool ret = true;
+  string filename = "dmxShowTest.lumidmx";
+  auto clock = make_shared<SteppingClock>();
+
+  // Record 100 frames of a chase over 3 universes. Universe 2 never changes.
+  vector<vector<vector<unsigned char> > > frames;
+  {
+    DMXPatch patch;
+    patch.assignInterface(new CaptureInterface("live"), 0);
+    patch.assignInterface("live", 1);
+    patch.assignInterface("live", 2);
+
+    if (!patch.startRecording(filename, clock)) {
+      cout << "Could not start recording\n";
+      return false;
+    }
+
+    for (int f = 0; f < 100; f++) {
+      vector<unsigned char> uni(512, 0);
+      uni[f % 512] = 255;
+      uni[200] = (unsigned char)f;
+      patch.setRawData(0, uni);
+      patch.setRawData(1, vector<unsigned char>(512, (unsigned char)(f / 10)));
+
+      frames.push_back(patch.getUniverses());
+      clock->step(chrono::milliseconds(25));
+    }
+
+    patch.stopRecording();
+  }
+
+  // Each setRawData call sent a frame, so the recording has two per step.
+  DMXShowReader reader;
+  if (!reader.open(filename) || reader.getNumFrames() != 200) {
+    cout << "Recorded " << reader.getNumFrames() << " frames, expected 200\n";
+    return false;
+  }
+
+  for (int f = 0; f < 100; f++) {
+    reader.next();
+    if (!reader.next() || reader.getUniverses() != frames[f] ||
+      reader.getTime() != chrono::milliseconds(25 * f)) {
+      cout << "Frame " << f << " doesn't match the recording\n";
+      ret = false;
+      break;
+    }
+  }
+
+  if (reader.next()) {
+    cout << "Read past the last frame\n";
+    ret = false;
+  }
+
+  // Seek to the second half of frame 70 from the nearest keyframe
+  if (!reader.seek(chrono::milliseconds(25 * 70 + 1)) || reader.getFrame() != 141 ||
+    reader.getUniverses() != frames[70]) {
+    cout << "Seek landed on frame " << reader.getFrame() << "\n";
+    ret = false;
+  }
+
+  if (!reader.seekFrame(3) || reader.getUniverses() != frames[1]) {
+    cout << "Frame seek failed\n";
+    ret = false;
+  }
+
+  // Replay: only changed universes are sent between keyframes
+  DMXShowPlayer player;
+  CaptureInterface* out = new CaptureInterface("out");
+  player.open(filename);
+  player.addOutput(out, 0);
+  player.addOutput(out, 2);
+
+  if (player.sendUntil(chrono::milliseconds(25 * 10)) != 22) {
+    cout << "Player sent the wrong number of frames\n";
+    ret = false;
+  }
+
+  size_t uni2 = 0;
+  for (const auto& s : out->sent) {
+    if (s.first == 2)
+      uni2++;
+  }
+
+  if (uni2 != 1 || out->sent.back().second != frames[10][0]) {
+    cout << "Player output doesn't match the recording\n";
+    ret = false;
+  }
+
+  delete out;
+  remove(filename.c_str());
+
+  return ret;
+}
+
+bool RigTests::dmxOutputThreads() {
+  bool ret = true;
+
+  DMXPatch patch;
+  CaptureInterface* iface = new CaptureInterface("slow");
+  iface->delay = 20;
+  patch.assignInterface(iface, 0);
+  patch.assignInterface("slow", 1);
+  // Publish every universe with every frame
+  patch.setKeepAliveInterval(0);
+  patch.init();
+
+  if (patch.getOutputThread("slow") == nullptr) {
+    cout << "Interface has no output thread\n";
+    return false;
+  }
+
+  // The interface takes 20ms per universe, publishing shouldn't wait for it.
+  auto start = chrono::steady_clock::now();
+  for (int f = 0; f < 20; f++) {
+    patch.setRawData(0, vector<unsigned char>(512, (unsigned char)f));
+  }
+  double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  if (ms > 100) {
+    cout << "Publishing 20 frames took " << ms << "ms\n";
+    ret = false;
+  }
+
+  // Failures are counted instead of reaching the update loop
+  this_thread::sleep_for(chrono::milliseconds(100));
+  iface->fail = true;
+  patch.setRawData(1, vector<unsigned char>(512, 7));
+  this_thread::sleep_for(chrono::milliseconds(100));
+  iface->fail = false;
+
+  // Frames that don't survive the flush are failures, not sends
+  iface->failFlush = true;
+  patch.setRawData(1, vector<unsigned char>(512, 8));
+  this_thread::sleep_for(chrono::milliseconds(100));
+  size_t sentBefore = patch.getOutputStats("slow").sent;
+  iface->failFlush = false;
+  patch.setRawData(0, vector<unsigned char>(512, 99));
+
+  this_thread::sleep_for(chrono::milliseconds(100));
+
+  // Each frame was either sent, replaced by a newer one, or failed
+  DMXOutputStats stats = patch.getOutputStats("slow");
+  if (stats.published != 46 || stats.errors < 2 || stats.sent <= sentBefore || stats.sent + stats.dropped + stats.errors != stats.published) {
+    cout << "Output counters are off: " << stats.published << " published, " << stats.sent << " sent, "
+      << stats.dropped << " dropped, " << stats.errors << " errors\n";
+    ret = false;
+  }
+
+  patch.close();
+
+  if (patch.getOutputThread("slow") != nullptr) {
+    cout << "Output thread still exists after close\n";
+    ret = false;
+  }
+
+  int last = -1;
+  for (const auto& sent : iface->sent) {
+    if (sent.first == 0)
+      last = sent.second[0];
+  }
+
+  if (last != 99) {
+    cout << "Last frame wasn't sent\n";
+    ret = false;
+  }
+
+  // Publishing again before the thread sends replaces the older frame
+  DMXOutputThread out(iface);
+  out.setUniverses({ 0 });
+  unsigned char data[512] = { 0 };
+  out.publish(data, 0);
+  out.publish(data, 0);
+  out.publish(data, 1);
+  stats = out.getStats();
+
+  if (stats.published != 2 || stats.dropped != 1) {
+    cout << "Dropped frames weren't counted\n";
+    ret = false;
+  }
+
+  return ret;
+}
+
+bool RigTests::dmxKeepAlive() {
+  bool ret = true;
+
+  DMXPatch patch;
+  CaptureInterface* iface = new CaptureInterface("capture");
+  patch.assignInterface(iface, 0);
+  patch.assignInterface("capture", 1);
+  patch.setKeepAliveInterval(200);
+
+  // Both universes go out the first time, then only when they change
+  vector<unsigned char> data(512, 10);
+  for (int i = 0; i < 10; i++) {
+    patch.setRawData(0, data);
+  }
+
+  if (iface->sent.size() != 2 || patch.getPacketsSent() != 2 || patch.getPacketsSaved() != 18) {
+    cout << "Unchanged universes were sent: " << iface->sent.size() << " sends\n";
+    ret = false;
+  }
+
+  data[511] = 11;
+  patch.setRawData(1, data);
+  if (iface->sent.size() != 3 || iface->sent.back().first != 1) {
+    cout << "Changed universe wasn't sent\n";
+    ret = false;
+  }
+
+  // Everything is sent again once the keep-alive interval passes
+  this_thread::sleep_for(chrono::milliseconds(250));
+  patch.setRawData(1, data);
+  if (iface->sent.size() != 5) {
+    cout << "Keep-alive wasn't sent\n";
+    ret = false;
+  }
+
+  patch.setKeepAliveInterval(0);
+  patch.setRawData(1, data);
+  if (iface->sent.size() != 7) {
+    cout << "Every universe should be sent without a keep-alive interval\n";
+    ret = false;
+  }
+
+  return ret;
+}
+
+bool RigTests::sacnLoopback() {
+#if defined(USE_SACN) && !defined(_WIN32)
+  bool ret = true;
+
+  // Local receiver on a free port
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if (sock < 0 || ::bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(sock, (sockaddr*)&addr, &len) != 0) {
+    cout << "Couldn't open a receiver\n";
+    return false;
+  }
+
+  timeval timeout = { 1, 0 };
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  // Round trip through the rig JSON so the loader is covered too
+  DMXPatch saved;
+  SACNInterface* iface = new SACNInterface("sacn", "Lumiverse Test", 150, "127.0.0.1", ntohs(addr.sin_port));
+  iface->setSyncUniverse(7);
+  saved.assignInterface(iface, 0);
+  saved.assignInterface("sacn", 1);
+
+  DMXPatch patch(saved.toJSON());
+  SACNInterface* loaded = dynamic_cast<SACNInterface*>(patch.getInterface("sacn"));
+  if (loaded == nullptr || loaded->getPriority() != 150 || loaded->getSyncUniverse() != 7 ||
+    loaded->getCID() != iface->getCID()) {
+    cout << "sACN interface wasn't loaded from JSON\n";
+    close(sock);
+    return false;
+  }
+
+  patch.setAsyncOutput(false);
+  patch.init();
+
+  vector<unsigned char> data(512, 0);
+  data[0] = 255;
+  data[511] = 42;
+  patch.setRawData(1, data);
+
+  // Two data packets, then the sync packet
+  unsigned char buf[1024];
+  int sizes[3];
+  unsigned char packets[3][SACNInterface::DATA_PACKET_SIZE];
+  for (int i = 0; i < 3; i++) {
+    sizes[i] = (int)recv(sock, buf, sizeof(buf), 0);
+    if (sizes[i] <= 0) {
+      cout << "Packet " << i << " wasn't received\n";
+      close(sock);
+      patch.close();
+      return false;
+    }
+    memcpy(packets[i], buf, min((size_t)sizes[i], SACNInterface::DATA_PACKET_SIZE));
+  }
+
+  for (int i = 0; i < 2; i++) {
+    unsigned char* p = packets[i];
+    int universe = (p[113] << 8) | p[114];
+    unsigned char* slots = p + 126;
+
+    if (sizes[i] != (int)SACNInterface::DATA_PACKET_SIZE || memcmp(p + 4, "ASC-E1.17", 9) != 0) {
+      cout << "Bad data packet header\n";
+      ret = false;
+    }
+    if (p[108] != 150 || p[111] != 0 || ((p[109] << 8) | p[110]) != 7) {
+      cout << "Bad priority, sequence or sync address\n";
+      ret = false;
+    }
+    if (universe == 2 && (slots[0] != 255 || slots[511] != 42)) {
+      cout << "Universe 2 has the wrong data\n";
+      ret = false;
+    }
+    if (universe != 1 && universe != 2) {
+      cout << "Unexpected universe " << universe << "\n";
+      ret = false;
+    }
+  }
+
+  unsigned char* sync = packets[2];
+  if (sizes[2] != (int)SACNInterface::SYNC_PACKET_SIZE || sync[21] != 0x08 || sync[43] != 0x01 ||
+    ((sync[45] << 8) | sync[46]) != 7) {
+    cout << "Bad sync packet\n";
+    ret = false;
+  }
+
+  // Sequence numbers go up per universe
+  patch.setKeepAliveInterval(0);
+  patch.setRawData(1, data);
+  if (recv(sock, buf, sizeof(buf), 0) <= 0 || buf[111] != 1) {
+    cout << "Sequence number didn't advance\n";
+    ret = false;
+  }
+
+  patch.close();
+  close(sock);
+
+  return ret;
+#else
+  return true;
+#endif
+}
+
+bool RigTests::artnetLoopback() {
+#if defined(USE_ARTNET) && !defined(_WIN32)
+  bool ret = true;
+
+  // Local node on a free port
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if (sock < 0 || ::bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(sock, (sockaddr*)&addr, &len) != 0) {
+    cout << "Couldn't open a receiver\n";
+    return false;
+  }
+
+  timeval timeout = { 1, 0 };
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  // Round trip through the rig JSON so the node table loads too
+  DMXPatch saved;
+  ArtNetInterface* iface = new ArtNetInterface("artnet", "127.0.0.1");
+  if (iface->getNative()) {
+    cout << "ArtNet interface should default to libartnet\n";
+    ret = false;
+  }
+  iface->setNative(true);
+  set<unsigned int> universes = { 0, 1 };
+  iface->addNode(ArtNetNode("127.0.0.1", universes, ntohs(addr.sin_port)));
+  saved.assignInterface(iface, 0);
+  saved.assignInterface("artnet", 1);
+
+  DMXPatch patch(saved.toJSON());
+  ArtNetInterface* loaded = dynamic_cast<ArtNetInterface*>(patch.getInterface("artnet"));
+  if (loaded == nullptr || !loaded->getNative() || loaded->getNodes().size() != 1 ||
+    loaded->getNodes()[0].universes != universes) {
+    cout << "ArtNet node table wasn't loaded from JSON\n";
+    close(sock);
+    return false;
+  }
+
+  patch.setAsyncOutput(false);
+  patch.init();
+
+  vector<unsigned char> data(512, 0);
+  data[0] = 255;
+  data[511] = 42;
+  patch.setRawData(1, data);
+
+  // Two ArtDmx packets, then the ArtSync. The node isn't on the standard port, so it
+  // gets its own ArtSync rather than relying on the broadcast one.
+  unsigned char packets[3][ArtNetInterface::DMX_PACKET_SIZE];
+  int sizes[3];
+  for (int i = 0; i < 3; i++) {
+    sizes[i] = (int)recv(sock, packets[i], ArtNetInterface::DMX_PACKET_SIZE, 0);
+    if (sizes[i] <= 0) {
+      cout << "Packet " << i << " wasn't received\n";
+      close(sock);
+      patch.close();
+      return false;
+    }
+  }
+
+  for (int i = 0; i < 2; i++) {
+    unsigned char* p = packets[i];
+    int universe = p[14] | (p[15] << 8);
+
+    if (sizes[i] != (int)ArtNetInterface::DMX_PACKET_SIZE || memcmp(p, "Art-Net", 8) != 0 ||
+      p[8] != 0x00 || p[9] != 0x50 || p[12] != 1) {
+      cout << "Bad ArtDmx header\n";
+      ret = false;
+    }
+    if (universe == 1 && (p[18] != 255 || p[529] != 42)) {
+      cout << "Universe 1 has the wrong data\n";
+      ret = false;
+    }
+    if (universe != 0 && universe != 1) {
+      cout << "Unexpected universe " << universe << "\n";
+      ret = false;
+    }
+  }
+
+  if (sizes[2] != (int)ArtNetInterface::SYNC_PACKET_SIZE || packets[2][8] != 0x00 || packets[2][9] != 0x52) {
+    cout << "Bad ArtSync\n";
+    ret = false;
+  }
+
+  patch.close();
+  close(sock);
+
+  return ret;
+#else
+  return true;
+#endif
+}
+
+bool RigTests::kinetPorts() {
+#if defined(USE_KINET) && !defined(_WIN32)
+  bool ret = true;
+
+  // Local power supply on a free port
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if (sock < 0 || ::bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(sock, (sockaddr*)&addr, &len) != 0) {
+    cout << "Couldn't open a receiver\n";
+    return false;
+  }
+
+  timeval timeout = { 1, 0 };
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  // Ports 1 and 3 of the power supply get their own universes
+  DMXPatch saved;
+  KiNetInterface* iface = new KiNetInterface("kinet", "127.0.0.1", ntohs(addr.sin_port), KinetProtocolType::NEW);
+  iface->setPortUniverse(1, 0);
+  iface->setPortUniverse(3, 1);
+  saved.assignInterface(iface, 0);
+  saved.assignInterface("kinet", 1);
+
+  DMXPatch patch(saved.toJSON());
+  KiNetInterface* loaded = dynamic_cast<KiNetInterface*>(patch.getInterface("kinet"));
+  if (loaded == nullptr || loaded->getPortUniverse(1) != 0 || loaded->getPortUniverse(2) != -1 ||
+    loaded->getPortUniverse(3) != 1) {
+    cout << "KiNet port map wasn't loaded from JSON\n";
+    close(sock);
+    return false;
+  }
+
+  patch.setAsyncOutput(false);
+  patch.init();
+
+  // The first frame sends both universes, one packet per mapped port
+  vector<unsigned char> data(512, 7);
+  patch.setRawData(0, data);
+
+  unsigned char buf[1024];
+  int seen[16] = { 0 };
+  for (int i = 0; i < 2; i++) {
+    int size = (int)recv(sock, buf, sizeof(buf), 0);
+    if (size != (int)loaded->getPacketSize()) {
+      cout << "Bad packet size " << size << "\n";
+      ret = false;
+      break;
+    }
+
+    int port = buf[16];
+    unsigned char expected = (port == 1) ? 7 : 0;
+    if ((port != 1 && port != 3) || buf[24] != expected || buf[535] != expected) {
+      cout << "Port " << port << " has the wrong data\n";
+      ret = false;
+    }
+    seen[port & 0xf]++;
+  }
+
+  if (seen[1] != 1 || seen[3] != 1) {
+    cout << "Each mapped port should get one packet\n";
+    ret = false;
+  }
+
+  // Only the port of the universe that changed is sent next
+  data.assign(512, 9);
+  patch.setRawData(1, data);
+  if (recv(sock, buf, sizeof(buf), 0) <= 0 || buf[16] != 3 || buf[24] != 9) {
+    cout << "Port 3 wasn't updated\n";
+    ret = false;
+  }
+
+  // Nothing else should be waiting
+  timeval shortTimeout = { 0, 100000 };
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &shortTimeout, sizeof(shortTimeout));
+  if (recv(sock, buf, sizeof(buf), 0) > 0) {
+    cout << "Unmapped ports were sent\n";
+    ret = false;
+  }
+
+  patch.close();
+  close(sock);
+
+  return ret;
+#else
+  return true;
+#endif
+}
+
+bool RigTests::dmxInputMerge() {
+#ifndef _WIN32
+  bool ret = true;
+
+  DMXPatch patch;
+  CaptureInterface* iface = new CaptureInterface("capture");
+  patch.assignInterface(iface, 0);
+  patch.setAsyncOutput(false);
+  patch.setKeepAliveInterval(0);
+
+  // Console universe 3 merges into universe 0. Channels 0-9 HTP, 10-19 LTP, 20-29
+  // priority, 30 ignores the console.
+  ArtNetInput* console = new ArtNetInput("console", 0);
+  patch.addInput(console);
+  patch.setMergeSource(0, "console", 3);
+  patch.setMergeMode(0, MERGE_LTP, 10, 10);
+  patch.setMergeMode(0, MERGE_PRIORITY, 20, 10);
+  patch.setMergeMode(0, MERGE_OFF, 30, 1);
+
+  // A device reads channel 5 back from the console
+  Device par("par", 1, "par");
+  par.setParam("intensity", new LumiverseFloat());
+  patch.addParameter("par", "intensity", 5, FLOAT_TO_SINGLE);
+  patch.patchDevice("par", new DMXDevicePatch("par", 0, 0));
+
+  // Round trip through the rig JSON
+  DMXPatch loaded(patch.toJSON());
+  if (dynamic_cast<ArtNetInput*>(loaded.getInput("console")) == nullptr || loaded.getMergeMode(0, 9) != MERGE_HTP ||
+    loaded.getMergeMode(0, 10) != MERGE_LTP || loaded.getMergeMode(0, 29) != MERGE_PRIORITY ||
+    loaded.getMergeMode(0, 30) != MERGE_OFF || loaded.getMergeMode(1, 0) != MERGE_OFF) {
+    cout << "Merge settings weren't loaded from JSON\n";
+    ret = false;
+  }
+
+  patch.init();
+  if (!console->isRunning()) {
+    cout << "Input didn't start\n";
+    return false;
+  }
+
+  // Console sets every channel to 100
+  unsigned char packet[530] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0, 0x00, 0x50, 0, 14, 0, 0, 3, 0, 2, 0 };
+  memset(packet + 18, 100, 512);
+
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = htons((unsigned short)console->getPort());
+  sendto(sock, (const char*)packet, sizeof(packet), 0, (sockaddr*)&addr, sizeof(addr));
+
+  for (int i = 0; i < 100 && console->getPacketsReceived() == 0; i++)
+    this_thread::sleep_for(chrono::milliseconds(10));
+
+  vector<unsigned char> data(512, 0);
+  data[0] = 50;
+  data[1] = 200;
+  data[10] = 50;
+  data[20] = 150;
+  data[30] = 50;
+  patch.setRawData(0, data);
+
+  const vector<unsigned char>& out = iface->sent.back().second;
+  if (console->getPacketsReceived() != 1 || out[0] != 100 || out[1] != 200 || out[10] != 100 || out[20] != 150 ||
+    out[30] != 50 || out[511] != 100) {
+    cout << "Bad merge: " << (int)out[0] << " " << (int)out[1] << " " << (int)out[10] << " " << (int)out[20] << " "
+      << (int)out[30] << " " << (int)out[511] << "\n";
+    ret = false;
+  }
+
+  // The patch moved channel 10 last, and the console now has the higher priority
+  data[10] = 60;
+  patch.setOutputPriority(50);
+  patch.setRawData(0, data);
+  if (iface->sent.back().second[10] != 60 || iface->sent.back().second[20] != 100) {
+    cout << "LTP or priority merge is wrong\n";
+    ret = false;
+  }
+
+  if (patch.getUniverses()[0][0] != 50) {
+    cout << "Merge changed the device data\n";
+    ret = false;
+  }
+
+  // Input maps back onto the device
+  set<Device*> devices = { &par };
+  float intensity = -1;
+  par.getParam("intensity", intensity);
+  if (patch.applyInput(devices) != 1 || !par.getParam("intensity", intensity) || abs(intensity - 100 / 255.0f) > 0.001f) {
+    cout << "Input wasn't applied to the device: " << intensity << "\n";
+    ret = false;
+  }
+
+  // A silent console stops merging once it times out
+  console->setTimeout(0);
+  this_thread::sleep_for(chrono::milliseconds(5));
+  patch.setRawData(0, data);
+  if (iface->sent.back().second[0] != 50) {
+    cout << "Timed out input is still merged\n";
+    ret = false;
+  }
+
+  patch.close();
+  if (console->isRunning()) {
+    cout << "Input still running after close\n";
+    ret = false;
+  }
+
+#ifdef USE_SACN
+  // sACN carries its own priority
+  {
+    DMXPatch sacnPatch;
+    CaptureInterface* capture = new CaptureInterface("capture");
+    sacnPatch.assignInterface(capture, 0);
+    sacnPatch.setAsyncOutput(false);
+
+    SACNInput* input = new SACNInput("sacn", 0);
+    sacnPatch.addInput(input);
+    sacnPatch.setMergeSource(0, "sacn", 4);
+    sacnPatch.setMergeMode(0, MERGE_PRIORITY);
+    sacnPatch.init();
+
+    SACNInterface source("source", "Console", 180, "127.0.0.1", input->getPort());
+    source.init();
+    vector<unsigned char> level(512, 30);
+    source.sendDMX(&level.front(), 4);
+    source.flush();
+
+    for (int i = 0; i < 100 && input->getPacketsReceived() == 0; i++)
+      this_thread::sleep_for(chrono::milliseconds(10));
+
+    sacnPatch.setRawData(0, vector<unsigned char>(512, 90));
+    if (capture->sent.back().second[0] != 30 || capture->sent.back().second[511] != 30) {
+      cout << "Higher priority sACN input didn't take over\n";
+      ret = false;
+    }
+
+    source.closeInt();
+    sacnPatch.close();
+  }
+#endif
+
+  close(sock);
+  return ret;
+#else
+  return true;
+#endif
+}
+
+bool RigTests::dmxCurves() {
+  bool ret = true;
+
+  DMXCurve square(DMXCurve::SQUARE);
+  DMXCurve scurve(DMXCurve::S_CURVE);
+  DMXCurve custom(vector<float>({ 0, 0.5f, 1 }));
+
+  if (square.toSingle(0) != 0 || square.toSingle(0.5f) != 64 || square.toSingle(1) != 255 ||
+    scurve.toSingle(0.5f) != 128 || custom.toSingle(0.25f) != 64 || abs(square.toFine(0.5f) - 16384) > 1) {
+    cout << "Bad curve tables\n";
+    ret = false;
+  }
+
+  if (abs(square.inverse(0.25f) - 0.5f) > 0.001f) {
+    cout << "Bad inverse: " << square.inverse(0.25f) << "\n";
+    ret = false;
+  }
+
+  DMXPatch patch;
+  patch.assignInterface(new CaptureInterface("capture"), 0);
+  patch.setAsyncOutput(false);
+  patch.addParameter("par", "intensity", 0, FLOAT_TO_SINGLE);
+  patch.addParameter("par", "fine", 1, FLOAT_TO_FINE);
+  patch.addParameter("par", "red", 3, RGB_REPEAT2);
+  patch.patchDevice("par", new DMXDevicePatch("par", 10, 0));
+
+  patch.addCurve("led", make_shared<DMXCurve>(vector<float>({ 0, 0.1f, 1 })));
+  if (!patch.setParameterCurve("par", "intensity", "square") || !patch.setParameterCurve("par", "fine", "square") ||
+    !patch.setParameterCurve("par", "red", "led") || patch.setParameterCurve("par", "red", "missing")) {
+    cout << "Couldn't set curves\n";
+    ret = false;
+  }
+
+  Device par("par", 1, "par");
+  par.setParam("intensity", new LumiverseFloat(0.5f));
+  par.setParam("fine", new LumiverseFloat(0.5f));
+  par.setParam("red", new LumiverseFloat(0.5f));
+  set<Device*> devices = { &par };
+
+  // Curves are applied on the way out, the device keeps its value
+  patch.update(devices);
+  vector<unsigned char> uni = patch.getUniverses()[0];
+  if (uni[10] != 64 || abs(((uni[11] << 8) | uni[12]) - 16384) > 1 || uni[13] != 26 || uni[16] != 26) {
+    cout << "Curves weren't applied: " << (int)uni[10] << " " << ((uni[11] << 8) | uni[12]) << " " << (int)uni[13] << "\n";
+    ret = false;
+  }
+
+  // Curves and their use are saved with the rig
+  DMXPatch loaded(patch.toJSON());
+  loaded.assignInterface(new CaptureInterface("capture"), 0);
+  loaded.setAsyncOutput(false);
+  loaded.update(devices);
+  if (loaded.getCurve("led") == nullptr || loaded.getCurve("led")->getShape() != DMXCurve::CUSTOM ||
+    loaded.getUniverses()[0] != uni) {
+    cout << "Curves weren't loaded from JSON\n";
+    ret = false;
+  }
+
+  // Replacing a curve updates the maps that use it
+  patch.addCurve("led", make_shared<DMXCurve>(DMXCurve::LINEAR));
+  patch.update(devices);
+  if (patch.getUniverses()[0][13] != 128) {
+    cout << "Replaced curve wasn't used\n";
+    ret = false;
+  }
+
+  return ret;
+}
+
+bool RigTests::dmxUniverseSlab() {
+  bool ret = true;
+
+  // A pixel mapped wall with 10000 universes on one interface, patched from the top down
+  DMXPatch patch;
+  patch.setAsyncOutput(false);
+  CaptureInterface* iface = new CaptureInterface("wall");
+  patch.addInterface(iface);
+
+  auto start = chrono::steady_clock::now();
+  for (int u = 9999; u >= 0; u--) {
+    patch.assignInterface("wall", u * 2);
+  }
+  double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  const DMXUniverseSlab& slab = patch.getUniverseSlab();
+  if (slab.size() != 10000 || slab.range() != 19999 || ((uintptr_t)slab.data() % DMXUniverseSlab::ALIGNMENT) != 0) {
+    cout << "Bad slab: " << slab.size() << " universes, range " << slab.range() << "\n";
+    ret = false;
+  }
+
+  if (ms > 2000) {
+    cout << "Assigning 10000 universes took " << ms << "ms\n";
+    ret = false;
+  }
+
+  // Universes nobody outputs have no storage
+  if (patch.getUniverse(1) != nullptr || patch.getUniverse(20000) != nullptr || patch.getUniverse(19998) == nullptr ||
+    patch.setRawData(1, vector<unsigned char>(512, 1))) {
+    cout << "Sparse universes aren't mapped right\n";
+    ret = false;
+  }
+
+  // Every universe goes out once, then only the one that changed
+  patch.setRawData(19998, vector<unsigned char>(512, 5));
+  patch.setRawData(0, vector<unsigned char>(512, 6));
+
+  if (iface->sent.size() != 10001 || iface->sent.back().first != 0 || iface->sent.back().second[511] != 6 ||
+    patch.getUniverse(19998)[0] != 5) {
+    cout << "Wrong universes were sent: " << iface->sent.size() << " sends\n";
+    ret = false;
+  }
+
+  int found = 0;
+  for (const auto& sent : iface->sent) {
+    if (sent.first == 19998 && sent.second[0] == 5)
+      found++;
+  }
+  if (found != 1) {
+    cout << "Universe 19998 wasn't sent\n";
+    ret = false;
+  }
+
+  // Moving an interface to a new universe gives it storage
+  patch.moveInterface("wall", 0, 30000);
+  if (patch.getUniverse(30000) == nullptr || !patch.setRawData(30000, vector<unsigned char>(512, 7)) ||
+    iface->sent.back().first != 30000) {
+    cout << "Moved universe wasn't sent\n";
+    ret = false;
+  }
+
+  // Universes nobody outputs anymore give their storage back
+  if (patch.getUniverse(0) != nullptr || slab.size() != 10000) {
+    cout << "Universe 0 was kept after its interface moved\n";
+    ret = false;
+  }
+
+  for (int u = 0; u < 9999; u++) {
+    patch.removeInterface(u * 2, "wall");
+  }
+
+  const vector<vector<unsigned char> >& universes = patch.getUniverses();
+  if (slab.size() != 2 || slab.range() != 30001 || patch.getUniverse(19998) == nullptr ||
+    patch.getUniverse(19998)[0] != 5 || ((uintptr_t)slab.data() % DMXUniverseSlab::ALIGNMENT) != 0) {
+    cout << "Removed universes weren't released: " << slab.size() << " universes, range " << slab.range() << "\n";
+    ret = false;
+  }
+
+  if (universes.size() != 30001 || universes[19998][0] != 5 || universes[30000][0] != 7 || universes[0][0] != 0 ||
+    &patch.getUniverses() != &universes) {
+    cout << "getUniverses() doesn't match the slab\n";
+    ret = false;
+  }
+
+  size_t sends = iface->sent.size();
+  patch.setRawData(30000, vector<unsigned char>(512, 8));
+  if (iface->sent.size() != sends + 2) {
+    cout << "Remaining universes weren't sent after their slots moved\n";
+    ret = false;
+  }
+
+  return ret;
+}
+
+bool RigTests::oscBundles() {
+#if defined(USE_OSC) && !defined(_WIN32)
+  bool ret = true;
+
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if (sock < 0 || ::bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(sock, (sockaddr*)&addr, &len) != 0) {
+    cout << "Couldn't open a receiver\n";
+    return false;
+  }
+
+  timeval timeout = { 0, 200000 };
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  set<Device*> devices;
+  for (int i = 0; i < 100; i++) {
+    Device* d = new Device("d" + to_string(i), i + 1, "test");
+    d->setParam("intensity", new LumiverseFloat());
+    devices.insert(d);
+  }
+
+  // Reads packets until none arrive, returning the message addresses
+  auto receive = [&](int& packets, size_t& largest) {
+    vector<string> addresses;
+    char buf[65536];
+    packets = 0;
+    largest = 0;
+    int size;
+    while ((size = (int)recv(sock, buf, sizeof(buf), 0)) > 0) {
+      packets++;
+      largest = max(largest, (size_t)size);
+      osc::ReceivedPacket packet(buf, size);
+      if (packet.IsBundle()) {
+        osc::ReceivedBundle bundle(packet);
+        for (auto e = bundle.ElementsBegin(); e != bundle.ElementsEnd(); e++)
+          addresses.push_back(osc::ReceivedMessage(*e).AddressPattern());
+      }
+      else {
+        addresses.push_back(osc::ReceivedMessage(packet).AddressPattern());
+      }
+    }
+    return addresses;
+  };
+
+  OscPatch patch("127.0.0.1", ntohs(addr.sin_port), PREFIXED_ADDR, "lv");
+  patch.setKeepAliveInterval(10000);
+  patch.init();
+
+  // Everything goes out the first time, packed into bundles no bigger than the MTU
+  int packets;
+  size_t largest;
+  patch.update(devices);
+  vector<string> addresses = receive(packets, largest);
+  if (addresses.size() != 100 || packets < 2 || packets > 10 || (size_t)packets != patch.getPacketsSent() ||
+    largest > OscPatch::DEFAULT_MAX_PACKET_SIZE) {
+    cout << "First update sent " << addresses.size() << " messages in " << packets << " packets of up to " << largest << " bytes\n";
+    ret = false;
+  }
+
+  // Only the changed device goes out after that
+  Device* changed = nullptr;
+  for (auto d : devices) {
+    if (d->getId() == "d5")
+      changed = d;
+  }
+  changed->setParam("intensity", 0.5f);
+
+  patch.update(devices);
+  addresses = receive(packets, largest);
+  if (addresses.size() != 1 || addresses[0] != "/lv/d5" || patch.getMessagesSaved() != 99) {
+    cout << "Expected only /lv/d5, got " << addresses.size() << " messages\n";
+    ret = false;
+  }
+
+  // Updates faster than the send rate are skipped, changes go out with the next send
+  patch.setSendRate(1);
+  changed->setParam("intensity", 0.75f);
+  patch.update(devices);
+  patch.setSendRate(0);
+  if (patch.getMessagesSent() != 101) {
+    cout << "Update wasn't skipped by the send rate\n";
+    ret = false;
+  }
+  patch.update(devices);
+  addresses = receive(packets, largest);
+  if (addresses.size() != 1 || addresses[0] != "/lv/d5") {
+    cout << "Change made between sends was lost\n";
+    ret = false;
+  }
+
+  // Messages too big for a bundle go out on their own
+  patch.setMaxPacketSize(32);
+  patch.setKeepAliveInterval(0);
+  patch.update(devices);
+  addresses = receive(packets, largest);
+  if (addresses.size() != 100 || packets != 100) {
+    cout << "Oversized messages weren't sent alone\n";
+    ret = false;
+  }
+
+  OscPatch loaded(patch.toJSON());
+  if (loaded.getMaxPacketSize() != 32 || loaded.getKeepAliveInterval() != 0 || loaded.getSendRate() != 0) {
+    cout << "OSC settings weren't loaded from JSON\n";
+    ret = false;
+  }
+
+  patch.close();
+  close(sock);
+  for (auto d : devices)
+    delete d;
+
+  return ret;
+#else
+  return true;
+#endif
+}
+
+bool RigTests::oscInput() {
+#if defined(USE_OSC) && !defined(_WIN32)
+  bool ret = true;
+
+  // Find a free port for the server
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if (sock < 0 || ::bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(sock, (sockaddr*)&addr, &len) != 0) {
+    cout << "Couldn't find a free port\n";
+    return false;
+  }
+  close(sock);
+  int port = ntohs(addr.sin_port);
+
+  map<string, Device*> devices;
+  for (string id : { "a", "b", "c" }) {
+    devices[id] = new Device(id, 1, "test");
+    devices[id]->setParam("intensity", new LumiverseFloat());
+  }
+
+  OscPatch patch("127.0.0.1", port);
+  patch.changeInPort(port);
+  patch.setReceive(true);
+  patch.init();
+
+  if (!patch.isReceiving()) {
+    cout << "OSC server didn't start\n";
+    ret = false;
+  }
+
+  sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  auto send = [&](const osc::OutboundPacketStream& p) {
+    sendto(sock, p.Data(), p.Size(), 0, (sockaddr*)&addr, sizeof(addr));
+  };
+
+  char buf[512];
+  osc::OutboundPacketStream select(buf, sizeof(buf));
+  select << osc::BeginMessage("/lumiverse/select") << "a" << "b" << osc::EndMessage;
+  send(select);
+
+  // Set the selection and a single device in one bundle
+  osc::OutboundPacketStream bundle(buf, sizeof(buf));
+  bundle << osc::BeginBundleImmediate;
+  bundle << osc::BeginMessage("/lumiverse/selected/intensity") << 0.5f << osc::EndMessage;
+  bundle << osc::BeginMessage("/lumiverse/c/intensity") << 1 << osc::EndMessage;
+  bundle << osc::EndBundle;
+  send(bundle);
+
+  osc::OutboundPacketStream ignored(buf, sizeof(buf));
+  ignored << osc::BeginMessage("/other/a/intensity") << 0.1f << osc::EndMessage;
+  send(ignored);
+
+  for (int i = 0; i < 200 && patch.getCommandsReceived() < 3; i++) {
+    this_thread::sleep_for(chrono::milliseconds(5));
+  }
+  this_thread::sleep_for(chrono::milliseconds(20));
+
+  if (patch.getCommandsReceived() != 3) {
+    cout << "Expected 3 commands, received " << patch.getCommandsReceived() << "\n";
+    ret = false;
+  }
+
+  // Nothing changes until the commands are applied
+  if (devices["a"]->getIntensity()->getVal() != 0) {
+    cout << "Command was applied outside the update loop\n";
+    ret = false;
+  }
+
+  set<string> changed = patch.applyCommands(devices);
+  if (changed != set<string>({ "a", "b", "c" }) || devices["a"]->getIntensity()->getVal() != 0.5f ||
+    devices["b"]->getIntensity()->getVal() != 0.5f || devices["c"]->getIntensity()->getVal() != 1) {
+    cout << "Commands weren't applied to the right devices\n";
+    ret = false;
+  }
+
+  if (patch.getSelection() != set<string>({ "a", "b" })) {
+    cout << "Wrong selection\n";
+    ret = false;
+  }
+
+  patch.close();
+  close(sock);
+  if (patch.isReceiving()) {
+    cout << "OSC server didn't stop\n";
+    ret = false;
+  }
+
+  // An Eos patch with the pattern "eos" binds the configured address and leaves console replies alone
+  OscPatch eos("127.0.0.1", port, ETC_EOS, "eos");
+  eos.changeInPort(port);
+  eos.changeInAddress("127.0.0.1");
+  eos.setReceive(true);
+  eos.init();
+
+  if (!eos.isReceiving() || OscPatch(eos.toJSON()).getInAddress() != "127.0.0.1") {
+    cout << "Eos OSC server didn't bind the configured address\n";
+    ret = false;
+  }
+
+  sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  osc::OutboundPacketStream reply(buf, sizeof(buf));
+  reply << osc::BeginMessage("/eos/out/active/chan") << "1 [50]" << osc::EndMessage;
+  send(reply);
+
+  osc::OutboundPacketStream cmd(buf, sizeof(buf));
+  cmd << osc::BeginMessage("/eos/c/intensity") << 0.25f << osc::EndMessage;
+  send(cmd);
+
+  for (int i = 0; i < 200 && eos.getCommandsReceived() < 1; i++) {
+    this_thread::sleep_for(chrono::milliseconds(5));
+  }
+  this_thread::sleep_for(chrono::milliseconds(20));
+
+  if (eos.getCommandsReceived() != 1) {
+    cout << "Expected 1 Eos patch command, received " << eos.getCommandsReceived() << "\n";
+    ret = false;
+  }
+
+  eos.close();
+  close(sock);
+
+  for (auto& d : devices)
+    delete d.second;
+
+  return ret;
+#else
+  return true;
+#endif
+}
+
+bool RigTests::oscEosCoalescing() {
+#if defined(USE_OSC) && !defined(_WIN32)
+  bool ret = true;
+
+  int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if (sock < 0 || ::bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(sock, (sockaddr*)&addr, &len) != 0) {
+    cout << "Couldn't open a receiver\n";
+    return false;
+  }
+
+  timeval timeout = { 0, 200000 };
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  // Reads packets until none arrive, returning the command lines sent
+  auto receive = [&]() {
+    vector<string> cmds;
+    char buf[1024];
+    int size;
+    while ((size = (int)recv(sock, buf, sizeof(buf), 0)) > 0) {
+      osc::ReceivedMessage m(osc::ReceivedPacket(buf, size));
+      if (string(m.AddressPattern()) == "/eos/newcmd")
+        cmds.push_back(m.ArgumentsBegin()->AsString());
+      else
+        cmds.push_back(m.AddressPattern());
+    }
+    return cmds;
+  };
+
+  set<Device*> devices;
+  map<int, Device*> chans;
+  for (int i = 1; i <= 50; i++) {
+    Device* d = new Device("d" + to_string(i), i, "test");
+    d->setParam("intensity", new LumiverseFloat());
+    devices.insert(d);
+    chans[i] = d;
+  }
+
+  OscPatch patch("127.0.0.1", ntohs(addr.sin_port), ETC_EOS);
+  patch.setEosCommandWindow(0);
+  patch.init();
+
+  // Everything goes out once, as a single command
+  patch.update(devices);
+  vector<string> cmds = receive();
+  if (cmds != vector<string>({ "/eos/user", "Chan 1 Thru 50 At 00#" })) {
+    cout << "Wrong initial commands: " << cmds.size() << "\n";
+    ret = false;
+  }
+
+  // Channels going to the same level are grouped
+  for (int i = 1; i <= 40; i++)
+    chans[i]->setParam("intensity", 0.5f);
+  chans[45]->setParam("intensity", 0.5f);
+  chans[47]->setParam("intensity", 0.05f);
+
+  patch.update(devices);
+  cmds = receive();
+  if (cmds != vector<string>({ "Chan 47 At 05#", "Chan 1 Thru 40 + 45 At 50#" }) || patch.getEosCommandsLastFrame() != 2) {
+    cout << "Wrong grouped commands:";
+    for (auto& c : cmds)
+      cout << " '" << c << "'";
+    cout << "\n";
+    ret = false;
+  }
+
+  // Nothing changed, nothing sent
+  patch.update(devices);
+  if (!receive().empty() || patch.getEosCommandsLastFrame() != 0) {
+    cout << "Unchanged channels were sent\n";
+    ret = false;
+  }
+
+  // Colors select their channels first
+  chans[3]->setParam("color", new LumiverseColor(BASIC_RGB));
+  chans[3]->setColorRGBRaw("color", 1, 0, 0);
+  patch.update(devices);
+  cmds = receive();
+  if (cmds != vector<string>({ "Chan 3#", "/eos/color/rgb" })) {
+    cout << "Color change wasn't sent\n";
+    ret = false;
+  }
+
+  // Changes past the window wait for the next update
+  patch.setEosCommandWindow(1);
+  chans[1]->setParam("intensity", 0.1f);
+  chans[2]->setParam("intensity", 0.2f);
+  patch.update(devices);
+  cmds = receive();
+  patch.update(devices);
+  vector<string> next = receive();
+  if (cmds != vector<string>({ "Chan 1 At 10#" }) || next != vector<string>({ "Chan 2 At 20#" })) {
+    cout << "Command window wasn't respected\n";
+    ret = false;
+  }
+
+  if (patch.getEosCommandsSent() != 7) {
+    cout << "Expected 7 commands, counted " << patch.getEosCommandsSent() << "\n";
+    ret = false;
+  }
+
+  patch.close();
+
+  // With a server, the window holds the command lines the console hasn't echoed yet
+  int server = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in serverAddr = addr;
+  serverAddr.sin_port = 0;
+  len = sizeof(serverAddr);
+  if (server < 0 || ::bind(server, (sockaddr*)&serverAddr, sizeof(serverAddr)) != 0 ||
+    getsockname(server, (sockaddr*)&serverAddr, &len) != 0) {
+    cout << "Couldn't find a free port\n";
+    ret = false;
+  }
+  close(server);
+
+  OscPatch acked("127.0.0.1", ntohs(addr.sin_port), ETC_EOS);
+  acked.changeInPort(ntohs(serverAddr.sin_port));
+  acked.setReceive(true);
+  acked.setEosCommandWindow(0);
+  acked.init();
+  acked.update(devices);
+  cmds = receive();
+
+  // Acknowledges one command line, the way Eos echoes it
+  auto ack = [&]() {
+    char buf[64];
+    osc::OutboundPacketStream p(buf, sizeof(buf));
+    p << osc::BeginMessage("/eos/out/cmd") << "" << osc::EndMessage;
+    sendto(sock, p.Data(), p.Size(), 0, (sockaddr*)&serverAddr, sizeof(serverAddr));
+  };
+  auto waitPending = [&](size_t pending) {
+    for (int i = 0; i < 200 && acked.getEosCommandsPending() != pending; i++)
+      this_thread::sleep_for(chrono::milliseconds(5));
+    return acked.getEosCommandsPending() == pending;
+  };
+
+  for (auto& c : cmds) {
+    if (c.back() == '#')
+      ack();
+  }
+  if (!waitPending(0)) {
+    cout << "Initial Eos commands weren't acknowledged\n";
+    ret = false;
+  }
+  acked.setEosCommandWindow(2);
+
+  // Color messages aren't echoed, so two color groups fit in a window of two
+  chans[4]->setParam("color", new LumiverseColor(BASIC_RGB));
+  chans[4]->setColorRGBRaw("color", 0, 1, 0);
+  chans[5]->setParam("color", new LumiverseColor(BASIC_RGB));
+  chans[5]->setColorRGBRaw("color", 0, 0, 1);
+  acked.update(devices);
+  cmds = receive();
+  if (cmds != vector<string>({ "Chan 5#", "/eos/color/rgb", "Chan 4#", "/eos/color/rgb" }) ||
+    acked.getEosCommandsPending() != 2) {
+    cout << "Color messages held the Eos command window: " << cmds.size() << " sent, " <<
+      acked.getEosCommandsPending() << " pending\n";
+    ret = false;
+  }
+
+  // The console only gets to one of them, so one new command fits
+  ack();
+  waitPending(1);
+  chans[1]->setParam("intensity", 0.3f);
+  chans[2]->setParam("intensity", 0.4f);
+  acked.update(devices);
+  cmds = receive();
+  if (cmds != vector<string>({ "Chan 1 At 30#" }) || acked.getEosCommandsPending() != 2) {
+    cout << "Unacknowledged commands didn't hold the window: " << cmds.size() << " sent\n";
+    ret = false;
+  }
+
+  // Nothing goes out until the console catches up
+  acked.update(devices);
+  if (!receive().empty()) {
+    cout << "Commands were sent past the window\n";
+    ret = false;
+  }
+
+  ack();
+  waitPending(1);
+  acked.update(devices);
+  cmds = receive();
+  if (cmds != vector<string>({ "Chan 2 At 40#" })) {
+    cout << "Acknowledged command didn't open the window\n";
+    ret = false;
+  }
+
+  acked.close();
+  close(sock);
+  for (auto d : devices)
+    delete d;
+
+  return ret;
+#else
+  return true;
+#endif
+}
+
+bool RigTests::photoAccumulator() {
+  bool ret = true;
+
+  // Odd number of pixels so no tile size divides it evenly
+  const size_t numPixels = 5003;
+  const size_t numLights = 7;
+
+  vector<vector<float> > photos(numLights, vector<float>(numPixels * 4));
+  vector<PhotoAccumulator::Light> lights(numLights);
+  for (size_t l = 0; l < numLights; l++) {
+    for (size_t i = 0; i < numPixels * 4; i++)
+      photos[l][i] = (float)((i * 31 + l * 17) % 101) / 100;
+
+    lights[l].photo = photos[l].data();
+    for (int ch = 0; ch < 4; ch++)
+      lights[l].scale[ch] = 0.1f * (l + 1) + 0.05f * ch;
+  }
+
+  vector<double> expected(numPixels * 4, 0);
+  for (size_t l = 0; l < numLights; l++) {
+    for (size_t i = 0; i < numPixels * 4; i++)
+      expected[i] += photos[l][i] * lights[l].scale[i % 4];
+  }
+
+  PhotoAccumulator acc(make_shared<ThreadPool>(4));
+  vector<float> out(numPixels * 4);
+
+  for (size_t tile : { (size_t)1, (size_t)3, (size_t)64, PhotoAccumulator::DEFAULT_TILE_SIZE, numPixels * 2 }) {
+    acc.setTileSize(tile);
+    fill(out.begin(), out.end(), -1.f);
+
+    if (!acc.accumulate(out.data(), numPixels, lights)) {
+      cout << "Uninterrupted accumulate returned false with tile size " << tile << "\n";
+      ret = false;
+    }
+
+    for (size_t i = 0; i < numPixels * 4; i++) {
+      if (abs(out[i] - expected[i]) > 1e-4) {
+        cout << "Pixel " << i / 4 << " channel " << i % 4 << " is " << out[i] << ", expected "
+          << expected[i] << " with tile size " << tile << "\n";
+        ret = false;
+        break;
+      }
+    }
+  }
+
+  // No lights clears the image
+  acc.accumulate(out.data(), numPixels, vector<PhotoAccumulator::Light>());
+  for (float f : out) {
+    if (f != 0) {
+      cout << "Accumulating no lights didn't clear the image\n";
+      ret = false;
+      break;
+    }
+  }
+
+  // The first interrupt stops every remaining tile
+  acc.setTileSize(16);
+  atomic<int> calls(0);
+  bool finished = acc.accumulate(out.data(), numPixels, lights, [&]() { return ++calls > 5; });
+  if (finished) {
+    cout << "Interrupted accumulate returned true\n";
+    ret = false;
+  }
+  if (calls >= (int)(numPixels / 16)) {
+    cout << "Interrupt was checked " << calls << " times, tiles weren't skipped\n";
+    ret = false;
+  }
+
+  cout << "Instruction set: " << PhotoAccumulator::getInstructionSet() << "\n";
+
+  return ret;
+}
@@ -21,7 +21,7 @@ private:
   bool runTest(std::function<bool()> t, string testName, int testNum);
 
   // Update when new tests are written.
-  static const int m_numTests = 12;
+  static const int m_numTests = 26;
 
   // Initialized in rigStart()
   Rig* m_testRig;
@@ -39,6 +39,20 @@ private:
   bool queryMixed();
   bool queryFilter();
   bool dynamicQuery();
+  bool profileUpdate();
+  bool dmxShowRecordReplay();
+  bool dmxOutputThreads();
+  bool dmxKeepAlive();
+  bool sacnLoopback();
+  bool artnetLoopback();
+  bool kinetPorts();
+  bool dmxInputMerge();
+  bool dmxCurves();
+  bool dmxUniverseSlab();
+  bool oscBundles();
+  bool oscInput();
+  bool oscEosCoalescing();
+  bool photoAccumulator();
 
   // Reserved for future use.
   bool queryComplex();
@@ -7,6 +7,7 @@ int TypeTests::runTests() {
   (runTest([=]{ return this->enumTests(); }, "enumTests", 2)) ? numPassed++ : numPassed;
   (runTest([=]{ return this->colorTests(); }, "colorTests", 3)) ? numPassed++ : numPassed;
   (runTest([=]{ return this->oriTests(); }, "oriTests", 4)) ? numPassed++ : numPassed;
+  (runTest([=]{ return this->colorBatchTests(); }, "colorBatchTests", 5)) ? numPassed++ : numPassed;
 
   return numPassed;
 }
@@ -292,3 +293,77 @@ bool TypeTests::oriTests() {
 
   return ret;
 }
+
+bool TypeTests::colorBatchTests() {
+  bool ret = true;
+
+  map<string, Eigen::Vector3d> basis;
+  basis["Blue"] = Eigen::Vector3d(4.30497, 3.859103, 29.365243);
+  basis["Green"] = Eigen::Vector3d(5.59857, 25.901501, 4.084567);
+  basis["Red"] = Eigen::Vector3d(13.16544, 5.868346, 0.000025);
+  basis["White"] = Eigen::Vector3d(81.33195, 79.590576, 47.302138);
+
+  LumiverseColor c1(basis);
+  LumiverseColor c2(basis);
+  LumiverseColor c3(basis);
+  c1["Red"] = 1;
+  c2["Green"] = 0.25;
+  c2["Blue"] = 0.75;
+  c3["White"] = 0.001;
+
+  vector<LumiverseColor*> colors = { &c1, &c2, &c3 };
+  vector<double> rgb(colors.size() * 3);
+  LumiverseColor::getRGB(colors, rgb.data());
+
+  // Batch results should match the per-color conversions
+  for (size_t i = 0; i < colors.size(); i++) {
+    Eigen::Vector3d expected = colors[i]->getRGB();
+    Eigen::Vector3d actual(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]);
+
+    if ((expected - actual).norm() > 1e-9) {
+      cout << "Batch getRGB mismatch for color " << i << ". Expected: " << expected.transpose() << ". Received: " << actual.transpose() << "\n";
+      ret = false;
+    }
+  }
+
+  vector<double> xyz = { c1.getX(), c1.getY(), c1.getZ(), c2.getX(), c2.getY(), c2.getZ() };
+  vector<double> out(xyz.size());
+
+  ColorUtils::convXYZtoLab(xyz.data(), out.data(), 2, refWhites[D65]);
+  ColorUtils::convLabtoLCHab(out.data(), out.data(), 2);
+  for (size_t i = 0; i < 2; i++) {
+    Eigen::Vector3d expected = colors[i]->getLCHab(D65);
+    Eigen::Vector3d actual(out[i * 3], out[i * 3 + 1], out[i * 3 + 2]);
+
+    if ((expected - actual).norm() > 1e-9) {
+      cout << "Batch LCHab mismatch for color " << i << ". Expected: " << expected.transpose() << ". Received: " << actual.transpose() << "\n";
+      ret = false;
+    }
+  }
+
+  ColorUtils::convXYZtoRGB(xyz.data(), out.data(), 2);
+  ColorUtils::convRGBtoHSV(out.data(), out.data(), 2);
+  for (size_t i = 0; i < 2; i++) {
+    Eigen::Vector3d expected = colors[i]->getHSV();
+    Eigen::Vector3d actual(out[i * 3], out[i * 3 + 1], out[i * 3 + 2]);
+
+    if ((expected - actual).norm() > 1e-9) {
+      cout << "Batch HSV mismatch for color " << i << ". Expected: " << expected.transpose() << ". Received: " << actual.transpose() << "\n";
+      ret = false;
+    }
+  }
+
+  // Round trip through the cached inverse
+  vector<double> rgbIn = { 0.2, 0.4, 0.6, 1, 0, 0.5 };
+  ColorUtils::convRGBtoXYZ(rgbIn.data(), out.data(), 2);
+  for (auto& v : out) v *= 100;
+  ColorUtils::convXYZtoRGB(out.data(), out.data(), 2);
+  for (size_t i = 0; i < rgbIn.size(); i++) {
+    if (abs(out[i] - rgbIn[i]) > 1e-6) {
+      cout << "RGB -> XYZ -> RGB round trip failed. Expected: " << rgbIn[i] << ". Received: " << out[i] << "\n";
+      ret = false;
+    }
+  }
+
+  return ret;
+}
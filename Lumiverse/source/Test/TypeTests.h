@@ -21,11 +21,12 @@ private:
   bool runTest(std::function<bool()> t, string testName, int testNum);
 
   // Update when new tests are written.
-  static const int m_numTests = 4;
+  static const int m_numTests = 5;
 
   // Test functions
   bool floatTests();
   bool enumTests();
   bool colorTests();
   bool oriTests();
+  bool colorBatchTests();
 };
\ No newline at end of file